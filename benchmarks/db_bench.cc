@@ -41,6 +41,7 @@
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/memtablerep.h"
 #include "leveldb/write_batch.h"
 #include "port/port.h"
 #include "util/crc32c.h"
@@ -64,6 +65,8 @@
 //      readreverse   -- read N times in reverse order
 //      readrandom    -- read N times in random order
 //      readmissing   -- read N missing keys in random order
+//      multireadrandom -- read N times in random order, in batches of
+//                         --multiget_batch_size keys per DB::MultiGet()
 //      readhot       -- read N times in random order from 1% section of DB
 //      seekrandom    -- N random seeks
 //      open          -- cost of opening a DB
@@ -126,6 +129,10 @@ static int FLAGS_block_size = 0;
 // Negative means use default settings.
 static int FLAGS_cache_size = -1;
 
+// Fraction of the cache reserved for index, filter and frequently used
+// blocks.
+static double FLAGS_cache_high_pri_pool_ratio = 0;
+
 // Maximum number of files to keep open at the same time (use default if == 0)
 static int FLAGS_open_files = 0;
 
@@ -133,6 +140,24 @@ static int FLAGS_open_files = 0;
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
 
+// If true, write data blocks with a hash index for point lookups.
+static bool FLAGS_data_block_hash_index = false;
+
+// If true, store the key prefixes of restart points in every block.
+static bool FLAGS_restart_key_prefixes = false;
+
+// If true, partition the index and filter blocks of every table.
+static bool FLAGS_partition_index_and_filters = false;
+
+// Readahead of readseq and readreverse scans (0: none).
+static int FLAGS_readahead_size = 0;
+
+// Readahead of compaction inputs (use default if < 0).
+static int FLAGS_compaction_readahead_size = -1;
+
+// Values of at least this many bytes go to blob files (0: none).
+static int FLAGS_min_blob_size = 0;
+
 // If true, do not destroy the existing database.  If you set this
 // flag and also specify a benchmark that wants a fresh database, that
 // benchmark will fail.
@@ -141,6 +166,36 @@ static bool FLAGS_use_existing_db = false;
 // If true, reuse existing log/MANIFEST files when re-opening a database.
 static bool FLAGS_reuse_logs = false;
 
+// If true, overlap logging and memtable insertion of concurrent writers.
+static bool FLAGS_enable_pipelined_write = false;
+
+// Write rate in bytes per second once compactions fall behind.
+// (initialized to default value by "main")
+static int FLAGS_delayed_write_rate = 0;
+
+// Pending compaction bytes above which writes are delayed.
+// (initialized to default value by "main")
+static int FLAGS_soft_pending_compaction_bytes_limit = 0;
+
+// Number of keys looked up per DB::MultiGet() call in multireadrandom.
+static int FLAGS_multiget_batch_size = 100;
+
+// If true, write batches refer to the values instead of copying them.
+static bool FLAGS_reference_values = false;
+
+// If true, do not record writes in the log file.
+static bool FLAGS_disable_wal = false;
+
+// If true, append log records from a dedicated background thread.
+static bool FLAGS_enable_wal_thread = false;
+
+// Microseconds the log thread waits for more sync writers before a sync.
+static int FLAGS_wal_sync_window_micros = 0;
+
+// Memtable representation: "skiplist", "vector", "vector_index" or "hash".
+// Null means use the default.
+static const char* FLAGS_memtable_rep = nullptr;
+
 // Use the db with the following name.
 static const char* FLAGS_db = nullptr;
 
@@ -344,12 +399,29 @@ struct ThreadState {
   ThreadState(int index) : tid(index), rand(1000 + index), shared(nullptr) {}
 };
 
+const MemTableRepFactory* NewMemTableRepFactory(const char* name) {
+  if (name == nullptr) {
+    return nullptr;
+  } else if (strcmp(name, "skiplist") == 0) {
+    return NewSkipListRepFactory();
+  } else if (strcmp(name, "vector") == 0) {
+    return NewVectorRepFactory(false);
+  } else if (strcmp(name, "vector_index") == 0) {
+    return NewVectorRepFactory(true);
+  } else if (strcmp(name, "hash") == 0) {
+    return NewHashSkipListRepFactory(1 << 20);
+  }
+  fprintf(stderr, "Unknown memtable representation '%s'\n", name);
+  exit(1);
+}
+
 }  // namespace
 
 class Benchmark {
  private:
   Cache* cache_;
   const FilterPolicy* filter_policy_;
+  const MemTableRepFactory* memtable_factory_;
   DB* db_;
   int num_;
   int value_size_;
@@ -434,10 +506,14 @@ class Benchmark {
 
  public:
   Benchmark()
-      : cache_(FLAGS_cache_size >= 0 ? NewLRUCache(FLAGS_cache_size) : nullptr),
+      : cache_(FLAGS_cache_size >= 0
+                   ? NewLRUCache(FLAGS_cache_size,
+                                 FLAGS_cache_high_pri_pool_ratio)
+                   : nullptr),
         filter_policy_(FLAGS_bloom_bits >= 0
                            ? NewBloomFilterPolicy(FLAGS_bloom_bits)
                            : nullptr),
+        memtable_factory_(NewMemTableRepFactory(FLAGS_memtable_rep)),
         db_(nullptr),
         num_(FLAGS_num),
         value_size_(FLAGS_value_size),
@@ -460,6 +536,7 @@ class Benchmark {
     delete db_;
     delete cache_;
     delete filter_policy_;
+    delete memtable_factory_;
   }
 
   void Run() {
@@ -484,6 +561,7 @@ class Benchmark {
       value_size_ = FLAGS_value_size;
       entries_per_batch_ = 1;
       write_options_ = WriteOptions();
+      write_options_.disable_wal = FLAGS_disable_wal;
 
       void (Benchmark::*method)(ThreadState*) = nullptr;
       bool fresh_db = false;
@@ -522,6 +600,8 @@ class Benchmark {
         method = &Benchmark::ReadReverse;
       } else if (name == Slice("readrandom")) {
         method = &Benchmark::ReadRandom;
+      } else if (name == Slice("multireadrandom")) {
+        method = &Benchmark::MultiReadRandom;
       } else if (name == Slice("readmissing")) {
         method = &Benchmark::ReadMissing;
       } else if (name == Slice("seekrandom")) {
@@ -727,7 +807,21 @@ class Benchmark {
     options.block_size = FLAGS_block_size;
     options.max_open_files = FLAGS_open_files;
     options.filter_policy = filter_policy_;
+    options.data_block_hash_index = FLAGS_data_block_hash_index;
+    options.restart_key_prefixes = FLAGS_restart_key_prefixes;
+    options.partition_index_and_filters = FLAGS_partition_index_and_filters;
+    if (FLAGS_compaction_readahead_size >= 0) {
+      options.compaction_readahead_size = FLAGS_compaction_readahead_size;
+    }
+    options.min_blob_size = FLAGS_min_blob_size;
     options.reuse_logs = FLAGS_reuse_logs;
+    options.enable_pipelined_write = FLAGS_enable_pipelined_write;
+    options.enable_wal_thread = FLAGS_enable_wal_thread;
+    options.delayed_write_rate = FLAGS_delayed_write_rate;
+    options.soft_pending_compaction_bytes_limit =
+        FLAGS_soft_pending_compaction_bytes_limit;
+    options.wal_sync_window_micros = FLAGS_wal_sync_window_micros;
+    options.memtable_factory = memtable_factory_;
     // printf("cm %d\n", options.create_if_missing);
     // printf("bc %p\n", options.block_cache);
     // printf("wb %zu\n", options.write_buffer_size);
@@ -774,7 +868,13 @@ class Benchmark {
         const int k = seq ? i + j : (thread->rand.Next() % FLAGS_num);
         char key[100];
         snprintf(key, sizeof(key), "%016d", k);
-        batch.Put(key, gen.Generate(value_size_));
+        if (FLAGS_reference_values) {
+          Slice key_slice(key);
+          Slice value = gen.Generate(value_size_);
+          batch.Put(SliceParts(&key_slice, 1), SliceParts(&value, 1));
+        } else {
+          batch.Put(key, gen.Generate(value_size_));
+        }
         bytes += value_size_ + strlen(key);
         thread->stats.FinishedSingleOp();
       }
@@ -790,7 +890,9 @@ class Benchmark {
   }
 
   void ReadSequential(ThreadState* thread) {
-    Iterator* iter = db_->NewIterator(ReadOptions());
+    ReadOptions options;
+    options.readahead_size = FLAGS_readahead_size;
+    Iterator* iter = db_->NewIterator(options);
     int i = 0;
     int64_t bytes = 0;
     rtc_init();
@@ -808,7 +910,9 @@ class Benchmark {
   }
 
   void ReadReverse(ThreadState* thread) {
-    Iterator* iter = db_->NewIterator(ReadOptions());
+    ReadOptions options;
+    options.readahead_size = FLAGS_readahead_size;
+    Iterator* iter = db_->NewIterator(options);
     int i = 0;
     int64_t bytes = 0;
     for (iter->SeekToLast(); i < reads_ && iter->Valid(); iter->Prev()) {
@@ -842,6 +946,37 @@ class Benchmark {
     thread->stats.AddMessage(msg);
   }
 
+  void MultiReadRandom(ThreadState* thread) {
+    ReadOptions options;
+    const int batch_size = std::max(FLAGS_multiget_batch_size, 1);
+    std::vector<std::string> key_buffers(batch_size);
+    std::vector<Slice> keys(batch_size);
+    std::vector<std::string> values;
+    std::vector<Status> statuses;
+    int found = 0;
+    for (int i = 0; i < reads_; i += batch_size) {
+      const int n = std::min(batch_size, reads_ - i);
+      keys.resize(n);
+      for (int j = 0; j < n; j++) {
+        char key[100];
+        const int k = thread->rand.Next() % FLAGS_num;
+        snprintf(key, sizeof(key), "%016d", k);
+        key_buffers[j] = key;
+        keys[j] = key_buffers[j];
+      }
+      db_->MultiGet(options, keys, &values, &statuses);
+      for (int j = 0; j < n; j++) {
+        if (statuses[j].ok()) {
+          found++;
+        }
+        thread->stats.FinishedSingleOp();
+      }
+    }
+    char msg[100];
+    snprintf(msg, sizeof(msg), "(%d of %d found)", found, num_);
+    thread->stats.AddMessage(msg);
+  }
+
   void ReadMissing(ThreadState* thread) {
     ReadOptions options;
     std::string value;
@@ -985,6 +1120,9 @@ int main(int argc, char** argv) {
   FLAGS_max_file_size = leveldb::Options().max_file_size;
   FLAGS_block_size = leveldb::Options().block_size;
   FLAGS_open_files = leveldb::Options().max_open_files;
+  FLAGS_delayed_write_rate = leveldb::Options().delayed_write_rate;
+  FLAGS_soft_pending_compaction_bytes_limit =
+      leveldb::Options().soft_pending_compaction_bytes_limit;
   std::string default_db_path;
 
   for (int i = 1; i < argc; i++) {
@@ -1004,6 +1142,30 @@ int main(int argc, char** argv) {
     } else if (sscanf(argv[i], "--reuse_logs=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_reuse_logs = n;
+    } else if (sscanf(argv[i], "--enable_pipelined_write=%d%c", &n, &junk) ==
+                   1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_enable_pipelined_write = n;
+    } else if (sscanf(argv[i], "--delayed_write_rate=%d%c", &n, &junk) == 1) {
+      FLAGS_delayed_write_rate = n;
+    } else if (sscanf(argv[i], "--soft_pending_compaction_bytes_limit=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_soft_pending_compaction_bytes_limit = n;
+    } else if (sscanf(argv[i], "--multiget_batch_size=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_multiget_batch_size = n;
+    } else if (sscanf(argv[i], "--reference_values=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_reference_values = n;
+    } else if (sscanf(argv[i], "--disable_wal=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_disable_wal = n;
+    } else if (sscanf(argv[i], "--enable_wal_thread=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_enable_wal_thread = n;
+    } else if (sscanf(argv[i], "--wal_sync_window_micros=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_wal_sync_window_micros = n;
     } else if (sscanf(argv[i], "--num=%d%c", &n, &junk) == 1) {
       FLAGS_num = n;
     } else if (sscanf(argv[i], "--reads=%d%c", &n, &junk) == 1) {
@@ -1020,10 +1182,34 @@ int main(int argc, char** argv) {
       FLAGS_block_size = n;
     } else if (sscanf(argv[i], "--cache_size=%d%c", &n, &junk) == 1) {
       FLAGS_cache_size = n;
+    } else if (sscanf(argv[i], "--cache_high_pri_pool_ratio=%lf%c", &d,
+                      &junk) == 1) {
+      FLAGS_cache_high_pri_pool_ratio = d;
     } else if (sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1) {
       FLAGS_bloom_bits = n;
+    } else if (sscanf(argv[i], "--data_block_hash_index=%d%c", &n, &junk) ==
+                   1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_data_block_hash_index = n;
+    } else if (sscanf(argv[i], "--restart_key_prefixes=%d%c", &n, &junk) ==
+                   1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_restart_key_prefixes = n;
+    } else if (sscanf(argv[i], "--partition_index_and_filters=%d%c", &n,
+                      &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_partition_index_and_filters = n;
+    } else if (sscanf(argv[i], "--readahead_size=%d%c", &n, &junk) == 1) {
+      FLAGS_readahead_size = n;
+    } else if (sscanf(argv[i], "--compaction_readahead_size=%d%c", &n,
+                      &junk) == 1) {
+      FLAGS_compaction_readahead_size = n;
+    } else if (sscanf(argv[i], "--min_blob_size=%d%c", &n, &junk) == 1) {
+      FLAGS_min_blob_size = n;
     } else if (sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1) {
       FLAGS_open_files = n;
+    } else if (strncmp(argv[i], "--memtable_rep=", 15) == 0) {
+      FLAGS_memtable_rep = argv[i] + 15;
     } else if (strncmp(argv[i], "--db=", 5) == 0) {
       FLAGS_db = argv[i] + 5;
     } else if (sscanf(argv[i], "--vefs=%d%c", &n, &junk) == 1 &&
@@ -0,0 +1,130 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/blob_file.h"
+
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+
+namespace {
+
+// checksum (4) + type (1) + key size (4) + value size (4)
+const size_t kBlobHeaderSize = 13;
+
+}  // namespace
+
+void BlobIndex::EncodeTo(std::string* dst) const {
+  PutVarint64(dst, file_number);
+  PutVarint64(dst, offset);
+  PutVarint64(dst, size);
+}
+
+bool BlobIndex::DecodeFrom(Slice input) {
+  return GetVarint64(&input, &file_number) && GetVarint64(&input, &offset) &&
+         GetVarint64(&input, &size) && input.empty();
+}
+
+BlobFileBuilder::BlobFileBuilder(const Options& options, WritableFile* file,
+                                 uint64_t file_number)
+    : options_(options),
+      file_(file),
+      file_number_(file_number),
+      offset_(0),
+      num_blobs_(0) {}
+
+Status BlobFileBuilder::Add(const Slice& user_key, const Slice& value,
+                            BlobIndex* index) {
+  Slice contents = value;
+  CompressionType type = kNoCompression;
+  if (options_.compression == kSnappyCompression &&
+      port::Snappy_Compress(value.data(), value.size(), &compressed_) &&
+      compressed_.size() < value.size() - (value.size() / 8u)) {
+    // Only keep the compressed form if it saves at least 12.5%, as
+    // TableBuilder does for blocks.
+    contents = compressed_;
+    type = kSnappyCompression;
+  }
+
+  record_.assign(4, '\0');  // Checksum, filled in below
+  record_.push_back(static_cast<char>(type));
+  PutFixed32(&record_, static_cast<uint32_t>(user_key.size()));
+  PutFixed32(&record_, static_cast<uint32_t>(contents.size()));
+  record_.append(user_key.data(), user_key.size());
+  record_.append(contents.data(), contents.size());
+  EncodeFixed32(&record_[0], crc32c::Mask(crc32c::Value(
+                                 record_.data() + 4, record_.size() - 4)));
+
+  Status s = file_->Append(record_);
+  if (s.ok()) {
+    index->file_number = file_number_;
+    index->offset = offset_;
+    index->size = record_.size();
+    offset_ += record_.size();
+    num_blobs_++;
+  }
+  return s;
+}
+
+Status ReadBlob(RandomAccessFile* file, const ReadOptions& options,
+                const BlobIndex& index, const Slice& user_key,
+                std::string* value) {
+  const size_t n = static_cast<size_t>(index.size);
+  if (n < kBlobHeaderSize) {
+    return Status::Corruption("bad blob index");
+  }
+  std::string scratch;
+  scratch.resize(n);
+  Slice record;
+  Status s = file->Read(index.offset, n, &record, &scratch[0]);
+  if (!s.ok()) {
+    return s;
+  }
+  if (record.size() != n) {
+    return Status::Corruption("truncated blob read");
+  }
+
+  const char* data = record.data();
+  if (options.verify_checksums) {
+    const uint32_t crc = crc32c::Unmask(DecodeFixed32(data));
+    if (crc32c::Value(data + 4, n - 4) != crc) {
+      return Status::Corruption("blob checksum mismatch");
+    }
+  }
+  const uint32_t key_size = DecodeFixed32(data + 5);
+  const uint32_t value_size = DecodeFixed32(data + 9);
+  if (kBlobHeaderSize + static_cast<uint64_t>(key_size) + value_size != n) {
+    return Status::Corruption("bad blob record");
+  }
+  if (Slice(data + kBlobHeaderSize, key_size) != user_key) {
+    return Status::Corruption("blob belongs to another key");
+  }
+
+  const char* contents = data + kBlobHeaderSize + key_size;
+  switch (data[4]) {
+    case kNoCompression:
+      value->assign(contents, value_size);
+      break;
+    case kSnappyCompression: {
+      size_t ulength = 0;
+      if (!port::Snappy_GetUncompressedLength(contents, value_size,
+                                              &ulength)) {
+        return Status::Corruption("corrupted compressed blob");
+      }
+      value->resize(ulength);
+      if (!port::Snappy_Uncompress(contents, value_size, &(*value)[0])) {
+        return Status::Corruption("corrupted compressed blob");
+      }
+      break;
+    }
+    default:
+      return Status::Corruption("bad blob type");
+  }
+  return Status::OK();
+}
+
+}  // namespace leveldb
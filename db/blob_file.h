@@ -0,0 +1,85 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Values of at least Options::min_blob_size bytes are kept apart from the
+// tables, in append-only blob files.  The table entry of such a value has
+// the type kTypeBlobIndex and holds an encoded BlobIndex instead of the
+// value.  A blob file is a sequence of records:
+//
+//    checksum: uint32    // masked crc32c of the rest of the record
+//    type: uint8         // kNoCompression or kSnappyCompression
+//    key_size: fixed32
+//    value_size: fixed32 // size of the stored (maybe compressed) value
+//    key: uint8[key_size]
+//    value: uint8[value_size]
+//
+// Blob files are never modified.  Each blob is referred to by exactly one
+// table entry, so the version records how many blobs of each file are no
+// longer referred to, and compactions move the remaining blobs out of
+// files that are mostly garbage (see VersionSet::Finalize()).
+
+#ifndef STORAGE_LEVELDB_DB_BLOB_FILE_H_
+#define STORAGE_LEVELDB_DB_BLOB_FILE_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class RandomAccessFile;
+class WritableFile;
+
+// Where a blob is stored: the whole record at [offset, offset + size) of
+// the blob file "file_number".
+struct BlobIndex {
+  BlobIndex() : file_number(0), offset(0), size(0) {}
+
+  void EncodeTo(std::string* dst) const;
+  bool DecodeFrom(Slice input);
+
+  uint64_t file_number;
+  uint64_t offset;
+  uint64_t size;
+};
+
+// Appends blobs to a blob file.  The caller syncs and closes the file.
+class BlobFileBuilder {
+ public:
+  BlobFileBuilder(const Options& options, WritableFile* file,
+                  uint64_t file_number);
+
+  BlobFileBuilder(const BlobFileBuilder&) = delete;
+  BlobFileBuilder& operator=(const BlobFileBuilder&) = delete;
+
+  // Appends the value of "user_key" and stores its location in *index.
+  Status Add(const Slice& user_key, const Slice& value, BlobIndex* index);
+
+  uint64_t FileSize() const { return offset_; }
+  uint64_t NumBlobs() const { return num_blobs_; }
+
+ private:
+  const Options options_;
+  WritableFile* const file_;
+  const uint64_t file_number_;
+  uint64_t offset_;
+  uint64_t num_blobs_;
+  std::string record_;
+  std::string compressed_;
+};
+
+// Reads the blob "index" refers to from "file", which must be the blob file
+// index.file_number, and stores its value in *value.  Fails if the blob
+// does not belong to "user_key".
+Status ReadBlob(RandomAccessFile* file, const ReadOptions& options,
+                const BlobIndex& index, const Slice& user_key,
+                std::string* value);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BLOB_FILE_H_
@@ -4,8 +4,10 @@
 
 #include "db/builder.h"
 
+#include "db/blob_file.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "leveldb/db.h"
@@ -15,13 +17,23 @@
 namespace leveldb {
 
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta) {
+                  TableCache* table_cache, Iterator* iter,
+                  const std::vector<RangeTombstone>& range_deletions,
+                  FileMetaData* meta, BlobFileMetaData* blob) {
   Status s;
   meta->file_size = 0;
+  meta->blob_files.clear();
+  if (blob != nullptr) {
+    blob->file_size = 0;
+    blob->blob_count = 0;
+  }
   iter->SeekToFirst();
 
   std::string fname = TableFileName(dbname, meta->number);
-  if (iter->Valid()) {
+  std::string blob_fname;
+  WritableFile* blob_file = nullptr;
+  BlobFileBuilder* blob_builder = nullptr;
+  if (iter->Valid() || !range_deletions.empty()) {
     WritableFile* file;
     s = env->NewWritableFile(fname, &file);
     if (!s.ok()) {
@@ -29,15 +41,82 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
     }
 
     TableBuilder* builder = new TableBuilder(options, file);
-    meta->smallest.DecodeFrom(iter->key());
-    for (; iter->Valid(); iter->Next()) {
+    bool has_bounds = false;
+    std::string blob_key, blob_index;
+    for (; s.ok() && iter->Valid(); iter->Next()) {
       Slice key = iter->key();
+      Slice value = iter->value();
+      ParsedInternalKey ikey;
+      if (blob != nullptr && options.min_blob_size > 0 &&
+          value.size() >= options.min_blob_size &&
+          ParseInternalKey(key, &ikey) && ikey.type == kTypeValue) {
+        // Move the value to the blob file
+        if (blob_builder == nullptr) {
+          blob_fname = BlobFileName(dbname, blob->number);
+          s = env->NewWritableFile(blob_fname, &blob_file);
+          if (!s.ok()) {
+            break;
+          }
+          blob_builder = new BlobFileBuilder(options, blob_file, blob->number);
+        }
+        BlobIndex index;
+        s = blob_builder->Add(ikey.user_key, value, &index);
+        blob_key.clear();
+        AppendInternalKey(&blob_key, ParsedInternalKey(ikey.user_key,
+                                                       ikey.sequence,
+                                                       kTypeBlobIndex));
+        blob_index.clear();
+        index.EncodeTo(&blob_index);
+        key = blob_key;
+        value = blob_index;
+      }
+      if (!has_bounds) {
+        meta->smallest.DecodeFrom(key);
+        has_bounds = true;
+      }
       meta->largest.DecodeFrom(key);
-      builder->Add(key, iter->value());
+      builder->Add(key, value);
+    }
+
+    // The blob file has to be durable before the table refers to it
+    if (blob_builder != nullptr) {
+      if (s.ok()) {
+        blob->file_size = blob_builder->FileSize();
+        blob->blob_count = blob_builder->NumBlobs();
+        meta->blob_files.push_back(blob->number);
+        s = blob_file->Sync();
+      }
+      if (s.ok()) {
+        s = blob_file->Close();
+      }
+      delete blob_builder;
+    }
+    delete blob_file;
+
+    // The bounds of the table also cover its range deletions
+    const Comparator* icmp = options.comparator;
+    for (const RangeTombstone& t : range_deletions) {
+      InternalKey start = t.StartKey();
+      InternalKey end = t.EndKey();
+      builder->AddRangeDeletion(start.Encode(), t.end);
+      if (!has_bounds ||
+          icmp->Compare(start.Encode(), meta->smallest.Encode()) < 0) {
+        meta->smallest = start;
+      }
+      if (!has_bounds ||
+          icmp->Compare(end.Encode(), meta->largest.Encode()) > 0) {
+        meta->largest = end;
+      }
+      has_bounds = true;
     }
+    meta->has_range_deletions = !range_deletions.empty();
 
     // Finish and check for builder errors
-    s = builder->Finish();
+    if (s.ok()) {
+      s = builder->Finish();
+    } else {
+      builder->Abandon();
+    }
     if (s.ok()) {
       meta->file_size = builder->FileSize();
       assert(meta->file_size > 0);
@@ -72,6 +151,12 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
     // Keep it
   } else {
     env->DeleteFile(fname);
+    if (!blob_fname.empty()) {
+      env->DeleteFile(blob_fname);
+    }
+    if (blob != nullptr) {
+      blob->file_size = 0;
+    }
   }
   return s;
 }
@@ -5,25 +5,38 @@
 #ifndef STORAGE_LEVELDB_DB_BUILDER_H_
 #define STORAGE_LEVELDB_DB_BUILDER_H_
 
+#include <vector>
+
 #include "leveldb/status.h"
 
 namespace leveldb {
 
 struct Options;
+struct BlobFileMetaData;
 struct FileMetaData;
 
 class Env;
 class Iterator;
 class TableCache;
 class VersionEdit;
+struct RangeTombstone;
 
-// Build a Table file from the contents of *iter.  The generated file
-// will be named according to meta->number.  On success, the rest of
-// *meta will be filled with metadata about the generated table.
-// If no data is present in *iter, meta->file_size will be set to
+// Build a Table file from the contents of *iter and the range deletions
+// in "range_deletions".  The generated file will be named according to
+// meta->number.  On success, the rest of *meta will be filled with
+// metadata about the generated table.  If no data is present in *iter
+// and there are no range deletions, meta->file_size will be set to
 // zero, and no Table file will be produced.
+//
+// If "blob" is non-null, the values of at least options.min_blob_size
+// bytes are written to the blob file named according to blob->number
+// instead (see db/blob_file.h).  On success, the rest of *blob will be
+// filled with metadata about the blob file; blob->file_size will be zero
+// if no blob file was produced.
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta);
+                  TableCache* table_cache, Iterator* iter,
+                  const std::vector<RangeTombstone>& range_deletions,
+                  FileMetaData* meta, BlobFileMetaData* blob = nullptr);
 
 }  // namespace leveldb
 
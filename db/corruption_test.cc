@@ -12,6 +12,7 @@
 #include "leveldb/db.h"
 #include "leveldb/table.h"
 #include "leveldb/write_batch.h"
+#include "table/format.h"
 #include "util/logging.h"
 #include "util/testharness.h"
 #include "util/testutil.h"
@@ -155,6 +156,35 @@ class CorruptionTest {
     ASSERT_TRUE(s.ok()) << s.ToString();
   }
 
+  // Returns the offset of the metaindex block of the latest table file.
+  int MetaindexOffset() {
+    std::vector<std::string> filenames;
+    env_.target()->GetChildren(dbname_, &filenames);
+    uint64_t number;
+    FileType type;
+    std::string fname;
+    int picked_number = -1;
+    for (size_t i = 0; i < filenames.size(); i++) {
+      if (ParseFileName(filenames[i], &number, &type) && type == kTableFile &&
+          int(number) > picked_number) {
+        fname = dbname_ + "/" + filenames[i];
+        picked_number = number;
+      }
+    }
+    std::string contents;
+    ReadFileToString(env_.target(), fname, &contents);
+    if (contents.size() < Footer::kEncodedLength) {
+      return -1;
+    }
+    Slice input(contents.data() + contents.size() - Footer::kEncodedLength,
+                Footer::kEncodedLength);
+    Footer footer;
+    if (!footer.DecodeFrom(&input).ok()) {
+      return -1;
+    }
+    return static_cast<int>(footer.metaindex_handle().offset());
+  }
+
   int Property(const std::string& name) {
     std::string property;
     int result;
@@ -260,6 +290,39 @@ TEST(CorruptionTest, TableFileIndexData) {
   Check(5000, 9999);
 }
 
+TEST(CorruptionTest, TableFileRangeDeletions) {
+  options_.paranoid_checks = true;
+  Reopen();
+  Build(100);
+  std::string begin_space, end_space;
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), Key(10, &begin_space),
+                             Key(20, &end_space)));
+  DBImpl* dbi = reinterpret_cast<DBImpl*>(db_);
+  dbi->TEST_CompactMemTable();
+
+  // The deleted keys must not come back when the range deletions of the
+  // table cannot be read.
+  const int offset = MetaindexOffset();
+  ASSERT_GE(offset, 0);
+  Corrupt(kTableFile, offset, 1);
+  Reopen();
+  std::string key_space, value;
+  ASSERT_TRUE(db_->Get(ReadOptions(), Key(15, &key_space), &value)
+                  .IsCorruption());
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->SeekToFirst();
+  ASSERT_TRUE(!iter->Valid());
+  ASSERT_TRUE(iter->status().IsCorruption());
+  delete iter;
+
+  // Nor may a compaction write them out without the range deletion.
+  dbi = reinterpret_cast<DBImpl*>(db_);
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbi->TEST_CompactRange(level, nullptr, nullptr);
+  }
+  ASSERT_TRUE(!db_->Get(ReadOptions(), Key(15, &key_space), &value).ok());
+}
+
 TEST(CorruptionTest, MissingDescriptor) {
   Build(1000);
   RepairDB();
@@ -13,6 +13,7 @@
 #include <string>
 #include <vector>
 
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_iter.h"
 #include "db/dbformat.h"
@@ -20,11 +21,13 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/status.h"
 #include "leveldb/table.h"
 #include "leveldb/table_builder.h"
@@ -47,21 +50,48 @@ const int kNumNonTableCacheFiles = 10;
 // Information kept for every waiting writer
 struct DBImpl::Writer {
   explicit Writer(port::Mutex* mu)
-      : batch(nullptr), sync(false), done(false), cv(mu) {}
+      : batch(nullptr),
+        sync(false),
+        disable_wal(false),
+        done(false),
+        group(nullptr),
+        cv(mu) {}
 
   Status status;
   WriteBatch* batch;
   bool sync;
+  bool disable_wal;
   bool done;
+  WriteGroup* group;  // Set when the writer may insert into the memtable
   port::CondVar cv;
 };
 
+// Writers whose batches were logged together and are now being applied
+// to the memtable by their own threads (pipelined writes only).
+struct DBImpl::WriteGroup {
+  std::vector<Writer*> writers;
+  SequenceNumber last_sequence;
+  int pending;  // Number of writers still inserting into the memtable
+  Status status;
+};
+
+// A group of writers whose record is queued in wal_writer_.
+struct DBImpl::WalGroup {
+  Writer* leader;
+  SequenceNumber last_sequence;
+  bool done;       // Wait() returned for the record
+  bool finished;   // Removed from wal_groups_
+  Status status;
+};
+
 struct DBImpl::CompactionState {
   // Files produced by compaction
   struct Output {
     uint64_t number;
     uint64_t file_size;
     InternalKey smallest, largest;
+    bool has_range_deletions;
+    std::set<uint64_t> blob_files;  // Blob files the output refers to
   };
 
   Output* current_output() { return &outputs[outputs.size() - 1]; }
@@ -69,8 +99,11 @@ struct DBImpl::CompactionState {
   explicit CompactionState(Compaction* c)
       : compaction(c),
         smallest_snapshot(0),
+        has_output_lower_bound(false),
         outfile(nullptr),
         builder(nullptr),
+        blob_outfile(nullptr),
+        blob_builder(nullptr),
         total_bytes(0) {}
 
   Compaction* const compaction;
@@ -81,12 +114,31 @@ struct DBImpl::CompactionState {
   // we can drop all entries for the same key with sequence numbers < S.
   SequenceNumber smallest_snapshot;
 
+  // Range deletions of the inputs that the outputs must keep.  Each output
+  // holds the parts of them that lie between the first user key of the
+  // output (output_lower_bound, absent for the first output) and the first
+  // user key of the next output.
+  std::vector<RangeTombstone> range_deletions;
+  std::string output_lower_bound;
+  bool has_output_lower_bound;
+
   std::vector<Output> outputs;
 
   // State kept for output being generated
   WritableFile* outfile;
   TableBuilder* builder;
 
+  // Blob files produced by compaction, and the state kept for the one
+  // being generated (see db/blob_file.h)
+  std::vector<BlobFileMetaData> blob_outputs;
+  WritableFile* blob_outfile;
+  BlobFileBuilder* blob_builder;
+
+  // Backing store for an entry whose value was moved to a blob file
+  std::string blob_key;
+  std::string blob_index;
+  std::string blob_value;
+
   uint64_t total_bytes;
 };
 
@@ -107,6 +159,10 @@ Options SanitizeOptions(const std::string& dbname,
   ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
   ClipToRange(&result.max_file_size, 1 << 20, 1 << 30);
   ClipToRange(&result.block_size, 1 << 10, 4 << 20);
+  if (src.comparator != BytewiseComparator()) {
+    // Restart key prefixes order keys by their bytes.
+    result.restart_key_prefixes = false;
+  }
   if (result.info_log == nullptr) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -148,11 +204,22 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       logfile_number_(0),
       log_(nullptr),
       seed_(0),
+      read_view_(nullptr),
+      read_view_number_(0),
+      local_read_view_(&DBImpl::UnrefCachedReadView),
+      wal_writer_(raw_options.enable_wal_thread &&
+                          !raw_options.enable_pipelined_write
+                      ? new log::AsyncWriter(raw_options.env,
+                                             raw_options.wal_sync_window_micros)
+                      : nullptr),
       tmp_batch_(new WriteBatch),
       background_compaction_scheduled_(false),
       manual_compaction_(nullptr),
       versions_(new VersionSet(dbname_, &options_, table_cache_,
-                               &internal_comparator_)) {}
+                               &internal_comparator_)),
+      write_controller_(options_.delayed_write_rate,
+                        options_.soft_pending_compaction_bytes_limit),
+      write_stall_micros_(0) {}
 
 DBImpl::~DBImpl() {
   // Wait for background work to finish.
@@ -161,6 +228,17 @@ DBImpl::~DBImpl() {
   while (background_compaction_scheduled_) {
     background_work_finished_signal_.Wait();
   }
+  // Release the read views before the versions and memtables they refer
+  // to are destroyed.
+  std::vector<void*> cached_views;
+  local_read_view_.Scrape(&cached_views, nullptr);
+  for (void* view : cached_views) {
+    UnrefReadViewLocked(reinterpret_cast<ReadView*>(view));
+  }
+  if (read_view_ != nullptr) {
+    UnrefReadViewLocked(read_view_);
+    read_view_ = nullptr;
+  }
   mutex_.Unlock();
 
   if (db_lock_ != nullptr) {
@@ -171,6 +249,7 @@ DBImpl::~DBImpl() {
   if (mem_ != nullptr) mem_->Unref();
   if (imm_ != nullptr) imm_->Unref();
   delete tmp_batch_;
+  delete wal_writer_;
   delete log_;
   delete logfile_;
   delete table_cache_;
@@ -256,6 +335,7 @@ void DBImpl::DeleteObsoleteFiles() {
           keep = (number >= versions_->ManifestFileNumber());
           break;
         case kTableFile:
+        case kBlobFile:
           keep = (live.find(number) != live.end());
           break;
         case kTempFile:
@@ -272,7 +352,7 @@ void DBImpl::DeleteObsoleteFiles() {
 
       if (!keep) {
         files_to_delete.push_back(std::move(filename));
-        if (type == kTableFile) {
+        if (type == kTableFile || type == kBlobFile) {
           table_cache_->Evict(number);
         }
         Log(options_.info_log, "Delete type=%d #%lld\n", static_cast<int>(type),
@@ -438,7 +518,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     WriteBatchInternal::SetContents(&batch, record);
 
     if (mem == nullptr) {
-      mem = new MemTable(internal_comparator_);
+      mem = new MemTable(internal_comparator_, options_.memtable_factory);
       mem->Ref();
     }
     status = WriteBatchInternal::InsertInto(&batch, mem);
@@ -484,7 +564,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
         mem = nullptr;
       } else {
         // mem can be nullptr if lognum exists but was empty.
-        mem_ = new MemTable(internal_comparator_);
+        mem_ = new MemTable(internal_comparator_, options_.memtable_factory);
         mem_->Ref();
       }
     }
@@ -509,22 +589,37 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
   FileMetaData meta;
   meta.number = versions_->NewFileNumber();
   pending_outputs_.insert(meta.number);
+  BlobFileMetaData blob;
+  if (options_.min_blob_size > 0) {
+    blob.number = versions_->NewFileNumber();
+    pending_outputs_.insert(blob.number);
+  }
   Iterator* iter = mem->NewIterator();
+  std::vector<RangeTombstone> range_deletions;
+  mem->GetRangeDeletions(&range_deletions);
   Log(options_.info_log, "Level-0 table #%llu: started",
       (unsigned long long)meta.number);
 
   Status s;
   {
     mutex_.Unlock();
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    s = BuildTable(dbname_, env_, options_, table_cache_, iter,
+                   range_deletions, &meta,
+                   options_.min_blob_size > 0 ? &blob : nullptr);
     mutex_.Lock();
   }
 
   Log(options_.info_log, "Level-0 table #%llu: %lld bytes %s",
       (unsigned long long)meta.number, (unsigned long long)meta.file_size,
       s.ToString().c_str());
+  if (blob.file_size > 0) {
+    Log(options_.info_log, "Blob file #%llu: %lld blobs, %lld bytes",
+        (unsigned long long)blob.number, (long long)blob.blob_count,
+        (long long)blob.file_size);
+  }
   delete iter;
   pending_outputs_.erase(meta.number);
+  pending_outputs_.erase(blob.number);
 
   // Note that if file_size is zero, the file has been deleted and
   // should not be added to the manifest.
@@ -535,13 +630,15 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
     if (base != nullptr) {
       level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
     }
-    edit->AddFile(level, meta.number, meta.file_size, meta.smallest,
-                  meta.largest);
+    edit->AddFile(level, meta);
+    if (blob.file_size > 0) {
+      edit->AddBlobFile(blob.number, blob.file_size, blob.blob_count);
+    }
   }
 
   CompactionStats stats;
   stats.micros = env_->NowMicros() - start_micros;
-  stats.bytes_written = meta.file_size;
+  stats.bytes_written = meta.file_size + blob.file_size;
   stats_[level].Add(stats);
   return s;
 }
@@ -573,6 +670,7 @@ void DBImpl::CompactMemTable() {
     imm_->Unref();
     imm_ = nullptr;
     has_imm_.store(false, std::memory_order_release);
+    InstallReadView();
     DeleteObsoleteFiles();
   } else {
     RecordBackgroundError(s);
@@ -596,6 +694,78 @@ void DBImpl::CompactRange(const Slice* begin, const Slice* end) {
   }
 }
 
+Status DBImpl::DeleteFilesInRange(const Slice& begin, const Slice& end) {
+  Status s;
+  bool compact_boundaries = false;
+  {
+    MutexLock l(&mutex_);
+    // Take the place of the background compaction, so that no compaction
+    // reads the files while they are deleted.
+    while (background_compaction_scheduled_ && bg_error_.ok()) {
+      background_work_finished_signal_.Wait();
+    }
+    if (!bg_error_.ok()) {
+      return bg_error_;
+    }
+    background_compaction_scheduled_ = true;
+
+    VersionEdit edit;
+    Version* base = versions_->current();
+    std::vector<FileMetaData*> files[config::kNumLevels];
+    std::vector<FileMetaData*> blob_tables;
+    int num_deleted = 0;
+    uint64_t bytes_deleted = 0;
+    base->GetFilesInRange(begin, end, files);
+    for (int level = 0; level < config::kNumLevels; level++) {
+      for (FileMetaData* f : files[level]) {
+        edit.DeleteFile(level, f->number);
+        num_deleted++;
+        bytes_deleted += f->file_size;
+        if (!f->blob_files.empty()) {
+          blob_tables.push_back(f);
+        }
+      }
+    }
+    if (!blob_tables.empty()) {
+      // The blobs that the deleted tables refer to become garbage
+      base->Ref();
+      mutex_.Unlock();
+      for (size_t i = 0; s.ok() && i < blob_tables.size(); i++) {
+        s = AddBlobGarbageOfTable(blob_tables[i], &edit);
+      }
+      mutex_.Lock();
+      base->Unref();
+    }
+    if (num_deleted > 0 && s.ok()) {
+      s = versions_->LogAndApply(&edit, &mutex_);
+      if (s.ok()) {
+        InstallReadView();
+        DeleteObsoleteFiles();
+      } else {
+        RecordBackgroundError(s);
+      }
+      VersionSet::LevelSummaryStorage tmp;
+      Log(options_.info_log, "Deleted %d files in range, %lld bytes %s: %s\n",
+          num_deleted, static_cast<long long>(bytes_deleted),
+          s.ToString().c_str(), versions_->LevelSummary(&tmp));
+    }
+    for (int level = 0; level < config::kNumLevels; level++) {
+      if (versions_->current()->OverlapInLevel(level, &begin, &end)) {
+        compact_boundaries = true;
+      }
+    }
+
+    background_compaction_scheduled_ = false;
+    MaybeScheduleCompaction();
+    background_work_finished_signal_.SignalAll();
+  }
+
+  if (s.ok() && compact_boundaries) {
+    CompactRange(&begin, &end);
+  }
+  return s;
+}
+
 void DBImpl::TEST_CompactRange(int level, const Slice* begin,
                                const Slice* end) {
   assert(level >= 0);
@@ -635,10 +805,12 @@ void DBImpl::TEST_CompactRange(int level, const Slice* begin,
   }
 }
 
-Status DBImpl::TEST_CompactMemTable() {
+Status DBImpl::TEST_CompactMemTable() { return FlushMemTable(true); }
+
+Status DBImpl::FlushMemTable(bool wait) {
   // nullptr batch means just wait for earlier writes to be done
   Status s = Write(WriteOptions(), nullptr);
-  if (s.ok()) {
+  if (s.ok() && wait) {
     // Wait until the compaction completes
     MutexLock l(&mutex_);
     while (imm_ != nullptr && bg_error_.ok()) {
@@ -734,10 +906,11 @@ void DBImpl::BackgroundCompaction() {
     assert(c->num_input_files(0) == 1);
     FileMetaData* f = c->input(0, 0);
     c->edit()->DeleteFile(c->level(), f->number);
-    c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest,
-                       f->largest);
+    c->edit()->AddFile(c->level() + 1, *f);
     status = versions_->LogAndApply(c->edit(), &mutex_);
-    if (!status.ok()) {
+    if (status.ok()) {
+      InstallReadView();
+    } else {
       RecordBackgroundError(status);
     }
     VersionSet::LevelSummaryStorage tmp;
@@ -790,10 +963,15 @@ void DBImpl::CleanupCompaction(CompactionState* compact) {
     assert(compact->outfile == nullptr);
   }
   delete compact->outfile;
+  delete compact->blob_builder;
+  delete compact->blob_outfile;
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
     pending_outputs_.erase(out.number);
   }
+  for (const BlobFileMetaData& b : compact->blob_outputs) {
+    pending_outputs_.erase(b.number);
+  }
   delete compact;
 }
 
@@ -809,6 +987,7 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
     out.number = file_number;
     out.smallest.Clear();
     out.largest.Clear();
+    out.has_range_deletions = false;
     compact->outputs.push_back(out);
     mutex_.Unlock();
   }
@@ -822,6 +1001,57 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   return s;
 }
 
+// Returns true iff the current output may end before "internal_key".
+bool DBImpl::CanFinishCompactionOutputBefore(CompactionState* compact,
+                                             const Slice& internal_key) {
+  if (compact->range_deletions.empty()) {
+    return true;
+  }
+  // Range deletions are split between outputs at user keys, so all entries
+  // for a user key must stay in one output.
+  return internal_key.size() >= 8 &&
+         user_comparator()->Compare(
+             ExtractUserKey(internal_key),
+             compact->current_output()->largest.user_key()) != 0;
+}
+
+void DBImpl::AddRangeDeletionsToOutput(CompactionState* compact,
+                                       const Slice* upper_bound) {
+  const Comparator* ucmp = user_comparator();
+  CompactionState::Output* out = compact->current_output();
+  bool has_bounds = compact->builder->NumEntries() > 0;
+  for (const RangeTombstone& t : compact->range_deletions) {
+    Slice begin = t.begin;
+    Slice end = t.end;
+    if (compact->has_output_lower_bound &&
+        ucmp->Compare(begin, compact->output_lower_bound) < 0) {
+      begin = compact->output_lower_bound;
+    }
+    if (upper_bound != nullptr && ucmp->Compare(*upper_bound, end) < 0) {
+      end = *upper_bound;
+    }
+    if (ucmp->Compare(begin, end) >= 0) {
+      continue;  // Not in this output
+    }
+    RangeTombstone part(begin, end, t.sequence);
+    InternalKey start = part.StartKey();
+    InternalKey limit = part.EndKey();
+    compact->builder->AddRangeDeletion(start.Encode(), part.end);
+    if (!has_bounds || internal_comparator_.Compare(start, out->smallest) < 0) {
+      out->smallest = start;
+    }
+    if (!has_bounds || internal_comparator_.Compare(limit, out->largest) > 0) {
+      out->largest = limit;
+    }
+    has_bounds = true;
+    out->has_range_deletions = true;
+  }
+  if (upper_bound != nullptr) {
+    compact->output_lower_bound = upper_bound->ToString();
+    compact->has_output_lower_bound = true;
+  }
+}
+
 Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
                                           Iterator* input) {
   assert(compact != nullptr);
@@ -871,22 +1101,240 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   return s;
 }
 
+// Moves the value of the entry "ikey" to a blob file of the compaction if
+// it is large, or if it is a blob of a blob file that the compaction
+// collects.  *key and *value then hold the entry that refers to the new
+// blob.  Also records the blob files that the current output refers to.
+Status DBImpl::SeparateBlobValue(CompactionState* compact,
+                                 const ParsedInternalKey& ikey, Slice* key,
+                                 Slice* value) {
+  Status s;
+  BlobIndex index;
+  Slice blob_value;
+  if (ikey.type == kTypeBlobIndex) {
+    if (!index.DecodeFrom(*value)) {
+      return Status::Corruption("bad blob index for ", ikey.user_key);
+    }
+    if (compact->compaction->blob_files_to_collect().count(
+            index.file_number) == 0) {
+      compact->current_output()->blob_files.insert(index.file_number);
+      return s;
+    }
+    ReadOptions options;
+    options.verify_checksums = options_.paranoid_checks;
+    options.fill_cache = false;
+    s = table_cache_->ReadBlob(options, ikey.user_key, index,
+                               &compact->blob_value);
+    if (!s.ok()) {
+      return s;
+    }
+    compact->compaction->edit()->AddBlobGarbage(index.file_number, 1,
+                                                index.size);
+    blob_value = compact->blob_value;
+  } else if (ikey.type == kTypeValue && options_.min_blob_size > 0 &&
+             value->size() >= options_.min_blob_size) {
+    blob_value = *value;
+  } else {
+    return s;
+  }
+
+  if (compact->blob_builder == nullptr) {
+    s = OpenCompactionBlobFile(compact);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  s = compact->blob_builder->Add(ikey.user_key, blob_value, &index);
+  if (s.ok() &&
+      compact->blob_builder->FileSize() >= options_.max_blob_file_size) {
+    s = FinishCompactionBlobFile(compact);
+  }
+  if (s.ok()) {
+    compact->current_output()->blob_files.insert(index.file_number);
+    compact->blob_key.clear();
+    AppendInternalKey(&compact->blob_key,
+                      ParsedInternalKey(ikey.user_key, ikey.sequence,
+                                        kTypeBlobIndex));
+    compact->blob_index.clear();
+    index.EncodeTo(&compact->blob_index);
+    *key = compact->blob_key;
+    *value = compact->blob_index;
+  }
+  return s;
+}
+
+Status DBImpl::OpenCompactionBlobFile(CompactionState* compact) {
+  assert(compact->blob_builder == nullptr);
+  uint64_t file_number;
+  {
+    mutex_.Lock();
+    file_number = versions_->NewFileNumber();
+    pending_outputs_.insert(file_number);
+    BlobFileMetaData out;
+    out.number = file_number;
+    compact->blob_outputs.push_back(out);
+    mutex_.Unlock();
+  }
+
+  std::string fname = BlobFileName(dbname_, file_number);
+  Status s = env_->NewWritableFile(fname, &compact->blob_outfile);
+  if (s.ok()) {
+    compact->blob_builder =
+        new BlobFileBuilder(options_, compact->blob_outfile, file_number);
+  }
+  return s;
+}
+
+Status DBImpl::FinishCompactionBlobFile(CompactionState* compact) {
+  assert(compact->blob_builder != nullptr);
+  BlobFileMetaData* out = &compact->blob_outputs.back();
+  out->file_size = compact->blob_builder->FileSize();
+  out->blob_count = compact->blob_builder->NumBlobs();
+  delete compact->blob_builder;
+  compact->blob_builder = nullptr;
+
+  Status s = compact->blob_outfile->Sync();
+  if (s.ok()) {
+    s = compact->blob_outfile->Close();
+  }
+  delete compact->blob_outfile;
+  compact->blob_outfile = nullptr;
+  if (s.ok()) {
+    Log(options_.info_log, "Generated blob file #%llu: %lld blobs, %lld bytes",
+        (unsigned long long)out->number, (long long)out->blob_count,
+        (long long)out->file_size);
+  }
+  return s;
+}
+
+// Records the blobs that the entries of "f" refer to as garbage in *edit,
+// for a table that is deleted without being compacted.
+Status DBImpl::AddBlobGarbageOfTable(const FileMetaData* f,
+                                     VersionEdit* edit) {
+  ReadOptions options;
+  options.verify_checksums = options_.paranoid_checks;
+  options.fill_cache = false;
+  Iterator* iter = table_cache_->NewIterator(options, f->number, f->file_size);
+  Status s;
+  for (iter->SeekToFirst(); s.ok() && iter->Valid(); iter->Next()) {
+    ParsedInternalKey ikey;
+    if (ParseInternalKey(iter->key(), &ikey) && ikey.type == kTypeBlobIndex) {
+      BlobIndex index;
+      if (index.DecodeFrom(iter->value())) {
+        edit->AddBlobGarbage(index.file_number, 1, index.size);
+      } else {
+        s = Status::Corruption("bad blob index for ", ikey.user_key);
+      }
+    }
+  }
+  if (s.ok()) {
+    s = iter->status();
+  }
+  delete iter;
+  return s;
+}
+
 Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   mutex_.AssertHeld();
   Log(options_.info_log, "Compacted %d@%d + %d@%d files => %lld bytes",
       compact->compaction->num_input_files(0), compact->compaction->level(),
       compact->compaction->num_input_files(1), compact->compaction->level() + 1,
       static_cast<long long>(compact->total_bytes));
+  if (compact->compaction->num_hidden_files() > 0) {
+    Log(options_.info_log, "Dropped %d@%d files hidden by range deletions",
+        compact->compaction->num_hidden_files(),
+        compact->compaction->level() + 1);
+  }
 
   // Add compaction outputs
   compact->compaction->AddInputDeletions(compact->compaction->edit());
   const int level = compact->compaction->level();
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
-    compact->compaction->edit()->AddFile(level + 1, out.number, out.file_size,
-                                         out.smallest, out.largest);
+    FileMetaData f;
+    f.number = out.number;
+    f.file_size = out.file_size;
+    f.smallest = out.smallest;
+    f.largest = out.largest;
+    f.has_range_deletions = out.has_range_deletions;
+    f.blob_files.assign(out.blob_files.begin(), out.blob_files.end());
+    compact->compaction->edit()->AddFile(level + 1, f);
+  }
+  for (const BlobFileMetaData& b : compact->blob_outputs) {
+    compact->compaction->edit()->AddBlobFile(b.number, b.file_size,
+                                             b.blob_count);
+  }
+  Status s = versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+  if (s.ok()) {
+    InstallReadView();
   }
-  return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+  return s;
+}
+
+// Reads the range deletions of the inputs.  The ones that every snapshot
+// sees go to *range_deletions, which is used to drop the entries they
+// hide, and those of level() also drop the level()+1 inputs they hide.
+// The ones that may still hide entries below the output level go to
+// compact->range_deletions.  The mutex is released while the tables are
+// read.
+Status DBImpl::CollectRangeDeletions(CompactionState* compact,
+                                     RangeDelAggregator* range_deletions) {
+  mutex_.AssertHeld();
+  Compaction* c = compact->compaction;
+  std::vector<FileMetaData*> files[2];
+  for (int which = 0; which < 2; which++) {
+    for (int i = 0; i < c->num_input_files(which); i++) {
+      FileMetaData* f = c->input(which, i);
+      if (f->has_range_deletions) {
+        files[which].push_back(f);
+      }
+    }
+  }
+
+  // The input version is referenced by the compaction, so its files stay
+  // alive while the mutex is released.
+  Status s;
+  std::vector<RangeTombstone> tombstones[2];
+  mutex_.Unlock();
+  for (int which = 0; which < 2 && s.ok(); which++) {
+    for (FileMetaData* f : files[which]) {
+      RangeDelAggregator file_tombstones(user_comparator(),
+                                         kMaxSequenceNumber);
+      s = file_tombstones.AddTombstones(
+          table_cache_->NewRangeDeletionIterator(f->number, f->file_size));
+      if (!s.ok()) {
+        break;
+      }
+      tombstones[which].insert(tombstones[which].end(),
+                               file_tombstones.tombstones().begin(),
+                               file_tombstones.tombstones().end());
+    }
+  }
+  mutex_.Lock();
+  if (!s.ok()) {
+    return s;
+  }
+
+  RangeDelAggregator level_range_deletions(user_comparator(),
+                                           compact->smallest_snapshot);
+  for (const RangeTombstone& t : tombstones[0]) {
+    level_range_deletions.Add(t.begin, t.end, t.sequence);
+  }
+  c->DropHiddenInputs(&level_range_deletions);
+
+  for (int which = 0; which < 2; which++) {
+    for (const RangeTombstone& t : tombstones[which]) {
+      range_deletions->Add(t.begin, t.end, t.sequence);
+      if (t.sequence <= compact->smallest_snapshot &&
+          c->IsBaseLevelForRange(t.begin, t.end)) {
+        // Every snapshot sees the range deletion, the entries it hides in
+        // this compaction are dropped, and no older entries lie below.
+        continue;
+      }
+      compact->range_deletions.push_back(t);
+    }
+  }
+  return Status::OK();
 }
 
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
@@ -907,18 +1355,35 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
   }
 
+  RangeDelAggregator range_deletions(user_comparator(),
+                                     compact->smallest_snapshot);
+  Status status = CollectRangeDeletions(compact, &range_deletions);
+  if (!status.ok()) {
+    RecordBackgroundError(status);
+    return status;
+  }
+
   Iterator* input = versions_->MakeInputIterator(compact->compaction);
 
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
 
+  // The blobs that the files dropped by range deletions refer to are garbage
+  for (int i = 0; status.ok() && i < compact->compaction->num_hidden_files();
+       i++) {
+    const FileMetaData* f = compact->compaction->hidden_input(i);
+    if (!f->blob_files.empty()) {
+      status = AddBlobGarbageOfTable(f, compact->compaction->edit());
+    }
+  }
+
   input->SeekToFirst();
-  Status status;
   ParsedInternalKey ikey;
   std::string current_user_key;
   bool has_current_user_key = false;
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
-  while (input->Valid() && !shutting_down_.load(std::memory_order_acquire)) {
+  while (status.ok() && input->Valid() &&
+         !shutting_down_.load(std::memory_order_acquire)) {
     // Prioritize immutable compaction work
     if (has_imm_.load(std::memory_order_relaxed)) {
       const uint64_t imm_start = env_->NowMicros();
@@ -932,9 +1397,19 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
       imm_micros += (env_->NowMicros() - imm_start);
     }
 
+    // Close the output file if it is big enough or overlaps too much of
+    // the grandparent level
     Slice key = input->key();
-    if (compact->compaction->ShouldStopBefore(key) &&
-        compact->builder != nullptr) {
+    if ((compact->compaction->ShouldStopBefore(key) ||
+         (compact->builder != nullptr &&
+          compact->builder->FileSize() >=
+              compact->compaction->MaxOutputFileSize())) &&
+        compact->builder != nullptr &&
+        CanFinishCompactionOutputBefore(compact, key)) {
+      if (!compact->range_deletions.empty()) {
+        Slice next_user_key = ExtractUserKey(key);
+        AddRangeDeletionsToOutput(compact, &next_user_key);
+      }
       status = FinishCompactionOutputFile(compact, input);
       if (!status.ok()) {
         break;
@@ -972,9 +1447,23 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         //     few iterations of this loop (by rule (A) above).
         // Therefore this deletion marker is obsolete and can be dropped.
         drop = true;
+      } else if (range_deletions.ShouldDelete(ikey)) {
+        // Hidden by a range deletion that every snapshot sees
+        drop = true;
       }
 
       last_sequence_for_key = ikey.sequence;
+
+      if (drop && ikey.type == kTypeBlobIndex) {
+        // The blob is no longer referred to
+        BlobIndex index;
+        if (!index.DecodeFrom(input->value())) {
+          status = Status::Corruption("bad blob index for ", ikey.user_key);
+          break;
+        }
+        compact->compaction->edit()->AddBlobGarbage(index.file_number, 1,
+                                                    index.size);
+      }
     }
 #if 0
     Log(options_.info_log,
@@ -994,20 +1483,18 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
           break;
         }
       }
-      if (compact->builder->NumEntries() == 0) {
-        compact->current_output()->smallest.DecodeFrom(key);
-      }
-      compact->current_output()->largest.DecodeFrom(key);
-      compact->builder->Add(key, input->value());
-
-      // Close output file if it is big enough
-      if (compact->builder->FileSize() >=
-          compact->compaction->MaxOutputFileSize()) {
-        status = FinishCompactionOutputFile(compact, input);
+      Slice value = input->value();
+      if (has_current_user_key) {  // Corrupt keys are copied as they are
+        status = SeparateBlobValue(compact, ikey, &key, &value);
         if (!status.ok()) {
           break;
         }
       }
+      if (compact->builder->NumEntries() == 0) {
+        compact->current_output()->smallest.DecodeFrom(key);
+      }
+      compact->current_output()->largest.DecodeFrom(key);
+      compact->builder->Add(key, value);
     }
 
     input->Next();
@@ -1016,9 +1503,23 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   if (status.ok() && shutting_down_.load(std::memory_order_acquire)) {
     status = Status::IOError("Deleting DB during compaction");
   }
+  if (status.ok() && compact->builder == nullptr) {
+    // The range deletions past the last entry need an output of their own
+    for (const RangeTombstone& t : compact->range_deletions) {
+      if (!compact->has_output_lower_bound ||
+          user_comparator()->Compare(t.end, compact->output_lower_bound) > 0) {
+        status = OpenCompactionOutputFile(compact);
+        break;
+      }
+    }
+  }
   if (status.ok() && compact->builder != nullptr) {
+    AddRangeDeletionsToOutput(compact, nullptr);
     status = FinishCompactionOutputFile(compact, input);
   }
+  if (status.ok() && compact->blob_builder != nullptr) {
+    status = FinishCompactionBlobFile(compact);
+  }
   if (status.ok()) {
     status = input->status();
   }
@@ -1035,6 +1536,9 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     stats.bytes_written += compact->outputs[i].file_size;
   }
+  for (const BlobFileMetaData& b : compact->blob_outputs) {
+    stats.bytes_written += b.file_size;
+  }
 
   mutex_.Lock();
   stats_[compact->compaction->level() + 1].Add(stats);
@@ -1050,54 +1554,266 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   return status;
 }
 
-namespace {
-
-struct IterState {
-  port::Mutex* const mu;
-  Version* const version GUARDED_BY(mu);
-  MemTable* const mem GUARDED_BY(mu);
-  MemTable* const imm GUARDED_BY(mu);
+struct DBImpl::ReadView {
+  MemTable* mem;
+  MemTable* imm;  // May be nullptr
+  Version* current;
+  uint64_t number;
+  std::atomic<int> refs;
 
-  IterState(port::Mutex* mutex, MemTable* mem, MemTable* imm, Version* version)
-      : mu(mutex), version(version), mem(mem), imm(imm) {}
+  // REQUIRES: mutex_ is held and the last reference has been dropped.
+  void Free() {
+    mem->Unref();
+    if (imm != nullptr) imm->Unref();
+    current->Unref();
+    delete this;
+  }
 };
 
-static void CleanupIteratorState(void* arg1, void* arg2) {
-  IterState* state = reinterpret_cast<IterState*>(arg1);
-  state->mu->Lock();
-  state->mem->Unref();
-  if (state->imm != nullptr) state->imm->Unref();
-  state->version->Unref();
-  state->mu->Unlock();
-  delete state;
+// Stands in for the cached view of a thread in local_read_view_ while the
+// thread is using the view, so that InstallReadView() leaves it alone.
+static char read_view_in_use;
+
+DBImpl::ReadView* DBImpl::GetReadView(SequenceNumber* latest_sequence) {
+  ReadView* view =
+      reinterpret_cast<ReadView*>(local_read_view_.Swap(&read_view_in_use));
+  if (view != nullptr) {
+    const uint64_t number = view->number;
+    if (number == read_view_number_.load(std::memory_order_acquire)) {
+      *latest_sequence = versions_->LastSequence();
+      // The writes up to *latest_sequence went to the memtables of the
+      // view unless a newer view was installed in the meantime.  The
+      // sequence number must not be read before the view either, since
+      // compactions installed since then may have dropped entries that
+      // are visible at that sequence number.
+      if (number == read_view_number_.load(std::memory_order_acquire)) {
+        return view;
+      }
+    }
+    UnrefReadView(view);
+  }
+  MutexLock l(&mutex_);
+  view = read_view_;
+  view->refs.fetch_add(1, std::memory_order_relaxed);
+  *latest_sequence = versions_->LastSequence();
+  return view;
 }
 
-}  // anonymous namespace
+void DBImpl::ReturnReadView(ReadView* view) {
+  void* expected = &read_view_in_use;
+  if (!local_read_view_.CompareAndSwap(view, &expected)) {
+    // InstallReadView() replaced the view in the meantime.
+    UnrefReadView(view);
+  }
+}
 
-Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
-                                      SequenceNumber* latest_snapshot,
-                                      uint32_t* seed) {
-  mutex_.Lock();
-  *latest_snapshot = versions_->LastSequence();
+void DBImpl::UnrefReadView(ReadView* view) {
+  if (view->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    MutexLock l(&mutex_);
+    view->Free();
+  }
+}
+
+void DBImpl::UnrefReadViewLocked(ReadView* view) {
+  mutex_.AssertHeld();
+  if (view->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    view->Free();
+  }
+}
 
+void DBImpl::CleanupReadView(void* db, void* view) {
+  reinterpret_cast<DBImpl*>(db)->UnrefReadView(
+      reinterpret_cast<ReadView*>(view));
+}
+
+void DBImpl::UnrefCachedReadView(void* view) {
+  // A thread is exiting.  The view it cached is still read_view_, since
+  // InstallReadView() takes the cached views away before dropping
+  // read_view_, so this cannot be the last reference.
+  if (view != &read_view_in_use) {
+    ReadView* v = reinterpret_cast<ReadView*>(view);
+    int refs = v->refs.fetch_sub(1, std::memory_order_acq_rel);
+    assert(refs > 1);
+    (void)refs;
+  }
+}
+
+void DBImpl::InstallReadView() {
+  mutex_.AssertHeld();
+  ReadView* view = new ReadView;
+  view->mem = mem_;
+  mem_->Ref();
+  view->imm = imm_;
+  if (imm_ != nullptr) imm_->Ref();
+  view->current = versions_->current();
+  view->current->Ref();
+  view->number = read_view_number_.load(std::memory_order_relaxed) + 1;
+  view->refs.store(1, std::memory_order_relaxed);
+
+  ReadView* old_view = read_view_;
+  read_view_ = view;
+  read_view_number_.store(view->number, std::memory_order_release);
+
+  // Take away the views that threads cached.  A thread that is using its
+  // view finds its slot cleared and drops the view itself.
+  std::vector<void*> cached_views;
+  local_read_view_.Scrape(&cached_views, nullptr);
+  for (void* cached : cached_views) {
+    if (cached != &read_view_in_use) {
+      UnrefReadViewLocked(reinterpret_cast<ReadView*>(cached));
+    }
+  }
+  if (old_view != nullptr) {
+    UnrefReadViewLocked(old_view);
+  }
+}
+
+Iterator* DBImpl::NewViewIterator(const ReadOptions& options, ReadView* view,
+                                  const Slice* prefix) {
   // Collect together all needed child iterators
   std::vector<Iterator*> list;
-  list.push_back(mem_->NewIterator());
-  mem_->Ref();
-  if (imm_ != nullptr) {
-    list.push_back(imm_->NewIterator());
-    imm_->Ref();
+  list.push_back(view->mem->NewIterator());
+  if (view->imm != nullptr) {
+    list.push_back(view->imm->NewIterator());
   }
-  versions_->current()->AddIterators(options, &list);
-  Iterator* internal_iter =
-      NewMergingIterator(&internal_comparator_, &list[0], list.size());
-  versions_->current()->Ref();
+  view->current->AddIterators(options, &list, prefix);
+  return NewMergingIterator(&internal_comparator_, &list[0], list.size());
+}
 
-  IterState* cleanup = new IterState(&mutex_, mem_, imm_, versions_->current());
-  internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, nullptr);
+// The internal iterator of a DB iterator with prefix_same_as_start set.
+// A Seek() to a key with a new prefix replaces the merging iterator by one
+// over the files that may hold that prefix.  It then only yields all keys
+// with the prefix, which is all that DBIter returns.
+class DBImpl::PrefixSeekIterator : public Iterator {
+ public:
+  // Uses the caller's reference to "view".
+  PrefixSeekIterator(DBImpl* db, const ReadOptions& options, ReadView* view)
+      : db_(db),
+        options_(options),
+        view_(view),
+        iter_(nullptr),
+        has_prefix_(false) {}
+
+  ~PrefixSeekIterator() override { delete iter_; }
+
+  bool Valid() const override { return iter_ != nullptr && iter_->Valid(); }
+  void Seek(const Slice& target) override {
+    const SliceTransform* extractor = db_->options_.prefix_extractor;
+    const Slice user_key = ExtractUserKey(target);
+    if (extractor->InDomain(user_key)) {
+      const Slice prefix = extractor->Transform(user_key);
+      if (iter_ == nullptr || !has_prefix_ || prefix != Slice(prefix_)) {
+        Reset(&prefix);
+      }
+    } else if (iter_ == nullptr || has_prefix_) {
+      Reset(nullptr);
+    }
+    iter_->Seek(target);
+  }
+  // Unlike the other internal iterators, starts at the lower bound and
+  // ends before the upper bound of the iteration.  DBIter cannot seek to
+  // them without restricting the iterator to their prefixes.
+  void SeekToFirst() override {
+    if (iter_ == nullptr || has_prefix_) {
+      Reset(nullptr);
+    }
+    if (options_.iterate_lower_bound != nullptr) {
+      iter_->Seek(InternalKey(*options_.iterate_lower_bound,
+                              kMaxSequenceNumber, kValueTypeForSeek)
+                      .Encode());
+    } else {
+      iter_->SeekToFirst();
+    }
+  }
+  void SeekToLast() override {
+    if (iter_ == nullptr || has_prefix_) {
+      Reset(nullptr);
+    }
+    if (options_.iterate_upper_bound != nullptr) {
+      iter_->Seek(InternalKey(*options_.iterate_upper_bound,
+                              kMaxSequenceNumber, kValueTypeForSeek)
+                      .Encode());
+      if (iter_->Valid()) {
+        iter_->Prev();
+      } else {
+        iter_->SeekToLast();
+      }
+    } else {
+      iter_->SeekToLast();
+    }
+  }
+  void Next() override { iter_->Next(); }
+  void Prev() override { iter_->Prev(); }
+  Slice key() const override { return iter_->key(); }
+  Slice value() const override { return iter_->value(); }
+  Status status() const override {
+    return iter_ != nullptr ? iter_->status() : Status::OK();
+  }
+
+ private:
+  void Reset(const Slice* prefix) {
+    delete iter_;
+    iter_ = db_->NewViewIterator(options_, view_, prefix);
+    has_prefix_ = (prefix != nullptr);
+    if (has_prefix_) {
+      prefix_.assign(prefix->data(), prefix->size());
+    }
+  }
 
-  *seed = ++seed_;
-  mutex_.Unlock();
+  DBImpl* const db_;
+  const ReadOptions options_;
+  ReadView* const view_;
+  Iterator* iter_;
+  bool has_prefix_;
+  std::string prefix_;
+};
+
+Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
+                                      SequenceNumber* latest_snapshot,
+                                      uint32_t* seed,
+                                      RangeDelAggregator** range_deletions) {
+  ReadView* view = GetReadView(latest_snapshot);
+  Iterator* internal_iter;
+  if (options.prefix_same_as_start && options_.prefix_extractor != nullptr) {
+    internal_iter = new PrefixSeekIterator(this, options, view);
+  } else {
+    internal_iter = NewViewIterator(options, view, nullptr);
+  }
+
+  // The iterator holds its own reference to the view.
+  view->refs.fetch_add(1, std::memory_order_relaxed);
+  internal_iter->RegisterCleanup(CleanupReadView, this, view);
+
+  if (range_deletions != nullptr) {
+    const SequenceNumber sequence =
+        (options.snapshot != nullptr
+             ? static_cast<const SnapshotImpl*>(options.snapshot)
+                   ->sequence_number()
+             : *latest_snapshot);
+    RangeDelAggregator* aggregator =
+        new RangeDelAggregator(user_comparator(), sequence);
+    std::vector<RangeTombstone> memtable_range_deletions;
+    view->mem->GetRangeDeletions(&memtable_range_deletions);
+    if (view->imm != nullptr) {
+      view->imm->GetRangeDeletions(&memtable_range_deletions);
+    }
+    for (const RangeTombstone& t : memtable_range_deletions) {
+      aggregator->Add(t.begin, t.end, t.sequence);
+    }
+    Status s = view->current->AddRangeDeletions(aggregator);
+    if (!s.ok()) {
+      delete internal_iter;
+      internal_iter = NewErrorIterator(s);
+    }
+    if (!s.ok() || aggregator->empty()) {
+      delete aggregator;
+      aggregator = nullptr;
+    }
+    *range_deletions = aggregator;
+  }
+  ReturnReadView(view);
+
+  *seed = seed_.fetch_add(1, std::memory_order_relaxed) + 1;
   return internal_iter;
 }
 
@@ -1115,60 +1831,138 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
 Status DBImpl::Get(const ReadOptions& options, const Slice& key,
                    std::string* value) {
   Status s;
-  MutexLock l(&mutex_);
   SequenceNumber snapshot;
+  ReadView* view = GetReadView(&snapshot);
   if (options.snapshot != nullptr) {
     snapshot =
         static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number();
+  }
+
+  // First look in the memtable, then in the immutable memtable (if any).
+  LookupKey lkey(key, snapshot);
+  if (view->mem->Get(lkey, value, &s)) {
+    // Done
+  } else if (view->imm != nullptr && view->imm->Get(lkey, value, &s)) {
+    // Done
   } else {
-    snapshot = versions_->LastSequence();
+    Version::GetStats stats;
+    s = view->current->Get(options, lkey, value, &stats);
+    // Only take the mutex if a seek has to be charged to a file.
+    if (stats.seek_file != nullptr) {
+      MutexLock l(&mutex_);
+      if (view->current->UpdateStats(stats)) {
+        MaybeScheduleCompaction();
+      }
+    }
   }
+  ReturnReadView(view);
+  return s;
+}
 
-  MemTable* mem = mem_;
-  MemTable* imm = imm_;
-  Version* current = versions_->current();
-  mem->Ref();
-  if (imm != nullptr) imm->Ref();
-  current->Ref();
+void DBImpl::MultiGet(const ReadOptions& options,
+                      const std::vector<Slice>& keys,
+                      std::vector<std::string>* values,
+                      std::vector<Status>* statuses) {
+  const size_t n = keys.size();
+  values->resize(n);
+  statuses->assign(n, Status());
 
-  bool have_stat_update = false;
-  Version::GetStats stats;
+  SequenceNumber snapshot;
+  ReadView* view = GetReadView(&snapshot);
+  if (options.snapshot != nullptr) {
+    snapshot =
+        static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number();
+  }
+  MemTable* mem = view->mem;
+  MemTable* imm = view->imm;
+  Version* current = view->current;
 
-  // Unlock while reading from files and memtables
+  std::vector<Version::GetStats> stats;
   {
-    mutex_.Unlock();
     // First look in the memtable, then in the immutable memtable (if any).
-    LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
-      // Done
-    } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
-      // Done
-    } else {
-      s = current->Get(options, lkey, value, &stats);
-      have_stat_update = true;
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < n; i++) {
+      LookupKey lkey(keys[i], snapshot);
+      if (mem->Get(lkey, &(*values)[i], &(*statuses)[i])) {
+        // Done
+      } else if (imm != nullptr &&
+                 imm->Get(lkey, &(*values)[i], &(*statuses)[i])) {
+        // Done
+      } else {
+        pending.push_back(i);
+      }
+    }
+
+    if (!pending.empty()) {
+      // Look up the remaining keys in the table files in sorted order, so
+      // that keys in the same file or block are looked up together.
+      struct KeyOrder {
+        const Comparator* ucmp;
+        const std::vector<Slice>* keys;
+        bool operator()(size_t a, size_t b) const {
+          return ucmp->Compare((*keys)[a], (*keys)[b]) < 0;
+        }
+      };
+      std::sort(pending.begin(), pending.end(),
+                KeyOrder{user_comparator(), &keys});
+
+      std::vector<std::string> internal_keys(pending.size());
+      std::vector<Slice> sorted_keys(pending.size());
+      std::vector<std::string*> sorted_values(pending.size());
+      for (size_t j = 0; j < pending.size(); j++) {
+        AppendInternalKey(&internal_keys[j],
+                          ParsedInternalKey(keys[pending[j]], snapshot,
+                                            kValueTypeForSeek));
+        sorted_keys[j] = internal_keys[j];
+        sorted_values[j] = &(*values)[pending[j]];
+      }
+      std::vector<Status> sorted_statuses;
+      current->MultiGet(options, sorted_keys, sorted_values, &sorted_statuses,
+                        &stats);
+      for (size_t j = 0; j < pending.size(); j++) {
+        (*statuses)[pending[j]] = sorted_statuses[j];
+      }
     }
-    mutex_.Lock();
   }
 
-  if (have_stat_update && current->UpdateStats(stats)) {
-    MaybeScheduleCompaction();
+  bool charge_seeks = false;
+  for (const Version::GetStats& s : stats) {
+    if (s.seek_file != nullptr) {
+      charge_seeks = true;
+    }
   }
-  mem->Unref();
-  if (imm != nullptr) imm->Unref();
-  current->Unref();
-  return s;
+  if (charge_seeks) {
+    MutexLock l(&mutex_);
+    bool schedule_compaction = false;
+    for (const Version::GetStats& s : stats) {
+      if (current->UpdateStats(s)) {
+        schedule_compaction = true;
+      }
+    }
+    if (schedule_compaction) {
+      MaybeScheduleCompaction();
+    }
+  }
+  ReturnReadView(view);
 }
 
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   SequenceNumber latest_snapshot;
   uint32_t seed;
-  Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
-  return NewDBIterator(this, user_comparator(), iter,
+  RangeDelAggregator* range_deletions;
+  Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed,
+                                       &range_deletions);
+  return NewDBIterator(this, options, user_comparator(), iter,
                        (options.snapshot != nullptr
                             ? static_cast<const SnapshotImpl*>(options.snapshot)
                                   ->sequence_number()
                             : latest_snapshot),
-                       seed);
+                       seed, range_deletions,
+                       (options.prefix_same_as_start
+                            ? options_.prefix_extractor
+                            : nullptr),
+                       options.iterate_lower_bound,
+                       options.iterate_upper_bound);
 }
 
 void DBImpl::RecordReadSample(Slice key) {
@@ -1178,6 +1972,15 @@ void DBImpl::RecordReadSample(Slice key) {
   }
 }
 
+Status DBImpl::ReadBlob(const ReadOptions& options, const Slice& user_key,
+                        const Slice& blob_index, std::string* value) {
+  BlobIndex index;
+  if (!index.DecodeFrom(blob_index)) {
+    return Status::Corruption("bad blob index for ", user_key);
+  }
+  return table_cache_->ReadBlob(options, user_key, index, value);
+}
+
 const Snapshot* DBImpl::GetSnapshot() {
   MutexLock l(&mutex_);
   return snapshots_.New(versions_->LastSequence());
@@ -1198,14 +2001,21 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
 }
 
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
+  if (options_.enable_pipelined_write) {
+    return PipelinedWrite(options, updates);
+  }
+
   Writer w(&mutex_);
   w.batch = updates;
   w.sync = options.sync;
+  w.disable_wal = options.disable_wal;
   w.done = false;
 
   MutexLock l(&mutex_);
   writers_.push_back(&w);
-  while (!w.done && &w != writers_.front()) {
+  // Writers of a group that waits for wal_writer_ are no longer queued
+  // but not yet done.
+  while (!w.done && (writers_.empty() || &w != writers_.front())) {
     w.cv.Wait();
   }
   if (w.done) {
@@ -1214,10 +2024,17 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
 
   // May temporarily unlock and wait.
   Status status = MakeRoomForWrite(updates == nullptr);
-  uint64_t last_sequence = versions_->LastSequence();
+  // Sequence numbers of groups whose records are still queued in
+  // wal_writer_ are not yet published in versions_.
+  uint64_t last_sequence = wal_groups_.empty()
+                               ? versions_->LastSequence()
+                               : wal_groups_.back()->last_sequence;
+  uint64_t wal_ticket = 0;  // Non-zero if the record went to wal_writer_
+  WalGroup wal_group;
   Writer* last_writer = &w;
   if (status.ok() && updates != nullptr) {  // nullptr batch is for compactions
     WriteBatch* updates = BuildBatchGroup(&last_writer);
+    DelayWrite(WriteBatchInternal::ByteSize(updates));  // May unlock and wait
     WriteBatchInternal::SetSequence(updates, last_sequence + 1);
     last_sequence += WriteBatchInternal::Count(updates);
 
@@ -1227,12 +2044,28 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     // into mem_.
     {
       mutex_.Unlock();
-      status = log_->AddRecord(WriteBatchInternal::Contents(updates));
       bool sync_error = false;
-      if (status.ok() && options.sync) {
-        status = logfile_->Sync();
-        if (!status.ok()) {
-          sync_error = true;
+      if (options.disable_wal) {
+        // The batch is only kept in mem_.
+      } else {
+        // Values that the batch only refers to are gathered straight
+        // into the log record.
+        record_parts_.clear();
+        WriteBatchInternal::AppendContents(updates, &record_parts_);
+        if (wal_writer_ != nullptr) {
+          // The record is written in the background; its sequence numbers
+          // are published once it is in the log (see below).
+          wal_ticket = wal_writer_->AddRecord(
+              record_parts_.data(), record_parts_.size(), options.sync);
+        } else {
+          status =
+              log_->AddRecord(record_parts_.data(), record_parts_.size());
+          if (status.ok() && options.sync) {
+            status = logfile_->Sync();
+            if (!status.ok()) {
+              sync_error = true;
+            }
+          }
         }
       }
       if (status.ok()) {
@@ -1248,16 +2081,41 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     }
     if (updates == tmp_batch_) tmp_batch_->Clear();
 
-    versions_->SetLastSequence(last_sequence);
+    if (wal_ticket != 0) {
+      wal_group.leader = &w;
+      wal_group.last_sequence = last_sequence;
+      wal_group.done = false;
+      wal_group.finished = false;
+      wal_groups_.push_back(&wal_group);
+    } else {
+      // A group that skipped the log must not publish the sequence
+      // numbers of earlier groups that are still queued in wal_writer_,
+      // nor those of an earlier group whose record failed.
+      while (!wal_groups_.empty()) {
+        w.cv.Wait();
+      }
+      if (status.ok() && wal_writer_ != nullptr && !bg_error_.ok()) {
+        status = bg_error_;
+      }
+      if (status.ok()) {
+        versions_->SetLastSequence(last_sequence);
+      }
+    }
   }
 
+  // Writers of this group that wait for wal_writer_ along with us.
+  std::vector<Writer*> logging;
   while (true) {
     Writer* ready = writers_.front();
     writers_.pop_front();
     if (ready != &w) {
-      ready->status = status;
-      ready->done = true;
-      ready->cv.Signal();
+      if (wal_ticket != 0) {
+        logging.push_back(ready);
+      } else {
+        ready->status = status;
+        ready->done = true;
+        ready->cv.Signal();
+      }
     }
     if (ready == last_writer) break;
   }
@@ -1267,9 +2125,232 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     writers_.front()->cv.Signal();
   }
 
+  if (wal_ticket != 0) {
+    // The next group can be queued while this record is being written.
+    mutex_.Unlock();
+    Status log_status = wal_writer_->Wait(wal_ticket, options.sync);
+    mutex_.Lock();
+    if (!log_status.ok()) {
+      // mem_ already holds this group, so future writes must fail for the
+      // same reason as after a sync error above.
+      RecordBackgroundError(log_status);
+    }
+    wal_group.status = log_status;
+    wal_group.done = true;
+    PublishWalGroups();
+    // Our writes become visible only once every earlier group is done.
+    while (!wal_group.finished) {
+      w.cv.Wait();
+    }
+    status = wal_group.status;
+    for (Writer* ready : logging) {
+      ready->status = status;
+      ready->done = true;
+      ready->cv.Signal();
+    }
+  }
+
   return status;
 }
 
+void DBImpl::PublishWalGroups() {
+  mutex_.AssertHeld();
+  while (!wal_groups_.empty() && wal_groups_.front()->done) {
+    WalGroup* group = wal_groups_.front();
+    wal_groups_.pop_front();
+    // Once a record fails, wal_writer_ fails all later records as well,
+    // so no sequence number past a failed group is published.  Its
+    // entries stay invisible in mem_.
+    if (group->status.ok()) {
+      versions_->SetLastSequence(group->last_sequence);
+    }
+    group->finished = true;
+    group->leader->cv.Signal();
+  }
+  if (wal_groups_.empty() && !writers_.empty()) {
+    // The head of the queue may be waiting to switch memtables or to
+    // publish a group that skipped the log.
+    writers_.front()->cv.Signal();
+  }
+}
+
+Status DBImpl::PipelinedWrite(const WriteOptions& options,
+                              WriteBatch* updates) {
+  Writer w(&mutex_);
+  w.batch = updates;
+  w.sync = options.sync;
+  w.disable_wal = options.disable_wal;
+  w.done = false;
+
+  MutexLock l(&mutex_);
+  writers_.push_back(&w);
+  while (!w.done && w.group == nullptr && &w != writers_.front()) {
+    w.cv.Wait();
+  }
+  if (w.done) {
+    return w.status;
+  }
+
+  if (w.group == nullptr) {
+    // We are at the front of the writer queue and responsible for
+    // logging a group of writers.
+    // May temporarily unlock and wait.
+    Status status = MakeRoomForWrite(updates == nullptr);
+    if (!status.ok() || updates == nullptr) {
+      writers_.pop_front();
+      if (!writers_.empty()) {
+        writers_.front()->cv.Signal();
+      }
+      return status;
+    }
+
+    // Sequence numbers of groups that are still being applied to the
+    // memtable are not yet published in versions_.
+    SequenceNumber last_sequence = memtable_groups_.empty()
+                                       ? versions_->LastSequence()
+                                       : memtable_groups_.back()->last_sequence;
+    Writer* last_writer = &w;
+    WriteBatch* record = BuildBatchGroup(&last_writer);
+    DelayWrite(WriteBatchInternal::ByteSize(record));  // May unlock and wait
+    WriteBatchInternal::SetSequence(record, last_sequence + 1);
+
+    // Give every batch of the group its own sequence numbers so that each
+    // writer can insert its batch into the memtable by itself.
+    WriteGroup* group = new WriteGroup;
+    group->pending = 0;
+    for (std::deque<Writer*>::iterator iter = writers_.begin();; ++iter) {
+      Writer* member = *iter;
+      group->writers.push_back(member);
+      if (member->batch != nullptr) {
+        WriteBatchInternal::SetSequence(member->batch, last_sequence + 1);
+        last_sequence += WriteBatchInternal::Count(member->batch);
+        group->pending++;
+      }
+      if (member == last_writer) break;
+    }
+    group->last_sequence = last_sequence;
+
+    // Add to log.  We can release the lock during this phase since &w is
+    // at the front of the writer queue and protects against concurrent
+    // loggers.  The previous group may still be inserting into mem_.
+    {
+      mutex_.Unlock();
+      bool sync_error = false;
+      if (!options.disable_wal) {
+        record_parts_.clear();
+        WriteBatchInternal::AppendContents(record, &record_parts_);
+        status = log_->AddRecord(record_parts_.data(), record_parts_.size());
+        if (status.ok() && options.sync) {
+          status = logfile_->Sync();
+          if (!status.ok()) {
+            sync_error = true;
+          }
+        }
+      }
+      mutex_.Lock();
+      if (sync_error) {
+        // The state of the log file is indeterminate: the log record we
+        // just added may or may not show up when the DB is re-opened.
+        // So we force the DB into a mode where all future writes fail.
+        RecordBackgroundError(status);
+      }
+    }
+    if (record == tmp_batch_) tmp_batch_->Clear();
+
+    for (size_t i = 0; i < group->writers.size(); i++) {
+      writers_.pop_front();
+    }
+
+    if (!status.ok()) {
+      for (Writer* member : group->writers) {
+        if (member != &w) {
+          member->status = status;
+          member->done = true;
+          member->cv.Signal();
+        }
+      }
+      delete group;
+      if (!writers_.empty()) {
+        writers_.front()->cv.Signal();
+      }
+      return status;
+    }
+
+    memtable_groups_.push_back(group);
+    if (memtable_groups_.size() == 1) {
+      ActivateWriteGroup(group);
+    }
+
+    // Let the next group be logged while this one is applied.
+    if (!writers_.empty()) {
+      writers_.front()->cv.Signal();
+    }
+
+    while (w.group == nullptr) {
+      w.cv.Wait();
+    }
+  }
+
+  // Insert our own batch in parallel with the other writers of the group.
+  // mem_ cannot be switched while a group is being applied.
+  MemTable* mem = mem_;
+  Status status;
+  {
+    mutex_.Unlock();
+    status = WriteBatchInternal::InsertIntoConcurrently(w.batch, mem);
+    mutex_.Lock();
+  }
+  CompleteMemTableWrite(&w, status);
+  while (!w.done) {
+    w.cv.Wait();
+  }
+  return w.status;
+}
+
+// REQUIRES: group is at the front of memtable_groups_
+void DBImpl::ActivateWriteGroup(WriteGroup* group) {
+  mutex_.AssertHeld();
+  assert(group == memtable_groups_.front());
+  for (Writer* member : group->writers) {
+    if (member->batch != nullptr) {
+      member->group = group;
+      member->cv.Signal();
+    }
+  }
+}
+
+void DBImpl::CompleteMemTableWrite(Writer* w, const Status& s) {
+  mutex_.AssertHeld();
+  WriteGroup* group = w->group;
+  if (!s.ok() && group->status.ok()) {
+    group->status = s;
+  }
+  if (--group->pending > 0) {
+    return;
+  }
+
+  // Last writer of the group: make the group visible to readers.
+  assert(group == memtable_groups_.front());
+  versions_->SetLastSequence(group->last_sequence);
+  for (Writer* member : group->writers) {
+    member->status = group->status;
+    member->done = true;
+    if (member != w) {
+      member->cv.Signal();
+    }
+  }
+  memtable_groups_.pop_front();
+  delete group;
+
+  if (!memtable_groups_.empty()) {
+    ActivateWriteGroup(memtable_groups_.front());
+  } else if (!writers_.empty()) {
+    // The front writer may be waiting in MakeRoomForWrite() to switch
+    // to a new memtable.
+    writers_.front()->cv.Signal();
+  }
+}
+
 // REQUIRES: Writer list must be non-empty
 // REQUIRES: First writer must have a non-null batch
 WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
@@ -1299,6 +2380,11 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
       break;
     }
 
+    if (w->disable_wal != first->disable_wal) {
+      // The group is either logged as a whole or not at all.
+      break;
+    }
+
     if (w->batch != nullptr) {
       size += WriteBatchInternal::ByteSize(w->batch);
       if (size > max_size) {
@@ -1320,30 +2406,40 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
   return result;
 }
 
+// REQUIRES: mutex_ is held
+// REQUIRES: this thread is currently at the front of the writer queue
+void DBImpl::DelayWrite(uint64_t bytes) {
+  mutex_.AssertHeld();
+  write_controller_.Update(versions_->NumLevelFiles(0),
+                           versions_->PendingCompactionBytes());
+  if (write_controller_.rate() == 0) {
+    return;
+  }
+  // We are getting close to hitting a hard limit.  Rather than delaying
+  // a single write by several seconds when we hit the limit, meter all
+  // writes to reduce latency variance.  Also, the delay hands over some
+  // CPU to the compaction thread in case it is sharing the same core as
+  // the writer.
+  const uint64_t delay = write_controller_.GetDelay(env_->NowMicros(), bytes);
+  if (delay > 0) {
+    mutex_.Unlock();
+    env_->SleepForMicroseconds(static_cast<int>(delay));
+    mutex_.Lock();
+    write_stall_micros_ += delay;
+  }
+}
+
 // REQUIRES: mutex_ is held
 // REQUIRES: this thread is currently at the front of the writer queue
 Status DBImpl::MakeRoomForWrite(bool force) {
   mutex_.AssertHeld();
   assert(!writers_.empty());
-  bool allow_delay = !force;
   Status s;
   while (true) {
     if (!bg_error_.ok()) {
       // Yield previous error
       s = bg_error_;
       break;
-    } else if (allow_delay && versions_->NumLevelFiles(0) >=
-                                  config::kL0_SlowdownWritesTrigger) {
-      // We are getting close to hitting a hard limit on the number of
-      // L0 files.  Rather than delaying a single write by several
-      // seconds when we hit the hard limit, start delaying each
-      // individual write by 1ms to reduce latency variance.  Also,
-      // this delay hands over some CPU to the compaction thread in
-      // case it is sharing the same core as the writer.
-      mutex_.Unlock();
-      env_->SleepForMicroseconds(1000);
-      allow_delay = false;  // Do not delay a single write more than once
-      mutex_.Lock();
     } else if (!force &&
                (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
       // There is room in current memtable
@@ -1357,6 +2453,14 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // There are too many level-0 files.
       Log(options_.info_log, "Too many L0 files; waiting...\n");
       background_work_finished_signal_.Wait();
+    } else if (!memtable_groups_.empty()) {
+      // Pipelined writers are still inserting into mem_, so we wait
+      // for them before switching to a new memtable.
+      writers_.front()->cv.Wait();
+    } else if (!wal_groups_.empty()) {
+      // Records for mem_ are still queued in wal_writer_.  Wait until they
+      // are in the current log and their sequence numbers are published.
+      writers_.front()->cv.Wait();
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
       assert(versions_->PrevLogNumber() == 0);
@@ -1373,10 +2477,14 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       logfile_ = lfile;
       logfile_number_ = new_log_number;
       log_ = new log::Writer(lfile);
+      if (wal_writer_ != nullptr) {
+        wal_writer_->SetLog(log_, logfile_);
+      }
       imm_ = mem_;
       has_imm_.store(true, std::memory_order_release);
-      mem_ = new MemTable(internal_comparator_);
+      mem_ = new MemTable(internal_comparator_, options_.memtable_factory);
       mem_->Ref();
+      InstallReadView();
       force = false;  // Do not force another compaction if have room
       MaybeScheduleCompaction();
     }
@@ -1441,6 +2549,18 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
              static_cast<unsigned long long>(total_usage));
     value->append(buf);
     return true;
+  } else if (in == "delayed-write-rate") {
+    char buf[50];
+    snprintf(buf, sizeof(buf), "%llu",
+             static_cast<unsigned long long>(write_controller_.rate()));
+    value->append(buf);
+    return true;
+  } else if (in == "write-stall-micros") {
+    char buf[50];
+    snprintf(buf, sizeof(buf), "%llu",
+             static_cast<unsigned long long>(write_stall_micros_));
+    value->append(buf);
+    return true;
   }
 
   return false;
@@ -1478,6 +2598,42 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   return Write(opt, &batch);
 }
 
+Status DB::DeleteRange(const WriteOptions& opt, const Slice& begin,
+                       const Slice& end) {
+  WriteBatch batch;
+  batch.DeleteRange(begin, end);
+  return Write(opt, &batch);
+}
+
+Status DB::DeleteFilesInRange(const Slice& begin, const Slice& end) {
+  return Status::NotSupported("DeleteFilesInRange");
+}
+
+Status DB::FlushMemTable(bool wait) {
+  return Status::NotSupported("FlushMemTable");
+}
+
+void DB::MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                  std::vector<std::string>* values,
+                  std::vector<Status>* statuses) {
+  // Without an explicit snapshot, separate Get() calls could observe
+  // different states of the database.
+  const Snapshot* snapshot = nullptr;
+  ReadOptions read_options = options;
+  if (read_options.snapshot == nullptr) {
+    snapshot = GetSnapshot();
+    read_options.snapshot = snapshot;
+  }
+  values->resize(keys.size());
+  statuses->resize(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    (*statuses)[i] = Get(read_options, keys[i], &(*values)[i]);
+  }
+  if (snapshot != nullptr) {
+    ReleaseSnapshot(snapshot);
+  }
+}
+
 DB::~DB() = default;
 
 Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
@@ -1500,7 +2656,8 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
       impl->logfile_ = lfile;
       impl->logfile_number_ = new_log_number;
       impl->log_ = new log::Writer(lfile);
-      impl->mem_ = new MemTable(impl->internal_comparator_);
+      impl->mem_ = new MemTable(impl->internal_comparator_,
+                                impl->options_.memtable_factory);
       impl->mem_->Ref();
     }
   }
@@ -1510,6 +2667,10 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     s = impl->versions_->LogAndApply(&edit, &impl->mutex_);
   }
   if (s.ok()) {
+    if (impl->wal_writer_ != nullptr) {
+      impl->wal_writer_->SetLog(impl->log_, impl->logfile_);
+    }
+    impl->InstallReadView();
     impl->DeleteObsoleteFiles();
     impl->MaybeScheduleCompaction();
   }
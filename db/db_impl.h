@@ -9,18 +9,24 @@
 #include <deque>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
+#include "db/log_async_writer.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
+#include "db/write_controller.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
+#include "util/thread_local.h"
 
 namespace leveldb {
 
+struct FileMetaData;
 class MemTable;
+class RangeDelAggregator;
 class TableCache;
 class Version;
 class VersionEdit;
@@ -42,12 +48,17 @@ class DBImpl : public DB {
   Status Write(const WriteOptions& options, WriteBatch* updates) override;
   Status Get(const ReadOptions& options, const Slice& key,
              std::string* value) override;
+  void MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                std::vector<std::string>* values,
+                std::vector<Status>* statuses) override;
   Iterator* NewIterator(const ReadOptions&) override;
   const Snapshot* GetSnapshot() override;
   void ReleaseSnapshot(const Snapshot* snapshot) override;
   bool GetProperty(const Slice& property, std::string* value) override;
   void GetApproximateSizes(const Range* range, int n, uint64_t* sizes) override;
   void CompactRange(const Slice* begin, const Slice* end) override;
+  Status DeleteFilesInRange(const Slice& begin, const Slice& end) override;
+  Status FlushMemTable(bool wait) override;
 
   // Extra methods (for testing) that are not in the public DB interface
 
@@ -71,10 +82,20 @@ class DBImpl : public DB {
   // bytes.
   void RecordReadSample(Slice key);
 
+  // Read the value of "user_key" from the blob that the encoded BlobIndex
+  // "blob_index" refers to (see db/blob_file.h).  The blob file must be
+  // kept alive by a version the caller holds.
+  Status ReadBlob(const ReadOptions& options, const Slice& user_key,
+                  const Slice& blob_index, std::string* value);
+
  private:
   friend class DB;
   struct CompactionState;
+  class PrefixSeekIterator;
+  struct ReadView;
   struct Writer;
+  struct WriteGroup;
+  struct WalGroup;
 
   // Information for a manual compaction
   struct ManualCompaction {
@@ -101,9 +122,36 @@ class DBImpl : public DB {
     int64_t bytes_written;
   };
 
+  // If "range_deletions" is non-null, also collects the range deletions
+  // visible to the iterator in a new *range_deletions, or sets it to
+  // nullptr if there are none.
   Iterator* NewInternalIterator(const ReadOptions&,
                                 SequenceNumber* latest_snapshot,
-                                uint32_t* seed);
+                                uint32_t* seed,
+                                RangeDelAggregator** range_deletions = nullptr);
+
+  // Returns a merging iterator over the memtables and table files of
+  // "view".  If "prefix" is non-null, leaves out the table files that
+  // hold no user key with that prefix.
+  Iterator* NewViewIterator(const ReadOptions&, ReadView* view,
+                            const Slice* prefix);
+
+  // Return the latest read view and store the last sequence number of the
+  // writes it holds in *latest_sequence.  The caller owns a reference to
+  // the view until it passes the view to ReturnReadView().  Only locks
+  // mutex_ when the view that the calling thread cached is out of date.
+  ReadView* GetReadView(SequenceNumber* latest_sequence);
+  void ReturnReadView(ReadView* view);
+
+  // Drop a reference to "view" and free it once unused.
+  void UnrefReadView(ReadView* view);
+  void UnrefReadViewLocked(ReadView* view) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  static void CleanupReadView(void* db, void* view);
+  static void UnrefCachedReadView(void* view);
+
+  // Make mem_, imm_ and the current version the latest read view.  Must
+  // be called whenever one of them changes.
+  void InstallReadView() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   Status NewDB();
 
@@ -134,6 +182,19 @@ class DBImpl : public DB {
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   WriteBatch* BuildBatchGroup(Writer** last_writer)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Wait as long as write_controller_ asks for before a write group of
+  // "bytes" proceeds.
+  void DelayWrite(uint64_t bytes) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Write path used when options_.enable_pipelined_write is set.
+  Status PipelinedWrite(const WriteOptions& options, WriteBatch* updates);
+  void ActivateWriteGroup(WriteGroup* group) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void CompleteMemTableWrite(Writer* w, const Status& s)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Removes the groups at the front of wal_groups_ whose records are done
+  // and publishes the sequence numbers of those that reached the log.
+  void PublishWalGroups() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   void RecordBackgroundError(const Status& s);
 
@@ -146,8 +207,20 @@ class DBImpl : public DB {
   Status DoCompactionWork(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  Status CollectRangeDeletions(CompactionState* compact,
+                               RangeDelAggregator* range_deletions);
   Status OpenCompactionOutputFile(CompactionState* compact);
+  bool CanFinishCompactionOutputBefore(CompactionState* compact,
+                                       const Slice& internal_key);
+  void AddRangeDeletionsToOutput(CompactionState* compact,
+                                 const Slice* upper_bound);
   Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
+  Status SeparateBlobValue(CompactionState* compact,
+                           const ParsedInternalKey& ikey, Slice* key,
+                           Slice* value);
+  Status OpenCompactionBlobFile(CompactionState* compact);
+  Status FinishCompactionBlobFile(CompactionState* compact);
+  Status AddBlobGarbageOfTable(const FileMetaData* f, VersionEdit* edit);
   Status InstallCompactionResults(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -180,12 +253,35 @@ class DBImpl : public DB {
   WritableFile* logfile_;
   uint64_t logfile_number_ GUARDED_BY(mutex_);
   log::Writer* log_;
-  uint32_t seed_ GUARDED_BY(mutex_);  // For sampling.
+  std::atomic<uint32_t> seed_;  // For sampling.
+
+  // The state that reads consult, and a number that changes whenever it
+  // is replaced.  Every thread caches a reference to the view it used last
+  // in local_read_view_, so that reads find the view without locking.
+  ReadView* read_view_ GUARDED_BY(mutex_);
+  std::atomic<uint64_t> read_view_number_;
+  ThreadLocalPtr local_read_view_;
+
+  // Appends to log_ when options_.enable_wal_thread is set; null otherwise.
+  log::AsyncWriter* const wal_writer_;
+
+  // Write groups that have been handed to wal_writer_ and applied to mem_
+  // but whose sequence numbers are not yet published in versions_, in the
+  // order of their records.
+  std::deque<WalGroup*> wal_groups_ GUARDED_BY(mutex_);
 
   // Queue of writers.
   std::deque<Writer*> writers_ GUARDED_BY(mutex_);
   WriteBatch* tmp_batch_ GUARDED_BY(mutex_);
 
+  // The pieces of the log record of the current write group.  Only used
+  // by the writer at the front of writers_.
+  std::vector<Slice> record_parts_;
+
+  // Groups of pipelined writers that have been logged but are not yet
+  // completely applied to mem_.  Only the front group inserts into mem_.
+  std::deque<WriteGroup*> memtable_groups_ GUARDED_BY(mutex_);
+
   SnapshotList snapshots_ GUARDED_BY(mutex_);
 
   // Set of table files to protect from deletion because they are
@@ -203,6 +299,11 @@ class DBImpl : public DB {
   Status bg_error_ GUARDED_BY(mutex_);
 
   CompactionStats stats_[config::kNumLevels] GUARDED_BY(mutex_);
+
+  // Meters writes while compactions fall behind, and the total time that
+  // writers were delayed by it.
+  WriteController write_controller_ GUARDED_BY(mutex_);
+  uint64_t write_stall_micros_ GUARDED_BY(mutex_);
 };
 
 // Sanitize db options.  The caller should delete result.info_log if
@@ -7,8 +7,10 @@
 #include "db/db_impl.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/range_del.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "leveldb/slice_transform.h"
 #include "port/port.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
@@ -45,12 +47,24 @@ class DBIter : public Iterator {
   //     just before all entries whose user key == this->key().
   enum Direction { kForward, kReverse };
 
-  DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
-         uint32_t seed)
+  DBIter(DBImpl* db, const ReadOptions& options, const Comparator* cmp,
+         Iterator* iter, SequenceNumber s, uint32_t seed,
+         RangeDelAggregator* range_deletions,
+         const SliceTransform* prefix_extractor, const Slice* lower_bound,
+         const Slice* upper_bound)
       : db_(db),
+        options_(options),
         user_comparator_(cmp),
         iter_(iter),
         sequence_(s),
+        range_deletions_(range_deletions),
+        prefix_extractor_(prefix_extractor),
+        has_prefix_(false),
+        has_lower_bound_(lower_bound != nullptr),
+        has_upper_bound_(upper_bound != nullptr),
+        lower_bound_(has_lower_bound_ ? lower_bound->ToString() : ""),
+        upper_bound_(has_upper_bound_ ? upper_bound->ToString() : ""),
+        saved_is_blob_index_(false),
         direction_(kForward),
         valid_(false),
         rnd_(seed),
@@ -59,7 +73,10 @@ class DBIter : public Iterator {
   DBIter(const DBIter&) = delete;
   DBIter& operator=(const DBIter&) = delete;
 
-  ~DBIter() override { delete iter_; }
+  ~DBIter() override {
+    delete iter_;
+    delete range_deletions_;
+  }
   bool Valid() const override { return valid_; }
   Slice key() const override {
     assert(valid_);
@@ -67,13 +84,20 @@ class DBIter : public Iterator {
   }
   Slice value() const override {
     assert(valid_);
-    return (direction_ == kForward) ? iter_->value() : saved_value_;
+    if (direction_ == kForward) {
+      return (ExtractValueType(iter_->key()) == kTypeBlobIndex)
+                 ? ReadBlob(iter_->value())
+                 : iter_->value();
+    }
+    return saved_is_blob_index_ ? ReadBlob(saved_value_) : saved_value_;
   }
   Status status() const override {
-    if (status_.ok()) {
-      return iter_->status();
-    } else {
+    if (!status_.ok()) {
       return status_;
+    } else if (!blob_status_.ok()) {
+      return blob_status_;
+    } else {
+      return iter_->status();
     }
   }
 
@@ -88,6 +112,55 @@ class DBIter : public Iterator {
   void FindPrevUserEntry();
   bool ParseKey(ParsedInternalKey* key);
 
+  // Returns the value that the BlobIndex "blob_index" of the current entry
+  // refers to.  The blob read last is kept, since callers may ask for the
+  // value of an entry more than once.
+  Slice ReadBlob(const Slice& blob_index) const {
+    if (blob_index != Slice(blob_index_)) {
+      blob_index_.assign(blob_index.data(), blob_index.size());
+      Status s = db_->ReadBlob(options_, key(), blob_index, &blob_value_);
+      if (!s.ok()) {
+        blob_status_ = s;
+        blob_value_.clear();
+      }
+    }
+    return blob_value_;
+  }
+
+  // Returns the type of "ikey", except that values hidden by a range
+  // deletion count as deletions.
+  ValueType EntryType(const ParsedInternalKey& ikey) {
+    if ((ikey.type == kTypeValue || ikey.type == kTypeBlobIndex) &&
+        range_deletions_ != nullptr && range_deletions_->ShouldDelete(ikey)) {
+      return kTypeDeletion;
+    }
+    return ikey.type;
+  }
+
+  // Invalidates the iterator if it left the prefix of the last Seek().
+  void CheckPrefix() {
+    if (valid_ && has_prefix_) {
+      Slice k = key();
+      if (!prefix_extractor_->InDomain(k) ||
+          prefix_extractor_->Transform(k) != Slice(prefix_)) {
+        valid_ = false;
+        saved_key_.clear();
+        ClearSavedValue();
+        direction_ = kForward;
+      }
+    }
+  }
+
+  bool BeforeLowerBound(const Slice& user_key) const {
+    return has_lower_bound_ &&
+           user_comparator_->Compare(user_key, lower_bound_) < 0;
+  }
+
+  bool AtOrAfterUpperBound(const Slice& user_key) const {
+    return has_upper_bound_ &&
+           user_comparator_->Compare(user_key, upper_bound_) >= 0;
+  }
+
   inline void SaveKey(const Slice& k, std::string* dst) {
     dst->assign(k.data(), k.size());
   }
@@ -107,12 +180,26 @@ class DBIter : public Iterator {
   }
 
   DBImpl* db_;
+  const ReadOptions options_;  // Used to read blobs
   const Comparator* const user_comparator_;
   Iterator* const iter_;
   SequenceNumber const sequence_;
+  RangeDelAggregator* const range_deletions_;
+  const SliceTransform* const prefix_extractor_;
+  bool has_prefix_;     // prefix_ bounds the iteration
+  std::string prefix_;  // Prefix of the target of the last Seek()
+  const bool has_lower_bound_;
+  const bool has_upper_bound_;
+  const std::string lower_bound_;  // Smallest user key to yield
+  const std::string upper_bound_;  // User keys to yield are smaller
   Status status_;
   std::string saved_key_;    // == current key when direction_==kReverse
   std::string saved_value_;  // == current raw value when direction_==kReverse
+  bool saved_is_blob_index_;  // saved_value_ holds a BlobIndex
+  // The blob value() read last, and the error of the first failed read
+  mutable std::string blob_index_;
+  mutable std::string blob_value_;
+  mutable Status blob_status_;
   Direction direction_;
   bool valid_;
   Random rnd_;
@@ -172,6 +259,7 @@ void DBIter::Next() {
   }
 
   FindNextUserEntry(true, &saved_key_);
+  CheckPrefix();
 }
 
 void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
@@ -180,15 +268,23 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   assert(direction_ == kForward);
   do {
     ParsedInternalKey ikey;
-    if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
-      switch (ikey.type) {
+    const bool parsed = ParseKey(&ikey);
+    if (parsed && AtOrAfterUpperBound(ikey.user_key)) {
+      // Stop here even if entries were being skipped.
+      break;
+    }
+    if (parsed && ikey.sequence <= sequence_) {
+      switch (EntryType(ikey)) {
         case kTypeDeletion:
           // Arrange to skip all upcoming entries for this key since
           // they are hidden by this deletion.
           SaveKey(ikey.user_key, skip);
           skipping = true;
           break;
+        case kTypeRangeDeletion:
+          break;
         case kTypeValue:
+        case kTypeBlobIndex:
           if (skipping &&
               user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
             // Entry hidden
@@ -231,6 +327,7 @@ void DBIter::Prev() {
   }
 
   FindPrevUserEntry();
+  CheckPrefix();
 }
 
 void DBIter::FindPrevUserEntry() {
@@ -240,13 +337,18 @@ void DBIter::FindPrevUserEntry() {
   if (iter_->Valid()) {
     do {
       ParsedInternalKey ikey;
-      if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+      const bool parsed = ParseKey(&ikey);
+      if (parsed && BeforeLowerBound(ikey.user_key)) {
+        // The entries for this->key(), if any, have all been seen.
+        break;
+      }
+      if (parsed && ikey.sequence <= sequence_) {
         if ((value_type != kTypeDeletion) &&
             user_comparator_->Compare(ikey.user_key, saved_key_) < 0) {
           // We encountered a non-deleted value in entries for previous keys,
           break;
         }
-        value_type = ikey.type;
+        value_type = EntryType(ikey);
         if (value_type == kTypeDeletion) {
           saved_key_.clear();
           ClearSavedValue();
@@ -258,6 +360,7 @@ void DBIter::FindPrevUserEntry() {
           }
           SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
           saved_value_.assign(raw_value.data(), raw_value.size());
+          saved_is_blob_index_ = (value_type == kTypeBlobIndex);
         }
       }
       iter_->Prev();
@@ -275,24 +378,48 @@ void DBIter::FindPrevUserEntry() {
   }
 }
 
-void DBIter::Seek(const Slice& target) {
+void DBIter::Seek(const Slice& user_target) {
+  const Slice target =
+      BeforeLowerBound(user_target) ? Slice(lower_bound_) : user_target;
+  has_prefix_ = prefix_extractor_ != nullptr &&
+                prefix_extractor_->InDomain(target);
+  if (has_prefix_) {
+    Slice prefix = prefix_extractor_->Transform(target);
+    prefix_.assign(prefix.data(), prefix.size());
+  }
   direction_ = kForward;
   ClearSavedValue();
   saved_key_.clear();
+  if (AtOrAfterUpperBound(target)) {
+    valid_ = false;
+    return;
+  }
   AppendInternalKey(&saved_key_,
                     ParsedInternalKey(target, sequence_, kValueTypeForSeek));
   iter_->Seek(saved_key_);
   if (iter_->Valid()) {
     FindNextUserEntry(false, &saved_key_ /* temporary storage */);
+    CheckPrefix();
   } else {
     valid_ = false;
   }
 }
 
 void DBIter::SeekToFirst() {
+  has_prefix_ = false;
   direction_ = kForward;
   ClearSavedValue();
-  iter_->SeekToFirst();
+  // The internal iterator of prefix_same_as_start starts at the lower bound
+  // by itself (see DBImpl::PrefixSeekIterator).
+  if (has_lower_bound_ && prefix_extractor_ == nullptr) {
+    saved_key_.clear();
+    AppendInternalKey(&saved_key_, ParsedInternalKey(lower_bound_,
+                                                     kMaxSequenceNumber,
+                                                     kValueTypeForSeek));
+    iter_->Seek(saved_key_);
+  } else {
+    iter_->SeekToFirst();
+  }
   if (iter_->Valid()) {
     FindNextUserEntry(false, &saved_key_ /* temporary storage */);
   } else {
@@ -301,18 +428,40 @@ void DBIter::SeekToFirst() {
 }
 
 void DBIter::SeekToLast() {
+  has_prefix_ = false;
   direction_ = kReverse;
   ClearSavedValue();
-  iter_->SeekToLast();
+  // As in SeekToFirst(), the internal iterator of prefix_same_as_start
+  // ends before the upper bound by itself.
+  if (has_upper_bound_ && prefix_extractor_ == nullptr) {
+    saved_key_.clear();
+    AppendInternalKey(&saved_key_, ParsedInternalKey(upper_bound_,
+                                                     kMaxSequenceNumber,
+                                                     kValueTypeForSeek));
+    iter_->Seek(saved_key_);
+    if (iter_->Valid()) {
+      iter_->Prev();
+    } else {
+      iter_->SeekToLast();
+    }
+  } else {
+    iter_->SeekToLast();
+  }
   FindPrevUserEntry();
 }
 
 }  // anonymous namespace
 
-Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
+Iterator* NewDBIterator(DBImpl* db, const ReadOptions& options,
+                        const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed) {
-  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+                        uint32_t seed,
+                        RangeDelAggregator* range_deletions,
+                        const SliceTransform* prefix_extractor,
+                        const Slice* lower_bound, const Slice* upper_bound) {
+  return new DBIter(db, options, user_key_comparator, internal_iter, sequence,
+                    seed, range_deletions, prefix_extractor, lower_bound,
+                    upper_bound);
 }
 
 }  // namespace leveldb
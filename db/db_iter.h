@@ -13,13 +13,26 @@
 namespace leveldb {
 
 class DBImpl;
+class RangeDelAggregator;
+class SliceTransform;
 
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
-Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
+// into appropriate user keys.  Blob values are read with "options".  If
+// "range_deletions" is non-null, the entries it deletes are skipped; the
+// iterator takes ownership of it.  If "prefix_extractor" is non-null, the
+// iterator becomes invalid once it leaves the prefix of the target of the
+// last Seek() (see ReadOptions::prefix_same_as_start).  The iterator only
+// yields the user keys in [*lower_bound, *upper_bound) (see
+// ReadOptions::iterate_lower_bound); either bound may be null.
+Iterator* NewDBIterator(DBImpl* db, const ReadOptions& options,
+                        const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed);
+                        uint32_t seed,
+                        RangeDelAggregator* range_deletions = nullptr,
+                        const SliceTransform* prefix_extractor = nullptr,
+                        const Slice* lower_bound = nullptr,
+                        const Slice* upper_bound = nullptr);
 
 }  // namespace leveldb
 
@@ -4,6 +4,7 @@
 
 #include "leveldb/db.h"
 
+#include <algorithm>
 #include <atomic>
 #include <string>
 
@@ -14,6 +15,8 @@
 #include "leveldb/cache.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/memtablerep.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
@@ -150,12 +153,12 @@ class SpecialEnv : public EnvWrapper {
       Status Close() { return base_->Close(); }
       Status Flush() { return base_->Flush(); }
       Status Sync() {
-        if (env_->data_sync_error_.load(std::memory_order_acquire)) {
-          return Status::IOError("simulated data sync error");
-        }
         while (env_->delay_data_sync_.load(std::memory_order_acquire)) {
           DelayMilliseconds(100);
         }
+        if (env_->data_sync_error_.load(std::memory_order_acquire)) {
+          return Status::IOError("simulated data sync error");
+        }
         return base_->Sync();
       }
     };
@@ -236,6 +239,8 @@ class DBTest {
 
   DBTest() : env_(new SpecialEnv(Env::Default())), option_config_(kDefault) {
     filter_policy_ = NewBloomFilterPolicy(10);
+    vector_rep_factory_ = NewVectorRepFactory(true);
+    hash_rep_factory_ = NewHashSkipListRepFactory(1024);
     dbname_ = test::TmpDir() + "/db_test";
     DestroyDB(dbname_, Options());
     db_ = nullptr;
@@ -247,6 +252,8 @@ class DBTest {
     DestroyDB(dbname_, Options());
     delete env_;
     delete filter_policy_;
+    delete vector_rep_factory_;
+    delete hash_rep_factory_;
   }
 
   // Switch to a fresh database with the next option configuration to
@@ -275,6 +282,32 @@ class DBTest {
       case kUncompressed:
         options.compression = kNoCompression;
         break;
+      case kPipelinedWrite:
+        options.enable_pipelined_write = true;
+        break;
+      case kWalThread:
+        options.enable_wal_thread = true;
+        break;
+      case kVectorRep:
+        options.memtable_factory = vector_rep_factory_;
+        break;
+      case kHashSkipListRep:
+        options.memtable_factory = hash_rep_factory_;
+        break;
+      case kDataBlockHashIndex:
+        options.data_block_hash_index = true;
+        break;
+      case kRestartKeyPrefixes:
+        options.restart_key_prefixes = true;
+        break;
+      case kPartitionedIndex:
+        options.filter_policy = filter_policy_;
+        options.partition_index_and_filters = true;
+        options.index_partition_size = 64;
+        break;
+      case kBlobValues:
+        options.min_blob_size = 10;
+        break;
       default:
         break;
     }
@@ -318,6 +351,10 @@ class DBTest {
 
   Status Delete(const std::string& k) { return db_->Delete(WriteOptions(), k); }
 
+  Status DeleteRange(const std::string& begin, const std::string& end) {
+    return db_->DeleteRange(WriteOptions(), begin, end);
+  }
+
   std::string Get(const std::string& k, const Snapshot* snapshot = nullptr) {
     ReadOptions options;
     options.snapshot = snapshot;
@@ -331,6 +368,25 @@ class DBTest {
     return result;
   }
 
+  // Like Get(), but looks up all of "keys" with one DB::MultiGet() call.
+  std::vector<std::string> MultiGet(const std::vector<std::string>& keys,
+                                    const Snapshot* snapshot = nullptr) {
+    ReadOptions options;
+    options.snapshot = snapshot;
+    std::vector<Slice> key_slices(keys.begin(), keys.end());
+    std::vector<std::string> values;
+    std::vector<Status> statuses;
+    db_->MultiGet(options, key_slices, &values, &statuses);
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (statuses[i].IsNotFound()) {
+        values[i] = "NOT_FOUND";
+      } else if (!statuses[i].ok()) {
+        values[i] = statuses[i].ToString();
+      }
+    }
+    return values;
+  }
+
   // Return a string that contains all key,value pairs in order,
   // formatted like "(k1->v1)(k2->v2)".
   std::string Contents() {
@@ -387,6 +443,16 @@ class DBTest {
             case kTypeDeletion:
               result += "DEL";
               break;
+            case kTypeRangeDeletion:
+              result += "DELRANGE";
+              break;
+            case kTypeBlobIndex: {
+              std::string value;
+              Status s = dbfull()->ReadBlob(ReadOptions(), ikey.user_key,
+                                            iter->value(), &value);
+              result += s.ok() ? value : s.ToString();
+              break;
+            }
           }
         }
         iter->Next();
@@ -438,6 +504,22 @@ class DBTest {
     return static_cast<int>(files.size());
   }
 
+  // Returns the numbers of the blob files of the DB in increasing order.
+  std::vector<uint64_t> BlobFiles() {
+    std::vector<std::string> filenames;
+    env_->GetChildren(dbname_, &filenames);
+    std::vector<uint64_t> result;
+    uint64_t number;
+    FileType type;
+    for (const std::string& filename : filenames) {
+      if (ParseFileName(filename, &number, &type) && type == kBlobFile) {
+        result.push_back(number);
+      }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+  }
+
   uint64_t Size(const Slice& start, const Slice& limit) {
     Range r(start, limit);
     uint64_t size;
@@ -529,9 +611,25 @@ class DBTest {
 
  private:
   // Sequence of option configurations to try
-  enum OptionConfig { kDefault, kReuse, kFilter, kUncompressed, kEnd };
+  enum OptionConfig {
+    kDefault,
+    kReuse,
+    kFilter,
+    kUncompressed,
+    kPipelinedWrite,
+    kWalThread,
+    kVectorRep,
+    kHashSkipListRep,
+    kDataBlockHashIndex,
+    kRestartKeyPrefixes,
+    kPartitionedIndex,
+    kBlobValues,
+    kEnd
+  };
 
   const FilterPolicy* filter_policy_;
+  const MemTableRepFactory* vector_rep_factory_;
+  const MemTableRepFactory* hash_rep_factory_;
   int option_config_;
 };
 
@@ -584,6 +682,25 @@ TEST(DBTest, PutDeleteGet) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, PutParts) {
+  do {
+    std::string big(200000, 'v');
+    Slice key_parts[2] = {"fo", "o"};
+    Slice value_parts[2] = {Slice(big), "1"};
+    WriteBatch batch;
+    batch.Put(SliceParts(key_parts, 2), SliceParts(value_parts, 2));
+    batch.Put(SliceParts(key_parts + 1, 1), SliceParts(value_parts + 1, 1));
+    ASSERT_OK(db_->Write(WriteOptions(), &batch));
+    ASSERT_EQ(big + "1", Get("foo"));
+    ASSERT_EQ("1", Get("o"));
+
+    // The values were logged although the batch only referred to them.
+    Reopen();
+    ASSERT_EQ(big + "1", Get("foo"));
+    ASSERT_EQ("1", Get("o"));
+  } while (ChangeOptions());
+}
+
 TEST(DBTest, GetFromImmutableLayer) {
   do {
     Options options = CurrentOptions();
@@ -623,6 +740,15 @@ TEST(DBTest, GetMemUsage) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, GetWriteDelay) {
+  ASSERT_OK(Put("foo", "v1"));
+  std::string val;
+  ASSERT_TRUE(db_->GetProperty("leveldb.delayed-write-rate", &val));
+  ASSERT_EQ("0", val);
+  ASSERT_TRUE(db_->GetProperty("leveldb.write-stall-micros", &val));
+  ASSERT_EQ("0", val);
+}
+
 TEST(DBTest, GetSnapshot) {
   do {
     // Try with both a short key and a long key
@@ -983,6 +1109,31 @@ TEST(DBTest, Recover) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, DisableWal) {
+  do {
+    WriteOptions no_wal;
+    no_wal.disable_wal = true;
+    ASSERT_OK(db_->Put(no_wal, "foo", "v1"));
+    ASSERT_OK(Put("bar", "v2"));
+    ASSERT_EQ("v1", Get("foo"));
+    ASSERT_EQ("v2", Get("bar"));
+
+    // Only the logged write survives a reopen.
+    Reopen();
+    ASSERT_EQ("NOT_FOUND", Get("foo"));
+    ASSERT_EQ("v2", Get("bar"));
+
+    // Unlogged writes survive once they have been flushed.
+    ASSERT_OK(db_->Put(no_wal, "foo", "v3"));
+    ASSERT_OK(Put("baz", "v4"));
+    ASSERT_OK(db_->FlushMemTable(true));
+    Reopen();
+    ASSERT_EQ("v3", Get("foo"));
+    ASSERT_EQ("v2", Get("bar"));
+    ASSERT_EQ("v4", Get("baz"));
+  } while (ChangeOptions());
+}
+
 TEST(DBTest, RecoveryWithEmptyLog) {
   do {
     ASSERT_OK(Put("foo", "v1"));
@@ -1024,6 +1175,54 @@ static std::string Key(int i) {
   return std::string(buf);
 }
 
+TEST(DBTest, MultiGet) {
+  do {
+    // Spread the keys over a compacted level, level-0, the immutable
+    // memtable and the memtable.
+    const int N = 200;
+    for (int i = 0; i < N; i++) {
+      ASSERT_OK(Put(Key(i), "a" + std::to_string(i)));
+    }
+    Compact(Key(0), Key(N));
+    for (int i = 0; i < N; i += 2) {
+      ASSERT_OK(Put(Key(i), "b" + std::to_string(i)));
+    }
+    dbfull()->TEST_CompactMemTable();
+    const Snapshot* snapshot = db_->GetSnapshot();
+    for (int i = 0; i < N; i += 3) {
+      ASSERT_OK(Delete(Key(i)));
+    }
+    ASSERT_OK(dbfull()->FlushMemTable(false));
+    for (int i = 0; i < N; i += 5) {
+      ASSERT_OK(Put(Key(i), "c" + std::to_string(i)));
+    }
+
+    // Look the keys up in shuffled order, along with missing and
+    // duplicate keys.
+    std::vector<std::string> keys;
+    for (int i = 0; i < N; i++) {
+      keys.push_back(Key((i * 7) % N));
+    }
+    keys.push_back(Key(N + 1));
+    keys.push_back("");
+    keys.push_back(Key(3));
+    std::vector<std::string> values = MultiGet(keys);
+    std::vector<std::string> snapshot_values = MultiGet(keys, snapshot);
+    ASSERT_EQ(keys.size(), values.size());
+    ASSERT_EQ(keys.size(), snapshot_values.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      ASSERT_EQ(Get(keys[i]), values[i]);
+      ASSERT_EQ(Get(keys[i], snapshot), snapshot_values[i]);
+    }
+    ASSERT_EQ("NOT_FOUND", MultiGet({Key(3)})[0]);
+    ASSERT_EQ("b2", MultiGet({Key(2)})[0]);
+    ASSERT_EQ("c5", MultiGet({Key(5)})[0]);
+    ASSERT_EQ("a7", MultiGet({Key(7)})[0]);
+    ASSERT_EQ("b6", MultiGet({Key(6)}, snapshot)[0]);
+    db_->ReleaseSnapshot(snapshot);
+  } while (ChangeOptions());
+}
+
 TEST(DBTest, MinorCompactionsHappen) {
   Options options = CurrentOptions();
   options.write_buffer_size = 10000;
@@ -1171,6 +1370,10 @@ static bool Between(uint64_t val, uint64_t low, uint64_t high) {
 TEST(DBTest, ApproximateSizes) {
   do {
     Options options = CurrentOptions();
+    if (options.min_blob_size > 0) {
+      // Approximate sizes leave out the values kept in blob files
+      continue;
+    }
     options.write_buffer_size = 100000000;  // Large write buffer
     options.compression = kNoCompression;
     DestroyAndReopen();
@@ -1230,6 +1433,10 @@ TEST(DBTest, ApproximateSizes) {
 TEST(DBTest, ApproximateSizes_MixOfSmallAndLarge) {
   do {
     Options options = CurrentOptions();
+    if (options.min_blob_size > 0) {
+      // Approximate sizes leave out the values kept in blob files
+      continue;
+    }
     options.compression = kNoCompression;
     Reopen();
 
@@ -1337,7 +1544,9 @@ TEST(DBTest, HiddenValuesAreRemoved) {
     ASSERT_GT(NumTableFilesAtLevel(0), 0);
 
     ASSERT_EQ(big, Get("foo", snapshot));
-    ASSERT_TRUE(Between(Size("", "pastfoo"), 50000, 60000));
+    if (last_options_.min_blob_size == 0) {
+      ASSERT_TRUE(Between(Size("", "pastfoo"), 50000, 60000));
+    }
     db_->ReleaseSnapshot(snapshot);
     ASSERT_EQ(AllEntriesFor("foo"), "[ tiny, " + big + " ]");
     Slice x("x");
@@ -1407,6 +1616,364 @@ TEST(DBTest, DeletionMarkers2) {
   ASSERT_EQ(AllEntriesFor("foo"), "[ ]");
 }
 
+TEST(DBTest, DeleteRange) {
+  do {
+    ASSERT_OK(Put("a", "va"));
+    ASSERT_OK(Put("b", "vb"));
+    ASSERT_OK(Put("c", "vc"));
+    ASSERT_OK(Put("d", "vd"));
+    ASSERT_OK(DeleteRange("b", "d"));
+    ASSERT_EQ("va", Get("a"));
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("NOT_FOUND", Get("c"));
+    ASSERT_EQ("vd", Get("d"));
+    ASSERT_EQ("(a->va)(d->vd)", Contents());
+
+    // Newer writes are not covered.
+    ASSERT_OK(Put("c", "vc2"));
+    ASSERT_EQ("vc2", Get("c"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("vc2", Get("c"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+    std::vector<std::string> values = MultiGet({"a", "b", "c", "d"});
+    ASSERT_EQ("va", values[0]);
+    ASSERT_EQ("NOT_FOUND", values[1]);
+    ASSERT_EQ("vc2", values[2]);
+    ASSERT_EQ("vd", values[3]);
+
+    // A tombstone in a newer file covers entries of older files.
+    ASSERT_OK(DeleteRange("a", "c"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("NOT_FOUND", Get("a"));
+    ASSERT_EQ("(c->vc2)(d->vd)", Contents());
+
+    dbfull()->CompactRange(nullptr, nullptr);
+    ASSERT_EQ("NOT_FOUND", Get("a"));
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("(c->vc2)(d->vd)", Contents());
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, DeleteRangeWithSnapshot) {
+  do {
+    ASSERT_OK(Put("foo", "v1"));
+    dbfull()->TEST_CompactMemTable();
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_OK(DeleteRange("a", "z"));
+    ASSERT_EQ("NOT_FOUND", Get("foo"));
+    ASSERT_EQ("v1", Get("foo", snapshot));
+
+    dbfull()->TEST_CompactMemTable();
+    dbfull()->CompactRange(nullptr, nullptr);
+    ASSERT_EQ("NOT_FOUND", Get("foo"));
+    ASSERT_EQ("v1", Get("foo", snapshot));
+    ReadOptions options;
+    options.snapshot = snapshot;
+    Iterator* iter = db_->NewIterator(options);
+    iter->SeekToFirst();
+    ASSERT_EQ("foo->v1", IterStatus(iter));
+    delete iter;
+
+    db_->ReleaseSnapshot(snapshot);
+    dbfull()->CompactRange(nullptr, nullptr);
+    ASSERT_EQ("NOT_FOUND", Get("foo"));
+    ASSERT_EQ("", Contents());
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, DeleteRangeDropsCoveredData) {
+  Random rnd(301);
+  for (int i = 0; i < 200; i++) {
+    ASSERT_OK(Put(Key(i), RandomString(&rnd, 1000)));
+  }
+  dbfull()->CompactRange(nullptr, nullptr);
+  ASSERT_GT(Size(Key(0), Key(200)), 150000);
+
+  ASSERT_OK(DeleteRange(Key(50), Key(150)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(50)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(149)));
+  ASSERT_NE("NOT_FOUND", Get(Key(49)));
+  ASSERT_NE("NOT_FOUND", Get(Key(150)));
+
+  dbfull()->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("NOT_FOUND", Get(Key(50)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(149)));
+  ASSERT_NE("NOT_FOUND", Get(Key(49)));
+  ASSERT_NE("NOT_FOUND", Get(Key(150)));
+  ASSERT_LT(Size(Key(50), Key(150)), 10000);
+  ASSERT_EQ("[ ]", AllEntriesFor(Key(100)));
+
+  int count = 0;
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  delete iter;
+  ASSERT_EQ(100, count);
+
+  // The data survives reopening.
+  Reopen();
+  ASSERT_EQ("NOT_FOUND", Get(Key(100)));
+  ASSERT_NE("NOT_FOUND", Get(Key(10)));
+
+  // So does a range deletion that is only in the log.
+  ASSERT_OK(DeleteRange(Key(0), Key(20)));
+  Reopen();
+  ASSERT_EQ("NOT_FOUND", Get(Key(10)));
+  ASSERT_NE("NOT_FOUND", Get(Key(20)));
+}
+
+TEST(DBTest, DeleteFilesInRange) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;  // Small write buffer
+  options.max_file_size = 100000;      // Small files
+  Reopen(&options);
+
+  Random rnd(301);
+  for (int i = 0; i < 400; i++) {
+    ASSERT_OK(Put(Key(i), RandomString(&rnd, 1000)));
+  }
+  dbfull()->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  const int files_before = TotalTableFiles();
+  ASSERT_GT(files_before, 3);
+
+  ASSERT_OK(DeleteRange(Key(100), Key(300)));
+  ASSERT_OK(db_->DeleteFilesInRange(Key(100), Key(300)));
+  ASSERT_LT(TotalTableFiles(), files_before);
+  ASSERT_LT(Size(Key(100), Key(300)), 100000);
+  ASSERT_NE("NOT_FOUND", Get(Key(99)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(100)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(200)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(299)));
+  ASSERT_NE("NOT_FOUND", Get(Key(300)));
+
+  int count = 0;
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  delete iter;
+  ASSERT_EQ(200, count);
+
+  Reopen(&options);
+  ASSERT_EQ("NOT_FOUND", Get(Key(200)));
+  ASSERT_NE("NOT_FOUND", Get(Key(300)));
+}
+
+TEST(DBTest, DeleteFilesInRangeKeepsShadowingLevel0Files) {
+  ASSERT_OK(Put("b", "vb1"));
+  ASSERT_OK(Put("x", "vx1"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("b", "vb1"));
+  ASSERT_OK(Put("c", "vc1"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("w", "vw1"));
+  ASSERT_OK(Put("x", "vx1"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,2,1", FilesPerLevel());
+
+  ASSERT_OK(Put("b", "vb2"));
+  ASSERT_OK(Put("c", "vc2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("w", "vw2"));
+  ASSERT_OK(Put("x", "vx2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("c", "vc3"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("w", "vw3"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("4,2,1", FilesPerLevel());
+
+  // The level-0 file with "c" => "vc3" lies in the range, but hides an
+  // entry of the older file with "b", which sticks out of it.  The level-0
+  // files with "w" and "x" hide entries of the level-2 file, which sticks
+  // out as well.  So no file is deleted.
+  ASSERT_OK(db_->DeleteFilesInRange("c", "y"));
+  ASSERT_EQ("vb2", Get("b"));
+  ASSERT_EQ("vc3", Get("c"));
+  ASSERT_EQ("vw3", Get("w"));
+  ASSERT_EQ("vx2", Get("x"));
+}
+
+TEST(DBTest, DeleteFilesInRangeKeepsShadowingFiles) {
+  ASSERT_OK(Put("b", "vb1"));
+  ASSERT_OK(Put("x", "vx1"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("y1", "vy1"));
+  ASSERT_OK(Put("y2", "vy2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("x", "vx2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("c", "vc2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("x", "vx3"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("1,2,2", FilesPerLevel());
+
+  // The level-2 file with "b" and "x" sticks out of the range, so the
+  // newer files in the range that hide its entries are kept.  The file
+  // with "y1" and "y2" is deleted.
+  ASSERT_OK(db_->DeleteFilesInRange("c", "z"));
+  ASSERT_EQ("vb1", Get("b"));
+  ASSERT_EQ("vc2", Get("c"));
+  ASSERT_EQ("vx3", Get("x"));
+  ASSERT_EQ("NOT_FOUND", Get("y1"));
+}
+
+TEST(DBTest, BlobValues) {
+  Options options = CurrentOptions();
+  options.min_blob_size = 100;
+  Reopen(&options);
+
+  Random rnd(301);
+  const std::string big1 = RandomString(&rnd, 1000);
+  const std::string big2 = RandomString(&rnd, 100);
+  ASSERT_OK(Put("a", "small"));
+  ASSERT_OK(Put("b", big1));
+  ASSERT_OK(Put("c", big2));
+  ASSERT_OK(Put("d", std::string(99, 'd')));
+  ASSERT_EQ(big1, Get("b"));
+  ASSERT_TRUE(BlobFiles().empty());
+
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(1, BlobFiles().size());
+  ASSERT_EQ("[ " + big1 + " ]", AllEntriesFor("b"));
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ("small", Get("a"));
+    ASSERT_EQ(big1, Get("b"));
+    ASSERT_EQ(big2, Get("c"));
+    ASSERT_EQ(std::string(99, 'd'), Get("d"));
+
+    std::vector<std::string> values = MultiGet({"a", "b", "c", "e"});
+    ASSERT_EQ("small", values[0]);
+    ASSERT_EQ(big1, values[1]);
+    ASSERT_EQ(big2, values[2]);
+    ASSERT_EQ("NOT_FOUND", values[3]);
+
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    iter->SeekToFirst();
+    ASSERT_EQ("a->small", IterStatus(iter));
+    iter->Next();
+    ASSERT_EQ("b->" + big1, IterStatus(iter));
+    ASSERT_EQ(big1, iter->value().ToString());
+    iter->Next();
+    ASSERT_EQ("c->" + big2, IterStatus(iter));
+    iter->Prev();
+    ASSERT_EQ("b->" + big1, IterStatus(iter));
+    iter->SeekToLast();
+    iter->Prev();
+    ASSERT_EQ("c->" + big2, IterStatus(iter));
+    ASSERT_OK(iter->status());
+    delete iter;
+
+    // The blobs stay where they are when the tables are compacted
+    Reopen(&options);
+    dbfull()->CompactRange(nullptr, nullptr);
+    ASSERT_EQ(1, BlobFiles().size());
+  }
+}
+
+TEST(DBTest, BlobChecksums) {
+  Options options = CurrentOptions();
+  options.min_blob_size = 100;
+  options.compression = kNoCompression;
+  Reopen(&options);
+
+  const std::string big(1000, 'b');
+  ASSERT_OK(Put("b", big));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(1, BlobFiles().size());
+
+  // Flip a bit in the middle of the blob value
+  const std::string fname = BlobFileName(dbname_, BlobFiles()[0]);
+  std::string contents;
+  ASSERT_OK(ReadFileToString(env_, fname, &contents));
+  const size_t pos = contents.find(big);
+  ASSERT_NE(std::string::npos, pos);
+  contents[pos + big.size() / 2] ^= 1;
+  ASSERT_OK(WriteStringToFile(env_, contents, fname));
+  Reopen(&options);
+
+  ReadOptions verify;
+  verify.verify_checksums = true;
+  std::string value;
+  ASSERT_TRUE(db_->Get(verify, "b", &value).IsCorruption());
+  Iterator* iter = db_->NewIterator(verify);
+  iter->SeekToFirst();
+  ASSERT_TRUE(iter->Valid());
+  iter->value();
+  ASSERT_TRUE(iter->status().IsCorruption());
+  delete iter;
+
+  // Without verification the damaged value is returned
+  iter = db_->NewIterator(ReadOptions());
+  iter->SeekToFirst();
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ(big.size(), iter->value().size());
+  ASSERT_NE(big, iter->value().ToString());
+  ASSERT_OK(iter->status());
+  delete iter;
+}
+
+TEST(DBTest, BlobGarbageCollection) {
+  Options options = CurrentOptions();
+  options.min_blob_size = 100;
+  options.blob_gc_ratio = 0.5;
+  Reopen(&options);
+
+  const int kNumKeys = 20;
+  Random rnd(301);
+  std::vector<std::string> values(kNumKeys);
+  for (int i = 0; i < kNumKeys; i++) {
+    values[i] = RandomString(&rnd, 1000);
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(1, BlobFiles().size());
+  const uint64_t first_blob_file = BlobFiles()[0];
+
+  // Overwrite most values while a snapshot still sees the old ones
+  const Snapshot* snapshot = db_->GetSnapshot();
+  for (int i = 0; i < 15; i++) {
+    ASSERT_OK(Put(Key(i), "new" + RandomString(&rnd, 1000)));
+  }
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ(2, BlobFiles().size());
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_EQ(values[i], Get(Key(i), snapshot));
+  }
+
+  // Once the old values are compacted away, the five values still live in
+  // the first blob file are moved out of it and it is deleted.
+  db_->ReleaseSnapshot(snapshot);
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  for (int i = 0; i < 1000; i++) {
+    if (BlobFiles()[0] != first_blob_file) break;
+    DelayMilliseconds(10);
+  }
+  ASSERT_NE(first_blob_file, BlobFiles()[0]);
+  for (int i = 0; i < kNumKeys; i++) {
+    if (i < 15) {
+      ASSERT_EQ("new", Get(Key(i)).substr(0, 3));
+    } else {
+      ASSERT_EQ(values[i], Get(Key(i)));
+    }
+  }
+
+  // Deleting all tables deletes the blob files as well
+  Reopen(&options);
+  ASSERT_OK(db_->DeleteFilesInRange(Key(0), Key(kNumKeys)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(0)));
+  ASSERT_EQ(0, TotalTableFiles());
+  ASSERT_TRUE(BlobFiles().empty());
+}
+
 TEST(DBTest, OverlapInLevel0) {
   do {
     ASSERT_EQ(config::kMaxMemCompactLevel, 2) << "Fix test to match config";
@@ -1784,6 +2351,66 @@ TEST(DBTest, WriteSyncError) {
   ASSERT_EQ("NOT_FOUND", Get("k3"));
 }
 
+namespace {
+
+// A write made from another thread.
+struct BackgroundWrite {
+  DB* db;
+  WriteOptions options;
+  std::string key;
+  Status status;
+  std::atomic<bool> done;
+};
+
+void DoBackgroundWrite(void* arg) {
+  BackgroundWrite* write = reinterpret_cast<BackgroundWrite*>(arg);
+  write->status = write->db->Put(write->options, write->key, "v");
+  write->done.store(true, std::memory_order_release);
+}
+
+}  // namespace
+
+TEST(DBTest, WalThreadSyncError) {
+  // Check that a write that skips the log does not publish the writes of
+  // an earlier sync write whose sync fails.
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.enable_pipelined_write = false;
+  options.enable_wal_thread = true;
+  Reopen(&options);
+  ASSERT_OK(Put("k1", "v1"));
+
+  // (a) A sync write blocks in Sync(), and a write that skips the log
+  // queues behind it
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+  BackgroundWrite writes[2];
+  for (int i = 0; i < 2; i++) {
+    writes[i].db = db_;
+    writes[i].options.sync = (i == 0);
+    writes[i].options.disable_wal = (i == 1);
+    writes[i].key = (i == 0) ? "k2" : "k3";
+    writes[i].done.store(false, std::memory_order_release);
+    env_->StartThread(DoBackgroundWrite, &writes[i]);
+    DelayMilliseconds(100);
+  }
+  ASSERT_EQ("NOT_FOUND", Get("k2"));
+  ASSERT_EQ("NOT_FOUND", Get("k3"));
+
+  // (b) The sync fails, which fails both writes
+  env_->data_sync_error_.store(true, std::memory_order_release);
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  for (int i = 0; i < 2; i++) {
+    while (!writes[i].done.load(std::memory_order_acquire)) {
+      DelayMilliseconds(10);
+    }
+    ASSERT_TRUE(!writes[i].status.ok());
+  }
+  ASSERT_EQ("v1", Get("k1"));
+  ASSERT_EQ("NOT_FOUND", Get("k2"));
+  ASSERT_EQ("NOT_FOUND", Get("k3"));
+  env_->data_sync_error_.store(false, std::memory_order_release);
+}
+
 TEST(DBTest, ManifestWriteError) {
   // Test for the following problem:
   // (a) Compaction produces file F
@@ -1915,6 +2542,298 @@ TEST(DBTest, BloomFilter) {
   delete options.filter_policy;
 }
 
+static std::string TenantKey(int tenant, int i) {
+  char buf[100];
+  snprintf(buf, sizeof(buf), "t%03d|%05d", tenant, i);
+  return std::string(buf);
+}
+
+static std::string TenantPrefix(int tenant) {
+  return TenantKey(tenant, 0).substr(0, 5);
+}
+
+TEST(DBTest, PrefixSeek) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.prefix_extractor = NewFixedPrefixTransform(5);
+  Reopen(&options);
+
+  // Each even tenant gets a table file of its own.  Two more files span
+  // the tenants, one of which stays in level 0.
+  for (int t = 0; t < 20; t += 2) {
+    for (int i = 0; i < 100; i++) {
+      ASSERT_OK(Put(TenantKey(t, i), "v"));
+    }
+    dbfull()->TEST_CompactMemTable();
+  }
+  for (int j = 0; j < 2; j++) {
+    ASSERT_OK(Put(TenantKey(2 * j, 200), "v"));
+    ASSERT_OK(Put(TenantKey(18 - 2 * j, 200), "v"));
+    dbfull()->TEST_CompactMemTable();
+  }
+  ASSERT_EQ(1, NumTableFilesAtLevel(0));
+  ASSERT_OK(Put(TenantKey(4, 100), "v"));
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+
+  ReadOptions prefix_options;
+  prefix_options.prefix_same_as_start = true;
+  Iterator* iter = db_->NewIterator(prefix_options);
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(1005, count);
+
+  count = 0;
+  std::string last;
+  for (iter->Seek(TenantKey(4, 50)); iter->Valid(); iter->Next()) {
+    last = iter->key().ToString();
+    count++;
+  }
+  ASSERT_EQ(51, count);
+  ASSERT_EQ(TenantKey(4, 100), last);
+  iter->Seek(TenantPrefix(6));
+  ASSERT_EQ(TenantKey(6, 0) + "->v", IterStatus(iter));
+  iter->Prev();
+  ASSERT_TRUE(!iter->Valid());
+  iter->Seek(TenantKey(6, 99));
+  iter->Prev();
+  ASSERT_EQ(TenantKey(6, 98) + "->v", IterStatus(iter));
+  iter->Next();
+  iter->Next();
+  ASSERT_TRUE(!iter->Valid());
+
+  // Seeks to absent tenants only read a data block on a false positive of
+  // a filter.
+  env_->random_read_counter_.Reset();
+  for (int t = 1; t < 20; t += 2) {
+    iter->Seek(TenantPrefix(t));
+    ASSERT_TRUE(!iter->Valid());
+  }
+  ASSERT_LE(env_->random_read_counter_.Read(), 2);
+  ASSERT_OK(iter->status());
+  delete iter;
+
+  // Without prefix_same_as_start, the same seeks read the next tenant.
+  iter = db_->NewIterator(ReadOptions());
+  env_->random_read_counter_.Reset();
+  for (int t = 1; t < 19; t += 2) {
+    iter->Seek(TenantPrefix(t));
+    ASSERT_EQ(TenantKey(t + 1, 0) + "->v", IterStatus(iter));
+  }
+  ASSERT_GE(env_->random_read_counter_.Read(), 9);
+  delete iter;
+
+  // Iterate bounds also apply to SeekToFirst() and SeekToLast().
+  const std::string lower_key = TenantPrefix(4);
+  const std::string upper_key = TenantPrefix(6);
+  Slice lower(lower_key);
+  Slice upper(upper_key);
+  prefix_options.iterate_lower_bound = &lower;
+  prefix_options.iterate_upper_bound = &upper;
+  iter = db_->NewIterator(prefix_options);
+  iter->SeekToFirst();
+  ASSERT_EQ(TenantKey(4, 0) + "->v", IterStatus(iter));
+  iter->SeekToLast();
+  ASSERT_EQ(TenantKey(4, 100) + "->v", IterStatus(iter));
+  delete iter;
+
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+  delete options.prefix_extractor;
+}
+
+TEST(DBTest, PrefixSeekAfterClippedRangeDeletion) {
+  Options options = CurrentOptions();
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.prefix_extractor = NewFixedPrefixTransform(2);
+  Reopen(&options);
+
+  // The snapshot keeps the range deletion through the compaction below.
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_OK(DeleteRange("a0", "a8"));
+  Random rnd(301);
+  ASSERT_OK(Put("a1", RandomString(&rnd, options.max_file_size + 1000)));
+  ASSERT_OK(Put("a7x", "v1"));
+  ASSERT_OK(Put("a7y", "v2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+
+  // The large value fills the first output, which is cut before "a7x".
+  // The first output then ends on the range deletion clipped at "a7x",
+  // and holds no key with the prefix "a7".
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_EQ("0,0,0,2", FilesPerLevel());
+
+  ReadOptions prefix_options;
+  prefix_options.prefix_same_as_start = true;
+  Iterator* iter = db_->NewIterator(prefix_options);
+  iter->Seek("a7");
+  ASSERT_EQ("a7x->v1", IterStatus(iter));
+  iter->Next();
+  ASSERT_EQ("a7y->v2", IterStatus(iter));
+  iter->Next();
+  ASSERT_TRUE(!iter->Valid());
+  delete iter;
+
+  db_->ReleaseSnapshot(snapshot);
+  Close();
+  delete options.filter_policy;
+  delete options.prefix_extractor;
+}
+
+TEST(DBTest, IterateBounds) {
+  do {
+    ASSERT_OK(Put("a", "va"));
+    ASSERT_OK(Put("b", "vb"));
+    ASSERT_OK(Put("c", "vc"));
+    ASSERT_OK(Put("d", "vd"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_OK(Put("e", "ve"));
+    ASSERT_OK(Put("f", "vf"));
+    ASSERT_OK(Put("g", "vg"));
+    ASSERT_OK(Put("h", "vh"));
+    ASSERT_OK(Delete("c"));
+    ASSERT_OK(Delete("f"));
+    ASSERT_OK(Delete("g"));
+
+    Slice lower("b");
+    Slice upper("g");
+    ReadOptions ropts;
+    ropts.iterate_lower_bound = &lower;
+    ropts.iterate_upper_bound = &upper;
+    Iterator* iter = db_->NewIterator(ropts);
+
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "d->vd");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "e->ve");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+
+    iter->SeekToLast();
+    ASSERT_EQ(IterStatus(iter), "e->ve");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "d->vd");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+
+    iter->Seek("a");
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Seek("c");
+    ASSERT_EQ(IterStatus(iter), "d->vd");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "d->vd");
+    iter->Seek("g");
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+    iter->Seek("z");
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+
+    // "f" is deleted, so the upper bound is reached while skipping it.
+    iter->Seek("e");
+    ASSERT_EQ(IterStatus(iter), "e->ve");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+    ASSERT_OK(iter->status());
+    delete iter;
+
+    // Without bounds, "h" follows "e".
+    iter = db_->NewIterator(ReadOptions());
+    iter->Seek("e");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "h->vh");
+    delete iter;
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, IterateBoundsSkipReads) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.block_size = 1024;  // Several blocks per table file
+  Reopen(&options);
+
+  // Each tenant gets a table file of its own, and tenant 4 is deleted
+  // again.
+  for (int t = 0; t < 10; t++) {
+    for (int i = 0; i < 100; i++) {
+      ASSERT_OK(Put(TenantKey(t, i), "v"));
+    }
+    dbfull()->TEST_CompactMemTable();
+  }
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(Delete(TenantKey(4, i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+
+  // Counts the keys in [lower, upper) and the reads it takes.
+  auto scan = [&](const std::string& lower, const std::string& upper,
+                  int* reads) {
+    Slice lower_slice(lower);
+    Slice upper_slice(upper);
+    ReadOptions ropts;
+    ropts.iterate_lower_bound = &lower_slice;
+    ropts.iterate_upper_bound = &upper_slice;
+    Iterator* iter = db_->NewIterator(ropts);
+    env_->random_read_counter_.Reset();
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      count++;
+    }
+    *reads = env_->random_read_counter_.Read();
+    ASSERT_OK(iter->status());
+    delete iter;
+    return count;
+  };
+
+  int full_reads, half_reads, deleted_reads;
+  ASSERT_EQ(100, scan(TenantPrefix(2), TenantPrefix(3), &full_reads));
+  ASSERT_EQ(50, scan(TenantPrefix(2), TenantKey(2, 50), &half_reads));
+  ASSERT_LT(half_reads, full_reads);
+
+  // The iterator stops within the deletions of tenant 4 instead of
+  // reading on to tenant 5.
+  int bounded_reads, unbounded_reads;
+  ASSERT_EQ(100, scan(TenantPrefix(3), TenantKey(4, 50), &bounded_reads));
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  env_->random_read_counter_.Reset();
+  iter->Seek(TenantPrefix(3));
+  for (int i = 0; i < 100; i++) {
+    ASSERT_TRUE(iter->Valid());
+    iter->Next();
+  }
+  ASSERT_EQ(TenantKey(5, 0) + "->v", IterStatus(iter));
+  unbounded_reads = env_->random_read_counter_.Read();
+  delete iter;
+  ASSERT_LT(bounded_reads, unbounded_reads);
+  ASSERT_EQ(0, scan(TenantPrefix(4), TenantPrefix(5), &deleted_reads));
+
+  // Table files outside the bounds are not read at all.
+  ASSERT_EQ(0, scan(TenantPrefix(10), TenantPrefix(11), &deleted_reads));
+  ASSERT_EQ(0, deleted_reads);
+
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  Close();
+  delete options.block_cache;
+}
+
 // Multi-threaded test:
 namespace {
 
@@ -2012,6 +2931,66 @@ TEST(DBTest, MultiThreaded) {
   } while (ChangeOptions());
 }
 
+namespace {
+
+struct ReaderState {
+  DB* db;
+  std::atomic<bool> stop;
+  std::atomic<int> done;
+  std::atomic<bool> ok;
+};
+
+static void MonotonicReader(void* arg) {
+  ReaderState* state = reinterpret_cast<ReaderState*>(arg);
+  int last = 0;
+  std::string value;
+  while (!state->stop.load(std::memory_order_acquire)) {
+    // Every read picks up the latest read view, which has to contain
+    // every value written before the read started.
+    if (!state->db->Get(ReadOptions(), "key", &value).ok() ||
+        atoi(value.c_str()) < last) {
+      state->ok.store(false, std::memory_order_relaxed);
+    }
+    last = atoi(value.c_str());
+  }
+  state->done.fetch_add(1, std::memory_order_release);
+}
+
+}  // namespace
+
+TEST(DBTest, ReadsAcrossFlushes) {
+  const int kReaders = 4;
+  do {
+    ASSERT_OK(Put("key", "0"));
+    ReaderState state;
+    state.db = db_;
+    state.stop.store(false, std::memory_order_release);
+    state.done.store(0, std::memory_order_release);
+    state.ok.store(true, std::memory_order_relaxed);
+    for (int i = 0; i < kReaders; i++) {
+      env_->StartThread(MonotonicReader, &state);
+    }
+
+    // Replace the memtables and the version under the readers.
+    for (int i = 1; i <= 300; i++) {
+      ASSERT_OK(Put("key", NumberToString(i)));
+      ASSERT_EQ(NumberToString(i), Get("key"));
+      if (i % 10 == 0) {
+        dbfull()->TEST_CompactMemTable();
+      }
+      if (i % 100 == 0) {
+        dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+      }
+    }
+
+    state.stop.store(true, std::memory_order_release);
+    while (state.done.load(std::memory_order_acquire) < kReaders) {
+      DelayMilliseconds(10);
+    }
+    ASSERT_TRUE(state.ok.load(std::memory_order_relaxed));
+  } while (ChangeOptions());
+}
+
 namespace {
 typedef std::map<std::string, std::string> KVMap;
 }
@@ -2064,6 +3043,10 @@ class ModelDB : public DB {
         (*map_)[key.ToString()] = value.ToString();
       }
       void Delete(const Slice& key) override { map_->erase(key.ToString()); }
+      void DeleteRange(const Slice& begin, const Slice& end) override {
+        map_->erase(map_->lower_bound(begin.ToString()),
+                    map_->lower_bound(end.ToString()));
+      }
     };
     Handler handler;
     handler.map_ = &map_;
@@ -7,6 +7,7 @@
 #include <stdio.h>
 
 #include <sstream>
+#include <vector>
 
 #include "port/port.h"
 #include "util/coding.h"
@@ -115,6 +116,16 @@ bool InternalFilterPolicy::KeyMayMatch(const Slice& key, const Slice& f) const {
   return user_policy_->KeyMayMatch(ExtractUserKey(key), f);
 }
 
+void InternalFilterPolicy::KeysMayMatch(const Slice* keys, int n,
+                                        const Slice& f, bool* results) const {
+  // Unlike in CreateFilter(), callers still need keys[] afterwards.
+  std::vector<Slice> user_keys(n);
+  for (int i = 0; i < n; i++) {
+    user_keys[i] = ExtractUserKey(keys[i]);
+  }
+  user_policy_->KeysMayMatch(user_keys.data(), n, f, results);
+}
+
 LookupKey::LookupKey(const Slice& user_key, SequenceNumber s) {
   size_t usize = user_key.size();
   size_t needed = usize + 13;  // A conservative estimate
@@ -51,14 +51,23 @@ class InternalKey;
 // Value types encoded as the last component of internal keys.
 // DO NOT CHANGE THESE ENUM VALUES: they are embedded in the on-disk
 // data structures.
-enum ValueType { kTypeDeletion = 0x0, kTypeValue = 0x1 };
+enum ValueType {
+  kTypeDeletion = 0x0,
+  kTypeValue = 0x1,
+  // Marks the start key of a range deletion.  Such keys are only stored in
+  // the range-deletion block of a table, never among its data entries.
+  kTypeRangeDeletion = 0x2,
+  // The value is a BlobIndex (see db/blob_file.h) that refers to the actual
+  // value in a blob file.  Only found in tables, never in a memtable.
+  kTypeBlobIndex = 0x3
+};
 // kValueTypeForSeek defines the ValueType that should be passed when
 // constructing a ParsedInternalKey object for seeking to a particular
 // sequence number (since we sort sequence numbers in decreasing order
 // and the value type is embedded as the low 8 bits in the sequence
 // number in internal keys, we need to use the highest-numbered
 // ValueType, not the lowest).
-static const ValueType kValueTypeForSeek = kTypeValue;
+static const ValueType kValueTypeForSeek = kTypeBlobIndex;
 
 typedef uint64_t SequenceNumber;
 
@@ -97,6 +106,19 @@ inline Slice ExtractUserKey(const Slice& internal_key) {
   return Slice(internal_key.data(), internal_key.size() - 8);
 }
 
+// Returns the value type of an internal key.
+inline ValueType ExtractValueType(const Slice& internal_key) {
+  assert(internal_key.size() >= 8);
+  return static_cast<ValueType>(
+      static_cast<uint8_t>(internal_key[internal_key.size() - 8]));
+}
+
+// Returns the sequence number of an internal key.
+inline SequenceNumber ExtractSequence(const Slice& internal_key) {
+  assert(internal_key.size() >= 8);
+  return DecodeFixed64(internal_key.data() + internal_key.size() - 8) >> 8;
+}
+
 // A comparator for internal keys that uses a specified comparator for
 // the user key portion and breaks ties by decreasing sequence number.
 class InternalKeyComparator : public Comparator {
@@ -126,6 +148,8 @@ class InternalFilterPolicy : public FilterPolicy {
   const char* Name() const override;
   void CreateFilter(const Slice* keys, int n, std::string* dst) const override;
   bool KeyMayMatch(const Slice& key, const Slice& filter) const override;
+  void KeysMayMatch(const Slice* keys, int n, const Slice& filter,
+                    bool* results) const override;
 };
 
 // Modules in this directory should keep internal keys wrapped inside
@@ -177,7 +201,7 @@ inline bool ParseInternalKey(const Slice& internal_key,
   result->sequence = num >> 8;
   result->type = static_cast<ValueType>(c);
   result->user_key = Slice(internal_key.data(), n - 8);
-  return (c <= static_cast<uint8_t>(kTypeValue));
+  return (c <= static_cast<uint8_t>(kTypeBlobIndex));
 }
 
 // A helper class useful for DBImpl::Get()
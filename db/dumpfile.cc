@@ -88,6 +88,14 @@ class WriteBatchItemPrinter : public WriteBatch::Handler {
     r += "'\n";
     dst_->Append(r);
   }
+  void DeleteRange(const Slice& begin, const Slice& end) override {
+    std::string r = "  delrange '";
+    AppendEscapedStringTo(&r, begin);
+    r += "' '";
+    AppendEscapedStringTo(&r, end);
+    r += "'\n";
+    dst_->Append(r);
+  }
 
   WritableFile* dst_;
 };
@@ -144,6 +152,42 @@ Status DumpDescriptor(Env* env, const std::string& fname, WritableFile* dst) {
   return PrintLogContents(env, fname, VersionEditPrinter, dst);
 }
 
+// Prints an entry of a table, whose key is an internal key.
+static void PrintTableEntry(const Slice& ikey, const Slice& value,
+                            WritableFile* dst) {
+  std::string r;
+  ParsedInternalKey key;
+  if (!ParseInternalKey(ikey, &key)) {
+    r = "badkey '";
+    AppendEscapedStringTo(&r, ikey);
+    r += "' => '";
+    AppendEscapedStringTo(&r, value);
+    r += "'\n";
+    dst->Append(r);
+  } else {
+    r = "'";
+    AppendEscapedStringTo(&r, key.user_key);
+    r += "' @ ";
+    AppendNumberTo(&r, key.sequence);
+    r += " : ";
+    if (key.type == kTypeDeletion) {
+      r += "del";
+    } else if (key.type == kTypeValue) {
+      r += "val";
+    } else if (key.type == kTypeRangeDeletion) {
+      r += "delrange";
+    } else if (key.type == kTypeBlobIndex) {
+      r += "blob";
+    } else {
+      AppendNumberTo(&r, key.type);
+    }
+    r += " => '";
+    AppendEscapedStringTo(&r, value);
+    r += "'\n";
+    dst->Append(r);
+  }
+}
+
 Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
   uint64_t file_size;
   RandomAccessFile* file = nullptr;
@@ -168,35 +212,19 @@ Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
   ReadOptions ro;
   ro.fill_cache = false;
   Iterator* iter = table->NewIterator(ro);
-  std::string r;
   for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
-    r.clear();
-    ParsedInternalKey key;
-    if (!ParseInternalKey(iter->key(), &key)) {
-      r = "badkey '";
-      AppendEscapedStringTo(&r, iter->key());
-      r += "' => '";
-      AppendEscapedStringTo(&r, iter->value());
-      r += "'\n";
-      dst->Append(r);
-    } else {
-      r = "'";
-      AppendEscapedStringTo(&r, key.user_key);
-      r += "' @ ";
-      AppendNumberTo(&r, key.sequence);
-      r += " : ";
-      if (key.type == kTypeDeletion) {
-        r += "del";
-      } else if (key.type == kTypeValue) {
-        r += "val";
-      } else {
-        AppendNumberTo(&r, key.type);
-      }
-      r += " => '";
-      AppendEscapedStringTo(&r, iter->value());
-      r += "'\n";
-      dst->Append(r);
-    }
+    PrintTableEntry(iter->key(), iter->value(), dst);
+  }
+  s = iter->status();
+  if (!s.ok()) {
+    dst->Append("iterator error: " + s.ToString() + "\n");
+  }
+  delete iter;
+
+  // Range deletions are kept apart from the entries above.
+  iter = table->NewRangeDeletionIterator();
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    PrintTableEntry(iter->key(), iter->value(), dst);
   }
   s = iter->status();
   if (!s.ok()) {
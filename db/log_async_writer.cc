@@ -0,0 +1,141 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/log_async_writer.h"
+
+#include <cassert>
+#include <limits>
+
+#include "db/log_writer.h"
+#include "leveldb/env.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+namespace log {
+
+AsyncWriter::AsyncWriter(Env* env, int sync_window_micros)
+    : env_(env),
+      sync_window_micros_(sync_window_micros),
+      work_cv_(&mu_),
+      done_cv_(&mu_),
+      log_(nullptr),
+      file_(nullptr),
+      active_(0),
+      sync_{false, false},
+      next_ticket_(1),
+      written_(0),
+      synced_(0),
+      first_failed_(std::numeric_limits<uint64_t>::max()),
+      shutting_down_(false),
+      exited_(false) {
+  env_->StartThread(&AsyncWriter::BGWork, this);
+}
+
+AsyncWriter::~AsyncWriter() {
+  MutexLock l(&mu_);
+  shutting_down_ = true;
+  work_cv_.Signal();
+  while (!exited_) {
+    done_cv_.Wait();
+  }
+}
+
+void AsyncWriter::SetLog(Writer* log, WritableFile* file) {
+  MutexLock l(&mu_);
+  assert(written_ == next_ticket_ - 1);
+  log_ = log;
+  file_ = file;
+}
+
+uint64_t AsyncWriter::AddRecord(const Slice* parts, size_t n, bool sync) {
+  MutexLock l(&mu_);
+  assert(log_ != nullptr);
+  size_t length = 0;
+  for (size_t i = 0; i < n; i++) {
+    buffers_[active_].append(parts[i].data(), parts[i].size());
+    length += parts[i].size();
+  }
+  lengths_[active_].push_back(length);
+  sync_[active_] = sync_[active_] || sync;
+  work_cv_.Signal();
+  return next_ticket_++;
+}
+
+Status AsyncWriter::Wait(uint64_t ticket, bool sync) {
+  MutexLock l(&mu_);
+  while ((sync ? synced_ : written_) < ticket) {
+    done_cv_.Wait();
+  }
+  return (ticket < first_failed_) ? Status::OK() : status_;
+}
+
+void AsyncWriter::BGWork(void* writer) {
+  reinterpret_cast<AsyncWriter*>(writer)->Run();
+}
+
+void AsyncWriter::Run() {
+  mu_.Lock();
+  while (true) {
+    while (lengths_[active_].empty() && !shutting_down_) {
+      work_cv_.Wait();
+    }
+    if (lengths_[active_].empty()) {
+      break;  // Shutting down and nothing left to write
+    }
+    if (sync_[active_] && sync_window_micros_ > 0) {
+      // Give concurrent sync writers a chance to share this sync.
+      mu_.Unlock();
+      env_->SleepForMicroseconds(sync_window_micros_);
+      mu_.Lock();
+    }
+
+    // Swap buffers so that writers can continue to queue records while
+    // this one is written out.
+    const int flush = active_;
+    active_ = 1 - active_;
+    const uint64_t first_ticket = written_ + 1;
+    const uint64_t last_ticket = next_ticket_ - 1;
+    const bool sync = sync_[flush];
+    Writer* log = log_;
+    WritableFile* file = file_;
+    Status s = status_;
+    mu_.Unlock();
+
+    if (s.ok()) {
+      const char* p = buffers_[flush].data();
+      for (size_t length : lengths_[flush]) {
+        s = log->AddRecord(Slice(p, length));
+        if (!s.ok()) {
+          break;
+        }
+        p += length;
+      }
+      if (s.ok() && sync) {
+        s = file->Sync();
+      }
+    }
+    buffers_[flush].clear();
+    lengths_[flush].clear();
+    sync_[flush] = false;
+
+    mu_.Lock();
+    if (!s.ok() && status_.ok()) {
+      // The state of the log file is indeterminate, so fail this buffer
+      // and everything after it.
+      status_ = s;
+      first_failed_ = first_ticket;
+    }
+    written_ = last_ticket;
+    if (sync || !status_.ok()) {
+      synced_ = last_ticket;
+    }
+    done_cv_.SignalAll();
+  }
+  exited_ = true;
+  done_cv_.SignalAll();
+  mu_.Unlock();
+}
+
+}  // namespace log
+}  // namespace leveldb
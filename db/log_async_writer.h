@@ -0,0 +1,96 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_LOG_ASYNC_WRITER_H_
+#define STORAGE_LEVELDB_DB_LOG_ASYNC_WRITER_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+
+namespace leveldb {
+
+class Env;
+class WritableFile;
+
+namespace log {
+
+class Writer;
+
+// Appends log records from a dedicated background thread.
+//
+// Callers hand a copy of each record to AddRecord() and later block in
+// Wait().  Records are copied into one of two buffers: while the
+// background thread writes out (and possibly syncs) the records of one
+// buffer, new records accumulate in the other.  All records in a buffer
+// share a single Sync(), so concurrent sync writers are coalesced into
+// one fsync.
+class AsyncWriter {
+ public:
+  // Start the background thread.  Before syncing a buffer, the thread
+  // waits "sync_window_micros" for more records to join that sync.
+  AsyncWriter(Env* env, int sync_window_micros);
+
+  AsyncWriter(const AsyncWriter&) = delete;
+  AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+  // Writes out any queued records and stops the background thread.
+  ~AsyncWriter();
+
+  // Append subsequent records to "*log" and sync them with "*file", the
+  // destination of "*log".  Neither is owned by the AsyncWriter.
+  // REQUIRES: Wait() has returned for every record added so far.
+  void SetLog(Writer* log, WritableFile* file);
+
+  // Queue a copy of the record made of parts[0,n-1] and return a ticket
+  // for Wait().  If "sync" is true, the log file is synced after the
+  // record is written.
+  uint64_t AddRecord(const Slice* parts, size_t n, bool sync);
+
+  // Block until the record with "ticket" has been written, and synced too
+  // if "sync" is true.  Returns the status of the write.  Once a write
+  // fails, all later records fail with the same status.
+  Status Wait(uint64_t ticket, bool sync);
+
+ private:
+  static void BGWork(void* writer);
+  void Run();
+
+  Env* const env_;
+  const int sync_window_micros_;
+
+  port::Mutex mu_;
+  port::CondVar work_cv_ GUARDED_BY(mu_);  // Signalled for new records
+  port::CondVar done_cv_ GUARDED_BY(mu_);  // Signalled as records complete
+
+  Writer* log_ GUARDED_BY(mu_);
+  WritableFile* file_ GUARDED_BY(mu_);
+
+  // Writers append to buffers_[active_].  The other buffer belongs to the
+  // background thread while it writes out its records.
+  int active_ GUARDED_BY(mu_);
+  std::string buffers_[2];
+  std::vector<size_t> lengths_[2];  // Length of each record in buffers_[i]
+  bool sync_[2];                    // Does buffers_[i] need a sync?
+
+  uint64_t next_ticket_ GUARDED_BY(mu_);
+  uint64_t written_ GUARDED_BY(mu_);  // Records up to here are written
+  uint64_t synced_ GUARDED_BY(mu_);   // Records up to here are synced
+  uint64_t first_failed_ GUARDED_BY(mu_);
+  Status status_ GUARDED_BY(mu_);
+
+  bool shutting_down_ GUARDED_BY(mu_);
+  bool exited_ GUARDED_BY(mu_);
+};
+
+}  // namespace log
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_LOG_ASYNC_WRITER_H_
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
+#include "db/log_async_writer.h"
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "leveldb/env.h"
@@ -59,6 +60,27 @@ class LogTest {
     writer_->AddRecord(Slice(msg));
   }
 
+  void WriteParts(const Slice* parts, size_t n) {
+    ASSERT_TRUE(!reading_) << "Write() after starting to read";
+    writer_->AddRecord(parts, n);
+  }
+
+  // Write "msgs" from the background thread of an AsyncWriter.  Every
+  // other record asks for a sync.
+  void WriteAsync(const std::vector<std::string>& msgs) {
+    ASSERT_TRUE(!reading_) << "Write() after starting to read";
+    AsyncWriter async_writer(Env::Default(), 0);
+    async_writer.SetLog(writer_, &dest_);
+    std::vector<uint64_t> tickets;
+    for (size_t i = 0; i < msgs.size(); i++) {
+      Slice record(msgs[i]);
+      tickets.push_back(async_writer.AddRecord(&record, 1, i % 2 == 0));
+    }
+    for (size_t i = 0; i < msgs.size(); i++) {
+      ASSERT_OK(async_writer.Wait(tickets[i], i % 2 == 0));
+    }
+  }
+
   size_t WrittenBytes() const { return dest_.contents_.size(); }
 
   std::string Read() {
@@ -273,6 +295,31 @@ TEST(LogTest, ReadWrite) {
   ASSERT_EQ("EOF", Read());  // Make sure reads at eof work
 }
 
+TEST(LogTest, WriteParts) {
+  std::string large = BigString("large", 100000);
+  Slice parts[4] = {"sm", "", Slice(large), "all"};
+  WriteParts(parts, 4);
+  WriteParts(parts + 1, 1);
+  WriteParts(parts, 2);
+  ASSERT_EQ("sm" + large + "all", Read());
+  ASSERT_EQ("", Read());
+  ASSERT_EQ("sm", Read());
+  ASSERT_EQ("EOF", Read());
+}
+
+TEST(LogTest, AsyncWrite) {
+  Random rnd(301);
+  std::vector<std::string> records;
+  for (int i = 0; i < 1000; i++) {
+    records.push_back(RandomSkewedString(i, &rnd));
+  }
+  WriteAsync(records);
+  for (const std::string& record : records) {
+    ASSERT_EQ(record, Read());
+  }
+  ASSERT_EQ("EOF", Read());
+}
+
 TEST(LogTest, ManyBlocks) {
   for (int i = 0; i < 100000; i++) {
     Write(NumberString(i));
@@ -6,6 +6,8 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+
 #include "leveldb/env.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
@@ -16,6 +18,9 @@
 namespace leveldb {
 namespace log {
 
+// Source of the zero bytes for block trailers and record padding.
+static const char kZeroes[kHeaderSize] = {0};
+
 static void InitTypeCrc(uint32_t* type_crc) {
   for (int i = 0; i <= kMaxRecordType; i++) {
     char t = static_cast<char>(i);
@@ -42,14 +47,27 @@ Writer::~Writer() = default;
     return ((len + 3) / 4) * 4;
   }
 
-Status Writer::AddRecord(const Slice& slice) {
-  const char* ptr = slice.data();
-  size_t left = slice.size();
+Status Writer::AddRecord(const Slice& slice) { return AddRecord(&slice, 1); }
+
+Status Writer::AddRecord(const Slice* parts, size_t n) {
+  size_t left = 0;
+  for (size_t i = 0; i < n; i++) {
+    left += parts[i].size();
+  }
+  size_t part = 0;    // Part that holds the next byte of the record
+  size_t offset = 0;  // Offset of that byte in parts[part]
+
+  // The headers of all fragments are formatted into headers_ and the
+  // whole record is handed to dest_ in one AppendV() call.  Reserve room
+  // for every header up front so that the slices pointing into headers_
+  // stay valid.
+  pieces_.clear();
+  headers_.clear();
+  headers_.reserve(kHeaderSize * (left / (kBlockSize - 2 * kHeaderSize) + 2));
 
   // Fragment the record if necessary and emit it.  Note that if slice
   // is empty, we still want to iterate once to emit a single
   // zero-length record
-  Status s;
   bool begin = true;
   do {
     const int leftover = kBlockSize - block_offset_;
@@ -57,15 +75,8 @@ Status Writer::AddRecord(const Slice& slice) {
     if (leftover < kHeaderSize) {
       // Switch to a new block
       if (leftover > 0) {
-#ifndef VE_OPT
-        // Fill the trailer (literal below relies on kHeaderSize being 7)
-        static_assert(kHeaderSize == 7, "");
-        dest_->Append(Slice("\x00\x00\x00\x00\x00\x00", leftover));
-#else
-        // Fill the trailer (literal below relies on kHeaderSize being 8)
-        static_assert(kHeaderSize == 8, "");
-        dest_->Append(Slice("\x00\x00\x00\x00\x00\x00\x00", leftover));
-#endif
+        // Fill the trailer
+        pieces_.push_back(Slice(kZeroes, leftover));
       }
       block_offset_ = 0;
     }
@@ -92,16 +103,20 @@ Status Writer::AddRecord(const Slice& slice) {
       type = kMiddleType;
     }
 
-    s = EmitPhysicalRecord(type, ptr, fragment_length);
-    ptr += fragment_length;
+    AddPhysicalRecord(type, parts, &part, &offset, fragment_length);
     left -= fragment_length;
     begin = false;
-  } while (s.ok() && left > 0);
+  } while (left > 0);
+
+  Status s = dest_->AppendV(pieces_.data(), pieces_.size());
+  if (s.ok()) {
+    s = dest_->Flush();
+  }
   return s;
 }
 
-Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr,
-                                  size_t length) {
+void Writer::AddPhysicalRecord(RecordType t, const Slice* parts, size_t* part,
+                               size_t* offset, size_t length) {
   assert(length <= 0xffff);  // Must fit in two bytes
 #ifndef VE_OPT
   assert(block_offset_ + kHeaderSize + length <= kBlockSize);
@@ -111,7 +126,10 @@ Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr,
 #endif
 
   // Format the header
-  char buf[kHeaderSize];
+  assert(headers_.size() + kHeaderSize <= headers_.capacity());
+  const size_t header_offset = headers_.size();
+  headers_.resize(header_offset + kHeaderSize);
+  char* buf = &headers_[header_offset];
   buf[4] = static_cast<char>(length & 0xff);
   buf[5] = static_cast<char>(length >> 8);
 #ifndef VE_OPT
@@ -121,32 +139,34 @@ Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr,
   buf[7] = static_cast<char>(t);
 #endif
 
-  // Compute the crc of the record type and the payload.
-  uint32_t crc = crc32c::Extend(type_crc_[t], ptr, length);
-  crc = crc32c::Mask(crc);  // Adjust for storage
-  EncodeFixed32(buf, crc);
-
-  // Write the header and the payload
-  Status s = dest_->Append(Slice(buf, kHeaderSize));
-  if (s.ok()) {
-    s = dest_->Append(Slice(ptr, length));
-    if (s.ok()) {
-#ifndef VE_OPT
-#else
-      if (padding > 0) {
-        char tmp[padding];
-        dest_->Append(Slice(tmp, padding));
-      }
-#endif
-      s = dest_->Flush();
+  // Queue the header and the payload, computing the crc of the record
+  // type and the payload along the way.
+  pieces_.push_back(Slice(buf, kHeaderSize));
+  uint32_t crc = type_crc_[t];
+  size_t left = length;
+  while (left > 0) {
+    if (*offset == parts[*part].size()) {
+      ++*part;
+      *offset = 0;
+      continue;
     }
+    const char* ptr = parts[*part].data() + *offset;
+    const size_t n = std::min(left, parts[*part].size() - *offset);
+    crc = crc32c::Extend(crc, ptr, n);
+    pieces_.push_back(Slice(ptr, n));
+    *offset += n;
+    left -= n;
   }
+  crc = crc32c::Mask(crc);  // Adjust for storage
+  EncodeFixed32(buf, crc);
 #ifndef VE_OPT
   block_offset_ += kHeaderSize + length;
 #else
+  if (padding > 0) {
+    pieces_.push_back(Slice(kZeroes, padding));
+  }
   block_offset_ += kHeaderSize + length + padding;
 #endif
-  return s;
 }
 
 }  // namespace log
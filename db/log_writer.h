@@ -7,6 +7,9 @@
 
 #include <stdint.h>
 
+#include <string>
+#include <vector>
+
 #include "db/log_format.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
@@ -36,12 +39,24 @@ class Writer {
 
   Status AddRecord(const Slice& slice);
 
+  // Add one record whose contents are the concatenation of parts[0,n-1].
+  Status AddRecord(const Slice* parts, size_t n);
+
  private:
-  Status EmitPhysicalRecord(RecordType type, const char* ptr, size_t length);
+  // Queue one fragment of the current record in pieces_.  Its payload is
+  // the next "length" bytes of "parts", starting at byte *offset of
+  // parts[*part]; both are advanced past the payload.
+  void AddPhysicalRecord(RecordType type, const Slice* parts, size_t* part,
+                         size_t* offset, size_t length);
 
   WritableFile* dest_;
   int block_offset_;  // Current offset in block
 
+  // The pieces of the record being added and the storage for the headers
+  // of its fragments.  Kept as members to reuse their memory.
+  std::vector<Slice> pieces_;
+  std::string headers_;
+
   // crc32c values for all supported record types.  These are
   // pre-computed to reduce the overhead of computing the crc of the
   // record type stored in the header.
@@ -8,6 +8,7 @@
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "util/coding.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
@@ -26,19 +27,26 @@ static Slice GetLengthPrefixedKeySlice(const char* data) {
   return Slice(p, len);
 }
 
-MemTable::MemTable(const InternalKeyComparator& comparator)
-    : comparator_(comparator), refs_(0), table_(comparator_, &arena_) {}
-
-MemTable::~MemTable() { assert(refs_ == 0); }
+MemTable::MemTable(const InternalKeyComparator& comparator,
+                   const MemTableRepFactory* factory)
+    : comparator_(comparator),
+      refs_(0),
+      num_range_deletions_(0),
+      range_deletion_bytes_(0) {
+  if (factory == nullptr) {
+    factory = DefaultMemTableRepFactory();
+  }
+  table_ = factory->CreateMemTableRep(comparator_, &arena_);
+}
 
-size_t MemTable::ApproximateMemoryUsage() { return arena_.MemoryUsage(); }
+MemTable::~MemTable() {
+  assert(refs_ == 0);
+  delete table_;
+}
 
-int MemTable::KeyComparator::operator()(const char* aptr,
-                                        const char* bptr) const {
-  // Internal keys are encoded as length-prefixed strings.
-  Slice a = GetLengthPrefixedSlice(aptr);
-  Slice b = GetLengthPrefixedSlice(bptr);
-  return comparator.Compare(a, b);
+size_t MemTable::ApproximateMemoryUsage() {
+  return arena_.MemoryUsage() + table_->ApproximateMemoryUsage() +
+         range_deletion_bytes_.load(std::memory_order_relaxed);
 }
 
 // Encode a suitable internal key target for "target" and return it.
@@ -53,92 +61,191 @@ static const char* EncodeKey(std::string* scratch, const Slice& target) {
 
 class MemTableIterator : public Iterator {
  public:
-  explicit MemTableIterator(MemTable::Table* table) : iter_(table) {}
+  explicit MemTableIterator(MemTableRep* table)
+      : iter_(table->NewIterator()) {}
 
   MemTableIterator(const MemTableIterator&) = delete;
   MemTableIterator& operator=(const MemTableIterator&) = delete;
 
-  ~MemTableIterator() override = default;
+  ~MemTableIterator() override { delete iter_; }
 
-  bool Valid() const override { return iter_.Valid(); }
-  void Seek(const Slice& k) override { iter_.Seek(EncodeKey(&tmp_, k)); }
-  void SeekToFirst() override { iter_.SeekToFirst(); }
-  void SeekToLast() override { iter_.SeekToLast(); }
-  void Next() override { iter_.Next(); }
-  void Prev() override { iter_.Prev(); }
-  Slice key() const override { return GetLengthPrefixedSlice(iter_.key()); }
+  bool Valid() const override { return iter_->Valid(); }
+  void Seek(const Slice& k) override { iter_->Seek(EncodeKey(&tmp_, k)); }
+  void SeekToFirst() override { iter_->SeekToFirst(); }
+  void SeekToLast() override { iter_->SeekToLast(); }
+  void Next() override { iter_->Next(); }
+  void Prev() override { iter_->Prev(); }
+  Slice key() const override { return GetLengthPrefixedSlice(iter_->key()); }
   Slice value() const override {
-    Slice key_slice = GetLengthPrefixedSlice(iter_.key());
+    Slice key_slice = GetLengthPrefixedSlice(iter_->key());
     return GetLengthPrefixedKeySlice(key_slice.data() + key_slice.size());
   }
 
   Status status() const override { return Status::OK(); }
 
  private:
-  MemTable::Table::Iterator iter_;
+  MemTableRep::Iterator* const iter_;
   std::string tmp_;  // For passing to EncodeKey
 };
 
-Iterator* MemTable::NewIterator() { return new MemTableIterator(&table_); }
+Iterator* MemTable::NewIterator() { return new MemTableIterator(table_); }
 
-void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
-                   const Slice& value) {
+size_t MemTable::EncodedLength(const Slice& key, size_t value_size) {
+  size_t internal_key_size = key.size() + 8;
+  return VarintLength(internal_key_size) + internal_key_size +
+         VarintLength(value_size) + value_size /*+ 4*/;
+}
+
+size_t MemTable::PartsSize(const SliceParts& value) {
+  size_t size = 0;
+  for (int i = 0; i < value.num_parts; i++) {
+    size += value.parts[i].size();
+  }
+  return size;
+}
+
+void MemTable::EncodeEntry(char* buf, SequenceNumber s, ValueType type,
+                           const Slice& key, const SliceParts& value,
+                           size_t value_size) {
   // Format of an entry is concatenation of:
   //  key_size     : varint32 of internal_key.size()
   //  key bytes    : char[internal_key.size()]
   //  value_size   : varint32 of value.size()
   //  value bytes  : char[value.size()]
   size_t key_size = key.size();
-  size_t val_size = value.size();
   size_t internal_key_size = key_size + 8;
-  const size_t encoded_len = VarintLength(internal_key_size) +
-                             internal_key_size + VarintLength(val_size) +
-    val_size /*+ 4*/;
-  char* buf = arena_.Allocate(encoded_len);
   char* p = EncodeVarint32(buf, internal_key_size);
   memcpy(p, key.data(), key_size);
   p += key_size;
   EncodeFixed64(p, (s << 8) | type);
   p += 8;
-  p = EncodeVarint32(p, val_size);
+  p = EncodeVarint32(p, value_size);
   //  p = EncodeAlign(p);
-  memcpy(p, value.data(), val_size);
-  assert(p + val_size == buf + encoded_len);
-  //assert(p + val_size <= buf + encoded_len);
-  table_.Insert(buf);
+  for (int i = 0; i < value.num_parts; i++) {
+    memcpy(p, value.parts[i].data(), value.parts[i].size());
+    p += value.parts[i].size();
+  }
+  assert(p == buf + EncodedLength(key, value_size));
+}
+
+void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
+                   const Slice& value) {
+  Add(s, type, key, SliceParts(&value, 1));
+}
+
+void MemTable::AddConcurrently(SequenceNumber s, ValueType type,
+                               const Slice& key, const Slice& value) {
+  AddConcurrently(s, type, key, SliceParts(&value, 1));
+}
+
+void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
+                   const SliceParts& value) {
+  const size_t value_size = PartsSize(value);
+  char* buf = arena_.Allocate(EncodedLength(key, value_size));
+  EncodeEntry(buf, s, type, key, value, value_size);
+  table_->Insert(buf);
+}
+
+void MemTable::AddConcurrently(SequenceNumber s, ValueType type,
+                               const Slice& key, const SliceParts& value) {
+  const size_t value_size = PartsSize(value);
+  char* buf = arena_.AllocateConcurrently(EncodedLength(key, value_size));
+  EncodeEntry(buf, s, type, key, value, value_size);
+  table_->InsertConcurrently(buf);
+}
+
+void MemTable::AddRangeDeletion(SequenceNumber s, const Slice& begin,
+                                const Slice& end) {
+  MutexLock l(&range_del_mutex_);
+  range_deletions_.emplace_back(begin, end, s);
+  range_deletion_bytes_.fetch_add(
+      sizeof(RangeTombstone) + begin.size() + end.size(),
+      std::memory_order_relaxed);
+  num_range_deletions_.store(range_deletions_.size(),
+                             std::memory_order_release);
+}
+
+void MemTable::GetRangeDeletions(std::vector<RangeTombstone>* result) {
+  if (!HasRangeDeletions()) {
+    return;
+  }
+  MutexLock l(&range_del_mutex_);
+  result->insert(result->end(), range_deletions_.begin(),
+                 range_deletions_.end());
+}
+
+SequenceNumber MemTable::MaxCoveringRangeDeletion(const Slice& user_key,
+                                                  SequenceNumber sequence) {
+  const Comparator* ucmp = comparator_.comparator.user_comparator();
+  SequenceNumber result = 0;
+  MutexLock l(&range_del_mutex_);
+  for (const RangeTombstone& t : range_deletions_) {
+    if (t.sequence <= sequence && t.sequence > result &&
+        ucmp->Compare(t.begin, user_key) <= 0 &&
+        ucmp->Compare(user_key, t.end) < 0) {
+      result = t.sequence;
+    }
+  }
+  return result;
 }
 
 bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
-  Slice memkey = key.memtable_key();
-  Table::Iterator iter(&table_);
-  iter.Seek(memkey.data());
-  if (iter.Valid()) {
-    // entry format is:
-    //    klength  varint32
-    //    userkey  char[klength]
-    //    tag      uint64
-    //    vlength  varint32
-    //    value    char[vlength]
-    // Check that it belongs to same user key.  We do not check the
-    // sequence number since the Seek() call above should have skipped
-    // all entries with overly large sequence numbers.
-    const char* entry = iter.key();
-    uint32_t key_length;
-    const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
-    if (comparator_.comparator.user_comparator()->Compare(
-            Slice(key_ptr, key_length - 8), key.user_key()) == 0) {
-      // Correct user key
-      const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
-      switch (static_cast<ValueType>(tag & 0xff)) {
-        case kTypeValue: {
-          Slice v = GetLengthPrefixedKeySlice(key_ptr + key_length);
-          value->assign(v.data(), v.size());
-          return true;
-        }
-        case kTypeDeletion:
-          *s = Status::NotFound(Slice());
-          return true;
+  // Entries of older memtables and tables are older than any range
+  // deletion of this memtable, so a covering range deletion settles the
+  // lookup unless this memtable holds a newer entry for the key.
+  SequenceNumber range_del_sequence = 0;
+  if (HasRangeDeletions()) {
+    Slice internal_key = key.internal_key();
+    range_del_sequence = MaxCoveringRangeDeletion(
+        key.user_key(),
+        DecodeFixed64(internal_key.data() + internal_key.size() - 8) >> 8);
+  }
+
+  // We do not check the sequence number of the entry since the
+  // representation returns the newest entry visible at the sequence of key.
+  const char* entry = table_->Get(key);
+  if (entry != nullptr &&
+      GetFromEntry(entry, key, range_del_sequence, value, s)) {
+    return true;
+  }
+  if (range_del_sequence != 0) {
+    *s = Status::NotFound(Slice());
+    return true;
+  }
+  return false;
+}
+
+bool MemTable::GetFromEntry(const char* entry, const LookupKey& key,
+                            SequenceNumber range_del_sequence,
+                            std::string* value, Status* s) {
+  // entry format is:
+  //    klength  varint32
+  //    userkey  char[klength]
+  //    tag      uint64
+  //    vlength  varint32
+  //    value    char[vlength]
+  // Check that it belongs to same user key.
+  uint32_t key_length;
+  const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
+  if (comparator_.comparator.user_comparator()->Compare(
+          Slice(key_ptr, key_length - 8), key.user_key()) == 0) {
+    // Correct user key
+    const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+    if ((tag >> 8) < range_del_sequence) {
+      return false;  // Hidden by a range deletion
+    }
+    switch (static_cast<ValueType>(tag & 0xff)) {
+      case kTypeValue: {
+        Slice v = GetLengthPrefixedKeySlice(key_ptr + key_length);
+        value->assign(v.data(), v.size());
+        return true;
       }
+      case kTypeDeletion:
+        *s = Status::NotFound(Slice());
+        return true;
+      case kTypeRangeDeletion:
+      case kTypeBlobIndex:
+        break;
     }
   }
   return false;
@@ -5,11 +5,16 @@
 #ifndef STORAGE_LEVELDB_DB_MEMTABLE_H_
 #define STORAGE_LEVELDB_DB_MEMTABLE_H_
 
+#include <atomic>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
-#include "db/skiplist.h"
+#include "db/memtablerep.h"
+#include "db/range_del.h"
 #include "leveldb/db.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
 #include "util/arena.h"
 
 namespace leveldb {
@@ -21,7 +26,11 @@ class MemTable {
  public:
   // MemTables are reference counted.  The initial reference count
   // is zero and the caller must call Ref() at least once.
-  explicit MemTable(const InternalKeyComparator& comparator);
+  //
+  // Entries are kept in a representation created by "factory", or by
+  // DefaultMemTableRepFactory() if "factory" is null.
+  explicit MemTable(const InternalKeyComparator& comparator,
+                    const MemTableRepFactory* factory = nullptr);
 
   MemTable(const MemTable&) = delete;
   MemTable& operator=(const MemTable&) = delete;
@@ -56,9 +65,37 @@ class MemTable {
   void Add(SequenceNumber seq, ValueType type, const Slice& key,
            const Slice& value);
 
+  // Same as Add(), but may be called by several threads at the same time.
+  // REQUIRES: Add() is not called while concurrent adds are in progress.
+  void AddConcurrently(SequenceNumber seq, ValueType type, const Slice& key,
+                       const Slice& value);
+
+  // Same as Add() and AddConcurrently(), but the value is the
+  // concatenation of its parts.
+  void Add(SequenceNumber seq, ValueType type, const Slice& key,
+           const SliceParts& value);
+  void AddConcurrently(SequenceNumber seq, ValueType type, const Slice& key,
+                       const SliceParts& value);
+
+  // Record that the user keys in [begin, end) are deleted at the
+  // specified sequence number.  Range deletions are kept apart from the
+  // other entries, and NewIterator() does not yield them.  May be called
+  // at the same time as AddConcurrently().
+  void AddRangeDeletion(SequenceNumber seq, const Slice& begin,
+                        const Slice& end);
+
+  // Returns true iff AddRangeDeletion() has been called.
+  bool HasRangeDeletions() const {
+    return num_range_deletions_.load(std::memory_order_acquire) > 0;
+  }
+
+  // Appends the range deletions of the memtable to *result.
+  void GetRangeDeletions(std::vector<RangeTombstone>* result);
+
   // If memtable contains a value for key, store it in *value and return true.
-  // If memtable contains a deletion for key, store a NotFound() error
-  // in *status and return true.
+  // If memtable contains a deletion for key, or a range deletion that covers
+  // key and is newer than any value for it, store a NotFound() error in
+  // *status and return true.
   // Else, return false.
   bool Get(const LookupKey& key, std::string* value, Status* s);
 
@@ -66,20 +103,38 @@ class MemTable {
   friend class MemTableIterator;
   friend class MemTableBackwardIterator;
 
-  struct KeyComparator {
-    const InternalKeyComparator comparator;
-    explicit KeyComparator(const InternalKeyComparator& c) : comparator(c) {}
-    int operator()(const char* a, const char* b) const;
-  };
+  ~MemTable();  // Private since only Unref() should be used to delete it
 
-  typedef SkipList<const char*, KeyComparator> Table;
+  // Encode an entry into "buf", which must hold EncodedLength() bytes.
+  static size_t EncodedLength(const Slice& key, size_t value_size);
+  static void EncodeEntry(char* buf, SequenceNumber s, ValueType type,
+                          const Slice& key, const SliceParts& value,
+                          size_t value_size);
 
-  ~MemTable();  // Private since only Unref() should be used to delete it
+  // Return the total size of the parts of "value".
+  static size_t PartsSize(const SliceParts& value);
+
+  // Look up "key" in "entry", which must be the newest version of key
+  // visible at the lookup sequence, if there is such an entry.  Entries
+  // older than "range_del_sequence" are ignored.
+  bool GetFromEntry(const char* entry, const LookupKey& key,
+                    SequenceNumber range_del_sequence, std::string* value,
+                    Status* s);
 
-  KeyComparator comparator_;
+  // Returns the largest sequence number not above "sequence" of the range
+  // deletions that cover "user_key", or zero if there is none.
+  SequenceNumber MaxCoveringRangeDeletion(const Slice& user_key,
+                                          SequenceNumber sequence);
+
+  MemTableKeyComparator comparator_;
   int refs_;
   Arena arena_;
-  Table table_;
+  MemTableRep* table_;
+
+  port::Mutex range_del_mutex_;
+  std::vector<RangeTombstone> range_deletions_ GUARDED_BY(range_del_mutex_);
+  std::atomic<size_t> num_range_deletions_;
+  std::atomic<size_t> range_deletion_bytes_;
 };
 
 }  // namespace leveldb
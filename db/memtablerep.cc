@@ -0,0 +1,441 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/memtablerep.h"
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <vector>
+
+#include "db/skiplist.h"
+#include "db/vector.h"
+#include "leveldb/comparator.h"
+#include "port/port.h"
+#include "util/arena.h"
+#include "util/coding.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
+#include "util/no_destructor.h"
+#include "leveldb_autogen_conf.h"
+
+#if defined(VECTOR_MEMTABLE_INDEX) && !defined(VECTOR_MEMTABLE)
+#error "VECTOR_MEMTABLE_INDEX requires VECTOR_MEMTABLE"
+#endif
+
+namespace leveldb {
+
+static Slice GetLengthPrefixedSlice(const char* data) {
+  uint32_t len;
+  const char* p = data;
+  p = GetVarint32Ptr(p, p + 5, &len);  // +5: we assume "p" is not corrupted
+  return Slice(p, len);
+}
+
+static Slice EntryUserKey(const char* entry) {
+  return ExtractUserKey(GetLengthPrefixedSlice(entry));
+}
+
+static SequenceNumber EntrySequence(const char* entry) {
+  Slice internal_key = GetLengthPrefixedSlice(entry);
+  return DecodeFixed64(internal_key.data() + internal_key.size() - 8) >> 8;
+}
+
+int MemTableKeyComparator::operator()(const char* aptr,
+                                      const char* bptr) const {
+  // Internal keys are encoded as length-prefixed strings.
+  Slice a = GetLengthPrefixedSlice(aptr);
+  Slice b = GetLengthPrefixedSlice(bptr);
+  return comparator.Compare(a, b);
+}
+
+MemTableRepFactory::~MemTableRepFactory() = default;
+
+namespace {
+
+// Adapts the iterator of a SkipList-like "List" to MemTableRep::Iterator.
+template <typename List>
+class ListIterator : public MemTableRep::Iterator {
+ public:
+  explicit ListIterator(const List* list) : iter_(list) {}
+
+  bool Valid() const override { return iter_.Valid(); }
+  const char* key() const override { return iter_.key(); }
+  void Next() override { iter_.Next(); }
+  void Prev() override { iter_.Prev(); }
+  void Seek(const char* target) override { iter_.Seek(target); }
+  void SeekToFirst() override { iter_.SeekToFirst(); }
+  void SeekToLast() override { iter_.SeekToLast(); }
+
+ private:
+  typename List::Iterator iter_;
+};
+
+// Representation backed by a SkipList-like ordered "List" (SkipList or
+// VectorList).
+template <typename List>
+class ListRep : public MemTableRep {
+ public:
+  ListRep(const MemTableKeyComparator& cmp, Arena* arena)
+      : compare_(cmp), list_(cmp, arena) {}
+
+  void Insert(const char* entry) override { list_.Insert(entry); }
+
+  void InsertConcurrently(const char* entry) override {
+    list_.InsertConcurrently(entry);
+  }
+
+  const char* Get(const LookupKey& key) const override {
+    typename List::Iterator iter(&list_);
+    iter.Seek(key.memtable_key().data());
+    if (iter.Valid() && compare_.comparator.user_comparator()->Compare(
+                            EntryUserKey(iter.key()), key.user_key()) == 0) {
+      return iter.key();
+    }
+    return nullptr;
+  }
+
+  size_t ApproximateMemoryUsage() const override { return 0; }
+
+  Iterator* NewIterator() const override {
+    return new ListIterator<List>(&list_);
+  }
+
+ protected:
+  const MemTableKeyComparator compare_;
+  List list_;
+};
+
+typedef ListRep<SkipList<const char*, MemTableKeyComparator>> SkipListRep;
+
+// Open-addressing hash table that maps a user key to the entry holding its
+// newest version.  Entries are pointers into the memtable arena, so growing
+// the table only rehashes pointers, and the index is dropped together with
+// its memtable when that is flushed.
+class PointIndex {
+ public:
+  PointIndex() : lock_(0), slots_(kInitialSlots, nullptr), size_(0) {}
+
+  PointIndex(const PointIndex&) = delete;
+  PointIndex& operator=(const PointIndex&) = delete;
+
+  // Record "entry" unless a newer entry for its user key is present.
+  // Entries may arrive out of sequence order when inserted concurrently.
+  void Insert(const char* entry) {
+    Spinlock l(lock_);
+    if ((size_ + 1) * 4 > slots_.size() * 3) {
+      Grow();
+    }
+    const char*& slot = slots_[Find(EntryUserKey(entry))];
+    if (slot == nullptr) {
+      slot = entry;
+      size_++;
+    } else if (EntrySequence(slot) < EntrySequence(entry)) {
+      slot = entry;
+    }
+  }
+
+  // Return the newest entry for "user_key", or null if there is none.
+  const char* Lookup(const Slice& user_key) const {
+    Spinlock l(lock_);
+    return slots_[Find(user_key)];
+  }
+
+  size_t ApproximateMemoryUsage() const {
+    Spinlock l(lock_);
+    return slots_.size() * sizeof(const char*);
+  }
+
+ private:
+  static const size_t kInitialSlots = 1024;
+
+  // Return the index of the slot holding "user_key", or of the empty slot
+  // where it belongs.
+  size_t Find(const Slice& user_key) const {
+    const size_t mask = slots_.size() - 1;
+    size_t i = Hash(user_key.data(), user_key.size(), 0) & mask;
+    while (slots_[i] != nullptr && EntryUserKey(slots_[i]) != user_key) {
+      i = (i + 1) & mask;
+    }
+    return i;
+  }
+
+  void Grow() {
+    std::vector<const char*> old(slots_.size() * 2, nullptr);
+    old.swap(slots_);
+    for (const char* entry : old) {
+      if (entry != nullptr) {
+        slots_[Find(EntryUserKey(entry))] = entry;
+      }
+    }
+  }
+
+  std::atomic<int> mutable lock_;
+  std::vector<const char*> slots_;  // Size is a power of two
+  size_t size_;
+};
+
+class VectorRep : public ListRep<VectorList<const char*, MemTableKeyComparator>> {
+ public:
+  VectorRep(const MemTableKeyComparator& cmp, Arena* arena, bool hash_index)
+      : ListRep(cmp, arena),
+        // Equal user keys are only guaranteed to be equal byte strings
+        // with the bytewise comparator.
+        index_(hash_index && cmp.comparator.user_comparator() ==
+                                 BytewiseComparator()
+                   ? new PointIndex
+                   : nullptr),
+        entries_(0) {}
+
+  ~VectorRep() override { delete index_; }
+
+  void Insert(const char* entry) override {
+    list_.Insert(entry);
+    Added(entry);
+  }
+
+  void InsertConcurrently(const char* entry) override {
+    list_.InsertConcurrently(entry);
+    Added(entry);
+  }
+
+  const char* Get(const LookupKey& key) const override {
+    if (index_ != nullptr) {
+      const char* entry = index_->Lookup(key.user_key());
+      if (entry == nullptr) {
+        return nullptr;
+      }
+      Slice lookup_key = key.internal_key();
+      const SequenceNumber snapshot =
+          DecodeFixed64(lookup_key.data() + lookup_key.size() - 8) >> 8;
+      if (EntrySequence(entry) <= snapshot) {
+        return entry;
+      }
+      // The newest entry is not visible in this snapshot; search the runs.
+    }
+    return ListRep::Get(key);
+  }
+
+  size_t ApproximateMemoryUsage() const override {
+    size_t usage = entries_.load(std::memory_order_relaxed) * sizeof(char*);
+    if (index_ != nullptr) {
+      usage += index_->ApproximateMemoryUsage();
+    }
+    return usage;
+  }
+
+ private:
+  void Added(const char* entry) {
+    entries_.fetch_add(1, std::memory_order_relaxed);
+    if (index_ != nullptr) {
+      index_->Insert(entry);
+    }
+  }
+
+  PointIndex* const index_;
+  std::atomic<size_t> entries_;
+};
+
+// Iterates over a sorted snapshot of entries.
+class SortedVectorIterator : public MemTableRep::Iterator {
+ public:
+  SortedVectorIterator(const MemTableKeyComparator& cmp,
+                       std::vector<const char*>* entries)
+      : compare_(cmp), pos_(entries->size()) {
+    entries_.swap(*entries);
+  }
+
+  bool Valid() const override { return pos_ < entries_.size(); }
+  const char* key() const override { return entries_[pos_]; }
+  void Next() override { pos_++; }
+  void Prev() override { pos_ = (pos_ == 0) ? entries_.size() : pos_ - 1; }
+  void Seek(const char* target) override {
+    pos_ = std::lower_bound(entries_.begin(), entries_.end(), target,
+                            [this](const char* a, const char* b) {
+                              return compare_(a, b) < 0;
+                            }) -
+           entries_.begin();
+  }
+  void SeekToFirst() override { pos_ = 0; }
+  void SeekToLast() override {
+    pos_ = entries_.empty() ? 0 : entries_.size() - 1;
+  }
+
+ private:
+  const MemTableKeyComparator compare_;
+  std::vector<const char*> entries_;
+  size_t pos_;
+};
+
+class HashSkipListRep : public MemTableRep {
+ public:
+  HashSkipListRep(const MemTableKeyComparator& cmp, Arena* arena,
+                  size_t bucket_count)
+      : compare_(cmp),
+        arena_(arena),
+        bucket_count_(bucket_count),
+        buckets_(new std::atomic<Bucket*>[bucket_count]),
+        entries_(0) {
+    for (size_t i = 0; i < bucket_count_; i++) {
+      buckets_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  ~HashSkipListRep() override {
+    // The buckets live in the arena and own no other memory.
+    delete[] buckets_;
+  }
+
+  void Insert(const char* entry) override {
+    GetOrCreateBucket(EntryUserKey(entry))->Insert(entry);
+    entries_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void InsertConcurrently(const char* entry) override {
+    GetOrCreateBucket(EntryUserKey(entry))->InsertConcurrently(entry);
+    entries_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  const char* Get(const LookupKey& key) const override {
+    Bucket* bucket = GetBucket(key.user_key());
+    if (bucket == nullptr) {
+      return nullptr;
+    }
+    Bucket::Iterator iter(bucket);
+    iter.Seek(key.memtable_key().data());
+    if (iter.Valid() && EntryUserKey(iter.key()) == key.user_key()) {
+      return iter.key();
+    }
+    return nullptr;
+  }
+
+  size_t ApproximateMemoryUsage() const override {
+    return bucket_count_ * sizeof(std::atomic<Bucket*>);
+  }
+
+  // Copies and sorts all entries, which costs O(n log n).
+  Iterator* NewIterator() const override {
+    std::vector<const char*> entries;
+    entries.reserve(entries_.load(std::memory_order_relaxed));
+    for (size_t i = 0; i < bucket_count_; i++) {
+      Bucket* bucket = buckets_[i].load(std::memory_order_acquire);
+      if (bucket != nullptr) {
+        Bucket::Iterator iter(bucket);
+        for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+          entries.push_back(iter.key());
+        }
+      }
+    }
+    std::sort(entries.begin(), entries.end(),
+              [this](const char* a, const char* b) {
+                return compare_(a, b) < 0;
+              });
+    return new SortedVectorIterator(compare_, &entries);
+  }
+
+ private:
+  typedef SkipList<const char*, MemTableKeyComparator> Bucket;
+
+  Bucket* GetBucket(const Slice& user_key) const {
+    size_t i = Hash(user_key.data(), user_key.size(), 0) % bucket_count_;
+    return buckets_[i].load(std::memory_order_acquire);
+  }
+
+  Bucket* GetOrCreateBucket(const Slice& user_key) {
+    size_t i = Hash(user_key.data(), user_key.size(), 0) % bucket_count_;
+    Bucket* bucket = buckets_[i].load(std::memory_order_acquire);
+    if (bucket == nullptr) {
+      // Concurrent inserters may race to create the bucket.  The arena
+      // allows one thread at a time to use AllocateAligned() while the
+      // others allocate with AllocateConcurrently().
+      MutexLock l(&create_mutex_);
+      bucket = buckets_[i].load(std::memory_order_relaxed);
+      if (bucket == nullptr) {
+        char* mem = arena_->AllocateAligned(sizeof(Bucket));
+        bucket = new (mem) Bucket(compare_, arena_);
+        buckets_[i].store(bucket, std::memory_order_release);
+      }
+    }
+    return bucket;
+  }
+
+  const MemTableKeyComparator compare_;
+  Arena* const arena_;
+  const size_t bucket_count_;
+  std::atomic<Bucket*>* const buckets_;
+  std::atomic<size_t> entries_;
+  port::Mutex create_mutex_;
+};
+
+class SkipListRepFactory : public MemTableRepFactory {
+ public:
+  const char* Name() const override { return "leveldb.SkipListRep"; }
+
+  MemTableRep* CreateMemTableRep(const MemTableKeyComparator& cmp,
+                                 Arena* arena) const override {
+    return new SkipListRep(cmp, arena);
+  }
+};
+
+class VectorRepFactory : public MemTableRepFactory {
+ public:
+  explicit VectorRepFactory(bool hash_index) : hash_index_(hash_index) {}
+
+  const char* Name() const override { return "leveldb.VectorRep"; }
+
+  MemTableRep* CreateMemTableRep(const MemTableKeyComparator& cmp,
+                                 Arena* arena) const override {
+    return new VectorRep(cmp, arena, hash_index_);
+  }
+
+ private:
+  const bool hash_index_;
+};
+
+class HashSkipListRepFactory : public MemTableRepFactory {
+ public:
+  explicit HashSkipListRepFactory(size_t bucket_count)
+      : bucket_count_(bucket_count > 0 ? bucket_count : 1) {}
+
+  const char* Name() const override { return "leveldb.HashSkipListRep"; }
+
+  MemTableRep* CreateMemTableRep(const MemTableKeyComparator& cmp,
+                                 Arena* arena) const override {
+    // Buckets are found by hashing the bytes of the user key.
+    if (cmp.comparator.user_comparator() != BytewiseComparator()) {
+      return new SkipListRep(cmp, arena);
+    }
+    return new HashSkipListRep(cmp, arena, bucket_count_);
+  }
+
+ private:
+  const size_t bucket_count_;
+};
+
+}  // namespace
+
+const MemTableRepFactory* NewSkipListRepFactory() {
+  return new SkipListRepFactory;
+}
+
+const MemTableRepFactory* NewVectorRepFactory(bool hash_index) {
+  return new VectorRepFactory(hash_index);
+}
+
+const MemTableRepFactory* NewHashSkipListRepFactory(size_t bucket_count) {
+  return new HashSkipListRepFactory(bucket_count);
+}
+
+const MemTableRepFactory* DefaultMemTableRepFactory() {
+#if defined(VECTOR_MEMTABLE_INDEX)
+  static NoDestructor<VectorRepFactory> singleton(true);
+#elif defined(VECTOR_MEMTABLE)
+  static NoDestructor<VectorRepFactory> singleton(false);
+#else
+  static NoDestructor<SkipListRepFactory> singleton;
+#endif
+  return singleton.get();
+}
+
+}  // namespace leveldb
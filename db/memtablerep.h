@@ -0,0 +1,89 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_MEMTABLEREP_H_
+#define STORAGE_LEVELDB_DB_MEMTABLEREP_H_
+
+#include "db/dbformat.h"
+#include "leveldb/memtablerep.h"
+
+namespace leveldb {
+
+// Orders memtable entries, each of which starts with a length-prefixed
+// internal key (see MemTable::Add() for the entry format).
+struct MemTableKeyComparator {
+  const InternalKeyComparator comparator;
+  explicit MemTableKeyComparator(const InternalKeyComparator& c)
+      : comparator(c) {}
+  int operator()(const char* a, const char* b) const;
+};
+
+// The data structure that holds the entries of a MemTable.  MemTable
+// allocates and encodes the entries; a MemTableRep only orders and indexes
+// pointers to them.
+//
+// Thread safety: Insert() requires external synchronization.
+// InsertConcurrently() may be called by several threads at the same time
+// as long as no thread calls Insert().  Reads may run concurrently with
+// writes.
+class MemTableRep {
+ public:
+  // Iterates over the entries in the order given by MemTableKeyComparator.
+  class Iterator {
+   public:
+    virtual ~Iterator() = default;
+
+    virtual bool Valid() const = 0;
+
+    // Returns the entry at the current position.
+    // REQUIRES: Valid()
+    virtual const char* key() const = 0;
+
+    virtual void Next() = 0;
+    virtual void Prev() = 0;
+
+    // Advance to the first entry that is at or after "target", which is an
+    // encoded entry or a memtable key (see LookupKey::memtable_key()).
+    virtual void Seek(const char* target) = 0;
+
+    virtual void SeekToFirst() = 0;
+    virtual void SeekToLast() = 0;
+  };
+
+  MemTableRep() = default;
+
+  MemTableRep(const MemTableRep&) = delete;
+  MemTableRep& operator=(const MemTableRep&) = delete;
+
+  virtual ~MemTableRep() = default;
+
+  // Insert "entry" into the representation.
+  // REQUIRES: nothing that compares equal to entry is in the representation.
+  virtual void Insert(const char* entry) = 0;
+
+  // Same as Insert(), but see the thread safety notes above.
+  virtual void InsertConcurrently(const char* entry) = 0;
+
+  // Return the first entry at or after the memtable key of "key" if that
+  // entry has the same user key, and null otherwise.
+  virtual const char* Get(const LookupKey& key) const = 0;
+
+  // Returns an estimate of the memory used by the representation outside
+  // of the arena it was created with.
+  virtual size_t ApproximateMemoryUsage() const = 0;
+
+  // Return a new iterator over the entries.  The caller must delete it
+  // before the representation is destroyed.
+  virtual Iterator* NewIterator() const = 0;
+};
+
+// Returns the factory used when Options::memtable_factory is null.  This is
+// the skip list, or the vector representation in builds configured with
+// VECTOR_MEMTABLE (with its hash index if VECTOR_MEMTABLE_INDEX is also
+// defined).
+const MemTableRepFactory* DefaultMemTableRepFactory();
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_MEMTABLEREP_H_
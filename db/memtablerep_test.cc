@@ -0,0 +1,187 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/memtablerep.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "db/memtable.h"
+#include "leveldb/comparator.h"
+#include "util/random.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+namespace {
+
+class ReverseKeyComparator : public Comparator {
+ public:
+  const char* Name() const override {
+    return "leveldb.ReverseBytewiseComparator";
+  }
+
+  int Compare(const Slice& a, const Slice& b) const override {
+    return BytewiseComparator()->Compare(Reverse(a), Reverse(b));
+  }
+
+  void FindShortestSeparator(std::string* start,
+                             const Slice& limit) const override {}
+
+  void FindShortSuccessor(std::string* key) const override {}
+
+ private:
+  static std::string Reverse(const Slice& key) {
+    std::string str(key.ToString());
+    std::reverse(str.begin(), str.end());
+    return str;
+  }
+};
+
+struct ModelEntry {
+  std::string internal_key;
+  std::string value;
+};
+
+}  // namespace
+
+static ReverseKeyComparator reverse_key_comparator;
+
+class MemTableRepTest {
+ public:
+  // Fills a memtable created by "factory" with puts and deletes of a small
+  // key space, then checks Get() at several sequence numbers and
+  // iteration in both directions against a model.
+  void Check(const MemTableRepFactory* factory, const Comparator* ucmp) {
+    InternalKeyComparator icmp(ucmp);
+    MemTable* mem = new MemTable(icmp, factory);
+    mem->Ref();
+
+    Random rnd(test::RandomSeed());
+    std::vector<ModelEntry> model;
+    const int kKeys = 500;
+    const SequenceNumber kMaxSequence = 5000;
+    for (SequenceNumber seq = 1; seq <= kMaxSequence; seq++) {
+      std::string key = "key" + std::to_string(rnd.Uniform(kKeys));
+      ValueType type = rnd.OneIn(5) ? kTypeDeletion : kTypeValue;
+      std::string value =
+          (type == kTypeValue) ? "v" + std::to_string(seq) : std::string();
+      mem->Add(seq, type, key, value);
+
+      ModelEntry entry;
+      AppendInternalKey(&entry.internal_key,
+                        ParsedInternalKey(key, seq, type));
+      entry.value = value;
+      model.push_back(entry);
+    }
+    std::sort(model.begin(), model.end(),
+              [&icmp](const ModelEntry& a, const ModelEntry& b) {
+                return icmp.Compare(a.internal_key, b.internal_key) < 0;
+              });
+
+    // Point lookups
+    for (int i = 0; i < 2000; i++) {
+      std::string key = "key" + std::to_string(rnd.Uniform(kKeys + 10));
+      SequenceNumber snapshot = rnd.Uniform(kMaxSequence + 1);
+      LookupKey lkey(key, snapshot);
+      // Model answer: the first entry at or after the lookup key with
+      // the same user key.
+      const ModelEntry* expected = nullptr;
+      for (const ModelEntry& e : model) {
+        if (icmp.Compare(e.internal_key, lkey.internal_key()) >= 0) {
+          if (ucmp->Compare(ExtractUserKey(e.internal_key), key) == 0) {
+            expected = &e;
+          }
+          break;
+        }
+      }
+      std::string value;
+      Status s;
+      bool found = mem->Get(lkey, &value, &s);
+      if (expected == nullptr) {
+        ASSERT_TRUE(!found);
+      } else {
+        ASSERT_TRUE(found);
+        ParsedInternalKey parsed;
+        ASSERT_TRUE(ParseInternalKey(expected->internal_key, &parsed));
+        if (parsed.type == kTypeValue) {
+          ASSERT_OK(s);
+          ASSERT_EQ(expected->value, value);
+        } else {
+          ASSERT_TRUE(s.IsNotFound());
+        }
+      }
+    }
+
+    // Forward and backward iteration
+    Iterator* iter = mem->NewIterator();
+    iter->SeekToFirst();
+    for (const ModelEntry& e : model) {
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ(e.internal_key, iter->key().ToString());
+      ASSERT_EQ(e.value, iter->value().ToString());
+      iter->Next();
+    }
+    ASSERT_TRUE(!iter->Valid());
+    iter->SeekToLast();
+    for (auto e = model.rbegin(); e != model.rend(); ++e) {
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ(e->internal_key, iter->key().ToString());
+      iter->Prev();
+    }
+    ASSERT_TRUE(!iter->Valid());
+
+    // Seek followed by a change of direction
+    iter->Seek(model[model.size() / 2].internal_key);
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(model[model.size() / 2].internal_key, iter->key().ToString());
+    iter->Prev();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(model[model.size() / 2 - 1].internal_key, iter->key().ToString());
+    iter->Next();
+    iter->Next();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(model[model.size() / 2 + 1].internal_key, iter->key().ToString());
+    delete iter;
+
+    mem->Unref();
+  }
+
+  void CheckAll(const MemTableRepFactory* factory) {
+    Check(factory, BytewiseComparator());
+    Check(factory, &reverse_key_comparator);
+  }
+};
+
+TEST(MemTableRepTest, Default) { CheckAll(nullptr); }
+
+TEST(MemTableRepTest, SkipList) {
+  const MemTableRepFactory* factory = NewSkipListRepFactory();
+  CheckAll(factory);
+  delete factory;
+}
+
+TEST(MemTableRepTest, Vector) {
+  const MemTableRepFactory* factory = NewVectorRepFactory(false);
+  CheckAll(factory);
+  delete factory;
+}
+
+TEST(MemTableRepTest, VectorWithHashIndex) {
+  const MemTableRepFactory* factory = NewVectorRepFactory(true);
+  CheckAll(factory);
+  delete factory;
+}
+
+TEST(MemTableRepTest, HashSkipList) {
+  const MemTableRepFactory* factory = NewHashSkipListRepFactory(64);
+  CheckAll(factory);
+  delete factory;
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) { return leveldb::test::RunAllTests(); }
@@ -0,0 +1,147 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_del.h"
+
+#include <algorithm>
+#include <queue>
+#include <utility>
+
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+
+namespace leveldb {
+
+RangeDelAggregator::RangeDelAggregator(const Comparator* user_comparator,
+                                       SequenceNumber upper_bound)
+    : ucmp_(user_comparator), upper_bound_(upper_bound), fragmented_(true) {}
+
+void RangeDelAggregator::Add(const Slice& begin, const Slice& end,
+                             SequenceNumber sequence) {
+  if (sequence > upper_bound_ || ucmp_->Compare(begin, end) >= 0) {
+    return;
+  }
+  tombstones_.emplace_back(begin, end, sequence);
+  fragmented_ = false;
+}
+
+Status RangeDelAggregator::AddTombstones(Iterator* iter) {
+  Status s;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ParsedInternalKey ikey;
+    if (!ParseInternalKey(iter->key(), &ikey) ||
+        ikey.type != kTypeRangeDeletion) {
+      s = Status::Corruption("bad range deletion");
+      break;
+    }
+    Add(ikey.user_key, iter->value(), ikey.sequence);
+  }
+  if (s.ok()) {
+    s = iter->status();
+  }
+  delete iter;
+  return s;
+}
+
+void RangeDelAggregator::Fragment() {
+  boundaries_.clear();
+  sequences_.clear();
+  for (const RangeTombstone& t : tombstones_) {
+    boundaries_.push_back(t.begin);
+    boundaries_.push_back(t.end);
+  }
+  const Comparator* ucmp = ucmp_;
+  auto less = [ucmp](const std::string& a, const std::string& b) {
+    return ucmp->Compare(a, b) < 0;
+  };
+  std::sort(boundaries_.begin(), boundaries_.end(), less);
+  boundaries_.erase(
+      std::unique(boundaries_.begin(), boundaries_.end(),
+                  [ucmp](const std::string& a, const std::string& b) {
+                    return ucmp->Compare(a, b) == 0;
+                  }),
+      boundaries_.end());
+
+  // Sweep over the boundaries, keeping the tombstones that started so far
+  // in a heap ordered by sequence number.  Tombstones that ended are only
+  // removed once they reach the top.
+  std::vector<const RangeTombstone*> by_begin;
+  for (const RangeTombstone& t : tombstones_) {
+    by_begin.push_back(&t);
+  }
+  std::sort(by_begin.begin(), by_begin.end(),
+            [ucmp](const RangeTombstone* a, const RangeTombstone* b) {
+              return ucmp->Compare(a->begin, b->begin) < 0;
+            });
+  typedef std::pair<SequenceNumber, const RangeTombstone*> Entry;
+  std::priority_queue<Entry> active;
+  size_t next = 0;
+  for (const std::string& boundary : boundaries_) {
+    while (next < by_begin.size() &&
+           ucmp_->Compare(by_begin[next]->begin, boundary) <= 0) {
+      active.push(Entry(by_begin[next]->sequence, by_begin[next]));
+      next++;
+    }
+    while (!active.empty() &&
+           ucmp_->Compare(active.top().second->end, boundary) <= 0) {
+      active.pop();
+    }
+    sequences_.push_back(active.empty() ? 0 : active.top().first);
+  }
+  fragmented_ = true;
+}
+
+int RangeDelAggregator::FindFragment(const Slice& user_key) const {
+  // Find the last boundary at or before user_key.
+  int left = 0;
+  int right = static_cast<int>(boundaries_.size());
+  while (left < right) {
+    int mid = (left + right) / 2;
+    if (ucmp_->Compare(boundaries_[mid], user_key) <= 0) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left - 1;
+}
+
+SequenceNumber RangeDelAggregator::MaxCoveringSequence(const Slice& user_key) {
+  if (tombstones_.empty()) {
+    return 0;
+  }
+  if (!fragmented_) {
+    Fragment();
+  }
+  int i = FindFragment(user_key);
+  return (i < 0) ? 0 : sequences_[i];
+}
+
+SequenceNumber RangeDelAggregator::MinCoveringSequence(const Slice& smallest,
+                                                       const Slice& largest) {
+  if (tombstones_.empty()) {
+    return 0;
+  }
+  if (!fragmented_) {
+    Fragment();
+  }
+  int i = FindFragment(smallest);
+  if (i < 0) {
+    return 0;
+  }
+  SequenceNumber result = kMaxSequenceNumber;
+  for (; static_cast<size_t>(i) < sequences_.size(); i++) {
+    if (sequences_[i] == 0) {
+      return 0;
+    }
+    result = std::min(result, sequences_[i]);
+    if (static_cast<size_t>(i + 1) < boundaries_.size() &&
+        ucmp_->Compare(largest, boundaries_[i + 1]) < 0) {
+      return result;
+    }
+  }
+  return 0;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,109 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Range deletions (see DB::DeleteRange()) are kept apart from the point
+// entries: in a list held by each memtable and in a range-deletion block of
+// each table.  In that block, a range deletion of [begin, end) at sequence
+// number s is stored with the internal key (begin, s, kTypeRangeDeletion)
+// and the value end.
+
+#ifndef STORAGE_LEVELDB_DB_RANGE_DEL_H_
+#define STORAGE_LEVELDB_DB_RANGE_DEL_H_
+
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Comparator;
+class Iterator;
+
+// Deletes the user keys in [begin, end) written before "sequence".
+struct RangeTombstone {
+  RangeTombstone() : sequence(0) {}
+  RangeTombstone(const Slice& b, const Slice& e, SequenceNumber s)
+      : begin(b.ToString()), end(e.ToString()), sequence(s) {}
+
+  // The key under which the tombstone is stored in a table.
+  InternalKey StartKey() const {
+    return InternalKey(begin, sequence, kTypeRangeDeletion);
+  }
+
+  // The largest key of a table that holds the tombstone must be at least
+  // this key, which sorts before every entry for the user key "end".
+  InternalKey EndKey() const {
+    return InternalKey(end, kMaxSequenceNumber, kTypeRangeDeletion);
+  }
+
+  std::string begin;
+  std::string end;
+  SequenceNumber sequence;
+};
+
+// Collects the range deletions visible at a sequence number and answers
+// which of them covers a user key.  Not thread-safe.
+class RangeDelAggregator {
+ public:
+  // Tombstones with a sequence number larger than "upper_bound" are ignored.
+  RangeDelAggregator(const Comparator* user_comparator,
+                     SequenceNumber upper_bound);
+
+  RangeDelAggregator(const RangeDelAggregator&) = delete;
+  RangeDelAggregator& operator=(const RangeDelAggregator&) = delete;
+
+  void Add(const Slice& begin, const Slice& end, SequenceNumber sequence);
+
+  // Adds the tombstones yielded by "iter", an iterator over a
+  // range-deletion block, and deletes "iter".
+  Status AddTombstones(Iterator* iter);
+
+  bool empty() const { return tombstones_.empty(); }
+
+  // The tombstones added so far, in insertion order.
+  const std::vector<RangeTombstone>& tombstones() const {
+    return tombstones_;
+  }
+
+  // Returns the largest sequence number of the tombstones that cover
+  // "user_key", or zero if none does.
+  SequenceNumber MaxCoveringSequence(const Slice& user_key);
+
+  // Returns true iff a tombstone hides "key".
+  bool ShouldDelete(const ParsedInternalKey& key) {
+    return key.sequence < MaxCoveringSequence(key.user_key);
+  }
+
+  // Returns the largest sequence number s such that every user key in
+  // [smallest, largest] is covered by a tombstone of sequence s or larger,
+  // or zero if some key in the range is not covered at all.
+  SequenceNumber MinCoveringSequence(const Slice& smallest,
+                                     const Slice& largest);
+
+ private:
+  // Splits the tombstones into disjoint fragments, each with the largest
+  // sequence number of the tombstones that overlap it.
+  void Fragment();
+
+  // Index of the fragment containing "user_key", or -1.
+  int FindFragment(const Slice& user_key) const;
+
+  const Comparator* const ucmp_;
+  const SequenceNumber upper_bound_;
+  std::vector<RangeTombstone> tombstones_;
+
+  // Fragment i covers [boundaries_[i], boundaries_[i + 1]) and has the
+  // sequence number sequences_[i], which is zero for gaps.  Only valid
+  // while fragmented_ is true.
+  bool fragmented_;
+  std::vector<std::string> boundaries_;
+  std::vector<SequenceNumber> sequences_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_RANGE_DEL_H_
@@ -14,6 +14,8 @@
 //        all tables (see 2c)
 //      - compaction pointers are cleared
 //      - every table file is added at level 0
+//      - every blob file that a table refers to is added, with as many
+//        blobs as the tables refer to
 //
 // Possible optimization 1:
 //   (a) Compute total size and use to pick appropriate max-level M
@@ -24,6 +26,9 @@
 //   Store per-table metadata (smallest, largest, largest-seq#, ...)
 //   in the table's meta section to speed up ScanTable.
 
+#include <map>
+
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_impl.h"
 #include "db/dbformat.h"
@@ -31,6 +36,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "db/write_batch_internal.h"
@@ -93,6 +99,8 @@ class Repairer {
   struct TableInfo {
     FileMetaData meta;
     SequenceNumber max_sequence;
+    // Number of entries that refer to each blob file
+    std::map<uint64_t, uint64_t> blob_references;
   };
 
   Status FindFiles() {
@@ -177,7 +185,7 @@ class Repairer {
     std::string scratch;
     Slice record;
     WriteBatch batch;
-    MemTable* mem = new MemTable(icmp_);
+    MemTable* mem = new MemTable(icmp_, options_.memtable_factory);
     mem->Ref();
     int counter = 0;
     while (reader.ReadRecord(&record, &scratch)) {
@@ -203,7 +211,10 @@ class Repairer {
     FileMetaData meta;
     meta.number = next_file_number_++;
     Iterator* iter = mem->NewIterator();
-    status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    std::vector<RangeTombstone> range_deletions;
+    mem->GetRangeDeletions(&range_deletions);
+    status = BuildTable(dbname_, env_, options_, table_cache_, iter,
+                        range_deletions, &meta);
     delete iter;
     mem->Unref();
     mem = nullptr;
@@ -276,11 +287,42 @@ class Repairer {
       if (parsed.sequence > t.max_sequence) {
         t.max_sequence = parsed.sequence;
       }
+      BlobIndex index;
+      if (parsed.type == kTypeBlobIndex && index.DecodeFrom(iter->value())) {
+        t.blob_references[index.file_number]++;
+      }
+    }
+    for (const auto& blob_references_kvp : t.blob_references) {
+      t.meta.blob_files.push_back(blob_references_kvp.first);
     }
     if (!iter->status().ok()) {
       status = iter->status();
     }
     delete iter;
+
+    // The bounds of the table also cover its range deletions.
+    RangeDelAggregator range_deletions(icmp_.user_comparator(),
+                                       kMaxSequenceNumber);
+    if (status.ok()) {
+      status = range_deletions.AddTombstones(
+          table_cache_->NewRangeDeletionIterator(t.meta.number,
+                                                 t.meta.file_size));
+    }
+    for (const RangeTombstone& tombstone : range_deletions.tombstones()) {
+      InternalKey start = tombstone.StartKey();
+      InternalKey end = tombstone.EndKey();
+      if (empty || icmp_.Compare(start, t.meta.smallest) < 0) {
+        t.meta.smallest = start;
+      }
+      if (empty || icmp_.Compare(end, t.meta.largest) > 0) {
+        t.meta.largest = end;
+      }
+      empty = false;
+      if (tombstone.sequence > t.max_sequence) {
+        t.max_sequence = tombstone.sequence;
+      }
+    }
+    t.meta.has_range_deletions = !range_deletions.empty();
     Log(options_.info_log, "Table #%llu: %d entries %s",
         (unsigned long long)t.meta.number, counter, status.ToString().c_str());
 
@@ -312,6 +354,13 @@ class Repairer {
       counter++;
     }
     delete iter;
+    iter = table_cache_->NewRangeDeletionIterator(t.meta.number,
+                                                  t.meta.file_size);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      builder->AddRangeDeletion(iter->key(), iter->value());
+      counter++;
+    }
+    delete iter;
 
     ArchiveFile(src);
     if (counter == 0) {
@@ -365,11 +414,30 @@ class Repairer {
     edit_.SetNextFile(next_file_number_);
     edit_.SetLastSequence(max_sequence);
 
+    std::map<uint64_t, uint64_t> blob_references;
     for (size_t i = 0; i < tables_.size(); i++) {
       // TODO(opt): separate out into multiple levels
       const TableInfo& t = tables_[i];
-      edit_.AddFile(0, t.meta.number, t.meta.file_size, t.meta.smallest,
-                    t.meta.largest);
+      edit_.AddFile(0, t.meta);
+      for (const auto& blob_references_kvp : t.blob_references) {
+        blob_references[blob_references_kvp.first] +=
+            blob_references_kvp.second;
+      }
+    }
+
+    // The blobs that no table refers to are left out of blob_count, so a
+    // blob file is deleted once all the blobs that tables refer to are
+    // garbage.
+    for (const auto& blob_references_kvp : blob_references) {
+      const uint64_t number = blob_references_kvp.first;
+      uint64_t file_size;
+      Status s = env_->GetFileSize(BlobFileName(dbname_, number), &file_size);
+      if (s.ok()) {
+        edit_.AddBlobFile(number, file_size, blob_references_kvp.second);
+      } else {
+        Log(options_.info_log, "Blob file #%llu: missing: %s",
+            (unsigned long long)number, s.ToString().c_str());
+      }
     }
 
     // fprintf(stderr, "NewDescriptor:\n%s\n", edit_.DebugString().c_str());
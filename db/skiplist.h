@@ -8,7 +8,9 @@
 // Thread safety
 // -------------
 //
-// Writes require external synchronization, most likely a mutex.
+// Writes require external synchronization, most likely a mutex.  The
+// exception is InsertConcurrently(), which may be called by several
+// threads at the same time as long as no thread calls Insert().
 // Reads require a guarantee that the SkipList will not be destroyed
 // while the read is in progress.  Apart from that, reads progress
 // without any internal locking or synchronization.
@@ -32,13 +34,10 @@
 #include <cstdlib>
 
 #include "util/arena.h"
+#include "util/hash.h"
 #include "util/random.h"
 #include "rtc.h"
 
-#ifdef VECTOR_MEMTABLE
-#include "vector.h"
-#else
-
 namespace leveldb {
 
 class Arena;
@@ -61,6 +60,13 @@ class SkipList {
   // REQUIRES: nothing that compares equal to key is currently in the list.
   void Insert(const Key& key);
 
+  // Like Insert(), but several threads may insert at the same time.  Nodes
+  // are linked into every level with compare-and-swap, so concurrent
+  // readers observe the same guarantees as with Insert().
+  // REQUIRES: nothing that compares equal to key is currently in the list.
+  // REQUIRES: Insert() is not called while concurrent inserts are running.
+  void InsertConcurrently(const Key& key);
+
   // Returns true iff an entry that compares equal to key is in the list.
   bool Contains(const Key& key) const;
 
@@ -111,7 +117,9 @@ class SkipList {
   }
 
   Node* NewNode(const Key& key, int height);
+  Node* NewNodeConcurrently(const Key& key, int height);
   int RandomHeight();
+  int RandomHeightConcurrently(const Key& key) const;
   bool Equal(const Key& a, const Key& b) const { return (compare_(a, b) == 0); }
 
   // Return true if key is greater than the data stored in "n"
@@ -124,6 +132,11 @@ class SkipList {
   // node at "level" for every level in [0..max_height_-1].
   Node* FindGreaterOrEqual(const Key& key, Node** prev) const;
 
+  // Starting at "before", find the pair of adjacent nodes at "level"
+  // between which key belongs and store them in *prev and *next.
+  void FindSpliceForLevel(const Key& key, Node* before, int level, Node** prev,
+                          Node** next) const;
+
   // Return the latest node with a key < key.
   // Return head_ if there is no such node.
   Node* FindLessThan(const Key& key) const;
@@ -138,8 +151,8 @@ class SkipList {
 
   Node* const head_;
 
-  // Modified only by Insert().  Read racily by readers, but stale
-  // values are ok.
+  // Modified only by Insert() and InsertConcurrently().  Read racily by
+  // readers, but stale values are ok.
   std::atomic<int> max_height_;  // Height of the entire list
 
   // Read/written only by Insert().
@@ -178,6 +191,15 @@ struct SkipList<Key, Comparator>::Node {
     next_[n].store(x, std::memory_order_relaxed);
   }
 
+  // Link x after this node at level n iff the current link is still
+  // "expected".  Has release semantics like SetNext().
+  bool CASNext(int n, Node* expected, Node* x) {
+    assert(n >= 0);
+    return next_[n].compare_exchange_strong(expected, x,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed);
+  }
+
  private:
   // Array of length equal to the node height.  next_[0] is lowest level link.
   std::atomic<Node*> next_[1];
@@ -191,6 +213,14 @@ typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::NewNode(
   return new (node_memory) Node(key);
 }
 
+template <typename Key, class Comparator>
+typename SkipList<Key, Comparator>::Node*
+SkipList<Key, Comparator>::NewNodeConcurrently(const Key& key, int height) {
+  char* const node_memory = arena_->AllocateAlignedConcurrently(
+      sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1));
+  return new (node_memory) Node(key);
+}
+
 template <typename Key, class Comparator>
 inline SkipList<Key, Comparator>::Iterator::Iterator(const SkipList* list) {
   list_ = list;
@@ -256,6 +286,23 @@ int SkipList<Key, Comparator>::RandomHeight() {
   return height;
 }
 
+template <typename Key, class Comparator>
+int SkipList<Key, Comparator>::RandomHeightConcurrently(const Key& key) const {
+  // rnd_ cannot be shared between inserters, so the height is derived
+  // from a hash of the key instead.  Every pair of bits is zero with
+  // probability 1 in 4, which gives the same distribution as RandomHeight().
+  uint32_t bits =
+      Hash(reinterpret_cast<const char*>(&key), sizeof(key), 0xdeadbeef);
+  int height = 1;
+  while (height < kMaxHeight && (bits & 3) == 0) {
+    height++;
+    bits >>= 2;
+  }
+  assert(height > 0);
+  assert(height <= kMaxHeight);
+  return height;
+}
+
 template <typename Key, class Comparator>
 bool SkipList<Key, Comparator>::KeyIsAfterNode(const Key& key, Node* n) const {
   // null n is considered infinite
@@ -285,6 +332,23 @@ SkipList<Key, Comparator>::FindGreaterOrEqual(const Key& key,
   }
 }
 
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::FindSpliceForLevel(const Key& key, Node* before,
+                                                   int level, Node** prev,
+                                                   Node** next) const {
+  Node* x = before;
+  while (true) {
+    Node* n = x->Next(level);
+    if (KeyIsAfterNode(key, n)) {
+      x = n;
+    } else {
+      *prev = x;
+      *next = n;
+      return;
+    }
+  }
+}
+
 template <typename Key, class Comparator>
 typename SkipList<Key, Comparator>::Node*
 SkipList<Key, Comparator>::FindLessThan(const Key& key) const {
@@ -372,6 +436,49 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
   }
 }
 
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::InsertConcurrently(const Key& key) {
+  const int height = RandomHeightConcurrently(key);
+  int max_height = GetMaxHeight();
+  while (height > max_height) {
+    // Same reasoning as in Insert(): readers that observe the new height
+    // either see nullptr links from head_ or links to fully built nodes.
+    if (max_height_.compare_exchange_weak(max_height, height,
+                                          std::memory_order_relaxed)) {
+      max_height = height;
+      break;
+    }
+  }
+
+  // Find the splice at every level, reusing the result of the level above
+  // as the starting point of the search.
+  Node* prev[kMaxHeight];
+  Node* next[kMaxHeight];
+  Node* before = head_;
+  for (int i = max_height - 1; i >= 0; i--) {
+    FindSpliceForLevel(key, before, i, &prev[i], &next[i]);
+    before = prev[i];
+  }
+
+  // Our data structure does not allow duplicate insertion
+  assert(next[0] == nullptr || !Equal(key, next[0]->key));
+
+  // Link bottom-up so that the node is reachable at level 0 before it
+  // shows up in any of the express lanes.
+  Node* x = NewNodeConcurrently(key, height);
+  for (int i = 0; i < height; i++) {
+    while (true) {
+      x->NoBarrier_SetNext(i, next[i]);
+      if (prev[i]->CASNext(i, next[i], x)) {
+        break;
+      }
+      // Another inserter changed the splice at this level; recompute it
+      // starting from our old predecessor, which still precedes key.
+      FindSpliceForLevel(key, prev[i], i, &prev[i], &next[i]);
+    }
+  }
+}
+
 template <typename Key, class Comparator>
 bool SkipList<Key, Comparator>::Contains(const Key& key) const {
   Node* x = FindGreaterOrEqual(key, nullptr);
@@ -383,6 +490,5 @@ bool SkipList<Key, Comparator>::Contains(const Key& key) const {
 }
 
 }  // namespace leveldb
-#endif // VECTOR_MEMTABLE
 
 #endif  // STORAGE_LEVELDB_DB_SKIPLIST_H_
@@ -4,8 +4,10 @@
 
 #include "db/skiplist.h"
 
+#include <algorithm>
 #include <atomic>
 #include <set>
+#include <vector>
 
 #include "leveldb/env.h"
 #include "port/port.h"
@@ -126,6 +128,41 @@ TEST(SkipTest, InsertAndLookup) {
   }
 }
 
+// Interleaves inserts with iterator creation and checks that mixed
+// forward and backward movement agrees with a model.
+TEST(SkipTest, InterleavedInsertAndIterate) {
+  Random rnd(test::RandomSeed());
+  std::set<Key> keys;
+  Arena arena;
+  Comparator cmp;
+  SkipList<Key, Comparator> list(cmp, &arena);
+  for (int i = 0; i < 5000; i++) {
+    Key key = rnd.Next() % 100000;
+    if (keys.insert(key).second) {
+      list.Insert(key);
+    }
+    if (!rnd.OneIn(10)) {
+      continue;
+    }
+    Key target = rnd.Next() % 100000;
+    SkipList<Key, Comparator>::Iterator iter(&list);
+    std::set<Key>::iterator model_iter = keys.lower_bound(target);
+    iter.Seek(target);
+    for (int step = 0; step < 10 && model_iter != keys.end(); step++) {
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(*model_iter, iter.key());
+      if (rnd.OneIn(2)) {
+        ++model_iter;
+        iter.Next();
+      } else if (model_iter != keys.begin()) {
+        --model_iter;
+        iter.Prev();
+      }
+    }
+    ASSERT_EQ(model_iter != keys.end(), iter.Valid());
+  }
+}
+
 // We want to make sure that with a single writer and multiple
 // concurrent readers (with no synchronization other than when a
 // reader's iterator is created), the reader always observes all the
@@ -364,6 +401,93 @@ TEST(SkipTest, Concurrent3) { RunConcurrent(3); }
 TEST(SkipTest, Concurrent4) { RunConcurrent(4); }
 TEST(SkipTest, Concurrent5) { RunConcurrent(5); }
 
+// Several threads call InsertConcurrently() on disjoint key sets while a
+// reader checks that iteration stays sorted.  Afterwards every key must be
+// present exactly once.
+class ConcurrentInsertState {
+ public:
+  static const int kInserters = 4;
+  static const int kKeysPerInserter = 20000;
+
+  Arena arena_;
+  SkipList<Key, Comparator> list_;
+  std::atomic<int> inserters_done_;
+  std::atomic<bool> reader_done_;
+
+  ConcurrentInsertState()
+      : list_(Comparator(), &arena_), inserters_done_(0), reader_done_(false) {}
+};
+
+struct ConcurrentInserterArg {
+  ConcurrentInsertState* state;
+  int id;
+};
+
+static void ConcurrentInserter(void* arg) {
+  ConcurrentInserterArg* a = reinterpret_cast<ConcurrentInserterArg*>(arg);
+  Random rnd(1000 + a->id);
+  const int n = ConcurrentInsertState::kKeysPerInserter;
+  // Insert keys id, id + kInserters, id + 2 * kInserters, ... in a
+  // scrambled order so that the inserters keep colliding on splices.
+  std::vector<Key> keys;
+  for (int i = 0; i < n; i++) {
+    keys.push_back(static_cast<Key>(i) * ConcurrentInsertState::kInserters +
+                   a->id);
+  }
+  for (int i = n - 1; i > 0; i--) {
+    std::swap(keys[i], keys[rnd.Uniform(i + 1)]);
+  }
+  for (int i = 0; i < n; i++) {
+    a->state->list_.InsertConcurrently(keys[i]);
+  }
+  a->state->inserters_done_.fetch_add(1, std::memory_order_release);
+}
+
+static void ConcurrentInsertReader(void* arg) {
+  ConcurrentInsertState* state = reinterpret_cast<ConcurrentInsertState*>(arg);
+  while (state->inserters_done_.load(std::memory_order_acquire) <
+         ConcurrentInsertState::kInserters) {
+    SkipList<Key, Comparator>::Iterator iter(&state->list_);
+    bool first = true;
+    Key last = 0;
+    for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+      if (!first) {
+        ASSERT_LT(last, iter.key());
+      }
+      last = iter.key();
+      first = false;
+    }
+  }
+  state->reader_done_.store(true, std::memory_order_release);
+}
+
+TEST(SkipTest, ConcurrentInsert) {
+  ConcurrentInsertState state;
+  ConcurrentInserterArg args[ConcurrentInsertState::kInserters];
+  Env::Default()->StartThread(ConcurrentInsertReader, &state);
+  for (int i = 0; i < ConcurrentInsertState::kInserters; i++) {
+    args[i].state = &state;
+    args[i].id = i;
+    Env::Default()->StartThread(ConcurrentInserter, &args[i]);
+  }
+  while (!state.reader_done_.load(std::memory_order_acquire)) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+
+  const Key total = static_cast<Key>(ConcurrentInsertState::kInserters) *
+                    ConcurrentInsertState::kKeysPerInserter;
+  SkipList<Key, Comparator>::Iterator iter(&state.list_);
+  iter.SeekToFirst();
+  for (Key k = 0; k < total; k++) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(k, iter.key());
+    iter.Next();
+  }
+  ASSERT_TRUE(!iter.Valid());
+  ASSERT_TRUE(state.list_.Contains(total / 2));
+  ASSERT_TRUE(!state.list_.Contains(total));
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) { return leveldb::test::RunAllTests(); }
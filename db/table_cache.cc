@@ -13,7 +13,7 @@ namespace leveldb {
 
 struct TableAndFile {
   RandomAccessFile* file;
-  Table* table;
+  Table* table;  // nullptr for blob files
 };
 
 static void DeleteEntry(const Slice& key, void* value) {
@@ -75,6 +75,26 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
   return s;
 }
 
+Status TableCache::FindBlobFile(uint64_t file_number,
+                                Cache::Handle** handle) {
+  Status s;
+  char buf[sizeof(file_number)];
+  EncodeFixed64(buf, file_number);
+  Slice key(buf, sizeof(buf));
+  *handle = cache_->Lookup(key);
+  if (*handle == nullptr) {
+    RandomAccessFile* file = nullptr;
+    s = env_->NewRandomAccessFile(BlobFileName(dbname_, file_number), &file);
+    if (s.ok()) {
+      TableAndFile* tf = new TableAndFile;
+      tf->file = file;
+      tf->table = nullptr;
+      *handle = cache_->Insert(key, tf, 1, &DeleteEntry);
+    }
+  }
+  return s;
+}
+
 Iterator* TableCache::NewIterator(const ReadOptions& options,
                                   uint64_t file_number, uint64_t file_size,
                                   Table** tableptr) {
@@ -89,7 +109,28 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
   }
 
   Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-  Iterator* result = table->NewIterator(options);
+  Iterator* result;
+  if (options.iterate_lower_bound != nullptr ||
+      options.iterate_upper_bound != nullptr) {
+    // The smallest internal keys with the user keys of the bounds.
+    InternalKey lower, upper;
+    Slice lower_key, upper_key;
+    if (options.iterate_lower_bound != nullptr) {
+      lower = InternalKey(*options.iterate_lower_bound, kMaxSequenceNumber,
+                          kValueTypeForSeek);
+      lower_key = lower.Encode();
+    }
+    if (options.iterate_upper_bound != nullptr) {
+      upper = InternalKey(*options.iterate_upper_bound, kMaxSequenceNumber,
+                          kValueTypeForSeek);
+      upper_key = upper.Encode();
+    }
+    result = table->NewIterator(
+        options, options.iterate_lower_bound != nullptr ? &lower_key : nullptr,
+        options.iterate_upper_bound != nullptr ? &upper_key : nullptr);
+  } else {
+    result = table->NewIterator(options);
+  }
   result->RegisterCleanup(&UnrefEntry, cache_, handle);
   if (tableptr != nullptr) {
     *tableptr = table;
@@ -97,6 +138,20 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
   return result;
 }
 
+Iterator* TableCache::NewRangeDeletionIterator(uint64_t file_number,
+                                               uint64_t file_size) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+
+  Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  Iterator* result = table->NewRangeDeletionIterator();
+  result->RegisterCleanup(&UnrefEntry, cache_, handle);
+  return result;
+}
+
 Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
                        uint64_t file_size, const Slice& k, void* arg,
                        void (*handle_result)(void*, const Slice&,
@@ -111,6 +166,50 @@ Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
   return s;
 }
 
+bool TableCache::PrefixMayMatch(const ReadOptions& options,
+                                uint64_t file_number, uint64_t file_size,
+                                const Slice& prefix_key) {
+  Cache::Handle* handle = nullptr;
+  if (!FindTable(file_number, file_size, &handle).ok()) {
+    return true;
+  }
+  Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  bool result = t->PrefixMayMatch(options, prefix_key);
+  cache_->Release(handle);
+  return result;
+}
+
+void TableCache::MultiGet(const ReadOptions& options, uint64_t file_number,
+                          uint64_t file_size, int n, const Slice* keys,
+                          void* const* args, Status* statuses,
+                          void (*handle_result)(void*, const Slice&,
+                                                const Slice&)) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+    t->InternalMultiGet(options, n, keys, args, statuses, handle_result);
+    cache_->Release(handle);
+  } else {
+    for (int i = 0; i < n; i++) {
+      statuses[i] = s;
+    }
+  }
+}
+
+Status TableCache::ReadBlob(const ReadOptions& options, const Slice& user_key,
+                            const BlobIndex& index, std::string* value) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindBlobFile(index.file_number, &handle);
+  if (s.ok()) {
+    RandomAccessFile* file =
+        reinterpret_cast<TableAndFile*>(cache_->Value(handle))->file;
+    s = leveldb::ReadBlob(file, options, index, user_key, value);
+    cache_->Release(handle);
+  }
+  return s;
+}
+
 void TableCache::Evict(uint64_t file_number) {
   char buf[sizeof(file_number)];
   EncodeFixed64(buf, file_number);
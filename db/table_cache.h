@@ -11,6 +11,7 @@
 
 #include <string>
 
+#include "db/blob_file.h"
 #include "db/dbformat.h"
 #include "leveldb/cache.h"
 #include "leveldb/table.h"
@@ -35,17 +36,43 @@ class TableCache {
   Iterator* NewIterator(const ReadOptions& options, uint64_t file_number,
                         uint64_t file_size, Table** tableptr = nullptr);
 
+  // Return an iterator over the range deletions of the specified file (see
+  // db/range_del.h).  The range deletions are held in memory while the
+  // file is open.
+  Iterator* NewRangeDeletionIterator(uint64_t file_number, uint64_t file_size);
+
   // If a seek to internal key "k" in specified file finds an entry,
   // call (*handle_result)(arg, found_key, found_value).
   Status Get(const ReadOptions& options, uint64_t file_number,
              uint64_t file_size, const Slice& k, void* arg,
              void (*handle_result)(void*, const Slice&, const Slice&));
 
+  // Like Get(), but looks up the "n" keys in "keys", which must be sorted
+  // in increasing order.  For each keys[i] found, calls
+  // (*handle_result)(args[i], found_key, found_value), and stores the
+  // status of its lookup in statuses[i].
+  void MultiGet(const ReadOptions& options, uint64_t file_number,
+                uint64_t file_size, int n, const Slice* keys,
+                void* const* args, Status* statuses,
+                void (*handle_result)(void*, const Slice&, const Slice&));
+
+  // Returns false if the specified file holds no key with the prefix given
+  // by "prefix_key" (see Table::PrefixMayMatch()).  Errors count as a
+  // match.
+  bool PrefixMayMatch(const ReadOptions& options, uint64_t file_number,
+                      uint64_t file_size, const Slice& prefix_key);
+
+  // Reads the value of "user_key" from the blob that "index" refers to.
+  // Blob files are kept open in the same cache as the tables.
+  Status ReadBlob(const ReadOptions& options, const Slice& user_key,
+                  const BlobIndex& index, std::string* value);
+
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
 
  private:
   Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+  Status FindBlobFile(uint64_t file_number, Cache::Handle**);
 
   Env* const env_;
   const std::string dbname_;
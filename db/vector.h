@@ -5,6 +5,8 @@
 #include <memory>
 #include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <iterator>
 
 class Spinlock
 {
@@ -34,104 +36,294 @@ namespace leveldb {
 
 class Arena;
 
+// Vector-based alternative to SkipList with the same interface, used by
+// the vector memtable representation (see NewVectorRepFactory()).
+//
+// Keys are appended to a small unsorted buffer.  When the buffer fills, or
+// when an iterator is created, it is sorted into an immutable run.  Runs
+// are merged pairwise, newest first, whenever a run is not at least twice
+// as large as the run that follows it, so there are O(log n) runs.  The
+// merge itself is done outside of lock_ so that appends and readers are
+// not held up by it.
+//
+// Iterators take a reference-counted snapshot of the run list and merge
+// the runs on the fly; nothing is copied or sorted per iterator.
 template <typename Key, class Comparator>
-class SkipList {
+class VectorList {
 private:
   using Bucket = typename std::vector<Key>;
+  using Run = std::shared_ptr<const Bucket>;
+  using RunList = std::vector<Run>;
   using Iter = typename Bucket::const_iterator;
+
+  // Appends beyond this many unsorted keys seal the buffer into a run.
+  static const size_t kMaxBufferSize = 1024;
+
 public:
-  explicit SkipList(Comparator cmp, Arena* arena) : bucket_(new Bucket), compare_(cmp), lock_(0) {
+  explicit VectorList(Comparator cmp, Arena* arena) : compare_(cmp), lock_(0), runs_(new RunList), merging_(false) {
+    buffer_.reserve(kMaxBufferSize);
   }
 
-  SkipList(const SkipList&) = delete;
-  SkipList& operator=(const SkipList&) = delete;
-  ~SkipList() {
-    delete bucket_;
-  }
+  VectorList(const VectorList&) = delete;
+  VectorList& operator=(const VectorList&) = delete;
+
   void Insert(const Key& key) {
-    Spinlock l(lock_);
-    bucket_->push_back(key);
+    bool merge;
+    {
+      Spinlock l(lock_);
+      buffer_.push_back(key);
+      if (buffer_.size() < kMaxBufferSize) {
+        return;
+      }
+      SealBuffer();
+      merge = ClaimMerge();
+    }
+    if (merge) {
+      MergeRuns();
+    }
   }
+  // Insert() already serializes on lock_.
+  void InsertConcurrently(const Key& key) { Insert(key); }
   bool Contains(const Key& key) const {
-    Spinlock l(lock_);
-    return std::find(bucket_->begin(), bucket_->end(), key) != bucket_->end();
+    std::shared_ptr<const RunList> runs;
+    {
+      Spinlock l(lock_);
+      for (const Key& k : buffer_) {
+        if (compare_(k, key) == 0) {
+          return true;
+        }
+      }
+      runs = runs_;
+    }
+    for (const Run& run : *runs) {
+      Iter it = LowerBound(compare_, *run, key);
+      if (it != run->end() && compare_(*it, key) == 0) {
+        return true;
+      }
+    }
+    return false;
   }
 
   class Iterator {
   private:
   public:
-    explicit Iterator(const SkipList* list) : list_(list), bucket_(new Bucket(*(list_->bucket_))), compare_(list_->compare_), cit_(bucket_->end()), sorted_(false) {
-    }
-    ~Iterator() {
-      delete bucket_;
+    explicit Iterator(const VectorList* list) : compare_(list->compare_), current_(-1), direction_(kForward) {
+      runs_ = list->Snapshot();
+      pos_.resize(runs_->size());
     }
     bool Valid() const {
-      return cit_ != bucket_->end();
+      return current_ >= 0;
     }
     const Key& key() const {
-      return *cit_;
+      assert(Valid());
+      return (*(*runs_)[current_])[pos_[current_]];
     }
     void Next() {
-      DoSortIfNeeded();
-      if (cit_ == bucket_->end()) {
+      if (!Valid()) {
         return;
       }
-      ++cit_;
+      // Move every non-current run to the first key after key().  Since
+      // keys are unique across runs, that is the lower bound of key().
+      if (direction_ != kForward) {
+        const Key k = key();
+        for (size_t i = 0; i < runs_->size(); i++) {
+          if (static_cast<int>(i) != current_) {
+            const Bucket& run = *(*runs_)[i];
+            pos_[i] = LowerBound(compare_, run, k) - run.begin();
+          }
+        }
+        direction_ = kForward;
+      }
+      pos_[current_]++;
+      FindSmallest();
     }
     void Prev() {
-      DoSortIfNeeded();
-      if (cit_ == bucket_->begin()) {
-        cit_ = bucket_->end();
-      } else {
-        --cit_;
+      if (!Valid()) {
+        return;
+      }
+      // Move every non-current run to the last key before key().
+      if (direction_ != kReverse) {
+        const Key k = key();
+        for (size_t i = 0; i < runs_->size(); i++) {
+          if (static_cast<int>(i) != current_) {
+            const Bucket& run = *(*runs_)[i];
+            size_t p = LowerBound(compare_, run, k) - run.begin();
+            pos_[i] = (p == 0) ? run.size() : p - 1;
+          }
+        }
+        direction_ = kReverse;
       }
+      const Bucket& run = *(*runs_)[current_];
+      pos_[current_] = (pos_[current_] == 0) ? run.size() : pos_[current_] - 1;
+      FindLargest();
     }
     void Seek(const Key& target) {
-      DoSortIfNeeded();
-      cit_ = std::equal_range(bucket_->begin(),
-                              bucket_->end(),
-                              target,
-                              [this] (const Key &a, const Key &b) {
-                                return compare_(a, b) < 0;
-                              }).first;
+      for (size_t i = 0; i < runs_->size(); i++) {
+        const Bucket& run = *(*runs_)[i];
+        pos_[i] = LowerBound(compare_, run, target) - run.begin();
+      }
+      direction_ = kForward;
+      FindSmallest();
     }
     void SeekToFirst() {
-      DoSortIfNeeded();
-      cit_ = bucket_->begin();
+      for (size_t i = 0; i < runs_->size(); i++) {
+        pos_[i] = 0;
+      }
+      direction_ = kForward;
+      FindSmallest();
     }
     void SeekToLast() {
-      DoSortIfNeeded();
-      cit_ = bucket_->end();
-      if (bucket_->size() != 0) {
-        --cit_;
+      for (size_t i = 0; i < runs_->size(); i++) {
+        const Bucket& run = *(*runs_)[i];
+        pos_[i] = run.empty() ? 0 : run.size() - 1;
       }
+      direction_ = kReverse;
+      FindLargest();
     }
 
   private:
-    void DoSortIfNeeded() {
-      if (sorted_) {
-        return;
+    enum Direction { kForward, kReverse };
+
+    // Runs whose position equals their size are exhausted.
+    void FindSmallest() {
+      current_ = -1;
+      for (size_t i = 0; i < runs_->size(); i++) {
+        const Bucket& run = *(*runs_)[i];
+        if (pos_[i] < run.size() &&
+            (current_ < 0 || compare_(run[pos_[i]], key()) < 0)) {
+          current_ = i;
+        }
+      }
+    }
+    void FindLargest() {
+      current_ = -1;
+      for (size_t i = 0; i < runs_->size(); i++) {
+        const Bucket& run = *(*runs_)[i];
+        if (pos_[i] < run.size() &&
+            (current_ < 0 || compare_(run[pos_[i]], key()) > 0)) {
+          current_ = i;
+        }
       }
-      std::sort(bucket_->begin(), bucket_->end(),
-                [this] (const Key &a, const Key &b) {
-                  return compare_(a, b) < 0;
-                });
-      cit_ = bucket_->begin();
-      sorted_ = true;
     }
-    
-    const SkipList* const list_;
-    Bucket * const bucket_;
+    std::shared_ptr<const RunList> runs_;
+    std::vector<size_t> pos_;
     Comparator const compare_;
-    Iter mutable cit_;
-    bool sorted_;
+    int current_;
+    Direction direction_;
   };
 
 private:
   friend class Iterator;
-  Bucket * const bucket_;
+
+  static Iter LowerBound(const Comparator& cmp, const Bucket& run,
+                         const Key& target) {
+    return std::lower_bound(run.begin(), run.end(), target,
+                            [&cmp] (const Key &a, const Key &b) {
+                              return cmp(a, b) < 0;
+                            });
+  }
+
+  // Seals any buffered keys and returns the current list of runs.
+  std::shared_ptr<const RunList> Snapshot() const {
+    std::shared_ptr<const RunList> runs;
+    bool merge = false;
+    {
+      Spinlock l(lock_);
+      if (!buffer_.empty()) {
+        SealBuffer();
+        merge = ClaimMerge();
+      }
+      runs = runs_;
+    }
+    if (merge) {
+      MergeRuns();
+    }
+    return runs;
+  }
+
+  // REQUIRES: lock_ held.
+  void SealBuffer() const {
+    std::shared_ptr<Bucket> run(new Bucket(buffer_));
+    std::sort(run->begin(), run->end(),
+              [this] (const Key &a, const Key &b) {
+                return compare_(a, b) < 0;
+              });
+    buffer_.clear();
+    std::shared_ptr<RunList> runs(new RunList(*runs_));
+    runs->push_back(run);
+    runs_ = runs;
+  }
+
+  // Returns true if the caller should run MergeRuns().  Only one thread
+  // merges at a time; runs sealed meanwhile are picked up by that thread.
+  // REQUIRES: lock_ held.
+  bool ClaimMerge() const {
+    if (merging_ || FindMergeable(*runs_) < 0) {
+      return false;
+    }
+    merging_ = true;
+    return true;
+  }
+
+  // Returns the index i of the newest pair (i, i + 1) of runs that should
+  // be merged, or -1 if there is none.
+  static int FindMergeable(const RunList& runs) {
+    for (int i = static_cast<int>(runs.size()) - 2; i >= 0; i--) {
+      if (runs[i]->size() <= 2 * runs[i + 1]->size()) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  // REQUIRES: merging_ claimed by this thread, lock_ not held.
+  void MergeRuns() const {
+    while (true) {
+      std::shared_ptr<const RunList> runs;
+      int i;
+      {
+        Spinlock l(lock_);
+        i = FindMergeable(*runs_);
+        if (i < 0) {
+          merging_ = false;
+          return;
+        }
+        runs = runs_;
+      }
+      const Bucket& a = *(*runs)[i];
+      const Bucket& b = *(*runs)[i + 1];
+      std::shared_ptr<Bucket> merged(new Bucket);
+      merged->reserve(a.size() + b.size());
+      std::merge(a.begin(), a.end(), b.begin(), b.end(),
+                 std::back_inserter(*merged),
+                 [this] (const Key &x, const Key &y) {
+                   return compare_(x, y) < 0;
+                 });
+      {
+        // Other threads only append runs while we merge, so runs i and
+        // i + 1 are still at the same position.
+        Spinlock l(lock_);
+        std::shared_ptr<RunList> next(new RunList);
+        next->reserve(runs_->size() - 1);
+        for (size_t j = 0; j < runs_->size(); j++) {
+          if (j == static_cast<size_t>(i)) {
+            next->push_back(merged);
+          } else if (j != static_cast<size_t>(i) + 1) {
+            next->push_back((*runs_)[j]);
+          }
+        }
+        runs_ = next;
+      }
+    }
+  }
+
   Comparator const compare_;
   std::atomic<int> mutable lock_;
+  // Fields below are protected by lock_.  Readers seal the buffer too,
+  // so these are mutable.
+  Bucket mutable buffer_;
+  std::shared_ptr<const RunList> mutable runs_;
+  bool mutable merging_;
 };
 
 }  // namespace leveldb
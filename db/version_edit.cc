@@ -25,6 +25,13 @@ enum Tag {
 #ifdef VE_OPT
   kDummy = 10,
 #endif
+  // Same as kNewFile, for tables that have a range deletion block
+  kNewFileWithRangeDeletions = 11,
+  // Same as kNewFileWithRangeDeletions, followed by whether the table has
+  // a range deletion block and the blob files it refers to
+  kNewFileWithBlobFiles = 12,
+  kNewBlobFile = 13,
+  kBlobGarbage = 14,
 };
 
 void VersionEdit::Clear() {
@@ -40,6 +47,8 @@ void VersionEdit::Clear() {
   has_last_sequence_ = false;
   deleted_files_.clear();
   new_files_.clear();
+  new_blob_files_.clear();
+  blob_garbage_.clear();
 }
 
 void VersionEdit::EncodeTo(std::string* dst) const {
@@ -78,12 +87,38 @@ void VersionEdit::EncodeTo(std::string* dst) const {
 
   for (size_t i = 0; i < new_files_.size(); i++) {
     const FileMetaData& f = new_files_[i].second;
-    PutVarint32(dst, kNewFile);
+    if (!f.blob_files.empty()) {
+      PutVarint32(dst, kNewFileWithBlobFiles);
+    } else {
+      PutVarint32(dst, f.has_range_deletions ? kNewFileWithRangeDeletions
+                                             : kNewFile);
+    }
     PutVarint32(dst, new_files_[i].first);  // level
     PutVarint64(dst, f.number);
     PutVarint64(dst, f.file_size);
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
+    if (!f.blob_files.empty()) {
+      PutVarint32(dst, f.has_range_deletions ? 1 : 0);
+      PutVarint32(dst, static_cast<uint32_t>(f.blob_files.size()));
+      for (uint64_t blob_file : f.blob_files) {
+        PutVarint64(dst, blob_file);
+      }
+    }
+  }
+
+  for (const BlobFileMetaData& b : new_blob_files_) {
+    PutVarint32(dst, kNewBlobFile);
+    PutVarint64(dst, b.number);
+    PutVarint64(dst, b.file_size);
+    PutVarint64(dst, b.blob_count);
+  }
+
+  for (const auto& garbage_kvp : blob_garbage_) {
+    PutVarint32(dst, kBlobGarbage);
+    PutVarint64(dst, garbage_kvp.first);          // blob file number
+    PutVarint64(dst, garbage_kvp.second.first);   // count
+    PutVarint64(dst, garbage_kvp.second.second);  // bytes
   }
 
 #ifdef VE_OPT
@@ -103,6 +138,22 @@ static bool GetInternalKey(Slice* input, InternalKey* dst) {
   }
 }
 
+static bool GetBlobFiles(Slice* input, FileMetaData* f) {
+  uint32_t has_range_deletions, n;
+  if (!GetVarint32(input, &has_range_deletions) || !GetVarint32(input, &n)) {
+    return false;
+  }
+  f->has_range_deletions = (has_range_deletions != 0);
+  for (uint32_t i = 0; i < n; i++) {
+    uint64_t number;
+    if (!GetVarint64(input, &number)) {
+      return false;
+    }
+    f->blob_files.push_back(number);
+  }
+  return true;
+}
+
 static bool GetLevel(Slice* input, int* level) {
   uint32_t v;
   if (GetVarint32(input, &v) && v < config::kNumLevels) {
@@ -123,6 +174,8 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
   int level;
   uint64_t number;
   FileMetaData f;
+  BlobFileMetaData b;
+  uint64_t count, bytes;
   Slice str;
   InternalKey key;
 
@@ -186,15 +239,41 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         break;
 
       case kNewFile:
+      case kNewFileWithRangeDeletions:
+      case kNewFileWithBlobFiles:
+        f.blob_files.clear();
         if (GetLevel(&input, &level) && GetVarint64(&input, &f.number) &&
             GetVarint64(&input, &f.file_size) &&
             GetInternalKey(&input, &f.smallest) &&
-            GetInternalKey(&input, &f.largest)) {
+            GetInternalKey(&input, &f.largest) &&
+            (tag != kNewFileWithBlobFiles || GetBlobFiles(&input, &f))) {
+          if (tag != kNewFileWithBlobFiles) {
+            f.has_range_deletions = (tag == kNewFileWithRangeDeletions);
+          }
           new_files_.push_back(std::make_pair(level, f));
         } else {
           msg = "new-file entry";
         }
         break;
+
+      case kNewBlobFile:
+        if (GetVarint64(&input, &b.number) &&
+            GetVarint64(&input, &b.file_size) &&
+            GetVarint64(&input, &b.blob_count)) {
+          new_blob_files_.push_back(b);
+        } else {
+          msg = "new-blob-file entry";
+        }
+        break;
+
+      case kBlobGarbage:
+        if (GetVarint64(&input, &number) && GetVarint64(&input, &count) &&
+            GetVarint64(&input, &bytes)) {
+          AddBlobGarbage(number, count, bytes);
+        } else {
+          msg = "blob garbage";
+        }
+        break;
 #ifdef VE_OPT
     case kDummy:
       break;
@@ -263,6 +342,29 @@ std::string VersionEdit::DebugString() const {
     r.append(f.smallest.DebugString());
     r.append(" .. ");
     r.append(f.largest.DebugString());
+    if (f.has_range_deletions) {
+      r.append(" (range deletions)");
+    }
+    for (uint64_t blob_file : f.blob_files) {
+      r.append(" blob:");
+      AppendNumberTo(&r, blob_file);
+    }
+  }
+  for (const BlobFileMetaData& b : new_blob_files_) {
+    r.append("\n  AddBlobFile: ");
+    AppendNumberTo(&r, b.number);
+    r.append(" ");
+    AppendNumberTo(&r, b.file_size);
+    r.append(" ");
+    AppendNumberTo(&r, b.blob_count);
+  }
+  for (const auto& garbage_kvp : blob_garbage_) {
+    r.append("\n  BlobGarbage: ");
+    AppendNumberTo(&r, garbage_kvp.first);
+    r.append(" ");
+    AppendNumberTo(&r, garbage_kvp.second.first);
+    r.append(" ");
+    AppendNumberTo(&r, garbage_kvp.second.second);
   }
   r.append("\n}\n");
   return r;
@@ -5,6 +5,7 @@
 #ifndef STORAGE_LEVELDB_DB_VERSION_EDIT_H_
 #define STORAGE_LEVELDB_DB_VERSION_EDIT_H_
 
+#include <map>
 #include <set>
 #include <utility>
 #include <vector>
@@ -16,7 +17,11 @@ namespace leveldb {
 class VersionSet;
 
 struct FileMetaData {
-  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) {}
+  FileMetaData()
+      : refs(0),
+        allowed_seeks(1 << 30),
+        file_size(0),
+        has_range_deletions(false) {}
 
   int refs;
   int allowed_seeks;  // Seeks allowed until compaction
@@ -24,6 +29,26 @@ struct FileMetaData {
   uint64_t file_size;    // File size in bytes
   InternalKey smallest;  // Smallest internal key served by table
   InternalKey largest;   // Largest internal key served by table
+  bool has_range_deletions;  // Table has a range deletion block
+  std::vector<uint64_t> blob_files;  // Sorted blob files the table refers to
+};
+
+struct BlobFileMetaData {
+  BlobFileMetaData()
+      : number(0),
+        file_size(0),
+        blob_count(0),
+        garbage_count(0),
+        garbage_bytes(0) {}
+
+  uint64_t number;
+  uint64_t file_size;  // File size in bytes
+  uint64_t blob_count;
+  // The blobs of the file that no table refers to any more, and the size
+  // of their records.  The file is deleted once all of its blobs are
+  // garbage.
+  uint64_t garbage_count;
+  uint64_t garbage_bytes;
 };
 
 class VersionEdit {
@@ -60,16 +85,49 @@ class VersionEdit {
   // Add the specified file at the specified number.
   // REQUIRES: This version has not been saved (see VersionSet::SaveTo)
   // REQUIRES: "smallest" and "largest" are smallest and largest keys in file
+  // (including the bounds of its range deletions, if any)
   void AddFile(int level, uint64_t file, uint64_t file_size,
-               const InternalKey& smallest, const InternalKey& largest) {
+               const InternalKey& smallest, const InternalKey& largest,
+               bool has_range_deletions = false) {
     FileMetaData f;
     f.number = file;
     f.file_size = file_size;
     f.smallest = smallest;
     f.largest = largest;
+    f.has_range_deletions = has_range_deletions;
     new_files_.push_back(std::make_pair(level, f));
   }
 
+  // Same as above, for the table described by "f", which may refer to
+  // blob files.
+  void AddFile(int level, const FileMetaData& f) {
+    FileMetaData copy;
+    copy.number = f.number;
+    copy.file_size = f.file_size;
+    copy.smallest = f.smallest;
+    copy.largest = f.largest;
+    copy.has_range_deletions = f.has_range_deletions;
+    copy.blob_files = f.blob_files;
+    new_files_.push_back(std::make_pair(level, copy));
+  }
+
+  // Add the blob file "file" holding "blob_count" blobs.
+  void AddBlobFile(uint64_t file, uint64_t file_size, uint64_t blob_count) {
+    BlobFileMetaData b;
+    b.number = file;
+    b.file_size = file_size;
+    b.blob_count = blob_count;
+    new_blob_files_.push_back(b);
+  }
+
+  // Record that "count" more blobs of the blob file "file", whose records
+  // take "bytes" bytes, are no longer referred to.
+  void AddBlobGarbage(uint64_t file, uint64_t count, uint64_t bytes) {
+    std::pair<uint64_t, uint64_t>& garbage = blob_garbage_[file];
+    garbage.first += count;
+    garbage.second += bytes;
+  }
+
   // Delete the specified "file" from the specified "level".
   void DeleteFile(int level, uint64_t file) {
     deleted_files_.insert(std::make_pair(level, file));
@@ -99,6 +157,9 @@ class VersionEdit {
   std::vector<std::pair<int, InternalKey>> compact_pointers_;
   DeletedFileSet deleted_files_;
   std::vector<std::pair<int, FileMetaData>> new_files_;
+  std::vector<BlobFileMetaData> new_blob_files_;
+  // Blob file number -> (count, bytes) of its new garbage
+  std::map<uint64_t, std::pair<uint64_t, uint64_t>> blob_garbage_;
 };
 
 }  // namespace leveldb
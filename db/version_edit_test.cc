@@ -28,6 +28,21 @@ TEST(VersionEditTest, EncodeDecode) {
     edit.AddFile(3, kBig + 300 + i, kBig + 400 + i,
                  InternalKey("foo", kBig + 500 + i, kTypeValue),
                  InternalKey("zoo", kBig + 600 + i, kTypeDeletion));
+    edit.AddFile(5, kBig + 800 + i, kBig + 400 + i,
+                 InternalKey("bar", kBig + 500 + i, kTypeRangeDeletion),
+                 InternalKey("car", kMaxSequenceNumber, kTypeRangeDeletion),
+                 true);
+    FileMetaData f;
+    f.number = kBig + 850 + i;
+    f.file_size = kBig + 400 + i;
+    f.smallest = InternalKey("dar", kBig + 500 + i, kTypeBlobIndex);
+    f.largest = InternalKey("ear", kBig + 600 + i, kTypeValue);
+    f.has_range_deletions = (i % 2 == 0);
+    f.blob_files.push_back(kBig + 1100 + i);
+    f.blob_files.push_back(kBig + 1200 + i);
+    edit.AddFile(2, f);
+    edit.AddBlobFile(kBig + 1100 + i, kBig + 1300 + i, 1000 + i);
+    edit.AddBlobGarbage(kBig + 1200 + i, 10 + i, kBig + 1400 + i);
     edit.DeleteFile(4, kBig + 700 + i);
     edit.SetCompactPointer(i, InternalKey("x", kBig + 900 + i, kTypeValue));
   }
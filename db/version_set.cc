@@ -8,12 +8,15 @@
 
 #include <algorithm>
 
+#include "db/blob_file.h"
 #include "db/filename.h"
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "leveldb/env.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table_builder.h"
 #include "table/merger.h"
 #include "table/two_level_iterator.h"
@@ -156,6 +159,104 @@ bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
   return !BeforeFile(ucmp, largest_user_key, files[index]);
 }
 
+// Return the first eight bytes of "key" as a big-endian integer, padded
+// with zeroes.  Prefixes order like the keys under the bytewise
+// comparator, except that keys with equal prefixes need a full
+// comparison.
+static inline uint64_t KeyPrefix(const Slice& key) {
+  const size_t n = std::min<size_t>(key.size(), 8);
+  uint64_t prefix = 0;
+  for (size_t i = 0; i < n; i++) {
+    prefix |= static_cast<uint64_t>(static_cast<uint8_t>(key[i]))
+              << (56 - 8 * i);
+  }
+  return prefix;
+}
+
+void LevelFileIndex::Build(const Comparator* ucmp,
+                           const std::vector<FileMetaData*>& files) {
+  ucmp_ = ucmp;
+  bytewise_ = (ucmp == BytewiseComparator());
+  largest_prefixes_.clear();
+  files_.clear();
+  keys_.clear();
+  largest_prefixes_.reserve(files.size());
+  files_.reserve(files.size());
+  for (FileMetaData* f : files) {
+    const Slice smallest = f->smallest.user_key();
+    const Slice largest = f->largest.user_key();
+    const Slice largest_internal = f->largest.Encode();
+    File entry;
+    entry.smallest_prefix = KeyPrefix(smallest);
+    entry.largest_tag =
+        DecodeFixed64(largest_internal.data() + largest_internal.size() - 8);
+    entry.smallest_offset = keys_.size();
+    entry.smallest_size = smallest.size();
+    keys_.append(smallest.data(), smallest.size());
+    entry.largest_offset = keys_.size();
+    entry.largest_size = largest.size();
+    keys_.append(largest.data(), largest.size());
+    entry.meta = f;
+    largest_prefixes_.push_back(KeyPrefix(largest));
+    files_.push_back(entry);
+  }
+}
+
+inline int LevelFileIndex::Compare(const Slice& a, uint64_t a_prefix,
+                                   const Slice& b, uint64_t b_prefix) const {
+  if (bytewise_) {
+    if (a_prefix != b_prefix) {
+      return (a_prefix < b_prefix) ? -1 : +1;
+    }
+    return a.compare(b);
+  }
+  return ucmp_->Compare(a, b);
+}
+
+inline bool LevelFileIndex::LargestKeyBefore(size_t i, const Slice& user_key,
+                                             uint64_t prefix,
+                                             uint64_t tag) const {
+  const int r = Compare(LargestKey(i), largest_prefixes_[i], user_key, prefix);
+  // Among entries for the same user key, larger tags sort first.
+  return r < 0 || (r == 0 && files_[i].largest_tag > tag);
+}
+
+uint32_t LevelFileIndex::FindFile(const Slice& internal_key) const {
+  const Slice user_key = ExtractUserKey(internal_key);
+  const uint64_t prefix = KeyPrefix(user_key);
+  const uint64_t tag =
+      DecodeFixed64(internal_key.data() + internal_key.size() - 8);
+  uint32_t left = 0;
+  uint32_t right = files_.size();
+  while (left < right) {
+    uint32_t mid = (left + right) / 2;
+    if (LargestKeyBefore(mid, user_key, prefix, tag)) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return right;
+}
+
+bool LevelFileIndex::KeyAfterFile(const Slice& internal_key, size_t i) const {
+  const Slice user_key = ExtractUserKey(internal_key);
+  return LargestKeyBefore(
+      i, user_key, KeyPrefix(user_key),
+      DecodeFixed64(internal_key.data() + internal_key.size() - 8));
+}
+
+bool LevelFileIndex::UserKeyBeforeFile(const Slice& user_key,
+                                       size_t i) const {
+  return Compare(user_key, KeyPrefix(user_key), SmallestKey(i),
+                 files_[i].smallest_prefix) < 0;
+}
+
+bool LevelFileIndex::UserKeyAfterFile(const Slice& user_key, size_t i) const {
+  return Compare(user_key, KeyPrefix(user_key), LargestKey(i),
+                 largest_prefixes_[i]) > 0;
+}
+
 // An internal iterator.  For a given version/level pair, yields
 // information about the files in the level.  For a given entry, key()
 // is the largest key that occurs in the file, and value() is an
@@ -165,24 +266,34 @@ class Version::LevelFileNumIterator : public Iterator {
  public:
   LevelFileNumIterator(const InternalKeyComparator& icmp,
                        const std::vector<FileMetaData*>* flist)
-      : icmp_(icmp), flist_(flist), index_(flist->size()) {  // Marks as invalid
-  }
-  bool Valid() const override { return index_ < flist_->size(); }
+      : LevelFileNumIterator(icmp, flist, 0, flist->size()) {}
+
+  // Only yields the files (*flist)[begin, end).
+  LevelFileNumIterator(const InternalKeyComparator& icmp,
+                       const std::vector<FileMetaData*>* flist,
+                       uint32_t begin, uint32_t end)
+      : icmp_(icmp),
+        flist_(flist),
+        begin_(begin),
+        end_(end),
+        index_(end) {  // Marks as invalid
+    assert(begin_ <= end_ && end_ <= flist_->size());
+  }
+  bool Valid() const override { return index_ < end_; }
   void Seek(const Slice& target) override {
-    index_ = FindFile(icmp_, *flist_, target);
-  }
-  void SeekToFirst() override { index_ = 0; }
-  void SeekToLast() override {
-    index_ = flist_->empty() ? 0 : flist_->size() - 1;
+    index_ = std::min(
+        std::max<uint32_t>(FindFile(icmp_, *flist_, target), begin_), end_);
   }
+  void SeekToFirst() override { index_ = begin_; }
+  void SeekToLast() override { index_ = (begin_ == end_) ? end_ : end_ - 1; }
   void Next() override {
     assert(Valid());
     index_++;
   }
   void Prev() override {
     assert(Valid());
-    if (index_ == 0) {
-      index_ = flist_->size();  // Marks as invalid
+    if (index_ == begin_) {
+      index_ = end_;  // Marks as invalid
     } else {
       index_--;
     }
@@ -202,6 +313,8 @@ class Version::LevelFileNumIterator : public Iterator {
  private:
   const InternalKeyComparator icmp_;
   const std::vector<FileMetaData*>* const flist_;
+  const uint32_t begin_;
+  const uint32_t end_;
   uint32_t index_;
 
   // Backing store for value().  Holds the file number and size.
@@ -221,28 +334,135 @@ static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
 }
 
 Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
-                                            int level) const {
+                                            int level, uint32_t begin,
+                                            uint32_t end) const {
   return NewTwoLevelIterator(
-      new LevelFileNumIterator(vset_->icmp_, &files_[level]), &GetFileIterator,
-      vset_->table_cache_, options);
+      new LevelFileNumIterator(vset_->icmp_, &files_[level], begin, end),
+      &GetFileIterator, vset_->table_cache_, options);
+}
+
+bool Version::FileInIterateBounds(const ReadOptions& options,
+                                  const FileMetaData* f) const {
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  if (options.iterate_lower_bound != nullptr &&
+      ucmp->Compare(f->largest.user_key(), *options.iterate_lower_bound) < 0) {
+    return false;
+  }
+  if (options.iterate_upper_bound != nullptr &&
+      ucmp->Compare(f->smallest.user_key(), *options.iterate_upper_bound) >=
+          0) {
+    return false;
+  }
+  return true;
+}
+
+bool Version::FileMayHavePrefix(const ReadOptions& options, FileMetaData* f,
+                                const Slice& prefix,
+                                const InternalKey& prefix_key) {
+  // The keys with the prefix sort right after the prefix itself.
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  if (ucmp->Compare(f->largest.user_key(), prefix) < 0) {
+    return false;
+  }
+  const SliceTransform* extractor = vset_->options_->prefix_extractor;
+  const Slice smallest = f->smallest.user_key();
+  if (ucmp->Compare(smallest, prefix) > 0 &&
+      !(extractor->InDomain(smallest) &&
+        extractor->Transform(smallest) == prefix)) {
+    return false;
+  }
+  return vset_->table_cache_->PrefixMayMatch(options, f->number, f->file_size,
+                                             prefix_key.Encode());
 }
 
 void Version::AddIterators(const ReadOptions& options,
-                           std::vector<Iterator*>* iters) {
+                           std::vector<Iterator*>* iters,
+                           const Slice* prefix) {
+  InternalKey prefix_key;
+  if (prefix != nullptr) {
+    prefix_key = InternalKey(*prefix, kMaxSequenceNumber, kValueTypeForSeek);
+  }
+
   // Merge all level zero files together since they may overlap
   for (size_t i = 0; i < files_[0].size(); i++) {
-    iters->push_back(vset_->table_cache_->NewIterator(
-        options, files_[0][i]->number, files_[0][i]->file_size));
+    FileMetaData* f = files_[0][i];
+    if (!FileInIterateBounds(options, f)) {
+      continue;
+    }
+    if (prefix == nullptr ||
+        FileMayHavePrefix(options, f, *prefix, prefix_key)) {
+      iters->push_back(
+          vset_->table_cache_->NewIterator(options, f->number, f->file_size));
+    }
   }
 
   // For levels > 0, we can use a concatenating iterator that sequentially
   // walks through the non-overlapping files in the level, opening them
   // lazily.
   for (int level = 1; level < config::kNumLevels; level++) {
-    if (!files_[level].empty()) {
-      iters->push_back(NewConcatenatingIterator(options, level));
+    if (files_[level].empty()) {
+      continue;
+    }
+    const LevelFileIndex& files = file_index_[level];
+    if (prefix != nullptr) {
+      // The keys with the prefix start in the first file that reaches the
+      // prefix.  That file may end on a range deletion clipped at the start
+      // of the next file, so they can also start in the following files
+      // whose smallest key has the prefix.  The level holds none if none of
+      // these files does.
+      const SliceTransform* extractor = vset_->options_->prefix_extractor;
+      uint32_t i = files.FindFile(prefix_key.Encode());
+      while (i < files.size() &&
+             !FileMayHavePrefix(options, files.file(i), *prefix, prefix_key)) {
+        i++;
+        if (i < files.size()) {
+          const Slice smallest = files.file(i)->smallest.user_key();
+          if (!extractor->InDomain(smallest) ||
+              extractor->Transform(smallest) != *prefix) {
+            i = files.size();
+          }
+        }
+      }
+      if (i >= files.size()) {
+        continue;
+      }
+    }
+    // Leave out the files before the lower bound and after the upper bound.
+    uint32_t begin = 0;
+    uint32_t end = files.size();
+    if (options.iterate_lower_bound != nullptr) {
+      InternalKey lower(*options.iterate_lower_bound, kMaxSequenceNumber,
+                        kValueTypeForSeek);
+      begin = files.FindFile(lower.Encode());
+    }
+    if (options.iterate_upper_bound != nullptr) {
+      InternalKey upper(*options.iterate_upper_bound, kMaxSequenceNumber,
+                        kValueTypeForSeek);
+      end = files.FindFile(upper.Encode());
+      if (end < files.size() && FileInIterateBounds(options, files.file(end))) {
+        end++;
+      }
+    }
+    if (begin >= end) {
+      continue;
+    }
+    iters->push_back(NewConcatenatingIterator(options, level, begin, end));
+  }
+}
+
+Status Version::AddRangeDeletions(RangeDelAggregator* aggregator) {
+  Status s;
+  for (int level = 0; level < config::kNumLevels && s.ok(); level++) {
+    for (FileMetaData* f : files_[level]) {
+      if (f->has_range_deletions) {
+        s = aggregator->AddTombstones(
+            vset_->table_cache_->NewRangeDeletionIterator(f->number,
+                                                          f->file_size));
+        if (!s.ok()) break;
+      }
     }
   }
+  return s;
 }
 
 // Callback from TableCache::Get()
@@ -258,6 +478,10 @@ struct Saver {
   const Comparator* ucmp;
   Slice user_key;
   std::string* value;
+  // Sequence number of the newest range deletion seen so far that covers
+  // user_key, or zero.  Older entries count as deleted.
+  SequenceNumber range_del_sequence;
+  bool is_blob_index;  // *value holds a BlobIndex
 };
 }  // namespace
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
@@ -267,9 +491,14 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
     s->state = kCorrupt;
   } else {
     if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
-      s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
+      s->state = ((parsed_key.type == kTypeValue ||
+                   parsed_key.type == kTypeBlobIndex) &&
+                  parsed_key.sequence >= s->range_del_sequence)
+                     ? kFound
+                     : kDeleted;
       if (s->state == kFound) {
         s->value->assign(v.data(), v.size());
+        s->is_blob_index = (parsed_key.type == kTypeBlobIndex);
       }
     }
   }
@@ -279,24 +508,25 @@ static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
   return a->number > b->number;
 }
 
+// Returns true iff the table "f" refers to one of "blob_files".
+static bool RefersToBlobFiles(const FileMetaData* f,
+                              const std::set<uint64_t>& blob_files) {
+  for (uint64_t number : f->blob_files) {
+    if (blob_files.count(number) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
                                  bool (*func)(void*, int, FileMetaData*)) {
-  const Comparator* ucmp = vset_->icmp_.user_comparator();
-
   // Search level-0 in order from newest to oldest.
-  std::vector<FileMetaData*> tmp;
-  tmp.reserve(files_[0].size());
-  for (uint32_t i = 0; i < files_[0].size(); i++) {
-    FileMetaData* f = files_[0][i];
-    if (ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
-        ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
-      tmp.push_back(f);
-    }
-  }
-  if (!tmp.empty()) {
-    std::sort(tmp.begin(), tmp.end(), NewestFirst);
-    for (uint32_t i = 0; i < tmp.size(); i++) {
-      if (!(*func)(arg, 0, tmp[i])) {
+  const LevelFileIndex& level0 = file_index_[0];
+  for (uint32_t i = 0; i < level0.size(); i++) {
+    if (!level0.UserKeyBeforeFile(user_key, i) &&
+        !level0.UserKeyAfterFile(user_key, i)) {
+      if (!(*func)(arg, 0, level0.file(i))) {
         return;
       }
     }
@@ -304,17 +534,16 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
 
   // Search other levels.
   for (int level = 1; level < config::kNumLevels; level++) {
-    size_t num_files = files_[level].size();
-    if (num_files == 0) continue;
+    const LevelFileIndex& files = file_index_[level];
+    if (files.size() == 0) continue;
 
     // Binary search to find earliest index whose largest key >= internal_key.
-    uint32_t index = FindFile(vset_->icmp_, files_[level], internal_key);
-    if (index < num_files) {
-      FileMetaData* f = files_[level][index];
-      if (ucmp->Compare(user_key, f->smallest.user_key()) < 0) {
-        // All of "f" is past any data for user_key
+    uint32_t index = files.FindFile(internal_key);
+    if (index < files.size()) {
+      if (files.UserKeyBeforeFile(user_key, index)) {
+        // All of the file is past any data for user_key
       } else {
-        if (!(*func)(arg, level, f)) {
+        if (!(*func)(arg, level, files.file(index))) {
           return;
         }
       }
@@ -336,12 +565,29 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
     int last_file_read_level;
 
     VersionSet* vset;
+    SequenceNumber snapshot;
     Status s;
     bool found;
 
     static bool Match(void* arg, int level, FileMetaData* f) {
       State* state = reinterpret_cast<State*>(arg);
 
+      if (f->has_range_deletions) {
+        RangeDelAggregator range_deletions(state->saver.ucmp,
+                                           state->snapshot);
+        state->s = range_deletions.AddTombstones(
+            state->vset->table_cache_->NewRangeDeletionIterator(
+                f->number, f->file_size));
+        if (!state->s.ok()) {
+          state->found = true;
+          return false;
+        }
+        Saver* saver = &state->saver;
+        saver->range_del_sequence =
+            std::max(saver->range_del_sequence,
+                     range_deletions.MaxCoveringSequence(saver->user_key));
+      }
+
       if (state->stats->seek_file == nullptr &&
           state->last_file_read != nullptr) {
         // We have had more than one seek for this read.  Charge the 1st file.
@@ -385,15 +631,237 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
   state.options = &options;
   state.ikey = k.internal_key();
   state.vset = vset_;
+  state.snapshot = ExtractSequence(state.ikey);
 
   state.saver.state = kNotFound;
   state.saver.ucmp = vset_->icmp_.user_comparator();
   state.saver.user_key = k.user_key();
   state.saver.value = value;
+  state.saver.range_del_sequence = 0;
+  state.saver.is_blob_index = false;
 
   ForEachOverlapping(state.saver.user_key, state.ikey, &state, &State::Match);
 
-  return state.found ? state.s : Status::NotFound(Slice());
+  if (!state.found) {
+    return Status::NotFound(Slice());
+  }
+  if (state.s.ok() && state.saver.is_blob_index) {
+    state.s = ReadBlobValue(options, state.saver.user_key, value);
+  }
+  return state.s;
+}
+
+void Version::GetBlobFilesToCollect(std::set<uint64_t>* numbers) const {
+  const double ratio = vset_->options_->blob_gc_ratio;
+  for (const auto& blob_file_kvp : blob_files_) {
+    const BlobFileMetaData& b = blob_file_kvp.second;
+    if (b.garbage_bytes > 0 && b.garbage_bytes >= ratio * b.file_size) {
+      numbers->insert(b.number);
+    }
+  }
+}
+
+Status Version::ReadBlobValue(const ReadOptions& options,
+                              const Slice& user_key, std::string* value) {
+  BlobIndex index;
+  if (!index.DecodeFrom(*value)) {
+    return Status::Corruption("bad blob index for ", user_key);
+  }
+  return vset_->table_cache_->ReadBlob(options, user_key, index, value);
+}
+
+void Version::MultiGet(const ReadOptions& options,
+                       const std::vector<Slice>& keys,
+                       const std::vector<std::string*>& values,
+                       std::vector<Status>* statuses,
+                       std::vector<GetStats>* stats) {
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  const size_t n = keys.size();
+  statuses->assign(n, Status::NotFound(Slice()));
+  stats->resize(n);
+
+  struct KeyState {
+    Saver saver;
+    bool done;
+    FileMetaData* last_file_read;
+    int last_file_read_level;
+  };
+
+  struct State {
+    VersionSet* vset;
+    const ReadOptions* options;
+    const std::vector<Slice>* keys;
+    std::vector<Status>* statuses;
+    std::vector<GetStats>* stats;
+    std::vector<KeyState> key_states;
+
+    // Indexes of the keys to look up in the next file, and scratch space
+    // for that lookup.
+    std::vector<size_t> batch;
+    std::vector<Slice> batch_keys;
+    std::vector<void*> batch_args;
+    std::vector<Status> batch_statuses;
+
+    // Look up the keys in "batch" in file "f".
+    void Search(int level, FileMetaData* f) {
+      if (batch.empty()) {
+        return;
+      }
+      if (f->has_range_deletions && !ApplyRangeDeletions(f)) {
+        batch.clear();
+        return;
+      }
+      batch_keys.clear();
+      batch_args.clear();
+      for (size_t i : batch) {
+        KeyState* k = &key_states[i];
+        GetStats* st = &(*stats)[i];
+        if (st->seek_file == nullptr && k->last_file_read != nullptr) {
+          // We have had more than one seek for this read.  Charge the 1st
+          // file.
+          st->seek_file = k->last_file_read;
+          st->seek_file_level = k->last_file_read_level;
+        }
+        k->last_file_read = f;
+        k->last_file_read_level = level;
+        batch_keys.push_back((*keys)[i]);
+        batch_args.push_back(&k->saver);
+      }
+      batch_statuses.resize(batch.size());
+      vset->table_cache_->MultiGet(*options, f->number, f->file_size,
+                                   batch.size(), batch_keys.data(),
+                                   batch_args.data(), batch_statuses.data(),
+                                   SaveValue);
+
+      for (size_t j = 0; j < batch.size(); j++) {
+        const size_t i = batch[j];
+        KeyState* k = &key_states[i];
+        if (!batch_statuses[j].ok()) {
+          (*statuses)[i] = batch_statuses[j];
+          k->done = true;
+          continue;
+        }
+        switch (k->saver.state) {
+          case kNotFound:
+            break;  // Keep searching in other files
+          case kFound:
+            (*statuses)[i] = Status::OK();
+            k->done = true;
+            break;
+          case kDeleted:
+            k->done = true;
+            break;
+          case kCorrupt:
+            (*statuses)[i] =
+                Status::Corruption("corrupted key for ", k->saver.user_key);
+            k->done = true;
+            break;
+        }
+      }
+      batch.clear();
+    }
+
+    // Raises the range_del_sequence of the keys in "batch" to the range
+    // deletions of "f".  On error, finishes the keys and returns false.
+    bool ApplyRangeDeletions(FileMetaData* f) {
+      // All keys are looked up at the same sequence number.
+      RangeDelAggregator range_deletions(key_states[batch[0]].saver.ucmp,
+                                         ExtractSequence((*keys)[batch[0]]));
+      Status s = range_deletions.AddTombstones(
+          vset->table_cache_->NewRangeDeletionIterator(f->number,
+                                                       f->file_size));
+      for (size_t i : batch) {
+        KeyState* k = &key_states[i];
+        if (!s.ok()) {
+          (*statuses)[i] = s;
+          k->done = true;
+        } else {
+          k->saver.range_del_sequence =
+              std::max(k->saver.range_del_sequence,
+                       range_deletions.MaxCoveringSequence(k->saver.user_key));
+        }
+      }
+      return s.ok();
+    }
+  };
+
+  State state;
+  state.vset = vset_;
+  state.options = &options;
+  state.keys = &keys;
+  state.statuses = statuses;
+  state.stats = stats;
+  state.key_states.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    KeyState* k = &state.key_states[i];
+    k->saver.state = kNotFound;
+    k->saver.ucmp = ucmp;
+    k->saver.user_key = ExtractUserKey(keys[i]);
+    k->saver.value = values[i];
+    k->saver.range_del_sequence = 0;
+    k->saver.is_blob_index = false;
+    k->done = false;
+    k->last_file_read = nullptr;
+    k->last_file_read_level = -1;
+    (*stats)[i].seek_file = nullptr;
+    (*stats)[i].seek_file_level = -1;
+  }
+
+  // Search level-0 in order from newest to oldest.
+  const LevelFileIndex& level0 = file_index_[0];
+  for (uint32_t f = 0; f < level0.size(); f++) {
+    for (size_t i = 0; i < n; i++) {
+      const Slice& user_key = state.key_states[i].saver.user_key;
+      if (!state.key_states[i].done && !level0.UserKeyBeforeFile(user_key, f) &&
+          !level0.UserKeyAfterFile(user_key, f)) {
+        state.batch.push_back(i);
+      }
+    }
+    state.Search(0, level0.file(f));
+  }
+
+  // Search other levels.  Since the keys are sorted, consecutive keys
+  // often fall into the same file, which then needs to be found only
+  // once.
+  for (int level = 1; level < config::kNumLevels; level++) {
+    const LevelFileIndex& files = file_index_[level];
+    if (files.size() == 0) continue;
+
+    uint32_t index = 0;
+    FileMetaData* batch_file = nullptr;
+    for (size_t i = 0; i < n; i++) {
+      if (state.key_states[i].done) continue;
+      if (batch_file == nullptr || files.KeyAfterFile(keys[i], index)) {
+        // Find earliest index whose largest key >= keys[i].
+        index = files.FindFile(keys[i]);
+        if (index >= files.size()) {
+          break;  // This key and all later keys lie past the last file
+        }
+      }
+      FileMetaData* f = files.file(index);
+      if (files.UserKeyBeforeFile(state.key_states[i].saver.user_key, index)) {
+        // All of "f" is past any data for this key
+        continue;
+      }
+      if (f != batch_file) {
+        if (batch_file != nullptr) {
+          state.Search(level, batch_file);
+        }
+        batch_file = f;
+      }
+      state.batch.push_back(i);
+    }
+    if (batch_file != nullptr) {
+      state.Search(level, batch_file);
+    }
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    const Saver& saver = state.key_states[i].saver;
+    if (saver.is_blob_index && (*statuses)[i].ok()) {
+      (*statuses)[i] = ReadBlobValue(options, saver.user_key, values[i]);
+    }
+  }
 }
 
 bool Version::UpdateStats(const GetStats& stats) {
@@ -505,6 +973,25 @@ void Version::GetOverlappingInputs(int level, const InternalKey* begin,
   if (end != nullptr) {
     user_end = end->user_key();
   }
+  if (level > 0) {
+    // Files in the level are sorted and disjoint, so the overlapping files
+    // are consecutive.
+    const LevelFileIndex& files = file_index_[level];
+    uint32_t i = 0;
+    if (begin != nullptr) {
+      InternalKey small_key(user_begin, kMaxSequenceNumber,
+                            kValueTypeForSeek);
+      i = files.FindFile(small_key.Encode());
+    }
+    for (; i < files.size(); i++) {
+      if (end != nullptr && files.UserKeyBeforeFile(user_end, i)) {
+        break;
+      }
+      inputs->push_back(files.file(i));
+    }
+    return;
+  }
+
   const Comparator* user_cmp = vset_->icmp_.user_comparator();
   for (size_t i = 0; i < files_[level].size();) {
     FileMetaData* f = files_[level][i++];
@@ -534,6 +1021,48 @@ void Version::GetOverlappingInputs(int level, const InternalKey* begin,
   }
 }
 
+void Version::GetFilesInRange(
+    const Slice& begin, const Slice& end,
+    std::vector<FileMetaData*> inputs[config::kNumLevels]) {
+  const Comparator* user_cmp = vset_->icmp_.user_comparator();
+  const InternalKey begin_key(begin, kMaxSequenceNumber, kValueTypeForSeek);
+  const InternalKey end_key(end, kMaxSequenceNumber, kValueTypeForSeek);
+
+  // Visit the files that overlap the range from the oldest to the newest:
+  // the deepest level first, and level-0 files in the order they were
+  // written.  Keep every file that sticks out of the range or overlaps an
+  // older file that is kept.
+  std::vector<FileMetaData*> kept;
+  for (int level = config::kNumLevels - 1; level >= 0; level--) {
+    inputs[level].clear();
+    std::vector<FileMetaData*> files;
+    GetOverlappingInputs(level, &begin_key, &end_key, &files);
+    if (level == 0) {
+      std::sort(files.begin(), files.end(),
+                [](const FileMetaData* a, const FileMetaData* b) {
+                  return a->number < b->number;
+                });
+    }
+    for (FileMetaData* f : files) {
+      const Slice file_start = f->smallest.user_key();
+      const Slice file_limit = f->largest.user_key();
+      bool remove = user_cmp->Compare(file_start, begin) >= 0 &&
+                    user_cmp->Compare(file_limit, end) < 0;
+      for (size_t i = 0; remove && i < kept.size(); i++) {
+        if (user_cmp->Compare(kept[i]->largest.user_key(), file_start) >= 0 &&
+            user_cmp->Compare(kept[i]->smallest.user_key(), file_limit) <= 0) {
+          remove = false;
+        }
+      }
+      if (remove) {
+        inputs[level].push_back(f);
+      } else {
+        kept.push_back(f);
+      }
+    }
+  }
+}
+
 std::string Version::DebugString() const {
   std::string r;
   for (int level = 0; level < config::kNumLevels; level++) {
@@ -557,6 +1086,24 @@ std::string Version::DebugString() const {
       r.append("]\n");
     }
   }
+  if (!blob_files_.empty()) {
+    // E.g.,
+    //   --- blob files ---
+    //   21:40960[10 blobs, 4 garbage]
+    r.append("--- blob files ---\n");
+    for (const auto& blob_file_kvp : blob_files_) {
+      const BlobFileMetaData& b = blob_file_kvp.second;
+      r.push_back(' ');
+      AppendNumberTo(&r, b.number);
+      r.push_back(':');
+      AppendNumberTo(&r, b.file_size);
+      r.append("[");
+      AppendNumberTo(&r, b.blob_count);
+      r.append(" blobs, ");
+      AppendNumberTo(&r, b.garbage_count);
+      r.append(" garbage]\n");
+    }
+  }
   return r;
 }
 
@@ -589,10 +1136,12 @@ class VersionSet::Builder {
   VersionSet* vset_;
   Version* base_;
   LevelState levels_[config::kNumLevels];
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
 
  public:
   // Initialize a builder with the files from *base and other info from *vset
-  Builder(VersionSet* vset, Version* base) : vset_(vset), base_(base) {
+  Builder(VersionSet* vset, Version* base)
+      : vset_(vset), base_(base), blob_files_(base->blob_files_) {
     base_->Ref();
     BySmallestKey cmp;
     cmp.internal_comparator = &vset_->icmp_;
@@ -663,10 +1212,30 @@ class VersionSet::Builder {
       levels_[level].deleted_files.erase(f->number);
       levels_[level].added_files->insert(f);
     }
+
+    // Add new blob files and account for their garbage
+    for (const BlobFileMetaData& b : edit->new_blob_files_) {
+      blob_files_[b.number] = b;
+    }
+    for (const auto& garbage_kvp : edit->blob_garbage_) {
+      auto it = blob_files_.find(garbage_kvp.first);
+      if (it != blob_files_.end()) {
+        it->second.garbage_count += garbage_kvp.second.first;
+        it->second.garbage_bytes += garbage_kvp.second.second;
+      }
+    }
   }
 
   // Save the current state in *v.
   void SaveTo(Version* v) {
+    // Drop the blob files that no table refers to any more
+    for (const auto& blob_file_kvp : blob_files_) {
+      const BlobFileMetaData& b = blob_file_kvp.second;
+      if (b.garbage_count < b.blob_count) {
+        v->blob_files_.insert(blob_file_kvp);
+      }
+    }
+
     BySmallestKey cmp;
     cmp.internal_comparator = &vset_->icmp_;
     for (int level = 0; level < config::kNumLevels; level++) {
@@ -784,7 +1353,7 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
   }
 
   edit->SetNextFile(next_file_number_);
-  edit->SetLastSequence(last_sequence_);
+  edit->SetLastSequence(LastSequence());
 
   Version* v = new Version(this);
   {
@@ -968,7 +1537,7 @@ Status VersionSet::Recover(bool* save_manifest) {
     AppendVersion(v);
     manifest_file_number_ = next_file;
     next_file_number_ = next_file + 1;
-    last_sequence_ = last_sequence;
+    SetLastSequence(last_sequence);
     log_number_ = log_number;
     prev_log_number_ = prev_log_number;
 
@@ -1021,9 +1590,19 @@ void VersionSet::MarkFileNumberUsed(uint64_t number) {
 }
 
 void VersionSet::Finalize(Version* v) {
+  // Index the files for lookups
+  const Comparator* ucmp = icmp_.user_comparator();
+  std::vector<FileMetaData*> level0(v->files_[0]);
+  std::sort(level0.begin(), level0.end(), NewestFirst);
+  v->file_index_[0].Build(ucmp, level0);
+  for (int level = 1; level < config::kNumLevels; level++) {
+    v->file_index_[level].Build(ucmp, v->files_[level]);
+  }
+
   // Precomputed best level for next compaction
   int best_level = -1;
   double best_score = -1;
+  uint64_t pending_bytes = 0;
 
   for (int level = 0; level < config::kNumLevels - 1; level++) {
     double score;
@@ -1041,11 +1620,17 @@ void VersionSet::Finalize(Version* v) {
       // overwrites/deletions).
       score = v->files_[level].size() /
               static_cast<double>(config::kL0_CompactionTrigger);
+      if (score >= 1) {
+        pending_bytes += TotalFileSize(v->files_[level]);
+      }
     } else {
       // Compute the ratio of current size to size limit.
       const uint64_t level_bytes = TotalFileSize(v->files_[level]);
-      score =
-          static_cast<double>(level_bytes) / MaxBytesForLevel(options_, level);
+      const double max_bytes = MaxBytesForLevel(options_, level);
+      score = static_cast<double>(level_bytes) / max_bytes;
+      if (level_bytes > max_bytes) {
+        pending_bytes += level_bytes - static_cast<uint64_t>(max_bytes);
+      }
     }
 
     if (score > best_score) {
@@ -1056,6 +1641,26 @@ void VersionSet::Finalize(Version* v) {
 
   v->compaction_level_ = best_level;
   v->compaction_score_ = best_score;
+  v->pending_compaction_bytes_ = pending_bytes;
+
+  // Pick a table that refers to a blob file that is mostly garbage, so
+  // that compacting it moves its blobs out of that file.  Tables in the
+  // last level cannot be compacted and are left alone.
+  v->blob_gc_file_ = nullptr;
+  v->blob_gc_level_ = -1;
+  std::set<uint64_t> blob_files;
+  v->GetBlobFilesToCollect(&blob_files);
+  for (int level = 0;
+       level < config::kNumLevels - 1 && v->blob_gc_file_ == nullptr;
+       level++) {
+    for (FileMetaData* f : v->files_[level]) {
+      if (RefersToBlobFiles(f, blob_files)) {
+        v->blob_gc_file_ = f;
+        v->blob_gc_level_ = level;
+        break;
+      }
+    }
+  }
 }
 
 Status VersionSet::WriteSnapshot(log::Writer* log) {
@@ -1078,8 +1683,16 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
   for (int level = 0; level < config::kNumLevels; level++) {
     const std::vector<FileMetaData*>& files = current_->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
-      const FileMetaData* f = files[i];
-      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+      edit.AddFile(level, *files[i]);
+    }
+  }
+
+  // Save blob files
+  for (const auto& blob_file_kvp : current_->blob_files_) {
+    const BlobFileMetaData& b = blob_file_kvp.second;
+    edit.AddBlobFile(b.number, b.file_size, b.blob_count);
+    if (b.garbage_count > 0) {
+      edit.AddBlobGarbage(b.number, b.garbage_count, b.garbage_bytes);
     }
   }
 
@@ -1144,8 +1757,12 @@ void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
       const std::vector<FileMetaData*>& files = v->files_[level];
       for (size_t i = 0; i < files.size(); i++) {
         live->insert(files[i]->number);
+        live->insert(files[i]->blob_files.begin(), files[i]->blob_files.end());
       }
     }
+    for (const auto& blob_file_kvp : v->blob_files_) {
+      live->insert(blob_file_kvp.first);
+    }
   }
 }
 
@@ -1211,6 +1828,7 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
   ReadOptions options;
   options.verify_checksums = options_->paranoid_checks;
   options.fill_cache = false;
+  options.readahead_size = options_->compaction_readahead_size;
 
   // Level-0 files have to be merged together.  For other levels,
   // we will make a concatenating iterator per level.
@@ -1271,12 +1889,17 @@ Compaction* VersionSet::PickCompaction() {
     level = current_->file_to_compact_level_;
     c = new Compaction(options_, level);
     c->inputs_[0].push_back(current_->file_to_compact_);
+  } else if (current_->blob_gc_file_ != nullptr) {
+    level = current_->blob_gc_level_;
+    c = new Compaction(options_, level);
+    c->inputs_[0].push_back(current_->blob_gc_file_);
   } else {
     return nullptr;
   }
 
   c->input_version_ = current_;
   c->input_version_->Ref();
+  current_->GetBlobFilesToCollect(&c->blob_files_to_collect_);
 
   // Files in level 0 may overlap each other, so pick up all overlapping ones
   if (level == 0) {
@@ -1462,6 +2085,7 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
   Compaction* c = new Compaction(options_, level);
   c->input_version_ = current_;
   c->input_version_->Ref();
+  current_->GetBlobFilesToCollect(&c->blob_files_to_collect_);
   c->inputs_[0] = inputs;
   SetupOtherInputs(c);
   return c;
@@ -1489,10 +2113,12 @@ bool Compaction::IsTrivialMove() const {
   const VersionSet* vset = input_version_->vset_;
   // Avoid a move if there is lots of overlapping grandparent data.
   // Otherwise, the move could create a parent file that will require
-  // a very expensive merge later on.
+  // a very expensive merge later on.  Also rewrite files that refer to
+  // blob files to collect.
   return (num_input_files(0) == 1 && num_input_files(1) == 0 &&
           TotalFileSize(grandparents_) <=
-              MaxGrandParentOverlapBytes(vset->options_));
+              MaxGrandParentOverlapBytes(vset->options_) &&
+          !RefersToBlobFiles(inputs_[0][0], blob_files_to_collect_));
 }
 
 void Compaction::AddInputDeletions(VersionEdit* edit) {
@@ -1501,6 +2127,26 @@ void Compaction::AddInputDeletions(VersionEdit* edit) {
       edit->DeleteFile(level_ + which, inputs_[which][i]->number);
     }
   }
+  for (size_t i = 0; i < hidden_inputs_.size(); i++) {
+    edit->DeleteFile(level_ + 1, hidden_inputs_[i]->number);
+  }
+}
+
+void Compaction::DropHiddenInputs(RangeDelAggregator* range_deletions) {
+  if (range_deletions->empty()) {
+    return;
+  }
+  std::vector<FileMetaData*> kept;
+  for (FileMetaData* f : inputs_[1]) {
+    if (!f->has_range_deletions &&
+        range_deletions->MinCoveringSequence(f->smallest.user_key(),
+                                             f->largest.user_key()) != 0) {
+      hidden_inputs_.push_back(f);
+    } else {
+      kept.push_back(f);
+    }
+  }
+  inputs_[1].swap(kept);
 }
 
 bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
@@ -1524,6 +2170,15 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
   return true;
 }
 
+bool Compaction::IsBaseLevelForRange(const Slice& begin, const Slice& end) {
+  for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
+    if (input_version_->OverlapInLevel(lvl, &begin, &end)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool Compaction::ShouldStopBefore(const Slice& internal_key) {
   const VersionSet* vset = input_version_->vset_;
   // Scan to find earliest grandparent file that contains key.
@@ -15,6 +15,7 @@
 #ifndef STORAGE_LEVELDB_DB_VERSION_SET_H_
 #define STORAGE_LEVELDB_DB_VERSION_SET_H_
 
+#include <atomic>
 #include <map>
 #include <set>
 #include <vector>
@@ -33,6 +34,7 @@ class Writer;
 class Compaction;
 class Iterator;
 class MemTable;
+class RangeDelAggregator;
 class TableBuilder;
 class TableCache;
 class Version;
@@ -57,6 +59,77 @@ bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
                            const Slice* smallest_user_key,
                            const Slice* largest_user_key);
 
+// A flat copy of the key ranges of the files in one level.  The user keys
+// of the file boundaries are stored inline in one buffer, so searching
+// the index neither dereferences FileMetaData objects nor decodes
+// InternalKeys.  With the bytewise comparator, most probes only compare
+// the first eight bytes of the keys as integers.
+class LevelFileIndex {
+ public:
+  LevelFileIndex() : ucmp_(nullptr), bytewise_(false) {}
+
+  LevelFileIndex(const LevelFileIndex&) = delete;
+  LevelFileIndex& operator=(const LevelFileIndex&) = delete;
+
+  // Index "files" in the given order, replacing the previous contents.
+  // The files must outlive the index.
+  void Build(const Comparator* ucmp, const std::vector<FileMetaData*>& files);
+
+  size_t size() const { return files_.size(); }
+  FileMetaData* file(size_t i) const { return files_[i].meta; }
+
+  // Return the smallest index i such that the largest key of file i is
+  // >= internal_key, or size() if there is no such file.
+  // REQUIRES: The indexed files are sorted and do not overlap.
+  uint32_t FindFile(const Slice& internal_key) const;
+
+  // Returns true iff the largest key of file i is < internal_key.
+  bool KeyAfterFile(const Slice& internal_key, size_t i) const;
+
+  // Returns true iff user_key is before the smallest (after the largest)
+  // user key of file i.
+  bool UserKeyBeforeFile(const Slice& user_key, size_t i) const;
+  bool UserKeyAfterFile(const Slice& user_key, size_t i) const;
+
+ private:
+  struct File {
+    uint64_t smallest_prefix;
+    uint64_t largest_tag;  // Sequence number and type of the largest key
+    uint32_t smallest_offset;  // Offsets of the user keys in keys_
+    uint32_t smallest_size;
+    uint32_t largest_offset;
+    uint32_t largest_size;
+    FileMetaData* meta;
+  };
+
+  Slice SmallestKey(size_t i) const {
+    return Slice(keys_.data() + files_[i].smallest_offset,
+                 files_[i].smallest_size);
+  }
+  Slice LargestKey(size_t i) const {
+    return Slice(keys_.data() + files_[i].largest_offset,
+                 files_[i].largest_size);
+  }
+
+  // Compare user keys whose prefixes (see KeyPrefix()) are given.
+  int Compare(const Slice& a, uint64_t a_prefix, const Slice& b,
+              uint64_t b_prefix) const;
+
+  // Returns true iff the largest key of file i is before the internal key
+  // made of "user_key" and "tag".
+  bool LargestKeyBefore(size_t i, const Slice& user_key, uint64_t prefix,
+                        uint64_t tag) const;
+
+  const Comparator* ucmp_;
+  bool bytewise_;  // Whether key prefixes decide most comparisons
+
+  // The prefixes of the largest keys, kept apart from files_ so that a
+  // binary search over them touches as few cache lines as possible.
+  std::vector<uint64_t> largest_prefixes_;
+  std::vector<File> files_;
+  std::string keys_;
+};
+
 class Version {
  public:
   // Lookup the value for key.  If found, store it in *val and
@@ -68,13 +141,29 @@ class Version {
   };
 
   // Append to *iters a sequence of iterators that will
-  // yield the contents of this Version when merged together.
+  // yield the contents of this Version when merged together.  If "prefix"
+  // is non-null, leaves out the files whose filters show that they hold
+  // no user key with that prefix (see Options::prefix_extractor).  Also
+  // leaves out the files outside the iterate bounds of the options.
   // REQUIRES: This version has been saved (see VersionSet::SaveTo)
-  void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
+  void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters,
+                    const Slice* prefix = nullptr);
+
+  // Add the range deletions of all files of this Version to *aggregator.
+  Status AddRangeDeletions(RangeDelAggregator* aggregator);
 
   Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
              GetStats* stats);
 
+  // Look up each of "keys", which are internal keys sorted in increasing
+  // order, as if by Get().  Stores the value found for keys[i] in
+  // *values[i], the status of its lookup in (*statuses)[i], and the
+  // files it read in (*stats)[i].  Keys that fall into the same file are
+  // looked up together.
+  void MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                const std::vector<std::string*>& values,
+                std::vector<Status>* statuses, std::vector<GetStats>* stats);
+
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
   // REQUIRES: lock is held
@@ -97,6 +186,13 @@ class Version {
       const InternalKey* end,    // nullptr means after all keys
       std::vector<FileMetaData*>* inputs);
 
+  // Stores in "inputs[level]" the files of each level whose keys all lie
+  // in the user key range [begin, end).  A file is left out if it overlaps
+  // an older file that is left out, in a deeper level or in level 0, since
+  // removing it would bring back the older entries it hides.
+  void GetFilesInRange(const Slice& begin, const Slice& end,
+                       std::vector<FileMetaData*> inputs[config::kNumLevels]);
+
   // Returns true iff some file in the specified level overlaps
   // some part of [*smallest_user_key,*largest_user_key].
   // smallest_user_key==nullptr represents a key smaller than all the DB's keys.
@@ -111,6 +207,10 @@ class Version {
 
   int NumFiles(int level) const { return files_[level].size(); }
 
+  // Stores in *numbers the blob files of which at least
+  // Options::blob_gc_ratio of the bytes are garbage.
+  void GetBlobFilesToCollect(std::set<uint64_t>* numbers) const;
+
   // Return a human readable string that describes this version's contents.
   std::string DebugString() const;
 
@@ -127,15 +227,36 @@ class Version {
         refs_(0),
         file_to_compact_(nullptr),
         file_to_compact_level_(-1),
+        blob_gc_file_(nullptr),
+        blob_gc_level_(-1),
         compaction_score_(-1),
-        compaction_level_(-1) {}
+        compaction_level_(-1),
+        pending_compaction_bytes_(0) {}
 
   Version(const Version&) = delete;
   Version& operator=(const Version&) = delete;
 
   ~Version();
 
-  Iterator* NewConcatenatingIterator(const ReadOptions&, int level) const;
+  // Returns an iterator over the files [begin, end) of "level", which
+  // opens the files lazily.
+  Iterator* NewConcatenatingIterator(const ReadOptions&, int level,
+                                     uint32_t begin, uint32_t end) const;
+
+  // Returns false if "f" holds no user key within the iterate bounds of
+  // "options" (see ReadOptions::iterate_lower_bound).
+  bool FileInIterateBounds(const ReadOptions& options,
+                           const FileMetaData* f) const;
+
+  // Returns false if "f" holds no user key with "prefix".  "prefix_key" is
+  // the smallest internal key with the user key "prefix".
+  bool FileMayHavePrefix(const ReadOptions& options, FileMetaData* f,
+                         const Slice& prefix, const InternalKey& prefix_key);
+
+  // Replaces *value, the BlobIndex found for "user_key", by the value it
+  // refers to.
+  Status ReadBlobValue(const ReadOptions& options, const Slice& user_key,
+                       std::string* value);
 
   // Call func(arg, level, f) for every file that overlaps user_key in
   // order from newest to oldest.  If an invocation of func returns
@@ -153,15 +274,31 @@ class Version {
   // List of files per level
   std::vector<FileMetaData*> files_[config::kNumLevels];
 
+  // Index of files_ per level for lookups, built by Finalize().  Level-0
+  // files are indexed from newest to oldest.
+  LevelFileIndex file_index_[config::kNumLevels];
+
   // Next file to compact based on seek stats.
   FileMetaData* file_to_compact_;
   int file_to_compact_level_;
 
+  // Live blob files by number
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
+
+  // Next file to compact to move blobs out of blob files that are mostly
+  // garbage.  Initialized by Finalize().
+  FileMetaData* blob_gc_file_;
+  int blob_gc_level_;
+
   // Level that should be compacted next and its compaction score.
   // Score < 1 means compaction is not strictly needed.  These fields
   // are initialized by Finalize().
   double compaction_score_;
   int compaction_level_;
+
+  // Estimate of the bytes that compactions have to rewrite to bring every
+  // level within its limit.  Initialized by Finalize().
+  uint64_t pending_compaction_bytes_;
 };
 
 class VersionSet {
@@ -208,13 +345,22 @@ class VersionSet {
   // Return the combined file size of all files at the specified level.
   int64_t NumLevelBytes(int level) const;
 
-  // Return the last sequence number.
-  uint64_t LastSequence() const { return last_sequence_; }
+  // Return an estimate of the bytes that compactions have to rewrite
+  // before no level needs a compaction any more.
+  uint64_t PendingCompactionBytes() const {
+    return current_->pending_compaction_bytes_;
+  }
+
+  // Return the last sequence number.  May be called without holding the
+  // DB mutex.
+  uint64_t LastSequence() const {
+    return last_sequence_.load(std::memory_order_acquire);
+  }
 
   // Set the last sequence number to s.
   void SetLastSequence(uint64_t s) {
-    assert(s >= last_sequence_);
-    last_sequence_ = s;
+    assert(s >= LastSequence());
+    last_sequence_.store(s, std::memory_order_release);
   }
 
   // Mark the specified file number as used.
@@ -251,7 +397,8 @@ class VersionSet {
   // Returns true iff some level needs a compaction.
   bool NeedsCompaction() const {
     Version* v = current_;
-    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr);
+    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr) ||
+           (v->blob_gc_file_ != nullptr);
   }
 
   // Add all files listed in any live version to *live.
@@ -300,7 +447,7 @@ class VersionSet {
   const InternalKeyComparator icmp_;
   uint64_t next_file_number_;
   uint64_t manifest_file_number_;
-  uint64_t last_sequence_;
+  std::atomic<uint64_t> last_sequence_;
   uint64_t log_number_;
   uint64_t prev_log_number_;  // 0 or backing store for memtable being compacted
 
@@ -344,11 +491,34 @@ class Compaction {
   // Add all inputs to this compaction as delete operations to *edit.
   void AddInputDeletions(VersionEdit* edit);
 
+  // Removes from the "level+1" inputs the files whose whole key range is
+  // covered by the range deletions in *range_deletions, which must come
+  // from the "level" inputs and be visible to every snapshot.  Since the
+  // entries of "level+1" are older than those range deletions, these files
+  // are deleted without being read.  Files with range deletions of their
+  // own are kept.
+  void DropHiddenInputs(RangeDelAggregator* range_deletions);
+
+  // Number of files removed by DropHiddenInputs().
+  int num_hidden_files() const { return hidden_inputs_.size(); }
+
+  // Return the ith file removed by DropHiddenInputs().
+  FileMetaData* hidden_input(int i) const { return hidden_inputs_[i]; }
+
+  // Blob files whose blobs the compaction moves to new blob files (see
+  // Version::GetBlobFilesToCollect()).
+  const std::set<uint64_t>& blob_files_to_collect() const {
+    return blob_files_to_collect_;
+  }
+
   // Returns true if the information we have available guarantees that
   // the compaction is producing data in "level+1" for which no data exists
   // in levels greater than "level+1".
   bool IsBaseLevelForKey(const Slice& user_key);
 
+  // Like IsBaseLevelForKey(), for all user keys in [begin, end].
+  bool IsBaseLevelForRange(const Slice& begin, const Slice& end);
+
   // Returns true iff we should stop building the current output
   // before processing "internal_key".
   bool ShouldStopBefore(const Slice& internal_key);
@@ -371,6 +541,11 @@ class Compaction {
   // Each compaction reads inputs from "level_" and "level_+1"
   std::vector<FileMetaData*> inputs_[2];  // The two sets of inputs
 
+  // Files of "level_+1" that are deleted without being read
+  std::vector<FileMetaData*> hidden_inputs_;
+
+  std::set<uint64_t> blob_files_to_collect_;
+
   // State used to check for number of overlapping grandparent files
   // (parent == level_ + 1, grandparent == level_ + 2)
   std::vector<FileMetaData*> grandparents_;
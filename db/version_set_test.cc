@@ -32,7 +32,11 @@ class FindFileTest {
   int Find(const char* key) {
     InternalKey target(key, 100, kTypeValue);
     InternalKeyComparator cmp(BytewiseComparator());
-    return FindFile(cmp, files_, target.Encode());
+    int result = FindFile(cmp, files_, target.Encode());
+    LevelFileIndex index;
+    index.Build(BytewiseComparator(), files_);
+    ASSERT_EQ(result, index.FindFile(target.Encode()));
+    return result;
   }
 
   bool Overlaps(const char* smallest, const char* largest) {
@@ -173,6 +177,74 @@ TEST(FindFileTest, OverlappingFiles) {
   ASSERT_TRUE(Overlaps("600", "700"));
 }
 
+namespace {
+
+// Orders like the bytewise comparator, but is not recognized as such by
+// LevelFileIndex.
+class WrappedBytewiseComparator : public Comparator {
+ public:
+  const char* Name() const override { return "test.WrappedBytewise"; }
+  int Compare(const Slice& a, const Slice& b) const override {
+    return BytewiseComparator()->Compare(a, b);
+  }
+  void FindShortestSeparator(std::string* start,
+                             const Slice& limit) const override {}
+  void FindShortSuccessor(std::string* key) const override {}
+};
+
+}  // namespace
+
+// Compare LevelFileIndex against FindFile() and direct comparisons for
+// keys that share long prefixes and files that split a user key.
+TEST(FindFileTest, LevelFileIndex) {
+  WrappedBytewiseComparator wrapped;
+  const Comparator* ucmps[] = {BytewiseComparator(), &wrapped};
+  Random rnd(301);
+  for (const Comparator* ucmp : ucmps) {
+    InternalKeyComparator icmp(ucmp);
+    std::vector<FileMetaData*> files;
+    char buf[40];
+    for (int i = 0; i < 50; i++) {
+      FileMetaData* f = new FileMetaData;
+      f->number = i + 1;
+      snprintf(buf, sizeof(buf), "common.prefix.%04d", 2 * i);
+      f->smallest = InternalKey(buf, 100, kTypeValue);
+      // Every other file ends with the user key the next file starts with.
+      snprintf(buf, sizeof(buf), "common.prefix.%04d", 2 * i + 1 + i % 2);
+      f->largest = InternalKey(buf, (i % 2) ? 200 : 100, kTypeValue);
+      files.push_back(f);
+    }
+    LevelFileIndex index;
+    index.Build(ucmp, files);
+    ASSERT_EQ(files.size(), index.size());
+
+    for (int i = 0; i < 1000; i++) {
+      const int k = rnd.Uniform(110);
+      if (rnd.OneIn(3)) {
+        snprintf(buf, sizeof(buf), "common.%d", k);
+      } else {
+        snprintf(buf, sizeof(buf), "common.prefix.%04d", k);
+      }
+      const Slice user_key(buf);
+      InternalKey target(user_key, rnd.Uniform(300), kTypeValue);
+      ASSERT_EQ(FindFile(icmp, files, target.Encode()),
+                index.FindFile(target.Encode()));
+      for (size_t j = 0; j < files.size(); j++) {
+        ASSERT_EQ(icmp.Compare(files[j]->largest, target) < 0,
+                  index.KeyAfterFile(target.Encode(), j));
+        ASSERT_EQ(ucmp->Compare(user_key, files[j]->smallest.user_key()) < 0,
+                  index.UserKeyBeforeFile(user_key, j));
+        ASSERT_EQ(ucmp->Compare(user_key, files[j]->largest.user_key()) > 0,
+                  index.UserKeyAfterFile(user_key, j));
+        ASSERT_EQ(files[j], index.file(j));
+      }
+    }
+    for (FileMetaData* f : files) {
+      delete f;
+    }
+  }
+}
+
 void AddBoundaryInputs(const InternalKeyComparator& icmp,
                        const std::vector<FileMetaData*>& level_files,
                        std::vector<FileMetaData*>* compaction_files);
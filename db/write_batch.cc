@@ -8,10 +8,15 @@
 //    data: record[count]
 // record :=
 //    kTypeValue varstring varstring         |
-//    kTypeDeletion varstring
+//    kTypeDeletion varstring                |
+//    kTypeRangeDeletion varstring varstring
 // varstring :=
 //    len: varint32
 //    data: uint8[len]
+//
+// The data of a value added with Put(const SliceParts&, const SliceParts&)
+// is not stored in rep_.  Instead, refs_ holds the parts of that data and
+// ref_offsets_ the offset in rep_ (just after "len") at which they belong.
 
 #include "leveldb/write_batch.h"
 
@@ -33,12 +38,26 @@ WriteBatch::~WriteBatch() = default;
 
 WriteBatch::Handler::~Handler() = default;
 
+void WriteBatch::Handler::PutParts(const Slice& key, const SliceParts& value) {
+  std::string buf;
+  for (int i = 0; i < value.num_parts; i++) {
+    buf.append(value.parts[i].data(), value.parts[i].size());
+  }
+  Put(key, buf);
+}
+
+void WriteBatch::Handler::DeleteRange(const Slice& begin, const Slice& end) {}
+
 void WriteBatch::Clear() {
   rep_.clear();
   rep_.resize(kHeader);
+  ref_offsets_.clear();
+  refs_.clear();
 }
 
-size_t WriteBatch::ApproximateSize() const { return rep_.size(); }
+size_t WriteBatch::ApproximateSize() const {
+  return WriteBatchInternal::ByteSize(this);
+}
 
 Status WriteBatch::Iterate(Handler* handler) const {
   Slice input(rep_);
@@ -48,20 +67,46 @@ Status WriteBatch::Iterate(Handler* handler) const {
 
   input.remove_prefix(kHeader);
   Slice key, value;
+  uint32_t value_length;
+  size_t ref = 0;  // Index of the next value held by refs_
   int found = 0;
   while (!input.empty()) {
     found++;
     char tag = input[0];
     input.remove_prefix(1);
     switch (tag) {
-      case kTypeValue:
-        if (GetLengthPrefixedSlice(&input, &key) &&
-            GetLengthPrefixedSlice(&input, &value)) {
+      case kTypeValue: {
+        if (!GetLengthPrefixedSlice(&input, &key) ||
+            !GetVarint32(&input, &value_length)) {
+          return Status::Corruption("bad WriteBatch Put");
+        }
+        const size_t offset = input.data() - rep_.data();
+        if (ref < refs_.size() && ref_offsets_[ref] == offset) {
+          // The value is held by one or more references.
+          const size_t first = ref;
+          size_t length = 0;
+          while (ref < refs_.size() && ref_offsets_[ref] == offset) {
+            length += refs_[ref].size();
+            ref++;
+          }
+          if (length != value_length) {
+            return Status::Corruption("bad WriteBatch Put");
+          }
+          if (ref - first == 1) {
+            handler->Put(key, refs_[first]);
+          } else {
+            handler->PutParts(
+                key, SliceParts(&refs_[first], static_cast<int>(ref - first)));
+          }
+        } else if (input.size() >= value_length) {
+          value = Slice(input.data(), value_length);
+          input.remove_prefix(value_length);
           handler->Put(key, value);
         } else {
           return Status::Corruption("bad WriteBatch Put");
         }
         break;
+      }
       case kTypeDeletion:
         if (GetLengthPrefixedSlice(&input, &key)) {
           handler->Delete(key);
@@ -69,6 +114,14 @@ Status WriteBatch::Iterate(Handler* handler) const {
           return Status::Corruption("bad WriteBatch Delete");
         }
         break;
+      case kTypeRangeDeletion:
+        if (GetLengthPrefixedSlice(&input, &key) &&
+            GetLengthPrefixedSlice(&input, &value)) {
+          handler->DeleteRange(key, value);
+        } else {
+          return Status::Corruption("bad WriteBatch DeleteRange");
+        }
+        break;
       default:
         return Status::Corruption("unknown WriteBatch tag");
     }
@@ -103,12 +156,43 @@ void WriteBatch::Put(const Slice& key, const Slice& value) {
   PutLengthPrefixedSlice(&rep_, value);
 }
 
+void WriteBatch::Put(const SliceParts& key, const SliceParts& value) {
+  WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+  rep_.push_back(static_cast<char>(kTypeValue));
+  size_t key_length = 0;
+  for (int i = 0; i < key.num_parts; i++) {
+    key_length += key.parts[i].size();
+  }
+  PutVarint32(&rep_, key_length);
+  for (int i = 0; i < key.num_parts; i++) {
+    rep_.append(key.parts[i].data(), key.parts[i].size());
+  }
+  size_t value_length = 0;
+  for (int i = 0; i < value.num_parts; i++) {
+    value_length += value.parts[i].size();
+  }
+  PutVarint32(&rep_, value_length);
+  for (int i = 0; i < value.num_parts; i++) {
+    if (!value.parts[i].empty()) {
+      ref_offsets_.push_back(rep_.size());
+      refs_.push_back(value.parts[i]);
+    }
+  }
+}
+
 void WriteBatch::Delete(const Slice& key) {
   WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
   rep_.push_back(static_cast<char>(kTypeDeletion));
   PutLengthPrefixedSlice(&rep_, key);
 }
 
+void WriteBatch::DeleteRange(const Slice& begin, const Slice& end) {
+  WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+  rep_.push_back(static_cast<char>(kTypeRangeDeletion));
+  PutLengthPrefixedSlice(&rep_, begin);
+  PutLengthPrefixedSlice(&rep_, end);
+}
+
 void WriteBatch::Append(const WriteBatch& source) {
   WriteBatchInternal::Append(this, &source);
 }
@@ -118,13 +202,29 @@ class MemTableInserter : public WriteBatch::Handler {
  public:
   SequenceNumber sequence_;
   MemTable* mem_;
+  bool concurrent_;
 
   void Put(const Slice& key, const Slice& value) override {
-    mem_->Add(sequence_, kTypeValue, key, value);
-    sequence_++;
+    Add(kTypeValue, key, SliceParts(&value, 1));
+  }
+  void PutParts(const Slice& key, const SliceParts& value) override {
+    Add(kTypeValue, key, value);
   }
   void Delete(const Slice& key) override {
-    mem_->Add(sequence_, kTypeDeletion, key, Slice());
+    Add(kTypeDeletion, key, SliceParts());
+  }
+  void DeleteRange(const Slice& begin, const Slice& end) override {
+    mem_->AddRangeDeletion(sequence_, begin, end);
+    sequence_++;
+  }
+
+ private:
+  void Add(ValueType type, const Slice& key, const SliceParts& value) {
+    if (concurrent_) {
+      mem_->AddConcurrently(sequence_, type, key, value);
+    } else {
+      mem_->Add(sequence_, type, key, value);
+    }
     sequence_++;
   }
 };
@@ -134,17 +234,56 @@ Status WriteBatchInternal::InsertInto(const WriteBatch* b, MemTable* memtable) {
   MemTableInserter inserter;
   inserter.sequence_ = WriteBatchInternal::Sequence(b);
   inserter.mem_ = memtable;
+  inserter.concurrent_ = false;
+  return b->Iterate(&inserter);
+}
+
+Status WriteBatchInternal::InsertIntoConcurrently(const WriteBatch* b,
+                                                  MemTable* memtable) {
+  MemTableInserter inserter;
+  inserter.sequence_ = WriteBatchInternal::Sequence(b);
+  inserter.mem_ = memtable;
+  inserter.concurrent_ = true;
   return b->Iterate(&inserter);
 }
 
 void WriteBatchInternal::SetContents(WriteBatch* b, const Slice& contents) {
   assert(contents.size() >= kHeader);
   b->rep_.assign(contents.data(), contents.size());
+  b->ref_offsets_.clear();
+  b->refs_.clear();
+}
+
+size_t WriteBatchInternal::ByteSize(const WriteBatch* b) {
+  size_t size = b->rep_.size();
+  for (const Slice& ref : b->refs_) {
+    size += ref.size();
+  }
+  return size;
+}
+
+void WriteBatchInternal::AppendContents(const WriteBatch* b,
+                                        std::vector<Slice>* parts) {
+  size_t pos = 0;
+  for (size_t i = 0; i < b->refs_.size(); i++) {
+    const size_t offset = b->ref_offsets_[i];
+    if (offset > pos) {
+      parts->push_back(Slice(b->rep_.data() + pos, offset - pos));
+      pos = offset;
+    }
+    parts->push_back(b->refs_[i]);
+  }
+  parts->push_back(Slice(b->rep_.data() + pos, b->rep_.size() - pos));
 }
 
 void WriteBatchInternal::Append(WriteBatch* dst, const WriteBatch* src) {
   SetCount(dst, Count(dst) + Count(src));
   assert(src->rep_.size() >= kHeader);
+  const size_t shift = dst->rep_.size() - kHeader;
+  for (size_t offset : src->ref_offsets_) {
+    dst->ref_offsets_.push_back(offset + shift);
+  }
+  dst->refs_.insert(dst->refs_.end(), src->refs_.begin(), src->refs_.end());
   dst->rep_.append(src->rep_.data() + kHeader, src->rep_.size() - kHeader);
 }
 
@@ -5,6 +5,8 @@
 #ifndef STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
 #define STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
 
+#include <vector>
+
 #include "db/dbformat.h"
 #include "leveldb/write_batch.h"
 
@@ -29,14 +31,28 @@ class WriteBatchInternal {
   // this batch.
   static void SetSequence(WriteBatch* batch, SequenceNumber seq);
 
-  static Slice Contents(const WriteBatch* batch) { return Slice(batch->rep_); }
+  // REQUIRES: the batch does not refer to values outside of itself.
+  static Slice Contents(const WriteBatch* batch) {
+    assert(batch->refs_.empty());
+    return Slice(batch->rep_);
+  }
+
+  // Append slices to *parts whose concatenation is the contents of
+  // "batch", including the values that the batch only refers to.
+  static void AppendContents(const WriteBatch* batch,
+                             std::vector<Slice>* parts);
 
-  static size_t ByteSize(const WriteBatch* batch) { return batch->rep_.size(); }
+  static size_t ByteSize(const WriteBatch* batch);
 
   static void SetContents(WriteBatch* batch, const Slice& contents);
 
   static Status InsertInto(const WriteBatch* batch, MemTable* memtable);
 
+  // Like InsertInto(), but safe to call from several threads that insert
+  // different batches into the same memtable at the same time.
+  static Status InsertIntoConcurrently(const WriteBatch* batch,
+                                       MemTable* memtable);
+
   static void Append(WriteBatch* dst, const WriteBatch* src);
 };
 
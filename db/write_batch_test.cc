@@ -38,11 +38,27 @@ static std::string PrintContents(WriteBatch* b) {
         state.append(")");
         count++;
         break;
+      case kTypeRangeDeletion:
+      case kTypeBlobIndex:
+        // Range deletions are not stored with the point entries, and
+        // blob indexes only appear in tables.
+        break;
     }
     state.append("@");
     state.append(NumberToString(ikey.sequence));
   }
   delete iter;
+  std::vector<RangeTombstone> tombstones;
+  mem->GetRangeDeletions(&tombstones);
+  for (const RangeTombstone& t : tombstones) {
+    state.append("DeleteRange(");
+    state.append(t.begin);
+    state.append(", ");
+    state.append(t.end);
+    state.append(")@");
+    state.append(NumberToString(t.sequence));
+    count++;
+  }
   if (!s.ok()) {
     state.append("ParseError()");
   } else if (count != WriteBatchInternal::Count(b)) {
@@ -75,6 +91,22 @@ TEST(WriteBatchTest, Multiple) {
       PrintContents(&batch));
 }
 
+TEST(WriteBatchTest, DeleteRange) {
+  WriteBatch batch;
+  batch.Put(Slice("foo"), Slice("bar"));
+  batch.DeleteRange(Slice("a"), Slice("g"));
+  batch.Delete(Slice("box"));
+  batch.DeleteRange(Slice("x"), Slice("z"));
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_EQ(4, WriteBatchInternal::Count(&batch));
+  ASSERT_EQ(
+      "Delete(box)@102"
+      "Put(foo, bar)@100"
+      "DeleteRange(a, g)@101"
+      "DeleteRange(x, z)@103",
+      PrintContents(&batch));
+}
+
 TEST(WriteBatchTest, Corruption) {
   WriteBatch batch;
   batch.Put(Slice("foo"), Slice("bar"));
@@ -115,6 +147,56 @@ TEST(WriteBatchTest, Append) {
       PrintContents(&b1));
 }
 
+TEST(WriteBatchTest, PutParts) {
+  std::string large(100000, 'x');
+  Slice key_parts[2] = {"ke", "y"};
+  Slice value_parts[3] = {"va", "", Slice(large)};
+  Slice empty_value;
+
+  WriteBatch batch;
+  batch.Put("a", "va");
+  batch.Put(SliceParts(key_parts, 2), SliceParts(value_parts, 3));
+  batch.Put(SliceParts(key_parts + 1, 1), SliceParts(&empty_value, 1));
+  batch.Delete("b");
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_EQ(4, WriteBatchInternal::Count(&batch));
+  ASSERT_EQ(
+      "Put(a, va)@100"
+      "Delete(b)@103"
+      "Put(key, va" + large + ")@101"
+      "Put(y, )@102",
+      PrintContents(&batch));
+
+  // The gathered contents are the contents of an equivalent plain batch.
+  WriteBatch plain;
+  plain.Put("a", "va");
+  plain.Put("key", "va" + large);
+  plain.Put("y", "");
+  plain.Delete("b");
+  WriteBatchInternal::SetSequence(&plain, 100);
+  std::vector<Slice> parts;
+  WriteBatchInternal::AppendContents(&batch, &parts);
+  std::string contents;
+  for (const Slice& part : parts) {
+    contents.append(part.data(), part.size());
+  }
+  ASSERT_EQ(WriteBatchInternal::Contents(&plain).ToString(), contents);
+  ASSERT_EQ(plain.ApproximateSize(), batch.ApproximateSize());
+
+  // Appending keeps the references.
+  WriteBatch b1;
+  b1.Put("z", "vz");
+  b1.Append(batch);
+  WriteBatchInternal::SetSequence(&b1, 200);
+  ASSERT_EQ(
+      "Put(a, va)@201"
+      "Delete(b)@204"
+      "Put(key, va" + large + ")@202"
+      "Put(y, )@203"
+      "Put(z, vz)@200",
+      PrintContents(&b1));
+}
+
 TEST(WriteBatchTest, ApproximateSize) {
   WriteBatch batch;
   size_t empty_size = batch.ApproximateSize();
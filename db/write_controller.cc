@@ -0,0 +1,71 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/write_controller.h"
+
+#include <algorithm>
+
+#include "db/dbformat.h"
+
+namespace leveldb {
+
+// Writes arriving after an idle period may use up to this much time worth
+// of tokens at once.
+static const uint64_t kMaxBurstMicros = 1000;
+
+// The write rate never drops below this many bytes per second, so that a
+// large write is not held back for seconds.
+static const uint64_t kMinRate = 1 << 20;
+
+WriteController::WriteController(uint64_t max_rate,
+                                 uint64_t soft_pending_bytes_limit)
+    : max_rate_(std::max(max_rate, kMinRate)),
+      soft_pending_bytes_limit_(soft_pending_bytes_limit),
+      rate_(0),
+      next_write_micros_(0) {}
+
+void WriteController::Update(int level0_files,
+                             uint64_t pending_compaction_bytes) {
+  bool delayed = false;
+  double factor = 1.0;
+  if (level0_files >= config::kL0_SlowdownWritesTrigger) {
+    // Scale the rate down linearly from max_rate_ at the slowdown trigger
+    // towards zero at the stop trigger, where writes wait for compactions
+    // (see DBImpl::MakeRoomForWrite()).
+    const int span =
+        config::kL0_StopWritesTrigger - config::kL0_SlowdownWritesTrigger;
+    const int excess = level0_files - config::kL0_SlowdownWritesTrigger;
+    factor = static_cast<double>(std::max(span - excess, 1)) / span;
+    delayed = true;
+  }
+  if (soft_pending_bytes_limit_ > 0 &&
+      pending_compaction_bytes > soft_pending_bytes_limit_) {
+    // Scale the rate down in proportion to the excess backlog.
+    factor = std::min(factor, static_cast<double>(soft_pending_bytes_limit_) /
+                                  pending_compaction_bytes);
+    delayed = true;
+  }
+
+  if (!delayed) {
+    rate_ = 0;
+  } else {
+    rate_ = std::max(static_cast<uint64_t>(max_rate_ * factor), kMinRate);
+  }
+}
+
+uint64_t WriteController::GetDelay(uint64_t now_micros, uint64_t bytes) {
+  if (rate_ == 0) {
+    return 0;
+  }
+  // Tokens that were not used while idle only count up to the burst
+  // limit.
+  if (next_write_micros_ + kMaxBurstMicros < now_micros) {
+    next_write_micros_ = now_micros - kMaxBurstMicros;
+  }
+  next_write_micros_ += bytes * 1000000 / rate_;
+  return (next_write_micros_ > now_micros) ? next_write_micros_ - now_micros
+                                           : 0;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,54 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+#define STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+
+#include <stdint.h>
+
+namespace leveldb {
+
+// Meters writes while compactions fall behind.
+//
+// Update() derives an allowed write rate from the number of level-0 files
+// and the bytes that compactions still have to rewrite.  The rate drops
+// gradually as the backlog grows, so write latency degrades smoothly
+// instead of jumping when a trigger is crossed.  GetDelay() admits writes
+// at that rate through a token bucket.
+//
+// Not thread safe: callers must provide external synchronization.
+class WriteController {
+ public:
+  // Writes are admitted at up to "max_rate" bytes per second once they
+  // are delayed.  A backlog of more than "soft_pending_bytes_limit"
+  // pending compaction bytes delays writes; zero disables that check.
+  WriteController(uint64_t max_rate, uint64_t soft_pending_bytes_limit);
+
+  WriteController(const WriteController&) = delete;
+  WriteController& operator=(const WriteController&) = delete;
+
+  // Recompute the allowed write rate.
+  void Update(int level0_files, uint64_t pending_compaction_bytes);
+
+  // Return the allowed write rate in bytes per second, or zero if writes
+  // are not delayed.
+  uint64_t rate() const { return rate_; }
+
+  // Charge a write of "bytes" at time "now_micros" and return the number
+  // of microseconds the writer has to wait before proceeding.
+  uint64_t GetDelay(uint64_t now_micros, uint64_t bytes);
+
+ private:
+  const uint64_t max_rate_;
+  const uint64_t soft_pending_bytes_limit_;
+  uint64_t rate_;
+
+  // The time at which the bucket holds enough tokens for another write.
+  // The bucket holds at most a short burst worth of tokens.
+  uint64_t next_write_micros_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
@@ -0,0 +1,79 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/write_controller.h"
+
+#include "db/dbformat.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+static const uint64_t kRate = 16 << 20;
+static const uint64_t kSoftLimit = 256 << 20;
+
+class WriteControllerTest {};
+
+TEST(WriteControllerTest, NotDelayed) {
+  WriteController controller(kRate, kSoftLimit);
+  controller.Update(config::kL0_SlowdownWritesTrigger - 1, kSoftLimit);
+  ASSERT_EQ(0, controller.rate());
+  ASSERT_EQ(0, controller.GetDelay(1000000, 100 << 20));
+}
+
+TEST(WriteControllerTest, RateDropsWithBacklog) {
+  WriteController controller(kRate, kSoftLimit);
+  controller.Update(config::kL0_SlowdownWritesTrigger, 0);
+  ASSERT_EQ(kRate, controller.rate());
+
+  // The rate drops with every additional level-0 file.
+  uint64_t previous = controller.rate();
+  for (int files = config::kL0_SlowdownWritesTrigger + 1;
+       files < config::kL0_StopWritesTrigger; files++) {
+    controller.Update(files, 0);
+    ASSERT_LT(controller.rate(), previous);
+    ASSERT_GT(controller.rate(), 0);
+    previous = controller.rate();
+  }
+
+  // Pending compaction bytes scale the rate down as well.
+  controller.Update(0, kSoftLimit);
+  ASSERT_EQ(0, controller.rate());
+  controller.Update(0, 2 * kSoftLimit);
+  ASSERT_EQ(kRate / 2, controller.rate());
+  controller.Update(config::kL0_StopWritesTrigger - 1, 2 * kSoftLimit);
+  ASSERT_EQ(kRate / 4, controller.rate());
+
+  // Zero disables the pending bytes limit.
+  WriteController files_only(kRate, 0);
+  files_only.Update(0, 100 * kSoftLimit);
+  ASSERT_EQ(0, files_only.rate());
+}
+
+TEST(WriteControllerTest, TokenBucket) {
+  WriteController controller(kRate, kSoftLimit);
+  controller.Update(config::kL0_SlowdownWritesTrigger, 0);
+
+  // Writes are admitted at the rate: the last of 100 16KB writes issued
+  // at once waits for about 100ms at 16MB/s.
+  uint64_t now = 10000000;
+  uint64_t delay = 0;
+  for (int i = 0; i < 100; i++) {
+    delay = controller.GetDelay(now, 16 << 10);
+  }
+  ASSERT_GT(delay, 95000);
+  ASSERT_LT(delay, 100000);
+
+  // After an idle period, only a short burst proceeds without delay.
+  now += 10000000;
+  ASSERT_EQ(0, controller.GetDelay(now, 1 << 10));
+  delay = 0;
+  for (int i = 0; i < 100 && delay == 0; i++) {
+    delay = controller.GetDelay(now, 1 << 10);
+  }
+  ASSERT_GT(delay, 0);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) { return leveldb::test::RunAllTests(); }
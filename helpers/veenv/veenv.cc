@@ -292,6 +292,35 @@ class WritableFileImpl : public WritableFile {
     return WriteUnbuffered(write_data, write_size);
   }
 
+  // VeFS has no vectored append, so the buffered bytes and all of "data"
+  // are gathered into one contiguous region and handed to VeFS at once.
+  Status AppendV(const Slice* data, size_t n) override {
+    size_t write_size = 0;
+    for (size_t i = 0; i < n; i++) {
+      write_size += data[i].size();
+    }
+#ifdef VE_OPT
+    if (write_size <= kWritableFileBufferSize - pos_) {
+      for (size_t i = 0; i < n; i++) {
+        std::memcpy(buf_ + pos_, data[i].data(), data[i].size());
+        pos_ += data[i].size();
+      }
+      return Status::OK();
+    }
+#endif
+    if (pos_ == 0 && n == 1) {
+      return WriteUnbuffered(data[0].data(), data[0].size());
+    }
+    gather_.clear();
+    gather_.reserve(pos_ + write_size);
+    gather_.append(buf_, pos_);
+    for (size_t i = 0; i < n; i++) {
+      gather_.append(data[i].data(), data[i].size());
+    }
+    pos_ = 0;
+    return WriteUnbuffered(gather_.data(), gather_.size());
+  }
+
   Status Close() override { return FlushBuffer(); }
   Status Flush() override { return FlushBuffer(); }
   Status Sync() override {
@@ -321,6 +350,7 @@ class WritableFileImpl : public WritableFile {
   FileState* file_;
   char buf_[kWritableFileBufferSize];
   size_t pos_;
+  std::string gather_;  // Scratch space for AppendV()
 };
 
 class NoOpLogger : public Logger {
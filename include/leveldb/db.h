@@ -8,6 +8,9 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include <string>
+#include <vector>
+
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
@@ -72,6 +75,15 @@ class LEVELDB_EXPORT DB {
   // Note: consider setting options.sync = true.
   virtual Status Delete(const WriteOptions& options, const Slice& key) = 0;
 
+  // Remove the database entries (if any) for all keys in the range
+  // ["begin", "end").  Returns OK on success, and a non-OK status on error.
+  // Removes nothing if "end" does not sort after "begin".  The deleted
+  // entries are hidden at once, but their space is only reclaimed as
+  // compactions pass over the range.
+  // Note: consider setting options.sync = true.
+  virtual Status DeleteRange(const WriteOptions& options, const Slice& begin,
+                             const Slice& end);
+
   // Apply the specified updates to the database.
   // Returns OK on success, non-OK on failure.
   // Note: consider setting options.sync = true.
@@ -87,6 +99,19 @@ class LEVELDB_EXPORT DB {
   virtual Status Get(const ReadOptions& options, const Slice& key,
                      std::string* value) = 0;
 
+  // Look up every key in "keys" as if by Get().  Resizes "*values" and
+  // "*statuses" to keys.size() and stores the outcome of the lookup of
+  // keys[i] in (*values)[i] and (*statuses)[i].
+  //
+  // All keys are read from the same consistent view of the database.
+  // Looking up many keys at once is cheaper than calling Get() for each
+  // of them: keys that fall into the same table share its index lookup
+  // and block reads.
+  virtual void MultiGet(const ReadOptions& options,
+                        const std::vector<Slice>& keys,
+                        std::vector<std::string>* values,
+                        std::vector<Status>* statuses);
+
   // Return a heap-allocated iterator over the contents of the database.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
@@ -121,6 +146,11 @@ class LEVELDB_EXPORT DB {
   //     of the sstables that make up the db contents.
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
   //     bytes of memory in use by the DB.
+  //  "leveldb.delayed-write-rate" - returns the rate in bytes per second at
+  //     which writes are currently admitted, or 0 if they are not delayed.
+  //     The rate is recomputed by each write.
+  //  "leveldb.write-stall-micros" - returns the total number of
+  //     microseconds that writes have been delayed so far.
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
   // For each i in [0,n-1], store in "sizes[i]", the approximate
@@ -145,6 +175,29 @@ class LEVELDB_EXPORT DB {
   // Therefore the following call will compact the entire database:
   //    db->CompactRange(nullptr, nullptr);
   virtual void CompactRange(const Slice* begin, const Slice* end) = 0;
+
+  // Delete the table files whose keys all lie in ["begin", "end"), without
+  // reading them, and then compact the files that straddle "begin" or
+  // "end".  This reclaims the space of a large range much faster than
+  // compacting it.  A file that overlaps an older file that is kept is not
+  // deleted, so that no older entry of its keys comes back.
+  //
+  // This does not remove the range atomically: keys in the range that are
+  // held by other files or by the memtable stay visible.  To remove every
+  // key in the range, call DeleteRange() on it first.
+  //
+  // The default implementation returns NotSupported.
+  virtual Status DeleteFilesInRange(const Slice& begin, const Slice& end);
+
+  // Write the current memtable, which holds all recent writes, out to a
+  // table file.  After that, those writes survive a crash even if they
+  // were made with WriteOptions::disable_wal set.  If "wait" is true,
+  // returns once the table file has been installed; otherwise the table
+  // file is written in the background, unless the database is closed
+  // first.
+  //
+  // The default implementation returns NotSupported.
+  virtual Status FlushMemTable(bool wait);
 };
 
 // Destroy the contents of the specified database.
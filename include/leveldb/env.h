@@ -286,6 +286,12 @@ class LEVELDB_EXPORT WritableFile {
   virtual ~WritableFile();
 
   virtual Status Append(const Slice& data) = 0;
+
+  // Append the concatenation of data[0,n-1].  Implementations may write
+  // the pieces with a single gathering write instead of copying them.
+  // The default implementation calls Append() for each piece.
+  virtual Status AppendV(const Slice* data, size_t n);
+
   virtual Status Close() = 0;
   virtual Status Flush() = 0;
   virtual Status Sync() = 0;
@@ -49,6 +49,12 @@ class LEVELDB_EXPORT FilterPolicy {
   // This method may return true or false if the key was not on the
   // list, but it should aim to return false with a high probability.
   virtual bool KeyMayMatch(const Slice& key, const Slice& filter) const = 0;
+
+  // Set results[i] to KeyMayMatch(keys[i], filter) for each i in
+  // [0,n-1].  The default implementation calls KeyMayMatch() for each
+  // key; policies can override it to probe many keys at once.
+  virtual void KeysMayMatch(const Slice* keys, int n, const Slice& filter,
+                            bool* results) const;
 };
 
 // Return a new filter policy that uses a bloom filter with approximately
@@ -0,0 +1,65 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Recent writes are buffered in an in-memory table (the memtable) until it
+// is written out to a table file.  A MemTableRepFactory chooses the data
+// structure that keeps the memtable entries ordered and searchable, so that
+// each database can pick the structure that suits its mix of writes, point
+// lookups and scans (see Options::memtable_factory).
+//
+// The representations themselves are internal to leveldb; use one of the
+// New*RepFactory() functions below to obtain a factory.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_MEMTABLEREP_H_
+#define STORAGE_LEVELDB_INCLUDE_MEMTABLEREP_H_
+
+#include <stddef.h>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class Arena;
+class MemTableRep;
+struct MemTableKeyComparator;
+
+class LEVELDB_EXPORT MemTableRepFactory {
+ public:
+  virtual ~MemTableRepFactory();
+
+  // Return the name of the representation created by this factory.
+  virtual const char* Name() const = 0;
+
+  // Return a new, empty representation that orders entries by "cmp" and
+  // allocates from "*arena".  Called by leveldb whenever a new memtable is
+  // created.
+  virtual MemTableRep* CreateMemTableRep(const MemTableKeyComparator& cmp,
+                                         Arena* arena) const = 0;
+};
+
+// Return a factory for skip lists.  Inserts, point lookups and ordered
+// iteration all take O(log n).  This is the default representation.
+LEVELDB_EXPORT const MemTableRepFactory* NewSkipListRepFactory();
+
+// Return a factory for vectors of sorted runs plus an unsorted append
+// buffer.  Inserts are cheap appends, which suits append-heavy workloads;
+// lookups search each of the O(log n) runs.
+//
+// If "hash_index" is true, the representation also keeps a hash index from
+// user key to its newest entry, which makes most point lookups O(1).  The
+// index is only built when the database uses the bytewise comparator.
+LEVELDB_EXPORT const MemTableRepFactory* NewVectorRepFactory(bool hash_index);
+
+// Return a factory for representations that hash user keys into
+// "bucket_count" buckets, each of which is a skip list.  Point lookups only
+// search one small bucket, but ordered iteration (used by scans and when
+// the memtable is written out) has to sort all entries first, so this suits
+// lookup-heavy workloads.  Databases with a comparator other than the
+// bytewise comparator use a skip list instead.
+LEVELDB_EXPORT const MemTableRepFactory* NewHashSkipListRepFactory(
+    size_t bucket_count);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_MEMTABLEREP_H_
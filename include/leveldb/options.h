@@ -16,6 +16,9 @@ class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class MemTableRepFactory;
+class Slice;
+class SliceTransform;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -104,6 +107,52 @@ struct LEVELDB_EXPORT Options {
   // leave this parameter alone.
   int block_restart_interval = 16;
 
+  // If true, every data block written to a table carries a small hash
+  // index that maps the user keys in the block to the restart interval in
+  // which they occur, so that point lookups usually avoid the binary
+  // search over the restart points.  Costs about one byte per distinct
+  // user key.  Only useful with a comparator that treats keys as equal
+  // exactly when their bytes are equal.  Tables written with this option
+  // cannot be read by versions of leveldb that predate it.
+  //
+  // Default: false
+  bool data_block_hash_index = false;
+
+  // If true, data and index blocks store an 8-byte prefix of the key at
+  // every restart point in a fixed-width array, taken just past the
+  // prefix shared by all keys of the block.  Seeks then narrow down the
+  // restart interval by comparing integers, and only decode and compare
+  // full keys when prefixes tie.  Costs 8 bytes per restart point.
+  //
+  // Only used for the tables of a DB whose "comparator" is the default
+  // BytewiseComparator(); tables built with TableBuilder outside of a DB
+  // ignore it.  Tables written with this option cannot be read by
+  // versions of leveldb that predate it.
+  //
+  // Default: false
+  bool restart_key_prefixes = false;
+
+  // If true, the index of every table is split into partitions of about
+  // index_partition_size bytes, and only a small top-level index over the
+  // partitions is kept in memory while the table is open.  Partitions are
+  // read on demand through the block cache.  If filter_policy is set, the
+  // filter block is partitioned the same way.  This bounds the memory held
+  // by open tables when max_file_size is large.  Tables written with this
+  // option cannot be read by versions of leveldb that predate it.
+  //
+  // Default: false
+  bool partition_index_and_filters = false;
+
+  // Approximate size of an index partition.  Only used when
+  // partition_index_and_filters is true.
+  size_t index_partition_size = 4 * 1024;
+
+  // Compactions read their input tables ahead in chunks of this many
+  // bytes (see ReadOptions::readahead_size).  Zero turns this off.
+  //
+  // Default: 256KB
+  size_t compaction_readahead_size = 256 * 1024;
+
   // Leveldb will write up to this amount of bytes to a file before
   // switching to a new one.
   // Most clients should leave this parameter alone.  However if your
@@ -130,6 +179,29 @@ struct LEVELDB_EXPORT Options {
   // efficiently detect that and will switch to uncompressed mode.
   CompressionType compression = kSnappyCompression;
 
+  // Values of at least this many bytes are written to separate blob files
+  // when the memtable is flushed or when a compaction rewrites them, and
+  // the tables only hold a small reference to them.  This keeps large
+  // values out of the rewrites done by later compactions.  Reading such a
+  // value costs one more random read.  Zero keeps all values in the tables.
+  //
+  // Default: 0
+  size_t min_blob_size = 0;
+
+  // Blob files are written up to this many bytes before switching to a
+  // new one.
+  //
+  // Default: 256MB
+  size_t max_blob_file_size = 256 * 1024 * 1024;
+
+  // Once at least this fraction of the bytes of a blob file belong to
+  // values that were overwritten or deleted, the next compactions move
+  // the values still referred to out of the file so that it can be
+  // deleted.
+  //
+  // Default: 0.5
+  double blob_gc_ratio = 0.5;
+
   // EXPERIMENTAL: If true, append to existing MANIFEST and log files
   // when a database is opened.  This can significantly speed up open.
   //
@@ -140,6 +212,70 @@ struct LEVELDB_EXPORT Options {
   // Many applications will benefit from passing the result of
   // NewBloomFilterPolicy() here.
   const FilterPolicy* filter_policy = nullptr;
+
+  // If non-null, the filters of each table also hold the prefixes that
+  // this transform extracts from the user keys of the table, so that
+  // iterators with ReadOptions::prefix_same_as_start set can skip the
+  // tables that hold no key with the prefix they visit.  Only used if
+  // filter_policy is set; tables built with TableBuilder outside of a DB
+  // ignore it.
+  //
+  // Default: null
+  const SliceTransform* prefix_extractor = nullptr;
+
+  // If non-null, use the specified factory to create the data structure
+  // that holds the memtable (see leveldb/memtablerep.h).  Different
+  // databases in one process may use different representations.
+  //
+  // Default: null, which uses a skip list (builds configured with
+  // VECTOR_MEMTABLE default to NewVectorRepFactory() instead)
+  const MemTableRepFactory* memtable_factory = nullptr;
+
+  // If true, writes are pipelined: the log record for one group of
+  // writers is appended while the previous group is still being applied
+  // to the memtable, and every writer in a group inserts its own batch
+  // into the memtable in parallel with the other writers of the group.
+  // This improves write throughput when many threads write concurrently.
+  //
+  // Default: false
+  bool enable_pipelined_write = false;
+
+  // If true, a dedicated background thread appends all records to the
+  // log file.  Writers hand their batches to that thread instead of
+  // writing and syncing the log themselves, and the writes of all
+  // concurrent writers with WriteOptions::sync set are covered by a single
+  // sync.  A write still only returns once its record has been written
+  // (and synced, if requested).  Has no effect when enable_pipelined_write
+  // is true.
+  //
+  // Default: false
+  bool enable_wal_thread = false;
+
+  // When the log thread is about to sync the log file, it first waits this
+  // many microseconds so that more sync writers can share the sync.
+  // Raising this trades the latency of each sync write for fewer syncs.
+  // Only used when enable_wal_thread is true.
+  //
+  // Default: 0
+  int wal_sync_window_micros = 0;
+
+  // Once compactions fall behind, writes are admitted at no more than this
+  // many bytes per second.  The rate drops further as the backlog grows:
+  // from delayed_write_rate when the number of level-0 files reaches the
+  // slowdown trigger down to a quarter of it just below the stop trigger,
+  // and in proportion to soft_pending_compaction_bytes_limit when there
+  // are more pending compaction bytes than that.  The rate never drops
+  // below 1MB/s, so smaller values act like 1MB/s.
+  //
+  // Default: 16MB/s
+  size_t delayed_write_rate = 16 * 1024 * 1024;
+
+  // Writes are delayed while compactions have more than this many bytes
+  // to rewrite before every level is within its size limit.  Zero only
+  // delays writes based on the number of level-0 files.
+  //
+  // Default: 256MB
+  size_t soft_pending_compaction_bytes_limit = 256 * 1024 * 1024;
 };
 
 // Options that control read operations
@@ -159,6 +295,41 @@ struct LEVELDB_EXPORT ReadOptions {
   // not have been released).  If "snapshot" is null, use an implicit
   // snapshot of the state at the beginning of this read operation.
   const Snapshot* snapshot = nullptr;
+
+  // If non-zero, iterators read table files ahead in chunks of this many
+  // bytes, so that a scan issues few large reads instead of one read per
+  // block.  Each table iterator holds a buffer of this size.  Useful with
+  // Envs whose reads are expensive; mmap-ed files are read as before.
+  size_t readahead_size = 0;
+
+  // If true and the DB has a prefix extractor (see
+  // Options::prefix_extractor), an iterator that is positioned by Seek()
+  // only visits the keys with the same prefix as the seek target, and
+  // becomes invalid once it moves past them.  The iterator skips the table
+  // files whose filters show that they hold no key with that prefix.
+  // Targets without a prefix, SeekToFirst() and SeekToLast() position the
+  // iterator as usual.
+  bool prefix_same_as_start = false;
+
+  // If non-null, iterators only visit the user keys at or after
+  // *iterate_lower_bound: Seek() to an earlier key and SeekToFirst() act
+  // like Seek(*iterate_lower_bound), and Prev() makes the iterator invalid
+  // once it moves before the bound.  The Slice must outlive the iterator.
+  //
+  // Default: null
+  const Slice* iterate_lower_bound = nullptr;
+
+  // If non-null, iterators only visit the user keys before
+  // *iterate_upper_bound: SeekToLast() positions the iterator at the last
+  // such key, and the iterator becomes invalid instead of moving to the
+  // bound or past it, without reading further.  The Slice must outlive the
+  // iterator.
+  //
+  // Table files and blocks that only hold keys outside the bounds are not
+  // read.
+  //
+  // Default: null
+  const Slice* iterate_upper_bound = nullptr;
 };
 
 // Options that control write operations
@@ -180,6 +351,14 @@ struct LEVELDB_EXPORT WriteOptions {
   // with sync==true has similar crash semantics to a "write()"
   // system call followed by "fsync()".
   bool sync = false;
+
+  // If true, the write is not recorded in the log file.  It is only
+  // applied to the memtable, so it is lost if the process or the machine
+  // crashes before the memtable has been written out to a table file
+  // (see DB::FlushMemTable()).  This avoids writing the data twice, e.g.
+  // for bulk loads that can be restarted after a crash.  "sync" has no
+  // effect on such writes.
+  bool disable_wal = false;
 };
 
 }  // namespace leveldb
@@ -110,6 +110,16 @@ inline int Slice::compare(const Slice& b) const {
   return r;
 }
 
+// A sequence of slices that stands for their concatenation.  Like a
+// Slice, it does not own the memory it refers to.
+struct LEVELDB_EXPORT SliceParts {
+  SliceParts() : parts(nullptr), num_parts(0) {}
+  SliceParts(const Slice* p, int n) : parts(p), num_parts(n) {}
+
+  const Slice* parts;
+  int num_parts;
+};
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_SLICE_H_
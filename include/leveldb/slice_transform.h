@@ -0,0 +1,55 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A SliceTransform maps keys to their prefixes.  A database configured
+// with a prefix extractor (see Options::prefix_extractor) adds the
+// prefixes of the keys of each table to its filters, so that an iterator
+// that only visits the keys with one prefix can skip the tables that hold
+// none (see ReadOptions::prefix_same_as_start).
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+#define STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+
+#include <stddef.h>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT SliceTransform {
+ public:
+  virtual ~SliceTransform();
+
+  // Return the name of this transform.  Tables record the name of the
+  // transform whose prefixes their filters hold, and the prefixes of a
+  // table written with a differently named transform are not used.  If
+  // the transform changes in an incompatible way, its name must change
+  // too.
+  virtual const char* Name() const = 0;
+
+  // Returns true iff "key" has a prefix.
+  virtual bool InDomain(const Slice& key) const = 0;
+
+  // Returns the prefix of "key", which must be a prefix of the bytes of
+  // "key".  The keys with the same prefix must sort right after the
+  // prefix itself: no key with a different prefix may sort between two
+  // keys with the same prefix, or between them and the prefix.  This holds
+  // for the default comparator.
+  //
+  // REQUIRES: InDomain(key)
+  virtual Slice Transform(const Slice& key) const = 0;
+};
+
+// Return a new transform that maps the keys of at least "prefix_len" bytes
+// to their first "prefix_len" bytes.  Shorter keys have no prefix.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const SliceTransform* NewFixedPrefixTransform(
+    size_t prefix_len);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
@@ -50,6 +50,12 @@ class LEVELDB_EXPORT Table {
   // call one of the Seek methods on the iterator before using it).
   Iterator* NewIterator(const ReadOptions&) const;
 
+  // Returns a new iterator over the entries added to the table with
+  // TableBuilder::AddRangeDeletion(), which are held in memory while the
+  // table is open.  The result is initially invalid.  If they could not be
+  // read when the table was opened, the iterator reports that error.
+  Iterator* NewRangeDeletionIterator() const;
+
   // Given a key, return an approximate byte offset in the file where
   // the data for that key begins (or would begin if the key were
   // present in the file).  The returned value is in terms of file
@@ -63,9 +69,22 @@ class LEVELDB_EXPORT Table {
   struct Rep;
 
   static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+  static Iterator* IndexPartitionReader(void*, const ReadOptions&,
+                                        const Slice&);
+  static Iterator* ReadaheadBlockReader(void*, const ReadOptions&,
+                                        const Slice&);
+  static Iterator* BlockReader(Table* table, RandomAccessFile* file,
+                               const ReadOptions&, const Slice&,
+                               bool high_priority);
 
   explicit Table(Rep* rep) : rep_(rep) {}
 
+  // Like NewIterator(options), but Next() and Prev() do not read blocks
+  // that only hold keys before *lower_bound or at or after *upper_bound
+  // (see NewTwoLevelIterator()).  Either bound may be null.
+  Iterator* NewIterator(const ReadOptions&, const Slice* lower_bound,
+                        const Slice* upper_bound) const;
+
   // Calls (*handle_result)(arg, ...) with the entry found after a call
   // to Seek(key).  May not make such a call if filter policy says
   // that key is not present.
@@ -73,8 +92,34 @@ class LEVELDB_EXPORT Table {
                      void (*handle_result)(void* arg, const Slice& k,
                                            const Slice& v));
 
+  // Like InternalGet(), but for the "n" keys in "keys", which must be
+  // sorted.  Keys that fall into the same block share the index lookup
+  // and the read of that block.  Stores the status of the lookup of
+  // keys[i] in statuses[i].
+  void InternalMultiGet(const ReadOptions&, int n, const Slice* keys,
+                        void* const* args, Status* statuses,
+                        void (*handle_result)(void* arg, const Slice& k,
+                                              const Slice& v));
+
+  // Returns false if the table holds no key with the prefix given by
+  // "prefix_key", a key that sorts at or before all keys with the prefix
+  // and that the filter policy maps to the prefix.  Returns true for
+  // tables whose filters do not hold the prefixes of the keys.
+  bool PrefixMayMatch(const ReadOptions&, const Slice& prefix_key);
+
+  // Returns an iterator over the index, which walks the index partitions
+  // of a partitioned index.
+  Iterator* NewIndexIterator(const ReadOptions&) const;
+
+  // Sets results[i] to false for each of the "n" keys that the filter rules
+  // out for the data block at "block_offset" and to true for the others.
+  // keys[0] must fall into that block.
+  void KeysMayMatch(const ReadOptions&, uint64_t block_offset,
+                    const Slice* keys, int n, bool* results);
+
   void ReadMeta(const Footer& footer);
   void ReadFilter(const Slice& filter_handle_value);
+  void ReadRangeDeletions(const Slice& handle_value);
 
   Rep* const rep_;
 };
@@ -51,6 +51,13 @@ class LEVELDB_EXPORT TableBuilder {
   // REQUIRES: Finish(), Abandon() have not been called
   void Add(const Slice& key, const Slice& value);
 
+  // Add key,value to a separate block of range deletions, which is written
+  // by Finish() and read back with Table::NewRangeDeletionIterator().  The
+  // keys may be added in any order; only the first value added for a key
+  // is kept.
+  // REQUIRES: Finish(), Abandon() have not been called
+  void AddRangeDeletion(const Slice& key, const Slice& value);
+
   // Advanced operation: flush any buffered key/value pairs to file.
   // Can be used to ensure that two adjacent entries never live in
   // the same data block.  Most clients should not need to use this method.
@@ -83,6 +90,8 @@ class LEVELDB_EXPORT TableBuilder {
   bool ok() const { return status().ok(); }
   void WriteBlock(BlockBuilder* block, BlockHandle* handle);
   void WriteRawBlock(const Slice& data, CompressionType, BlockHandle* handle);
+  void WriteIndexPartition(const Slice& last_key);
+  void AddPrefixToFilter(const Slice& key);
 
   struct Rep;
   Rep* rep_;
@@ -22,14 +22,14 @@
 #define STORAGE_LEVELDB_INCLUDE_WRITE_BATCH_H_
 
 #include <string>
+#include <vector>
 
 #include "leveldb/export.h"
+#include "leveldb/slice.h"
 #include "leveldb/status.h"
 
 namespace leveldb {
 
-class Slice;
-
 class LEVELDB_EXPORT WriteBatch {
  public:
   class LEVELDB_EXPORT Handler {
@@ -37,6 +37,15 @@ class LEVELDB_EXPORT WriteBatch {
     virtual ~Handler();
     virtual void Put(const Slice& key, const Slice& value) = 0;
     virtual void Delete(const Slice& key) = 0;
+
+    // Called instead of Put() for values that a batch refers to in
+    // several parts (see Put(const SliceParts&, const SliceParts&)).  The
+    // default implementation concatenates the parts and calls Put().
+    virtual void PutParts(const Slice& key, const SliceParts& value);
+
+    // Called for range deletions (see WriteBatch::DeleteRange()).  The
+    // default implementation ignores them.
+    virtual void DeleteRange(const Slice& begin, const Slice& end);
   };
 
   WriteBatch();
@@ -50,9 +59,22 @@ class LEVELDB_EXPORT WriteBatch {
   // Store the mapping "key->value" in the database.
   void Put(const Slice& key, const Slice& value);
 
+  // Store the mapping "key->value" in the database, where key and value
+  // are the concatenations of their parts.  The key is copied into the
+  // batch, but the value is not: the batch refers to the memory of the
+  // value parts, which must remain live and unchanged until the batch has
+  // been written by DB::Write() or cleared.  This saves a copy of large
+  // values.  Copies of the batch and batches that Append() it refer to the
+  // same memory.
+  void Put(const SliceParts& key, const SliceParts& value);
+
   // If the database contains a mapping for "key", erase it.  Else do nothing.
   void Delete(const Slice& key);
 
+  // Erase the mappings of all keys in the range ["begin", "end").  Erases
+  // nothing if "end" does not sort after "begin".
+  void DeleteRange(const Slice& begin, const Slice& end);
+
   // Clear all updates buffered in this batch.
   void Clear();
 
@@ -76,6 +98,11 @@ class LEVELDB_EXPORT WriteBatch {
   friend class WriteBatchInternal;
 
   std::string rep_;  // See comment in write_batch.cc for the format of rep_
+
+  // Values that are referred to instead of being stored in rep_.
+  // refs_[i] holds bytes that belong at offset ref_offsets_[i] of rep_.
+  std::vector<size_t> ref_offsets_;
+  std::vector<Slice> refs_;
 };
 
 }  // namespace leveldb
@@ -70,6 +70,6 @@ date > output
 #benchmark
 
 pushd leveldb
-./build.sh "-DVECTOR_CRC32C -DVE_OPT" #-DVECTOR_MEMTABLE"
+./build.sh "-DVECTOR_CRC32C -DVE_OPT" #-DVECTOR_MEMTABLE -DVECTOR_MEMTABLE_INDEX"
 popd
 benchmark
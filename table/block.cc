@@ -8,42 +8,21 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <vector>
 
 #include "leveldb/comparator.h"
+#include "leveldb_autogen_conf.h"
+#include "table/block_builder.h"
 #include "table/format.h"
 #include "util/coding.h"
 #include "util/logging.h"
 
-namespace leveldb {
-
-inline uint32_t Block::NumRestarts() const {
-  assert(size_ >= sizeof(uint32_t));
-  return DecodeFixed32(data_ + size_ - sizeof(uint32_t));
-}
+#if defined(VECTOR_SEEK)
+#include "util/ve.h"
+#endif
 
-Block::Block(const BlockContents& contents)
-    : data_(contents.data.data()),
-      size_(contents.data.size()),
-      owned_(contents.heap_allocated) {
-  if (size_ < sizeof(uint32_t)) {
-    size_ = 0;  // Error marker
-  } else {
-    size_t max_restarts_allowed = (size_ - sizeof(uint32_t)) / sizeof(uint32_t);
-    if (NumRestarts() > max_restarts_allowed) {
-      // The size is too small for NumRestarts()
-      size_ = 0;
-    } else {
-      restart_offset_ = size_ - (1 + NumRestarts()) * sizeof(uint32_t);
-    }
-  }
-}
-
-Block::~Block() {
-  if (owned_) {
-    delete[] data_;
-  }
-}
+namespace leveldb {
 
 // Helper routine: decode the next block entry starting at "p",
 // storing the number of shared key bytes, non_shared key bytes,
@@ -74,12 +53,142 @@ static inline const char* DecodeEntry(const char* p, const char* limit,
   return p;
 }
 
+Block::Block(const BlockContents& contents)
+    : data_(contents.data.data()),
+      size_(contents.data.size()),
+      buckets_(nullptr),
+      num_buckets_(0),
+      prefixes_(nullptr),
+      common_prefix_(nullptr),
+      common_length_(0),
+      owned_(contents.heap_allocated) {
+  if (size_ < sizeof(uint32_t)) {
+    size_ = 0;  // Error marker
+    return;
+  }
+  // Parse the trailer backwards from the end of the block.
+  size_t limit = size_ - sizeof(uint32_t);
+  num_restarts_ = DecodeFixed32(data_ + limit);
+  const uint32_t flags = num_restarts_ & (kHashIndexFlag | kRestartPrefixFlag);
+  num_restarts_ &= ~flags;
+  if (num_restarts_ > limit / sizeof(uint32_t)) {
+    // The size is too small for num_restarts_
+    size_ = 0;
+    return;
+  }
+  if ((flags & kHashIndexFlag) != 0) {
+    if (limit < sizeof(uint32_t)) {
+      size_ = 0;
+      return;
+    }
+    limit -= sizeof(uint32_t);
+    num_buckets_ = DecodeFixed32(data_ + limit);
+    if (num_buckets_ == 0 || num_buckets_ > limit) {
+      // The size is too small for the hash index
+      size_ = 0;
+      return;
+    }
+    limit -= num_buckets_;
+    buckets_ = reinterpret_cast<const uint8_t*>(data_ + limit);
+  }
+  if ((flags & kRestartPrefixFlag) != 0) {
+    if (limit < sizeof(uint32_t) + num_restarts_ * sizeof(uint64_t)) {
+      // The size is too small for the restart key prefixes
+      size_ = 0;
+      return;
+    }
+    limit -= sizeof(uint32_t);
+    common_length_ = DecodeFixed32(data_ + limit);
+    limit -= num_restarts_ * sizeof(uint64_t);
+    prefixes_ = data_ + limit;
+  }
+  if (limit < num_restarts_ * sizeof(uint32_t)) {
+    size_ = 0;
+    return;
+  }
+  restart_offset_ = limit - num_restarts_ * sizeof(uint32_t);
+
+  if (prefixes_ != nullptr && num_restarts_ > 0) {
+    // The shared bytes are those of the first key.
+    uint32_t shared, non_shared, value_length;
+    const char* key_ptr = DecodeEntry(data_, data_ + restart_offset_, &shared,
+                                      &non_shared, &value_length);
+    if (key_ptr == nullptr || shared != 0 ||
+        non_shared < common_length_ + 8) {
+      size_ = 0;
+      return;
+    }
+    common_prefix_ = key_ptr;
+  }
+}
+
+Block::~Block() {
+  if (owned_) {
+    delete[] data_;
+  }
+}
+
+// Store in "*num_less" and "*num_less_or_equal" the number of entries of
+// the sorted array "prefixes[0,n-1]" of fixed64 numbers that are smaller
+// than "value" and not larger than "value", respectively.
+#if defined(VECTOR_SEEK)
+static void CountRestartPrefixes(const char* prefixes, uint32_t n,
+                                 uint64_t value, uint32_t* num_less,
+                                 uint32_t* num_less_or_equal) {
+  // Compare up to 256 prefixes with one vector instruction each.  The
+  // array is not aligned within the block, so it is copied first.
+  uint64_t buf[256];
+  uint32_t greater_or_equal = 0, greater = 0;
+  for (uint32_t start = 0; start < n; start += 256) {
+    const uint32_t m = std::min<uint32_t>(n - start, 256);
+    memcpy(buf, prefixes + start * sizeof(uint64_t), m * sizeof(uint64_t));
+    _ve_lvl(m);
+    Ve::VrReg p(buf);
+    greater_or_equal += p.IsGte(value).CountFlags();
+    greater += p.IsGt(value).CountFlags();
+  }
+  *num_less = n - greater_or_equal;
+  *num_less_or_equal = n - greater;
+}
+#else
+static void CountRestartPrefixes(const char* prefixes, uint32_t n,
+                                 uint64_t value, uint32_t* num_less,
+                                 uint32_t* num_less_or_equal) {
+  // Two binary searches over the integers.
+  uint32_t left = 0, right = n;
+  while (left < right) {
+    const uint32_t mid = (left + right) / 2;
+    if (DecodeFixed64(prefixes + mid * sizeof(uint64_t)) < value) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  *num_less = left;
+  right = n;
+  while (left < right) {
+    const uint32_t mid = (left + right) / 2;
+    if (DecodeFixed64(prefixes + mid * sizeof(uint64_t)) <= value) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  *num_less_or_equal = left;
+}
+#endif
+
 class Block::Iter : public Iterator {
  private:
   const Comparator* const comparator_;
   const char* const data_;       // underlying block contents
   uint32_t const restarts_;      // Offset of restart array (list of fixed32)
   uint32_t const num_restarts_;  // Number of uint32_t entries in restart array
+  const uint8_t* const buckets_;  // Hash index (nullptr if none)
+  uint32_t const num_buckets_;
+  const char* const prefixes_;       // Restart key prefixes (nullptr if none)
+  const char* const common_prefix_;  // Bytes shared by all user keys
+  uint32_t const common_length_;
 
   // current_ is offset in data_ of current entry.  >= restarts_ if !Valid
   uint32_t current_;
@@ -112,13 +221,34 @@ class Block::Iter : public Iterator {
     value_ = Slice(data_ + offset, 0);
   }
 
+  // Store in "*less" whether the key at restart point "index" is smaller
+  // than "target".  Returns false if the block is corrupted.
+  bool RestartKeyLess(uint32_t index, const Slice& target, bool* less) {
+    uint32_t region_offset = GetRestartPoint(index);
+    uint32_t shared, non_shared, value_length;
+    const char* key_ptr =
+        DecodeEntry(data_ + region_offset, data_ + restarts_, &shared,
+                    &non_shared, &value_length);
+    if (key_ptr == nullptr || (shared != 0)) {
+      CorruptionError();
+      return false;
+    }
+    Slice restart_key(key_ptr, non_shared);
+    *less = Compare(restart_key, target) < 0;
+    return true;
+  }
+
  public:
-  Iter(const Comparator* comparator, const char* data, uint32_t restarts,
-       uint32_t num_restarts)
+  Iter(const Comparator* comparator, const Block* block)
       : comparator_(comparator),
-        data_(data),
-        restarts_(restarts),
-        num_restarts_(num_restarts),
+        data_(block->data_),
+        restarts_(block->restart_offset_),
+        num_restarts_(block->num_restarts_),
+        buckets_(block->buckets_),
+        num_buckets_(block->num_buckets_),
+        prefixes_(block->prefixes_),
+        common_prefix_(block->common_prefix_),
+        common_length_(block->common_length_),
         current_(restarts_),
         restart_index_(num_restarts_) {
     assert(num_restarts_ > 0);
@@ -166,19 +296,58 @@ class Block::Iter : public Iterator {
     // with a key < target
     uint32_t left = 0;
     uint32_t right = num_restarts_ - 1;
+    bool less;
+    if (prefixes_ != nullptr && target.size() >= 8) {
+      // Restart keys whose prefix is smaller (larger) than that of "target"
+      // are smaller (larger) than "target", so only the restart points with
+      // an equal prefix are left for the binary search.
+      const Slice user_key(target.data(), target.size() - 8);
+      const size_t n = std::min<size_t>(user_key.size(), common_length_);
+      int r = memcmp(user_key.data(), common_prefix_, n);
+      if (r == 0 && user_key.size() < common_length_) {
+        r = -1;
+      }
+      if (r < 0) {
+        right = 0;  // "target" precedes every key
+      } else if (r > 0) {
+        left = right;  // "target" follows every key
+      } else {
+        uint32_t num_less, num_less_or_equal;
+        CountRestartPrefixes(
+            prefixes_, num_restarts_,
+            RestartKeyPrefix(user_key.data() + common_length_,
+                             user_key.size() - common_length_),
+            &num_less, &num_less_or_equal);
+        if (num_less > 0) left = num_less - 1;
+        right = (num_less_or_equal > 0) ? num_less_or_equal - 1 : 0;
+      }
+    } else if (buckets_ != nullptr && target.size() >= 8) {
+      // The hash index names the restart interval in which the user key of
+      // "target" first occurs.  Since keys that are not in the block may
+      // share its bucket, the restart keys around that interval are checked
+      // before the search range is narrowed to it.
+      const uint32_t hint = buckets_[HashIndexKey(target) % num_buckets_];
+      if (hint < num_restarts_) {
+        if (!RestartKeyLess(hint, target, &less)) return;
+        if (less) {
+          left = hint;
+          if (hint < right) {
+            if (!RestartKeyLess(hint + 1, target, &less)) return;
+            if (!less) right = hint;
+          }
+        } else if (hint > 0) {
+          right = hint - 1;
+          if (!RestartKeyLess(right, target, &less)) return;
+          if (less) left = right;
+        } else {
+          right = 0;
+        }
+      }
+    }
     while (left < right) {
       uint32_t mid = (left + right + 1) / 2;
-      uint32_t region_offset = GetRestartPoint(mid);
-      uint32_t shared, non_shared, value_length;
-      const char* key_ptr =
-          DecodeEntry(data_ + region_offset, data_ + restarts_, &shared,
-                      &non_shared, &value_length);
-      if (key_ptr == nullptr || (shared != 0)) {
-        CorruptionError();
-        return;
-      }
-      Slice mid_key(key_ptr, non_shared);
-      if (Compare(mid_key, target) < 0) {
+      if (!RestartKeyLess(mid, target, &less)) return;
+      if (less) {
         // Key at "mid" is smaller than "target".  Therefore all
         // blocks before "mid" are uninteresting.
         left = mid;
@@ -256,11 +425,10 @@ Iterator* Block::NewIterator(const Comparator* comparator) {
   if (size_ < sizeof(uint32_t)) {
     return NewErrorIterator(Status::Corruption("bad block contents"));
   }
-  const uint32_t num_restarts = NumRestarts();
-  if (num_restarts == 0) {
+  if (num_restarts_ == 0) {
     return NewEmptyIterator();
   } else {
-    return new Iter(comparator, data_, restart_offset_, num_restarts);
+    return new Iter(comparator, this);
   }
 }
 
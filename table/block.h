@@ -31,11 +31,15 @@ class Block {
  private:
   class Iter;
 
-  uint32_t NumRestarts() const;
-
   const char* data_;
   size_t size_;
   uint32_t restart_offset_;  // Offset in data_ of restart array
+  uint32_t num_restarts_;    // Number of entries in restart array
+  const uint8_t* buckets_;   // Hash index (nullptr if none)
+  uint32_t num_buckets_;
+  const char* prefixes_;       // Restart key prefixes (nullptr if none)
+  const char* common_prefix_;  // Bytes shared by all user keys
+  uint32_t common_length_;
   bool owned_;               // Block owns data_[]
 };
 
@@ -25,6 +25,28 @@
 //     restarts: uint32[num_restarts]
 //     num_restarts: uint32
 // restarts[i] contains the offset within the block of the ith restart point.
+//
+// Two optional extensions, which are only used for blocks of internal
+// keys, may follow the restart array.  Their presence is flagged in the
+// high bits of num_restarts:
+//     prefixes: uint64[num_restarts]       (if kRestartPrefixFlag)
+//     common_length: uint32
+//     buckets: uint8[num_buckets]          (if kHashIndexFlag)
+//     num_buckets: uint32
+//     num_restarts | flags: uint32
+//
+// With options.restart_key_prefixes, all user keys of the block share
+// their first common_length bytes, and prefixes[i] holds the next 8 bytes
+// of the user key at restart point i (see RestartKeyPrefix()).  Only
+// blocks of internal keys (see IsInternalKeyComparator()) get prefixes;
+// blocks with keys too short to be internal keys are written without.
+//
+// With options.data_block_hash_index, buckets[HashIndexKey(key) %
+// num_buckets] holds the index of the restart interval in which the user
+// key of "key" first occurs (or one of kHashIndexNoEntry and
+// kHashIndexCollision).  Blocks that would need too many restart points,
+// or that contain keys too short to be internal keys, are written without
+// a hash index.
 
 #include "table/block_builder.h"
 
@@ -34,12 +56,23 @@
 
 #include "leveldb/comparator.h"
 #include "leveldb/options.h"
+#include "table/format.h"
 #include "util/coding.h"
 
 namespace leveldb {
 
+// Number of hash index buckets for "n" distinct user keys, chosen so that
+// about three quarters of the buckets are in use.
+static size_t HashIndexBuckets(size_t n) { return n + n / 3 + 1; }
+
 BlockBuilder::BlockBuilder(const Options* options)
-    : options_(options), restarts_(), counter_(0), finished_(false) {
+    : options_(options),
+      restarts_(),
+      counter_(0),
+      finished_(false),
+      hash_index_(true),
+      internal_keys_(IsInternalKeyComparator(options->comparator)),
+      restart_prefixes_(internal_keys_) {
   assert(options->block_restart_interval >= 1);
   restarts_.push_back(0);  // First restart point is at offset 0
 }
@@ -51,12 +84,24 @@ void BlockBuilder::Reset() {
   counter_ = 0;
   finished_ = false;
   last_key_.clear();
+  hash_index_ = true;
+  key_hashes_.clear();
+  key_restarts_.clear();
+  restart_prefixes_ = internal_keys_;
+  restart_keys_.clear();
 }
 
 size_t BlockBuilder::CurrentSizeEstimate() const {
-  return (buffer_.size() +                       // Raw data buffer
-          restarts_.size() * sizeof(uint32_t) +  // Restart array
-          sizeof(uint32_t));                     // Restart array length
+  size_t estimate = buffer_.size() +                       // Raw data buffer
+                    restarts_.size() * sizeof(uint32_t) +  // Restart array
+                    sizeof(uint32_t);  // Restart array length
+  if (options_->data_block_hash_index && hash_index_) {
+    estimate += HashIndexBuckets(key_hashes_.size()) + sizeof(uint32_t);
+  }
+  if (options_->restart_key_prefixes && restart_prefixes_) {
+    estimate += restarts_.size() * sizeof(uint64_t) + sizeof(uint32_t);
+  }
+  return estimate;
 }
 
 Slice BlockBuilder::Finish() {
@@ -64,7 +109,46 @@ Slice BlockBuilder::Finish() {
   for (size_t i = 0; i < restarts_.size(); i++) {
     PutFixed32(&buffer_, restarts_[i]);
   }
-  PutFixed32(&buffer_, restarts_.size());
+  uint32_t flags = 0;
+  if (options_->restart_key_prefixes && restart_prefixes_ &&
+      restart_keys_.size() == restarts_.size() && !buffer_.empty()) {
+    // Since keys are sorted, every key starts with the bytes that the first
+    // and the last user key have in common.
+    const char* first = buffer_.data() + restart_keys_[0].first;
+    const size_t first_size = restart_keys_[0].second - 8;
+    const size_t last_size = last_key_.size() - 8;
+    size_t common = 0;
+    while (common < std::min(first_size, last_size) &&
+           first[common] == last_key_[common]) {
+      common++;
+    }
+    for (size_t i = 0; i < restart_keys_.size(); i++) {
+      const char* key = buffer_.data() + restart_keys_[i].first;
+      const size_t user_key_size = restart_keys_[i].second - 8;
+      PutFixed64(&buffer_,
+                 RestartKeyPrefix(key + common, user_key_size - common));
+    }
+    PutFixed32(&buffer_, common);
+    flags |= kRestartPrefixFlag;
+  }
+  if (options_->data_block_hash_index && hash_index_) {
+    // Append hash index
+    const size_t num_buckets = HashIndexBuckets(key_hashes_.size());
+    std::vector<uint8_t> buckets(num_buckets, kHashIndexNoEntry);
+    for (size_t i = 0; i < key_hashes_.size(); i++) {
+      uint8_t& bucket = buckets[key_hashes_[i] % num_buckets];
+      if (bucket == kHashIndexNoEntry) {
+        bucket = key_restarts_[i];
+      } else if (bucket != key_restarts_[i]) {
+        bucket = kHashIndexCollision;
+      }
+    }
+    buffer_.append(reinterpret_cast<const char*>(buckets.data()),
+                   num_buckets);
+    PutFixed32(&buffer_, num_buckets);
+    flags |= kHashIndexFlag;
+  }
+  PutFixed32(&buffer_, restarts_.size() | flags);
   finished_ = true;
   return Slice(buffer_);
 }
@@ -89,11 +173,35 @@ void BlockBuilder::Add(const Slice& key, const Slice& value) {
   }
   const size_t non_shared = key.size() - shared;
 
+  if (options_->data_block_hash_index && hash_index_) {
+    if (key.size() < 8 || restarts_.size() >= kHashIndexCollision) {
+      hash_index_ = false;
+      key_hashes_.clear();
+      key_restarts_.clear();
+    } else if (buffer_.empty() ||
+               Slice(key.data(), key.size() - 8) !=
+                   Slice(last_key_.data(), last_key_.size() - 8)) {
+      // First entry of a new user key
+      key_hashes_.push_back(HashIndexKey(key));
+      key_restarts_.push_back(restarts_.size() - 1);
+    }
+  }
+
+  if (options_->restart_key_prefixes && restart_prefixes_ && key.size() < 8) {
+    restart_prefixes_ = false;
+    restart_keys_.clear();
+  }
+  const bool is_restart = (buffer_.size() == restarts_.back());
+
   // Add "<shared><non_shared><value_size>" to buffer_
   PutVarint32(&buffer_, shared);
   PutVarint32(&buffer_, non_shared);
   PutVarint32(&buffer_, value.size());
 
+  if (options_->restart_key_prefixes && restart_prefixes_ && is_restart) {
+    restart_keys_.emplace_back(buffer_.size(), key.size());
+  }
+
   // Add string delta to buffer_ followed by value
   buffer_.append(key.data() + shared, non_shared);
   buffer_.append(value.data(), value.size());
@@ -7,14 +7,52 @@
 
 #include <stdint.h>
 
+#include <utility>
 #include <vector>
 
 #include "leveldb/slice.h"
+#include "util/hash.h"
 
 namespace leveldb {
 
 struct Options;
 
+// The optional hash index of a data block (see block_builder.cc) maps the
+// hash of a user key to the restart interval in which the key first
+// occurs.  Buckets without a key hold kHashIndexNoEntry and buckets shared
+// by keys of different restart intervals hold kHashIndexCollision, so a
+// block with a hash index has fewer than kHashIndexCollision restarts.
+static const uint8_t kHashIndexNoEntry = 255;
+static const uint8_t kHashIndexCollision = 254;
+
+// Set in the restart count at the end of a block that has a hash index.
+static const uint32_t kHashIndexFlag = 1u << 31;
+
+// Set in the restart count at the end of a block that stores the key
+// prefixes of its restart points.
+static const uint32_t kRestartPrefixFlag = 1u << 30;
+
+// Return the hash of the user key part of "key", an internal key.  The
+// hash index stores the key in bucket HashIndexKey(key) % num_buckets.
+// REQUIRES: key.size() >= 8
+inline uint32_t HashIndexKey(const Slice& key) {
+  return Hash(key.data(), key.size() - 8, 0x5bd1e995);
+}
+
+// Return the first 8 bytes of "p[0,n-1]", padded with zeros, as a
+// big-endian number, so that the numbers of two byte strings compare like
+// their first 8 bytes.
+inline uint64_t RestartKeyPrefix(const char* p, size_t n) {
+  uint64_t result = 0;
+  for (size_t i = 0; i < 8; i++) {
+    result <<= 8;
+    if (i < n) {
+      result |= static_cast<uint8_t>(p[i]);
+    }
+  }
+  return result;
+}
+
 class BlockBuilder {
  public:
   explicit BlockBuilder(const Options* options);
@@ -48,6 +86,18 @@ class BlockBuilder {
   int counter_;                     // Number of entries emitted since restart
   bool finished_;                   // Has Finish() been called?
   std::string last_key_;
+
+  // Hash index: hash and restart interval of every distinct user key.
+  // Cleared when a key cannot be indexed.
+  bool hash_index_;
+  std::vector<uint32_t> key_hashes_;
+  std::vector<uint8_t> key_restarts_;
+
+  // Restart key prefixes: offset in buffer_ and size of every restart key.
+  // Cleared when a key cannot be indexed.
+  const bool internal_keys_;  // Keys are internal keys of a DB
+  bool restart_prefixes_;
+  std::vector<std::pair<uint32_t, uint32_t>> restart_keys_;
 };
 
 }  // namespace leveldb
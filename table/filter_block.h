@@ -56,6 +56,11 @@ class FilterBlockReader {
   FilterBlockReader(const FilterPolicy* policy, const Slice& contents);
   bool KeyMayMatch(uint64_t block_offset, const Slice& key);
 
+  // Set results[i] to KeyMayMatch(block_offset, keys[i]) for each i in
+  // [0,n-1], probing the filter for all keys at once.
+  void KeysMayMatch(uint64_t block_offset, const Slice* keys, int n,
+                    bool* results);
+
  private:
   const FilterPolicy* policy_;
   const char* data_;    // Pointer to filter data (at block-start)
@@ -71,6 +71,35 @@ TEST(FilterBlockTest, SingleChunk) {
   ASSERT_TRUE(!reader.KeyMayMatch(100, "other"));
 }
 
+TEST(FilterBlockTest, BatchMatch) {
+  FilterBlockBuilder builder(&policy_);
+  builder.StartBlock(100);
+  builder.AddKey("foo");
+  builder.AddKey("bar");
+  builder.StartBlock(9000);
+  builder.AddKey("hello");
+  Slice block = builder.Finish();
+  FilterBlockReader reader(&policy_, block);
+  Slice keys[] = {"bar", "missing", "foo"};
+  bool results[3];
+  reader.KeysMayMatch(100, keys, 3, results);
+  ASSERT_TRUE(results[0]);
+  ASSERT_TRUE(!results[1]);
+  ASSERT_TRUE(results[2]);
+
+  // Empty filter
+  reader.KeysMayMatch(3100, keys, 3, results);
+  ASSERT_TRUE(!results[0]);
+  ASSERT_TRUE(!results[1]);
+  ASSERT_TRUE(!results[2]);
+
+  // Past the last filter
+  reader.KeysMayMatch(100000, keys, 3, results);
+  ASSERT_TRUE(results[0]);
+  ASSERT_TRUE(results[1]);
+  ASSERT_TRUE(results[2]);
+}
+
 TEST(FilterBlockTest, MultiChunk) {
   FilterBlockBuilder builder(&policy_);
 
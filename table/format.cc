@@ -4,6 +4,9 @@
 
 #include "table/format.h"
 
+#include <string.h>
+
+#include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "port/port.h"
 #include "table/block.h"
@@ -33,8 +36,10 @@ void Footer::EncodeTo(std::string* dst) const {
   metaindex_handle_.EncodeTo(dst);
   index_handle_.EncodeTo(dst);
   dst->resize(2 * BlockHandle::kMaxEncodedLength);  // Padding
-  PutFixed32(dst, static_cast<uint32_t>(kTableMagicNumber & 0xffffffffu));
-  PutFixed32(dst, static_cast<uint32_t>(kTableMagicNumber >> 32));
+  const uint64_t magic =
+      partitioned_index_ ? kPartitionedTableMagicNumber : kTableMagicNumber;
+  PutFixed32(dst, static_cast<uint32_t>(magic & 0xffffffffu));
+  PutFixed32(dst, static_cast<uint32_t>(magic >> 32));
   assert(dst->size() == original_size + kEncodedLength);
   (void)original_size;  // Disable unused variable warning.
 }
@@ -45,9 +50,10 @@ Status Footer::DecodeFrom(Slice* input) {
   const uint32_t magic_hi = DecodeFixed32(magic_ptr + 4);
   const uint64_t magic = ((static_cast<uint64_t>(magic_hi) << 32) |
                           (static_cast<uint64_t>(magic_lo)));
-  if (magic != kTableMagicNumber) {
+  if (magic != kTableMagicNumber && magic != kPartitionedTableMagicNumber) {
     return Status::Corruption("not an sstable (bad magic number)");
   }
+  partitioned_index_ = (magic == kPartitionedTableMagicNumber);
 
   Status result = metaindex_handle_.DecodeFrom(input);
   if (result.ok()) {
@@ -61,6 +67,90 @@ Status Footer::DecodeFrom(Slice* input) {
   return result;
 }
 
+namespace {
+
+class ReadaheadFile : public RandomAccessFile {
+ public:
+  ReadaheadFile(RandomAccessFile* file, size_t readahead_size)
+      : file_(file),
+        readahead_size_(readahead_size),
+        buffer_(nullptr),
+        buffer_offset_(0),
+        buffer_length_(0),
+        direct_(false) {}
+
+  ~ReadaheadFile() override { delete[] buffer_; }
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override {
+    if (direct_ || n > readahead_size_) {
+      return file_->Read(offset, n, result, scratch);
+    }
+    if (offset < buffer_offset_ ||
+        offset + n > buffer_offset_ + buffer_length_) {
+      if (buffer_ == nullptr) {
+        buffer_ = new char[readahead_size_];
+      }
+      // Read the chunk that ends with the requested bytes if the reader
+      // moves backwards, e.g. for a reverse scan.
+      const bool backwards = buffer_length_ > 0 && offset < buffer_offset_;
+      uint64_t start = offset;
+      if (backwards && offset + n > readahead_size_) {
+        start = offset + n - readahead_size_;
+      } else if (backwards) {
+        start = 0;
+      }
+      buffer_length_ = 0;
+      Slice chunk;
+      Status s = file_->Read(start, readahead_size_, &chunk, buffer_);
+      if (!s.ok()) {
+        // Some files refuse reads past their end.
+        return file_->Read(offset, n, result, scratch);
+      }
+      if (chunk.data() != buffer_) {
+        // Reading ahead does not help files that hand out their own memory.
+        direct_ = true;
+        delete[] buffer_;
+        buffer_ = nullptr;
+        return file_->Read(offset, n, result, scratch);
+      }
+      buffer_offset_ = start;
+      buffer_length_ = chunk.size();
+      if (offset >= buffer_offset_ + buffer_length_) {
+        return file_->Read(offset, n, result, scratch);  // Past the end
+      }
+    }
+    const size_t available =
+        static_cast<size_t>(buffer_offset_ + buffer_length_ - offset);
+    if (n > available) {
+      n = available;  // Short read at the end of the file
+    }
+    memcpy(scratch, buffer_ + (offset - buffer_offset_), n);
+    *result = Slice(scratch, n);
+    return Status::OK();
+  }
+
+ private:
+  RandomAccessFile* const file_;
+  const size_t readahead_size_;
+  mutable char* buffer_;
+  mutable uint64_t buffer_offset_;
+  mutable size_t buffer_length_;
+  mutable bool direct_;
+};
+
+}  // namespace
+
+RandomAccessFile* NewReadaheadFile(RandomAccessFile* file,
+                                   size_t readahead_size) {
+  return new ReadaheadFile(file, readahead_size);
+}
+
+bool IsInternalKeyComparator(const Comparator* comparator) {
+  // Must match InternalKeyComparator::Name()
+  return strcmp(comparator->Name(), "leveldb.InternalKeyComparator") == 0;
+}
+
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
                  const BlockHandle& handle, BlockContents* result) {
   result->data = Slice();
@@ -17,6 +17,7 @@
 namespace leveldb {
 
 class Block;
+class Comparator;
 class RandomAccessFile;
 struct ReadOptions;
 
@@ -64,12 +65,18 @@ class Footer {
   const BlockHandle& index_handle() const { return index_handle_; }
   void set_index_handle(const BlockHandle& h) { index_handle_ = h; }
 
+  // True if the index block is the top level of a partitioned index.
+  // Stored in the magic number, so that older readers reject the table.
+  bool partitioned_index() const { return partitioned_index_; }
+  void set_partitioned_index(bool p) { partitioned_index_ = p; }
+
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(Slice* input);
 
  private:
   BlockHandle metaindex_handle_;
   BlockHandle index_handle_;
+  bool partitioned_index_ = false;
 };
 
 // kTableMagicNumber was picked by running
@@ -77,6 +84,11 @@ class Footer {
 // and taking the leading 64 bits.
 static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 
+// Magic number of tables with a partitioned index, picked by running
+//    echo http://code.google.com/p/leveldb/#partitioned-index | sha1sum
+// and taking the leading 64 bits.
+static const uint64_t kPartitionedTableMagicNumber = 0xa92ec9c14b52dc15ull;
+
 #ifdef VE_OPT
 // 1-byte type + 32-bit crc + 3padding
 static const size_t kBlockTrailerSize = 8;
@@ -96,6 +108,21 @@ struct BlockContents {
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
                  const BlockHandle& handle, BlockContents* result);
 
+// Return a file that reads "file" ahead in chunks of "readahead_size"
+// bytes and serves reads that fall into the last chunk from memory, so
+// that reading consecutive blocks takes few large reads.  Files that
+// return their own memory from Read() (e.g. mmap-ed files) are read
+// directly.  The result does not own "file" and must only be used by one
+// thread at a time.
+RandomAccessFile* NewReadaheadFile(RandomAccessFile* file,
+                                   size_t readahead_size);
+
+// Return true iff "comparator" orders the internal keys of a DB (see
+// InternalKeyComparator in db/dbformat.h), i.e. every key ends in an
+// 8-byte sequence number and type.  Block and table features that look at
+// the user key part of a key are only used for such tables.
+bool IsInternalKeyComparator(const Comparator* comparator);
+
 // Implementation details follow.  Clients should ignore,
 
 inline BlockHandle::BlockHandle()
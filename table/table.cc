@@ -4,11 +4,14 @@
 
 #include "leveldb/table.h"
 
+#include <algorithm>
+
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/slice_transform.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -22,6 +25,7 @@ struct Table::Rep {
     delete filter;
     delete[] filter_data;
     delete index_block;
+    delete range_del_block;
   }
 
   Options options;
@@ -30,9 +34,14 @@ struct Table::Rep {
   uint64_t cache_id;
   FilterBlockReader* filter;
   const char* filter_data;
+  bool partitioned_index;   // index_block is the top-level index
+  bool partitioned_filter;  // Filter partitions are listed in index_block
+  bool prefix_filtered;     // Filters also hold the prefixes of the keys
 
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
   Block* index_block;
+  Block* range_del_block;  // nullptr if the table has no range deletions
+  Status range_del_status;  // Why the range deletions could not be read
 };
 
 Status Table::Open(const Options& options, RandomAccessFile* file,
@@ -74,6 +83,10 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
     rep->filter_data = nullptr;
     rep->filter = nullptr;
+    rep->partitioned_index = footer.partitioned_index();
+    rep->partitioned_filter = false;
+    rep->prefix_filtered = false;
+    rep->range_del_block = nullptr;
     *table = new Table(rep);
     (*table)->ReadMeta(footer);
   }
@@ -82,10 +95,6 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
 }
 
 void Table::ReadMeta(const Footer& footer) {
-  if (rep_->options.filter_policy == nullptr) {
-    return;  // Do not need any metadata
-  }
-
   // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
   // it is an empty block.
   ReadOptions opt;
@@ -93,18 +102,39 @@ void Table::ReadMeta(const Footer& footer) {
     opt.verify_checksums = true;
   }
   BlockContents contents;
-  if (!ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents).ok()) {
-    // Do not propagate errors since meta info is not needed for operation
+  Status s = ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents);
+  if (!s.ok()) {
+    // Do not propagate errors since meta info is not needed for operation,
+    // except for the range deletions, which may hide entries.
+    rep_->range_del_status = s;
     return;
   }
   Block* meta = new Block(contents);
 
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
-  key.append(rep_->options.filter_policy->Name());
-  iter->Seek(key);
-  if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+  iter->Seek("rangedel");
+  if (iter->Valid() && iter->key() == Slice("rangedel")) {
+    ReadRangeDeletions(iter->value());
+  }
+  if (rep_->options.filter_policy != nullptr) {
+    std::string key = "filter.";
+    key.append(rep_->options.filter_policy->Name());
+    iter->Seek(key);
+    if (iter->Valid() && iter->key() == Slice(key)) {
+      ReadFilter(iter->value());
+    } else if (rep_->partitioned_index) {
+      key = "partitionedfilter.";
+      key.append(rep_->options.filter_policy->Name());
+      iter->Seek(key);
+      rep_->partitioned_filter = iter->Valid() && iter->key() == Slice(key);
+    }
+    if (rep_->options.prefix_extractor != nullptr &&
+        (rep_->filter != nullptr || rep_->partitioned_filter)) {
+      key = "prefix.";
+      key.append(rep_->options.prefix_extractor->Name());
+      iter->Seek(key);
+      rep_->prefix_filtered = iter->Valid() && iter->key() == Slice(key);
+    }
   }
   delete iter;
   delete meta;
@@ -133,6 +163,27 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
   rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
 }
 
+void Table::ReadRangeDeletions(const Slice& handle_value) {
+  Slice v = handle_value;
+  BlockHandle handle;
+  Status s = handle.DecodeFrom(&v);
+  if (!s.ok()) {
+    rep_->range_del_status = s;
+    return;
+  }
+  ReadOptions opt;
+  if (rep_->options.paranoid_checks) {
+    opt.verify_checksums = true;
+  }
+  BlockContents contents;
+  s = ReadBlock(rep_->file, opt, handle, &contents);
+  if (s.ok()) {
+    rep_->range_del_block = new Block(contents);
+  } else {
+    rep_->range_del_status = s;
+  }
+}
+
 Table::~Table() { delete rep_; }
 
 static void DeleteBlock(void* arg, void* ignored) {
@@ -155,6 +206,43 @@ static void ReleaseBlock(void* arg, void* h) {
 Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
                              const Slice& index_value) {
   Table* table = reinterpret_cast<Table*>(arg);
+  return BlockReader(table, table->rep_->file, options, index_value, false);
+}
+
+namespace {
+
+// The state of an iterator with readahead.
+struct ReadaheadState {
+  Table* table;
+  RandomAccessFile* file;
+};
+
+}  // namespace
+
+static void DeleteReadaheadState(void* arg, void* ignored) {
+  ReadaheadState* state = reinterpret_cast<ReadaheadState*>(arg);
+  delete state->file;
+  delete state;
+}
+
+// Like BlockReader(), but reads through the readahead file of an iterator.
+Iterator* Table::ReadaheadBlockReader(void* arg, const ReadOptions& options,
+                                      const Slice& index_value) {
+  ReadaheadState* state = reinterpret_cast<ReadaheadState*>(arg);
+  return BlockReader(state->table, state->file, options, index_value, false);
+}
+
+// Like BlockReader(), but for the index partitions listed in the top-level
+// index, which are cached with high priority.
+Iterator* Table::IndexPartitionReader(void* arg, const ReadOptions& options,
+                                      const Slice& index_value) {
+  Table* table = reinterpret_cast<Table*>(arg);
+  return BlockReader(table, table->rep_->file, options, index_value, true);
+}
+
+Iterator* Table::BlockReader(Table* table, RandomAccessFile* file,
+                             const ReadOptions& options,
+                             const Slice& index_value, bool high_priority) {
   Cache* block_cache = table->rep_->options.block_cache;
   Block* block = nullptr;
   Cache::Handle* cache_handle = nullptr;
@@ -176,17 +264,18 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
       if (cache_handle != nullptr) {
         block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
       } else {
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
+        s = ReadBlock(file, options, handle, &contents);
         if (s.ok()) {
           block = new Block(contents);
           if (contents.cachable && options.fill_cache) {
-            cache_handle = block_cache->Insert(key, block, block->size(),
-                                               &DeleteCachedBlock);
+            cache_handle = block_cache->Insert(
+                key, block, block->size(), &DeleteCachedBlock,
+                high_priority ? Cache::kHighPriority : Cache::kLowPriority);
           }
         }
       }
     } else {
-      s = ReadBlock(table->rep_->file, options, handle, &contents);
+      s = ReadBlock(file, options, handle, &contents);
       if (s.ok()) {
         block = new Block(contents);
       }
@@ -207,24 +296,172 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
   return iter;
 }
 
+Iterator* Table::NewIndexIterator(const ReadOptions& options) const {
+  Iterator* iter = rep_->index_block->NewIterator(rep_->options.comparator);
+  if (rep_->partitioned_index) {
+    // Index partitions are read and cached like data blocks.  The reader
+    // ignores the filter partition that follows the index partition handle.
+    iter = NewTwoLevelIterator(iter, &Table::IndexPartitionReader,
+                               const_cast<Table*>(this), options);
+  }
+  return iter;
+}
+
 Iterator* Table::NewIterator(const ReadOptions& options) const {
-  return NewTwoLevelIterator(
-      rep_->index_block->NewIterator(rep_->options.comparator),
-      &Table::BlockReader, const_cast<Table*>(this), options);
+  return NewIterator(options, nullptr, nullptr);
+}
+
+Iterator* Table::NewIterator(const ReadOptions& options,
+                             const Slice* lower_bound,
+                             const Slice* upper_bound) const {
+  const Comparator* comparator =
+      (lower_bound != nullptr || upper_bound != nullptr)
+          ? rep_->options.comparator
+          : nullptr;
+  if (options.readahead_size > 0) {
+    ReadaheadState* state = new ReadaheadState;
+    state->table = const_cast<Table*>(this);
+    state->file = NewReadaheadFile(rep_->file, options.readahead_size);
+    Iterator* iter = NewTwoLevelIterator(
+        NewIndexIterator(options), &Table::ReadaheadBlockReader, state,
+        options, comparator, lower_bound, upper_bound);
+    iter->RegisterCleanup(&DeleteReadaheadState, state, nullptr);
+    return iter;
+  }
+  return NewTwoLevelIterator(NewIndexIterator(options), &Table::BlockReader,
+                             const_cast<Table*>(this), options, comparator,
+                             lower_bound, upper_bound);
+}
+
+Iterator* Table::NewRangeDeletionIterator() const {
+  if (!rep_->range_del_status.ok()) {
+    return NewErrorIterator(rep_->range_del_status);
+  }
+  if (rep_->range_del_block == nullptr) {
+    return NewEmptyIterator();
+  }
+  return rep_->range_del_block->NewIterator(rep_->options.comparator);
+}
+
+namespace {
+
+// A filter partition, as stored in the block cache.
+struct FilterPartition {
+  FilterPartition(const FilterPolicy* policy, const BlockContents& contents)
+      : reader(policy, contents.data),
+        data(contents.heap_allocated ? contents.data.data() : nullptr) {}
+  ~FilterPartition() { delete[] data; }
+
+  FilterBlockReader reader;
+  const char* data;  // Owned, or null if not heap allocated
+};
+
+}  // namespace
+
+static void DeleteCachedFilterPartition(const Slice& key, void* value) {
+  delete reinterpret_cast<FilterPartition*>(value);
+}
+
+void Table::KeysMayMatch(const ReadOptions& options, uint64_t block_offset,
+                         const Slice* keys, int n, bool* results) {
+  if (rep_->filter != nullptr) {
+    rep_->filter->KeysMayMatch(block_offset, keys, n, results);
+    return;
+  }
+  std::fill(results, results + n, true);
+  if (!rep_->partitioned_filter) {
+    return;
+  }
+
+  // The top-level index entry of the partition that holds keys[0] lists
+  // the filter partition handle and the offset its block offsets are
+  // relative to.  Errors are treated as a match, as for unfiltered tables.
+  Iterator* iter = rep_->index_block->NewIterator(rep_->options.comparator);
+  iter->Seek(keys[0]);
+  BlockHandle index_handle, filter_handle;
+  uint64_t base;
+  Slice input;
+  if (iter->Valid()) {
+    input = iter->value();
+  }
+  if (iter->Valid() && index_handle.DecodeFrom(&input).ok() &&
+      filter_handle.DecodeFrom(&input).ok() && GetVarint64(&input, &base) &&
+      block_offset >= base) {
+    Cache* block_cache = rep_->options.block_cache;
+    FilterPartition* partition = nullptr;
+    Cache::Handle* cache_handle = nullptr;
+    char cache_key_buffer[16];
+    EncodeFixed64(cache_key_buffer, rep_->cache_id);
+    EncodeFixed64(cache_key_buffer + 8, filter_handle.offset());
+    Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+    if (block_cache != nullptr) {
+      cache_handle = block_cache->Lookup(key);
+    }
+    if (cache_handle != nullptr) {
+      partition =
+          reinterpret_cast<FilterPartition*>(block_cache->Value(cache_handle));
+    } else {
+      BlockContents contents;
+      if (ReadBlock(rep_->file, options, filter_handle, &contents).ok()) {
+        partition =
+            new FilterPartition(rep_->options.filter_policy, contents);
+        if (block_cache != nullptr && contents.cachable &&
+            options.fill_cache) {
+          cache_handle = block_cache->Insert(
+              key, partition, contents.data.size(),
+              &DeleteCachedFilterPartition, Cache::kHighPriority);
+        }
+      }
+    }
+    if (partition != nullptr) {
+      partition->reader.KeysMayMatch(block_offset - base, keys, n, results);
+      if (cache_handle != nullptr) {
+        block_cache->Release(cache_handle);
+      } else {
+        delete partition;
+      }
+    }
+  }
+  delete iter;
+}
+
+bool Table::PrefixMayMatch(const ReadOptions& options,
+                           const Slice& prefix_key) {
+  if (!rep_->prefix_filtered) {
+    return true;
+  }
+  // The first key at or after "prefix_key" is the first key with the
+  // prefix if there is any, and the filter of its block holds the prefix.
+  Iterator* iiter = NewIndexIterator(options);
+  iiter->Seek(prefix_key);
+  bool may_match = !iiter->status().ok();
+  if (iiter->Valid()) {
+    Slice handle_value = iiter->value();
+    BlockHandle handle;
+    may_match = true;
+    if (handle.DecodeFrom(&handle_value).ok()) {
+      KeysMayMatch(options, handle.offset(), &prefix_key, 1, &may_match);
+    }
+  }
+  delete iiter;
+  return may_match;
 }
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
                           void (*handle_result)(void*, const Slice&,
                                                 const Slice&)) {
   Status s;
-  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* iiter = NewIndexIterator(options);
   iiter->Seek(k);
   if (iiter->Valid()) {
     Slice handle_value = iiter->value();
-    FilterBlockReader* filter = rep_->filter;
     BlockHandle handle;
-    if (filter != nullptr && handle.DecodeFrom(&handle_value).ok() &&
-        !filter->KeyMayMatch(handle.offset(), k)) {
+    bool may_match = true;
+    if ((rep_->filter != nullptr || rep_->partitioned_filter) &&
+        handle.DecodeFrom(&handle_value).ok()) {
+      KeysMayMatch(options, handle.offset(), &k, 1, &may_match);
+    }
+    if (!may_match) {
       // Not found
     } else {
       Iterator* block_iter = BlockReader(this, options, iiter->value());
@@ -243,9 +480,66 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
   return s;
 }
 
+void Table::InternalMultiGet(const ReadOptions& options, int n,
+                             const Slice* keys, void* const* args,
+                             Status* statuses,
+                             void (*handle_result)(void*, const Slice&,
+                                                   const Slice&)) {
+  const Comparator* cmp = rep_->options.comparator;
+  const bool has_filter = rep_->filter != nullptr || rep_->partitioned_filter;
+  Iterator* iiter = NewIndexIterator(options);
+  bool* may_match = has_filter ? new bool[n] : nullptr;
+  int i = 0;
+  while (i < n) {
+    iiter->Seek(keys[i]);
+    if (!iiter->Valid()) {
+      // keys[i..n-1] all lie past the last block.
+      Status s = iiter->status();
+      for (; i < n; i++) {
+        statuses[i] = s;
+      }
+      break;
+    }
+
+    // The following keys up to the separator of this index entry fall
+    // into the same block.
+    int end = i + 1;
+    while (end < n && cmp->Compare(keys[end], iiter->key()) <= 0) {
+      end++;
+    }
+
+    Slice handle_value = iiter->value();
+    BlockHandle handle;
+    const bool use_filter =
+        has_filter && handle.DecodeFrom(&handle_value).ok();
+    if (use_filter) {
+      // Probe the filter for all keys of this block at once.
+      KeysMayMatch(options, handle.offset(), keys + i, end - i,
+                   may_match + i);
+    }
+    Iterator* block_iter = nullptr;
+    for (; i < end; i++) {
+      if (use_filter && !may_match[i]) {
+        statuses[i] = Status::OK();  // Not found
+        continue;
+      }
+      if (block_iter == nullptr) {
+        block_iter = BlockReader(this, options, iiter->value());
+      }
+      block_iter->Seek(keys[i]);
+      if (block_iter->Valid()) {
+        (*handle_result)(args[i], block_iter->key(), block_iter->value());
+      }
+      statuses[i] = block_iter->status();
+    }
+    delete block_iter;
+  }
+  delete[] may_match;
+  delete iiter;
+}
+
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
-  Iterator* index_iter =
-      rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* index_iter = NewIndexIterator(ReadOptions());
   index_iter->Seek(key);
   uint64_t result;
   if (index_iter->Valid()) {
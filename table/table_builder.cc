@@ -6,10 +6,15 @@
 
 #include <assert.h>
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/slice_transform.h"
 #include "table/block_builder.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -26,6 +31,8 @@ struct TableBuilder::Rep {
         offset(0),
         data_block(&options),
         index_block(&index_block_options),
+        top_index_block(&index_block_options),
+        partition_offset(0),
         num_entries(0),
         closed(false),
         filter_block(opt.filter_policy == nullptr
@@ -33,6 +40,11 @@ struct TableBuilder::Rep {
                          : new FilterBlockBuilder(opt.filter_policy)),
         pending_index_entry(false) {
     index_block_options.block_restart_interval = 1;
+    index_block_options.data_block_hash_index = false;
+    if (!IsInternalKeyComparator(opt.comparator)) {
+      // Prefixes are taken from the user key part of internal keys.
+      options.prefix_extractor = nullptr;
+    }
   }
 
   Options options;
@@ -41,12 +53,17 @@ struct TableBuilder::Rep {
   uint64_t offset;
   Status status;
   BlockBuilder data_block;
-  BlockBuilder index_block;
+  BlockBuilder index_block;  // Current partition if partitioned
+  BlockBuilder top_index_block;
+  uint64_t partition_offset;  // Offset of the first block of the partition
   std::string last_key;
   int64_t num_entries;
   bool closed;  // Either Finish() or Abandon() has been called.
   FilterBlockBuilder* filter_block;
 
+  // The filter key of the last prefix added to the filters (see Add()).
+  std::string last_prefix_key;
+
   // We do not emit the index entry for a block until we have seen the
   // first key for the next data block.  This allows us to use shorter
   // keys in the index block.  For example, consider a block boundary
@@ -60,6 +77,9 @@ struct TableBuilder::Rep {
   BlockHandle pending_handle;  // Handle to add to index block
 
   std::string compressed_output;
+
+  // Written out in sorted order by Finish()
+  std::vector<std::pair<std::string, std::string>> range_deletions;
 };
 
 TableBuilder::TableBuilder(const Options& options, WritableFile* file)
@@ -82,12 +102,21 @@ Status TableBuilder::ChangeOptions(const Options& options) {
   if (options.comparator != rep_->options.comparator) {
     return Status::InvalidArgument("changing comparator while building table");
   }
+  if (options.partition_index_and_filters !=
+      rep_->options.partition_index_and_filters) {
+    return Status::InvalidArgument(
+        "changing partition_index_and_filters while building table");
+  }
 
   // Note that any live BlockBuilders point to rep_->options and therefore
   // will automatically pick up the updated options.
   rep_->options = options;
   rep_->index_block_options = options;
   rep_->index_block_options.block_restart_interval = 1;
+  rep_->index_block_options.data_block_hash_index = false;
+  if (!IsInternalKeyComparator(options.comparator)) {
+    rep_->options.prefix_extractor = nullptr;
+  }
   return Status::OK();
 }
 
@@ -106,10 +135,18 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
     r->pending_handle.EncodeTo(&handle_encoding);
     r->index_block.Add(r->last_key, Slice(handle_encoding));
     r->pending_index_entry = false;
+    if (r->options.partition_index_and_filters &&
+        r->index_block.CurrentSizeEstimate() >=
+            r->options.index_partition_size) {
+      WriteIndexPartition(r->last_key);
+    }
   }
 
   if (r->filter_block != nullptr) {
     r->filter_block->AddKey(key);
+    if (r->options.prefix_extractor != nullptr && key.size() >= 8) {
+      AddPrefixToFilter(key);
+    }
   }
 
   r->last_key.assign(key.data(), key.size());
@@ -122,6 +159,38 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
   }
 }
 
+void TableBuilder::AddRangeDeletion(const Slice& key, const Slice& value) {
+  Rep* r = rep_;
+  assert(!r->closed);
+  if (!ok()) return;
+  r->range_deletions.emplace_back(key.ToString(), value.ToString());
+}
+
+// Adds the prefix of the user key of "key" to the filters the first time
+// it occurs.  Since keys with the same prefix are adjacent, this is the
+// filter of the block that holds the first key at or after the prefix.
+// The prefix is passed in the form of an internal key with the 8-byte
+// trailer of "key", of which the filter policy only looks at the user key.
+void TableBuilder::AddPrefixToFilter(const Slice& key) {
+  Rep* r = rep_;
+  const Slice user_key(key.data(), key.size() - 8);
+  const SliceTransform* extractor = r->options.prefix_extractor;
+  if (!extractor->InDomain(user_key)) {
+    return;
+  }
+  const Slice prefix = extractor->Transform(user_key);
+  const Slice last_prefix(r->last_prefix_key.data(),
+                          r->last_prefix_key.empty()
+                              ? 0
+                              : r->last_prefix_key.size() - 8);
+  if (!r->last_prefix_key.empty() && prefix == last_prefix) {
+    return;
+  }
+  r->last_prefix_key.assign(prefix.data(), prefix.size());
+  r->last_prefix_key.append(key.data() + user_key.size(), 8);
+  r->filter_block->AddKey(r->last_prefix_key);
+}
+
 void TableBuilder::Flush() {
   Rep* r = rep_;
   assert(!r->closed);
@@ -134,8 +203,35 @@ void TableBuilder::Flush() {
     r->status = r->file->Flush();
   }
   if (r->filter_block != nullptr) {
-    r->filter_block->StartBlock(r->offset);
+    r->filter_block->StartBlock(r->offset - r->partition_offset);
+  }
+}
+
+// Writes out the current index partition and the filter partition of the
+// same data blocks, and adds an entry for them to the top-level index:
+//    last_key -> index partition handle [filter partition handle, base]
+// where filter offsets are relative to "base", the offset of the first
+// data block of the partition.
+void TableBuilder::WriteIndexPartition(const Slice& last_key) {
+  Rep* r = rep_;
+  assert(!r->index_block.empty());
+  std::string top_key = last_key.ToString();
+  BlockHandle index_handle, filter_handle;
+  WriteBlock(&r->index_block, &index_handle);
+  if (!ok()) return;
+  std::string handle_encoding;
+  index_handle.EncodeTo(&handle_encoding);
+  if (r->filter_block != nullptr) {
+    WriteRawBlock(r->filter_block->Finish(), kNoCompression, &filter_handle);
+    if (!ok()) return;
+    filter_handle.EncodeTo(&handle_encoding);
+    PutVarint64(&handle_encoding, r->partition_offset);
+    delete r->filter_block;
+    r->filter_block = new FilterBlockBuilder(r->options.filter_policy);
+    r->filter_block->StartBlock(0);
   }
+  r->top_index_block.Add(top_key, handle_encoding);
+  r->partition_offset = r->offset;
 }
 
 void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
@@ -201,18 +297,68 @@ Status TableBuilder::Finish() {
   assert(!r->closed);
   r->closed = true;
 
-  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle,
+      range_del_block_handle;
+
+  // Write the last index partition, which also holds the last filters
+  const bool partitioned = r->options.partition_index_and_filters;
+  if (ok() && partitioned) {
+    if (r->pending_index_entry) {
+      r->options.comparator->FindShortSuccessor(&r->last_key);
+      std::string handle_encoding;
+      r->pending_handle.EncodeTo(&handle_encoding);
+      r->index_block.Add(r->last_key, Slice(handle_encoding));
+      r->pending_index_entry = false;
+    }
+    if (!r->index_block.empty()) {
+      WriteIndexPartition(r->last_key);
+    }
+  }
 
   // Write filter block
-  if (ok() && r->filter_block != nullptr) {
+  if (ok() && r->filter_block != nullptr && !partitioned) {
     WriteRawBlock(r->filter_block->Finish(), kNoCompression,
                   &filter_block_handle);
   }
 
+  // The metaindex and the range deletions are read without the help of
+  // the fixed-width restart key prefixes.
+  Options range_del_options = r->index_block_options;
+  range_del_options.restart_key_prefixes = false;
+
+  // Write range deletion block
+  if (ok() && !r->range_deletions.empty()) {
+    const Comparator* cmp = r->options.comparator;
+    std::sort(r->range_deletions.begin(), r->range_deletions.end(),
+              [cmp](const std::pair<std::string, std::string>& a,
+                    const std::pair<std::string, std::string>& b) {
+                return cmp->Compare(a.first, b.first) < 0;
+              });
+    BlockBuilder range_del_block(&range_del_options);
+    for (size_t i = 0; i < r->range_deletions.size(); i++) {
+      const auto& range_deletion = r->range_deletions[i];
+      if (i > 0 && cmp->Compare(range_deletion.first,
+                                r->range_deletions[i - 1].first) == 0) {
+        continue;  // Duplicate
+      }
+      range_del_block.Add(range_deletion.first, range_deletion.second);
+    }
+    WriteBlock(&range_del_block, &range_del_block_handle);
+  }
+
   // Write metaindex block
   if (ok()) {
-    BlockBuilder meta_index_block(&r->options);
-    if (r->filter_block != nullptr) {
+    // The metaindex holds plain keys, not internal keys.
+    Options meta_index_options = range_del_options;
+    meta_index_options.comparator = BytewiseComparator();
+    BlockBuilder meta_index_block(&meta_index_options);
+    if (r->filter_block != nullptr && partitioned) {
+      // The filters are found through the top-level index; the entry
+      // only records that they exist and which policy built them.
+      std::string key = "partitionedfilter.";
+      key.append(r->options.filter_policy->Name());
+      meta_index_block.Add(key, Slice());
+    } else if (r->filter_block != nullptr) {
       // Add mapping from "filter.Name" to location of filter data
       std::string key = "filter.";
       key.append(r->options.filter_policy->Name());
@@ -220,6 +366,18 @@ Status TableBuilder::Finish() {
       filter_block_handle.EncodeTo(&handle_encoding);
       meta_index_block.Add(key, handle_encoding);
     }
+    if (r->filter_block != nullptr && r->options.prefix_extractor != nullptr) {
+      // Records that the filters also hold the prefixes of the keys.
+      std::string key = "prefix.";
+      key.append(r->options.prefix_extractor->Name());
+      meta_index_block.Add(key, Slice());
+    }
+    if (!r->range_deletions.empty()) {
+      // "rangedel" sorts after "filter.", "partitionedfilter." and "prefix."
+      std::string handle_encoding;
+      range_del_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add("rangedel", handle_encoding);
+    }
 
     // TODO(postrelease): Add stats and other meta blocks
     WriteBlock(&meta_index_block, &metaindex_block_handle);
@@ -234,7 +392,8 @@ Status TableBuilder::Finish() {
       r->index_block.Add(r->last_key, Slice(handle_encoding));
       r->pending_index_entry = false;
     }
-    WriteBlock(&r->index_block, &index_block_handle);
+    WriteBlock(partitioned ? &r->top_index_block : &r->index_block,
+               &index_block_handle);
   }
 
   // Write footer
@@ -242,6 +401,7 @@ Status TableBuilder::Finish() {
     Footer footer;
     footer.set_metaindex_handle(metaindex_block_handle);
     footer.set_index_handle(index_block_handle);
+    footer.set_partitioned_index(partitioned);
     std::string footer_encoding;
     footer.EncodeTo(&footer_encoding);
     r->status = r->file->Append(footer_encoding);
@@ -4,7 +4,9 @@
 
 #include "leveldb/table.h"
 
+#include <algorithm>
 #include <map>
+#include <set>
 #include <string>
 
 #include "db/dbformat.h"
@@ -12,11 +14,15 @@
 #include "db/write_batch_internal.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table_builder.h"
 #include "table/block.h"
 #include "table/block_builder.h"
 #include "table/format.h"
+#include "table/merger.h"
+#include "util/coding.h"
 #include "util/random.h"
 #include "util/testharness.h"
 #include "util/testutil.h"
@@ -109,14 +115,16 @@ class StringSink : public WritableFile {
 class StringSource : public RandomAccessFile {
  public:
   StringSource(const Slice& contents)
-      : contents_(contents.data(), contents.size()) {}
+      : contents_(contents.data(), contents.size()), reads_(0) {}
 
   ~StringSource() override = default;
 
   uint64_t Size() const { return contents_.size(); }
+  int reads() const { return reads_; }
 
   Status Read(uint64_t offset, size_t n, Slice* result,
               char* scratch) const override {
+    reads_++;
     if (offset >= contents_.size()) {
       return Status::InvalidArgument("invalid Read offset");
     }
@@ -130,6 +138,7 @@ class StringSource : public RandomAccessFile {
 
  private:
   std::string contents_;
+  mutable int reads_;
 };
 
 typedef std::map<std::string, std::string, STLLessThan> KVMap;
@@ -376,30 +385,39 @@ struct TestArgs {
   TestType type;
   bool reverse_compare;
   int restart_interval;
+  bool hash_index;
+  bool partitioned;
 };
 
 static const TestArgs kTestArgList[] = {
-    {TABLE_TEST, false, 16},
-    {TABLE_TEST, false, 1},
-    {TABLE_TEST, false, 1024},
-    {TABLE_TEST, true, 16},
-    {TABLE_TEST, true, 1},
-    {TABLE_TEST, true, 1024},
-
-    {BLOCK_TEST, false, 16},
-    {BLOCK_TEST, false, 1},
-    {BLOCK_TEST, false, 1024},
-    {BLOCK_TEST, true, 16},
-    {BLOCK_TEST, true, 1},
-    {BLOCK_TEST, true, 1024},
+    {TABLE_TEST, false, 16, false, false},
+    {TABLE_TEST, false, 1, false, false},
+    {TABLE_TEST, false, 1024, false, false},
+    {TABLE_TEST, true, 16, false, false},
+    {TABLE_TEST, true, 1, false, false},
+    {TABLE_TEST, true, 1024, false, false},
+    {TABLE_TEST, false, 16, true, false},
+    {TABLE_TEST, true, 1, true, false},
+    {TABLE_TEST, false, 16, false, true},
+    {TABLE_TEST, true, 1, false, true},
+
+    {BLOCK_TEST, false, 16, false, false},
+    {BLOCK_TEST, false, 1, false, false},
+    {BLOCK_TEST, false, 1024, false, false},
+    {BLOCK_TEST, true, 16, false, false},
+    {BLOCK_TEST, true, 1, false, false},
+    {BLOCK_TEST, true, 1024, false, false},
+    {BLOCK_TEST, false, 16, true, false},
+    {BLOCK_TEST, false, 1, true, false},
+    {BLOCK_TEST, true, 16, true, false},
 
     // Restart interval does not matter for memtables
-    {MEMTABLE_TEST, false, 16},
-    {MEMTABLE_TEST, true, 16},
+    {MEMTABLE_TEST, false, 16, false, false},
+    {MEMTABLE_TEST, true, 16, false, false},
 
     // Do not bother with restart interval variations for DB
-    {DB_TEST, false, 16},
-    {DB_TEST, true, 16},
+    {DB_TEST, false, 16, false, false},
+    {DB_TEST, true, 16, false, false},
 };
 static const int kNumTestArgs = sizeof(kTestArgList) / sizeof(kTestArgList[0]);
 
@@ -413,6 +431,10 @@ class Harness {
     options_ = Options();
 
     options_.block_restart_interval = args.restart_interval;
+    options_.data_block_hash_index = args.hash_index;
+    options_.partition_index_and_filters = args.partitioned;
+    // Few index entries per partition, to get many partitions.
+    options_.index_partition_size = 64;
     // Use shorter block size for tests to exercise block boundary
     // conditions more.
     options_.block_size = 256;
@@ -699,7 +721,7 @@ TEST(Harness, Randomized) {
 
 TEST(Harness, RandomizedLongDB) {
   Random rnd(test::RandomSeed());
-  TestArgs args = {DB_TEST, false, 16};
+  TestArgs args = {DB_TEST, false, 16, false, false};
   Init(args);
   int num_entries = 100000;
   for (int e = 0; e < num_entries; e++) {
@@ -721,6 +743,83 @@ TEST(Harness, RandomizedLongDB) {
   ASSERT_GT(files, 0);
 }
 
+class MergerTest {};
+
+TEST(MergerTest, ManyChildren) {
+  Random rnd(test::RandomSeed());
+  Options options;
+  const int kNumChildren = 20;
+  BlockConstructor* constructors[kNumChildren];
+  Iterator* children[kNumChildren];
+  std::set<std::string> key_set;
+  for (int c = 0; c < kNumChildren; c++) {
+    constructors[c] = new BlockConstructor(BytewiseComparator());
+    // Leave some children empty.
+    const int num_keys = (c % 5 == 0) ? 0 : rnd.Uniform(50);
+    for (int i = 0; i < num_keys; i++) {
+      std::string key = test::RandomKey(&rnd, 1 + rnd.Uniform(4));
+      if (key_set.insert(key).second) {
+        constructors[c]->Add(key, "v" + key);
+      }
+    }
+    std::vector<std::string> keys;
+    KVMap kvmap;
+    constructors[c]->Finish(options, &keys, &kvmap);
+    children[c] = constructors[c]->NewIterator();
+  }
+  const std::vector<std::string> model(key_set.begin(), key_set.end());
+  Iterator* iter =
+      NewMergingIterator(BytewiseComparator(), children, kNumChildren);
+
+  // Compare a random walk over the merged children with one over "model",
+  // in which pos == model.size() marks an invalid position.
+  size_t pos = model.size();
+  for (int i = 0; i < 5000; i++) {
+    switch (rnd.Uniform(5)) {
+      case 0:
+        iter->SeekToFirst();
+        pos = 0;
+        break;
+      case 1:
+        iter->SeekToLast();
+        pos = model.empty() ? 0 : model.size() - 1;
+        break;
+      case 2: {
+        const std::string target = test::RandomKey(&rnd, 1 + rnd.Uniform(4));
+        iter->Seek(target);
+        pos = std::lower_bound(model.begin(), model.end(), target) -
+              model.begin();
+        break;
+      }
+      case 3:
+        if (pos < model.size()) {
+          iter->Next();
+          pos++;
+        }
+        break;
+      case 4:
+        if (pos < model.size()) {
+          iter->Prev();
+          pos = (pos == 0) ? model.size() : pos - 1;
+        }
+        break;
+    }
+    if (pos < model.size()) {
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ(model[pos], iter->key().ToString());
+      ASSERT_EQ("v" + model[pos], iter->value().ToString());
+    } else {
+      ASSERT_TRUE(!iter->Valid());
+    }
+  }
+  ASSERT_TRUE(iter->status().ok());
+
+  delete iter;
+  for (int c = 0; c < kNumChildren; c++) {
+    delete constructors[c];
+  }
+}
+
 class MemTableTest {};
 
 TEST(MemTableTest, Simple) {
@@ -788,6 +887,273 @@ TEST(TableTest, ApproximateOffsetOfPlain) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 610000, 612000));
 }
 
+TEST(TableTest, ApproximateOffsetOfPartitioned) {
+  TableConstructor c(BytewiseComparator());
+  c.Add("k01", "hello");
+  c.Add("k02", "hello2");
+  c.Add("k03", std::string(10000, 'x'));
+  c.Add("k04", std::string(200000, 'x'));
+  c.Add("k05", std::string(300000, 'x'));
+  c.Add("k06", "hello3");
+  c.Add("k07", std::string(100000, 'x'));
+  std::vector<std::string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 1024;
+  options.compression = kNoCompression;
+  options.partition_index_and_filters = true;
+  options.index_partition_size = 1;  // One data block per partition
+  c.Finish(options, &keys, &kvmap);
+
+  // Index partitions are interleaved with the data blocks.
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("abc"), 0, 0));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k01"), 0, 0));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k03"), 0, 0));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k04"), 10000, 11000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k04a"), 210000, 211000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k05"), 210000, 211000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k06"), 510000, 511000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k07"), 510000, 511000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 610000, 612000));
+
+  Iterator* iter = c.NewIterator();
+  iter->Seek("k05");
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("k05", iter->key().ToString());
+  iter->Prev();
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("k04", iter->key().ToString());
+  iter->Seek("k07a");
+  ASSERT_TRUE(!iter->Valid());
+  delete iter;
+}
+
+TEST(TableTest, Readahead) {
+  StringSink sink;
+  Options options;
+  options.block_size = 256;
+  options.compression = kNoCompression;
+  TableBuilder builder(options, &sink);
+  for (int i = 0; i < 2000; i++) {
+    char key[20];
+    snprintf(key, sizeof(key), "k%06d", i);
+    builder.Add(key, std::string(20, 'v'));
+  }
+  ASSERT_OK(builder.Finish());
+  StringSource source(sink.contents());
+  Table* table;
+  ASSERT_OK(Table::Open(options, &source, sink.contents().size(), &table));
+
+  // A forward and a backward scan, with and without readahead.
+  std::vector<std::string> results[2];
+  int reads[2];
+  for (int r = 0; r < 2; r++) {
+    ReadOptions read_options;
+    read_options.readahead_size = (r == 0) ? 0 : 16 * 1024;
+    const int start = source.reads();
+    Iterator* iter = table->NewIterator(read_options);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      results[r].push_back(iter->key().ToString());
+    }
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+      results[r].push_back(iter->key().ToString());
+    }
+    ASSERT_OK(iter->status());
+    delete iter;
+    reads[r] = source.reads() - start;
+  }
+  ASSERT_EQ(4000, results[0].size());
+  ASSERT_TRUE(results[0] == results[1]);
+  ASSERT_LT(reads[1] * 4, reads[0]);
+  delete table;
+}
+
+TEST(TableTest, PrefixExtractorNeedsInternalKeys) {
+  // Prefixes are taken from internal keys, so plain tables hold none.
+  StringSink sink;
+  const FilterPolicy* policy = NewBloomFilterPolicy(10);
+  const SliceTransform* extractor = NewFixedPrefixTransform(2);
+  Options options;
+  options.compression = kNoCompression;
+  options.filter_policy = policy;
+  options.prefix_extractor = extractor;
+  TableBuilder builder(options, &sink);
+  for (int i = 0; i < 100; i++) {
+    char key[20];
+    snprintf(key, sizeof(key), "k%09d", i);
+    builder.Add(key, "v");
+  }
+  ASSERT_OK(builder.Finish());
+  const std::string meta_key = std::string("prefix.") + extractor->Name();
+  ASSERT_EQ(std::string::npos, sink.contents().find(meta_key));
+  delete extractor;
+  delete policy;
+}
+
+TEST(TableTest, DataBlockHashIndex) {
+  // Several versions of every user key, as in the tables of a DB.
+  Random rnd(301);
+  std::vector<std::string> keys;
+  for (int i = 0; i < 200; i++) {
+    char buf[20];
+    snprintf(buf, sizeof(buf), "key%06d", 3 * i);
+    const int versions = 1 + rnd.Uniform(i % 10 == 0 ? 40 : 3);
+    for (int v = versions; v > 0; v--) {
+      std::string ikey;
+      AppendInternalKey(&ikey, ParsedInternalKey(buf, 100 * i + v, kTypeValue));
+      keys.push_back(ikey);
+    }
+  }
+
+  InternalKeyComparator icmp(BytewiseComparator());
+  Options options;
+  options.comparator = &icmp;
+  Options hash_options = options;
+  hash_options.data_block_hash_index = true;
+  BlockBuilder with_index(&hash_options);
+  BlockBuilder without_index(&options);
+  for (size_t i = 0; i < keys.size(); i++) {
+    with_index.Add(keys[i], "v");
+    without_index.Add(keys[i], "v");
+  }
+  BlockContents contents;
+  contents.data = with_index.Finish();
+  contents.cachable = false;
+  contents.heap_allocated = false;
+  Block block(contents);
+  contents.data = without_index.Finish();
+  Block plain(contents);
+  ASSERT_GT(block.size(), plain.size() + 200);
+
+  Iterator* iter = block.NewIterator(&icmp);
+  Iterator* expected = plain.NewIterator(&icmp);
+  for (int i = 0; i < 620; i++) {
+    char buf[20];
+    snprintf(buf, sizeof(buf), "key%06d", i);
+    for (SequenceNumber s = 100 * (i / 3); s < 100 * (i / 3) + 45; s += 4) {
+      LookupKey lkey(buf, s);
+      iter->Seek(lkey.internal_key());
+      expected->Seek(lkey.internal_key());
+      ASSERT_EQ(expected->Valid(), iter->Valid());
+      if (expected->Valid()) {
+        ASSERT_EQ(expected->key().ToString(), iter->key().ToString());
+      }
+    }
+  }
+  ASSERT_OK(iter->status());
+  delete iter;
+  delete expected;
+}
+
+TEST(TableTest, RestartKeyPrefixes) {
+  // User keys with a shared prefix, and bytes that sort at both ends.
+  Random rnd(301);
+  const char kChars[] = {'\0', 'a', 'b', '\xff'};
+  std::set<std::string> user_keys;
+  for (int i = 0; i < 300; i++) {
+    std::string user_key = "user/";
+    const int len = rnd.Uniform(13);
+    for (int j = 0; j < len; j++) {
+      user_key.push_back(kChars[rnd.Uniform(4)]);
+    }
+    user_keys.insert(user_key);
+  }
+  std::vector<std::string> keys;
+  for (const std::string& user_key : user_keys) {
+    for (SequenceNumber s = 3; s > 0; s--) {
+      std::string ikey;
+      AppendInternalKey(&ikey, ParsedInternalKey(user_key, 10 * s, kTypeValue));
+      keys.push_back(ikey);
+    }
+  }
+  std::vector<std::string> targets;
+  for (const std::string& user_key : user_keys) {
+    targets.push_back(user_key);
+    targets.push_back(user_key + '\0');
+    targets.push_back(user_key.substr(0, user_key.size() - 1));
+  }
+  targets.push_back("");
+  targets.push_back("a");
+  targets.push_back("user");
+  targets.push_back("user0");
+  targets.push_back("zzz");
+
+  InternalKeyComparator icmp(BytewiseComparator());
+  for (int interval : {1, 16}) {
+    for (bool hash_index : {false, true}) {
+      Options options;
+      options.comparator = &icmp;
+      options.block_restart_interval = interval;
+      Options prefix_options = options;
+      prefix_options.restart_key_prefixes = true;
+      prefix_options.data_block_hash_index = hash_index;
+      BlockBuilder with_prefixes(&prefix_options);
+      BlockBuilder without_prefixes(&options);
+      for (size_t i = 0; i < keys.size(); i++) {
+        with_prefixes.Add(keys[i], "v");
+        without_prefixes.Add(keys[i], "v");
+      }
+      BlockContents contents;
+      contents.data = with_prefixes.Finish();
+      contents.cachable = false;
+      contents.heap_allocated = false;
+      Block block(contents);
+      contents.data = without_prefixes.Finish();
+      Block plain(contents);
+      ASSERT_GT(block.size(), plain.size() + keys.size() * 8 / interval);
+
+      Iterator* iter = block.NewIterator(&icmp);
+      Iterator* expected = plain.NewIterator(&icmp);
+      for (const std::string& target : targets) {
+        for (SequenceNumber s = 5; s < 40; s += 10) {
+          LookupKey lkey(target, s);
+          iter->Seek(lkey.internal_key());
+          expected->Seek(lkey.internal_key());
+          ASSERT_EQ(expected->Valid(), iter->Valid());
+          if (expected->Valid()) {
+            ASSERT_EQ(expected->key().ToString(), iter->key().ToString());
+          }
+        }
+      }
+      ASSERT_OK(iter->status());
+      delete iter;
+      delete expected;
+    }
+  }
+}
+
+TEST(TableTest, RestartKeyPrefixesNeedInternalKeys) {
+  // Plain keys have no 8-byte trailer, so blocks of them get no prefixes.
+  Options options;
+  options.block_restart_interval = 1;
+  options.restart_key_prefixes = true;
+  BlockBuilder builder(&options);
+  std::vector<std::string> keys;
+  for (int i = 0; i < 100; i++) {
+    char buf[100];
+    snprintf(buf, sizeof(buf), "key%06d.%08d", i / 10, i);
+    keys.push_back(buf);
+    builder.Add(keys.back(), "v");
+  }
+  BlockContents contents;
+  contents.data = builder.Finish();
+  contents.cachable = false;
+  contents.heap_allocated = false;
+  Block block(contents);
+  // No flags are set next to the number of restart points.
+  ASSERT_EQ(keys.size(), DecodeFixed32(contents.data.data() +
+                                       contents.data.size() - 4));
+
+  Iterator* iter = block.NewIterator(BytewiseComparator());
+  for (const std::string& key : keys) {
+    iter->Seek(key);
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(key, iter->key().ToString());
+  }
+  ASSERT_OK(iter->status());
+  delete iter;
+}
+
 static bool SnappyCompressionSupported() {
   std::string out;
   Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
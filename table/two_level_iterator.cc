@@ -4,6 +4,7 @@
 
 #include "table/two_level_iterator.h"
 
+#include "leveldb/comparator.h"
 #include "leveldb/table.h"
 #include "table/block.h"
 #include "table/format.h"
@@ -18,7 +19,9 @@ typedef Iterator* (*BlockFunction)(void*, const ReadOptions&, const Slice&);
 class TwoLevelIterator : public Iterator {
  public:
   TwoLevelIterator(Iterator* index_iter, BlockFunction block_function,
-                   void* arg, const ReadOptions& options);
+                   void* arg, const ReadOptions& options,
+                   const Comparator* comparator, const Slice* lower_bound,
+                   const Slice* upper_bound);
 
   ~TwoLevelIterator() override;
 
@@ -52,8 +55,9 @@ class TwoLevelIterator : public Iterator {
   void SaveError(const Status& s) {
     if (status_.ok() && !s.ok()) status_ = s;
   }
-  void SkipEmptyDataBlocksForward();
-  void SkipEmptyDataBlocksBackward();
+  // If "bounded" is true, stops at the bounds given to the constructor.
+  void SkipEmptyDataBlocksForward(bool bounded);
+  void SkipEmptyDataBlocksBackward(bool bounded);
   void SetDataIterator(Iterator* data_iter);
   void InitDataBlock();
 
@@ -66,16 +70,31 @@ class TwoLevelIterator : public Iterator {
   // If data_iter_ is non-null, then "data_block_handle_" holds the
   // "index_value" passed to block_function_ to create the data_iter_.
   std::string data_block_handle_;
+
+  // Null if the iterator is unbounded.
+  const Comparator* const comparator_;
+  const bool has_lower_bound_;
+  const bool has_upper_bound_;
+  const std::string lower_bound_;
+  const std::string upper_bound_;
 };
 
 TwoLevelIterator::TwoLevelIterator(Iterator* index_iter,
                                    BlockFunction block_function, void* arg,
-                                   const ReadOptions& options)
+                                   const ReadOptions& options,
+                                   const Comparator* comparator,
+                                   const Slice* lower_bound,
+                                   const Slice* upper_bound)
     : block_function_(block_function),
       arg_(arg),
       options_(options),
       index_iter_(index_iter),
-      data_iter_(nullptr) {}
+      data_iter_(nullptr),
+      comparator_(comparator),
+      has_lower_bound_(comparator != nullptr && lower_bound != nullptr),
+      has_upper_bound_(comparator != nullptr && upper_bound != nullptr),
+      lower_bound_(has_lower_bound_ ? lower_bound->ToString() : ""),
+      upper_bound_(has_upper_bound_ ? upper_bound->ToString() : "") {}
 
 TwoLevelIterator::~TwoLevelIterator() = default;
 
@@ -83,39 +102,42 @@ void TwoLevelIterator::Seek(const Slice& target) {
   index_iter_.Seek(target);
   InitDataBlock();
   if (data_iter_.iter() != nullptr) data_iter_.Seek(target);
-  SkipEmptyDataBlocksForward();
+  SkipEmptyDataBlocksForward(false);
 }
 
 void TwoLevelIterator::SeekToFirst() {
   index_iter_.SeekToFirst();
   InitDataBlock();
   if (data_iter_.iter() != nullptr) data_iter_.SeekToFirst();
-  SkipEmptyDataBlocksForward();
+  SkipEmptyDataBlocksForward(false);
 }
 
 void TwoLevelIterator::SeekToLast() {
   index_iter_.SeekToLast();
   InitDataBlock();
   if (data_iter_.iter() != nullptr) data_iter_.SeekToLast();
-  SkipEmptyDataBlocksBackward();
+  SkipEmptyDataBlocksBackward(false);
 }
 
 void TwoLevelIterator::Next() {
   assert(Valid());
   data_iter_.Next();
-  SkipEmptyDataBlocksForward();
+  SkipEmptyDataBlocksForward(true);
 }
 
 void TwoLevelIterator::Prev() {
   assert(Valid());
   data_iter_.Prev();
-  SkipEmptyDataBlocksBackward();
+  SkipEmptyDataBlocksBackward(true);
 }
 
-void TwoLevelIterator::SkipEmptyDataBlocksForward() {
+void TwoLevelIterator::SkipEmptyDataBlocksForward(bool bounded) {
   while (data_iter_.iter() == nullptr || !data_iter_.Valid()) {
-    // Move to next block
-    if (!index_iter_.Valid()) {
+    // Move to next block, unless the keys of all following blocks sort
+    // after the index key of the current one and thus past upper_bound_.
+    if (!index_iter_.Valid() ||
+        (bounded && has_upper_bound_ &&
+         comparator_->Compare(index_iter_.key(), upper_bound_) >= 0)) {
       SetDataIterator(nullptr);
       return;
     }
@@ -125,7 +147,7 @@ void TwoLevelIterator::SkipEmptyDataBlocksForward() {
   }
 }
 
-void TwoLevelIterator::SkipEmptyDataBlocksBackward() {
+void TwoLevelIterator::SkipEmptyDataBlocksBackward(bool bounded) {
   while (data_iter_.iter() == nullptr || !data_iter_.Valid()) {
     // Move to next block
     if (!index_iter_.Valid()) {
@@ -133,6 +155,12 @@ void TwoLevelIterator::SkipEmptyDataBlocksBackward() {
       return;
     }
     index_iter_.Prev();
+    if (bounded && has_lower_bound_ && index_iter_.Valid() &&
+        comparator_->Compare(index_iter_.key(), lower_bound_) < 0) {
+      // The keys of this block sort at or before its index key.
+      SetDataIterator(nullptr);
+      return;
+    }
     InitDataBlock();
     if (data_iter_.iter() != nullptr) data_iter_.SeekToLast();
   }
@@ -164,8 +192,12 @@ void TwoLevelIterator::InitDataBlock() {
 
 Iterator* NewTwoLevelIterator(Iterator* index_iter,
                               BlockFunction block_function, void* arg,
-                              const ReadOptions& options) {
-  return new TwoLevelIterator(index_iter, block_function, arg, options);
+                              const ReadOptions& options,
+                              const Comparator* comparator,
+                              const Slice* lower_bound,
+                              const Slice* upper_bound) {
+  return new TwoLevelIterator(index_iter, block_function, arg, options,
+                              comparator, lower_bound, upper_bound);
 }
 
 }  // namespace leveldb
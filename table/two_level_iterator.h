@@ -9,6 +9,7 @@
 
 namespace leveldb {
 
+class Comparator;
 struct ReadOptions;
 
 // Return a new two level iterator.  A two-level iterator contains an
@@ -20,11 +21,20 @@ struct ReadOptions;
 //
 // Uses a supplied function to convert an index_iter value into
 // an iterator over the contents of the corresponding block.
+//
+// If "comparator" is non-null, Next() does not move on to a block whose
+// keys all sort at or after *upper_bound, and Prev() does not move on to a
+// block whose keys all sort before *lower_bound; the iterator becomes
+// invalid instead.  Either bound may be null.  This relies on each key of
+// index_iter sorting at or after the keys of its block and before the keys
+// of the following blocks.  Seeks are not affected by the bounds.
 Iterator* NewTwoLevelIterator(
     Iterator* index_iter,
     Iterator* (*block_function)(void* arg, const ReadOptions& options,
                                 const Slice& index_value),
-    void* arg, const ReadOptions& options);
+    void* arg, const ReadOptions& options,
+    const Comparator* comparator = nullptr, const Slice* lower_bound = nullptr,
+    const Slice* upper_bound = nullptr);
 
 }  // namespace leveldb
 
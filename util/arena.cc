@@ -4,6 +4,11 @@
 
 #include "util/arena.h"
 
+#include <functional>
+#include <thread>
+
+#include "util/mutexlock.h"
+
 namespace leveldb {
 
 static const int kBlockSize = 4096;
@@ -55,8 +60,40 @@ char* Arena::AllocateAligned(size_t bytes) {
   return result;
 }
 
+char* Arena::AllocateFromShard(size_t bytes, bool aligned) {
+  assert(bytes > 0);
+  if (bytes > kBlockSize / 4) {
+    // Large objects get their own block, just like in AllocateFallback().
+    return AllocateNewBlock(bytes);
+  }
+
+  Shard* shard = &shards_[std::hash<std::thread::id>()(
+                              std::this_thread::get_id()) %
+                          kNumShards];
+  MutexLock l(&shard->mu);
+  const int align = (sizeof(void*) > 8) ? sizeof(void*) : 8;
+  size_t slop = 0;
+  if (aligned) {
+    size_t current_mod =
+        reinterpret_cast<uintptr_t>(shard->alloc_ptr) & (align - 1);
+    slop = (current_mod == 0 ? 0 : align - current_mod);
+  }
+  if (bytes + slop > shard->alloc_bytes_remaining) {
+    // We waste the remaining space in the shard's current block.
+    shard->alloc_ptr = AllocateNewBlock(kBlockSize);
+    shard->alloc_bytes_remaining = kBlockSize;
+    slop = 0;
+  }
+  char* result = shard->alloc_ptr + slop;
+  shard->alloc_ptr += bytes + slop;
+  shard->alloc_bytes_remaining -= bytes + slop;
+  assert(!aligned || (reinterpret_cast<uintptr_t>(result) & (align - 1)) == 0);
+  return result;
+}
+
 char* Arena::AllocateNewBlock(size_t block_bytes) {
   char* result = new char[block_bytes];
+  MutexLock l(&blocks_mutex_);
   blocks_.push_back(result);
   memory_usage_.fetch_add(block_bytes + sizeof(char*),
                           std::memory_order_relaxed);
@@ -11,6 +11,9 @@
 #include <cstdint>
 #include <vector>
 
+#include "port/port.h"
+#include "port/thread_annotations.h"
+
 namespace leveldb {
 
 class Arena {
@@ -28,6 +31,16 @@ class Arena {
   // Allocate memory with the normal alignment guarantees provided by malloc.
   char* AllocateAligned(size_t bytes);
 
+  // Thread-safe variants of Allocate() and AllocateAligned().  Several
+  // threads may call them at the same time, and at most one other thread
+  // may call the variants above meanwhile.
+  char* AllocateConcurrently(size_t bytes) {
+    return AllocateFromShard(bytes, false);
+  }
+  char* AllocateAlignedConcurrently(size_t bytes) {
+    return AllocateFromShard(bytes, true);
+  }
+
   // Returns an estimate of the total memory usage of data allocated
   // by the arena.
   size_t MemoryUsage() const {
@@ -35,15 +48,30 @@ class Arena {
   }
 
  private:
+  // Allocation state of the thread-safe variants.  Threads are spread
+  // over the shards, and every shard carves small allocations out of its
+  // own block, so that concurrent allocations rarely contend on a lock.
+  struct Shard {
+    port::Mutex mu;
+    char* alloc_ptr GUARDED_BY(mu) = nullptr;
+    size_t alloc_bytes_remaining GUARDED_BY(mu) = 0;
+  };
+  enum { kNumShards = 8 };
+
   char* AllocateFallback(size_t bytes);
   char* AllocateNewBlock(size_t block_bytes);
+  char* AllocateFromShard(size_t bytes, bool aligned);
 
   // Allocation state
   char* alloc_ptr_;
   size_t alloc_bytes_remaining_;
 
+  // Protects blocks_, which all allocation paths append to.
+  port::Mutex blocks_mutex_;
+
   // Array of new[] allocated memory blocks
-  std::vector<char*> blocks_;
+  std::vector<char*> blocks_ GUARDED_BY(blocks_mutex_);
+  Shard shards_[kNumShards];
 
   // Total memory usage of the arena.
   //
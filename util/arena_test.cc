@@ -4,6 +4,11 @@
 
 #include "util/arena.h"
 
+#include <string.h>
+
+#include <atomic>
+
+#include "leveldb/env.h"
 #include "util/random.h"
 #include "util/testharness.h"
 
@@ -60,6 +65,55 @@ TEST(ArenaTest, Simple) {
   }
 }
 
+struct ConcurrentArenaArg {
+  Arena* arena;
+  int id;
+  std::atomic<int>* done;
+  bool ok;
+};
+
+static void ConcurrentAllocator(void* arg) {
+  ConcurrentArenaArg* a = reinterpret_cast<ConcurrentArenaArg*>(arg);
+  Random rnd(301 + a->id);
+  std::vector<std::pair<size_t, char*>> allocated;
+  for (int i = 0; i < 20000; i++) {
+    size_t s = rnd.OneIn(1000) ? rnd.Uniform(6000) + 1 : rnd.Uniform(100) + 1;
+    char* r = rnd.OneIn(2) ? a->arena->AllocateConcurrently(s)
+                           : a->arena->AllocateAlignedConcurrently(s);
+    memset(r, a->id, s);
+    allocated.push_back(std::make_pair(s, r));
+  }
+  a->ok = true;
+  for (size_t i = 0; i < allocated.size(); i++) {
+    for (size_t b = 0; b < allocated[i].first; b++) {
+      if (allocated[i].second[b] != static_cast<char>(a->id)) {
+        a->ok = false;
+      }
+    }
+  }
+  a->done->fetch_add(1, std::memory_order_release);
+}
+
+TEST(ArenaTest, Concurrent) {
+  const int kThreads = 4;
+  Arena arena;
+  std::atomic<int> done(0);
+  ConcurrentArenaArg args[kThreads];
+  for (int i = 0; i < kThreads; i++) {
+    args[i].arena = &arena;
+    args[i].id = i + 1;
+    args[i].done = &done;
+    args[i].ok = false;
+    Env::Default()->StartThread(ConcurrentAllocator, &args[i]);
+  }
+  while (done.load(std::memory_order_acquire) < kThreads) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+  for (int i = 0; i < kThreads; i++) {
+    ASSERT_TRUE(args[i].ok);
+  }
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) { return leveldb::test::RunAllTests(); }
@@ -4,9 +4,16 @@
 
 #include "leveldb/filter_policy.h"
 
+#include <algorithm>
+
 #include "leveldb/slice.h"
+#include "leveldb_autogen_conf.h"
 #include "util/hash.h"
 
+#if defined(VECTOR_BLOOM)
+#include "util/ve.h"
+#endif
+
 namespace leveldb {
 
 namespace {
@@ -14,6 +21,49 @@ static uint32_t BloomHash(const Slice& key) {
   return Hash(key.data(), key.size(), 0xbc9f1d34);
 }
 
+// Return true if all "k" bits probed for hash "h" are set in the filter
+// "array" of "bits" bits.
+static bool ScalarProbe(uint32_t h, const char* array, size_t bits,
+                        size_t k) {
+  const uint32_t delta = (h >> 17) | (h << 15);  // Rotate right 17 bits
+  for (size_t j = 0; j < k; j++) {
+    const uint32_t bitpos = h % bits;
+    if ((array[bitpos / 8] & (1 << (bitpos % 8))) == 0) return false;
+    h += delta;
+  }
+  return true;
+}
+
+#if defined(VECTOR_BLOOM)
+// Keys probed per vector pass.
+static const int kParallel = 256;
+
+// Probe the filter for the n <= kParallel keys with hashes[0,n-1] at
+// once.  Each vector element follows the probe sequence of one key, and
+// the probed filter bytes are fetched by gathering the aligned words that
+// hold them.
+static void VectorProbe(const uint64_t* hashes, int n, const char* array,
+                        size_t bits, size_t k, bool* results) {
+  _ve_lvl(n);
+  Ve::VrReg h(hashes);
+  Ve::VrReg delta = ((h >> 17) | (h << 15)) & 0xFFFFFFFF;
+  Ve::VrReg match((int64_t)1);
+  for (size_t j = 0; j < k; j++) {
+    Ve::VrReg bitpos = h % bits;
+    Ve::VrReg byte_addr = (bitpos >> 3) + (uint64_t)array;
+    Ve::VrReg shift = ((byte_addr & 7) << 3) + (bitpos & 7);
+    match &= Ve::VrReg::PtrInit(byte_addr & ~7ULL) >> shift;
+    h = (h + delta) & 0xFFFFFFFF;
+  }
+  match &= 1;
+  uint64_t matched[kParallel];
+  match.WriteToMem(matched);
+  for (int i = 0; i < n; i++) {
+    results[i] = (matched[i] != 0);
+  }
+}
+#endif
+
 class BloomFilterPolicy : public FilterPolicy {
  public:
   explicit BloomFilterPolicy(int bits_per_key) : bits_per_key_(bits_per_key) {
@@ -69,14 +119,37 @@ class BloomFilterPolicy : public FilterPolicy {
       return true;
     }
 
-    uint32_t h = BloomHash(key);
-    const uint32_t delta = (h >> 17) | (h << 15);  // Rotate right 17 bits
-    for (size_t j = 0; j < k; j++) {
-      const uint32_t bitpos = h % bits;
-      if ((array[bitpos / 8] & (1 << (bitpos % 8))) == 0) return false;
-      h += delta;
+    return ScalarProbe(BloomHash(key), array, bits, k);
+  }
+
+  void KeysMayMatch(const Slice* keys, int n, const Slice& bloom_filter,
+                    bool* results) const override {
+    const size_t len = bloom_filter.size();
+    const char* array = bloom_filter.data();
+    const size_t bits = (len - 1) * 8;
+    const size_t k = (len < 2) ? 0 : array[len - 1];
+    if (len < 2 || k > 30) {
+      // See KeyMayMatch().
+      std::fill(results, results + n, len >= 2);
+      return;
+    }
+
+#if defined(VECTOR_BLOOM)
+    // Hashing walks keys of different lengths and stays scalar; the
+    // probes then run for all keys together.
+    uint64_t hashes[kParallel];
+    for (int start = 0; start < n; start += kParallel) {
+      const int m = std::min(n - start, kParallel);
+      for (int i = 0; i < m; i++) {
+        hashes[i] = BloomHash(keys[start + i]);
+      }
+      VectorProbe(hashes, m, array, bits, k, results + start);
+    }
+#else
+    for (int i = 0; i < n; i++) {
+      results[i] = ScalarProbe(BloomHash(keys[i]), array, bits, k);
     }
-    return true;
+#endif
   }
 
  private:
@@ -63,6 +63,19 @@ class BloomTest {
     return policy_->KeyMayMatch(s, filter_);
   }
 
+  // Probe all of "keys" with one KeysMayMatch() call.
+  std::vector<bool> BatchMatches(const std::vector<Slice>& keys) {
+    if (!keys_.empty()) {
+      Build();
+    }
+    bool* results = new bool[keys.size() + 1];
+    policy_->KeysMayMatch(keys.data(), static_cast<int>(keys.size()), filter_,
+                          results);
+    std::vector<bool> v(results, results + keys.size());
+    delete[] results;
+    return v;
+  }
+
   double FalsePositiveRate() {
     char buffer[sizeof(int)];
     int result = 0;
@@ -94,6 +107,38 @@ TEST(BloomTest, Small) {
   ASSERT_TRUE(!Matches("foo"));
 }
 
+TEST(BloomTest, EmptyBatch) {
+  std::vector<Slice> keys = {"hello", "world"};
+  std::vector<bool> results = BatchMatches(keys);
+  ASSERT_TRUE(!results[0]);
+  ASSERT_TRUE(!results[1]);
+}
+
+TEST(BloomTest, BatchMatchesSingle) {
+  // Batches larger than one vector pass, with keys both in and not in
+  // the filter.
+  const int kKeys = 700;
+  std::vector<std::string> keys;
+  char buffer[sizeof(int)];
+  for (int i = 0; i < kKeys; i++) {
+    Add(Key(i * 2, buffer));
+  }
+  for (int i = 0; i < kKeys * 2; i++) {
+    keys.push_back(Key(i, buffer).ToString());
+  }
+  keys.push_back("");
+  keys.push_back(std::string(100, 'x'));
+  std::vector<Slice> key_slices(keys.begin(), keys.end());
+  std::vector<bool> results = BatchMatches(key_slices);
+  ASSERT_EQ(key_slices.size(), results.size());
+  for (size_t i = 0; i < key_slices.size(); i++) {
+    ASSERT_EQ(Matches(key_slices[i]), results[i]) << i;
+    if (i < kKeys * 2 && i % 2 == 0) {
+      ASSERT_TRUE(results[i]) << i;
+    }
+  }
+}
+
 static int NextLength(int length) {
   if (length < 10) {
     length += 1;
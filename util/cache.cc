@@ -36,6 +36,16 @@ namespace {
 // Elements are moved between these lists by the Ref() and Unref() methods,
 // when they detect an element in the cache acquiring or losing its only
 // external reference.
+//
+// With a high-priority pool, the LRU list is split in two at lru_low_pri_:
+// the older part is the low-priority pool and the newer part the
+// high-priority pool.  High-priority entries, and entries that were looked
+// up again since they were inserted, enter at the newest end of the list.
+// Other entries enter in the middle, at the newest end of the low-priority
+// pool, and are evicted first unless they are hit again.  When the
+// high-priority pool outgrows its share of the capacity, its oldest entries
+// move into the low-priority pool.  A scan that reads every block once thus
+// only churns the low-priority pool.
 
 // An entry is a variable length heap-allocated structure.  Entries
 // are kept in a circular doubly linked list ordered by access time.
@@ -48,6 +58,9 @@ struct LRUHandle {
   size_t charge;  // TODO(opt): Only allow uint32_t?
   size_t key_length;
   bool in_cache;     // Whether entry is in the cache.
+  bool high_pri;     // Whether entry was inserted with kHighPriority.
+  bool in_high_pri;  // Whether entry is in the high-priority pool.
+  bool hit;          // Whether entry was looked up after its insertion.
   uint32_t refs;     // References, including cache reference, if present.
   uint32_t hash;     // Hash of key(); used for fast sharding and comparisons
   char key_data[1];  // Beginning of key
@@ -153,12 +166,18 @@ class LRUCache {
   ~LRUCache();
 
   // Separate from constructor so caller can easily make an array of LRUCache
-  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+  void SetCapacity(size_t capacity, double high_pri_pool_ratio) {
+    capacity_ = capacity;
+    high_pri_pool_ratio_ = high_pri_pool_ratio;
+    high_pri_pool_capacity_ =
+        static_cast<size_t>(capacity * high_pri_pool_ratio);
+  }
 
   // Like Cache methods, but with an extra "hash" parameter.
   Cache::Handle* Insert(const Slice& key, uint32_t hash, void* value,
                         size_t charge,
-                        void (*deleter)(const Slice& key, void* value));
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Priority priority);
   Cache::Handle* Lookup(const Slice& key, uint32_t hash);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
@@ -171,22 +190,30 @@ class LRUCache {
  private:
   void LRU_Remove(LRUHandle* e);
   void LRU_Append(LRUHandle* list, LRUHandle* e);
+  void LRU_Insert(LRUHandle* e);
+  void MaintainPoolSize();
   void Ref(LRUHandle* e);
   void Unref(LRUHandle* e);
   bool FinishErase(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   // Initialized before use.
   size_t capacity_;
+  double high_pri_pool_ratio_;
+  size_t high_pri_pool_capacity_;
 
   // mutex_ protects the following state.
   mutable port::Mutex mutex_;
   size_t usage_ GUARDED_BY(mutex_);
+  size_t high_pri_pool_usage_ GUARDED_BY(mutex_);
 
   // Dummy head of LRU list.
   // lru.prev is newest entry, lru.next is oldest entry.
   // Entries have refs==1 and in_cache==true.
   LRUHandle lru_ GUARDED_BY(mutex_);
 
+  // Newest entry of the low-priority pool, or &lru_ if the pool is empty.
+  LRUHandle* lru_low_pri_ GUARDED_BY(mutex_);
+
   // Dummy head of in-use list.
   // Entries are in use by clients, and have refs >= 2 and in_cache==true.
   LRUHandle in_use_ GUARDED_BY(mutex_);
@@ -194,10 +221,16 @@ class LRUCache {
   HandleTable table_ GUARDED_BY(mutex_);
 };
 
-LRUCache::LRUCache() : capacity_(0), usage_(0) {
+LRUCache::LRUCache()
+    : capacity_(0),
+      high_pri_pool_ratio_(0),
+      high_pri_pool_capacity_(0),
+      usage_(0),
+      high_pri_pool_usage_(0) {
   // Make empty circular linked lists.
   lru_.next = &lru_;
   lru_.prev = &lru_;
+  lru_low_pri_ = &lru_;
   in_use_.next = &in_use_;
   in_use_.prev = &in_use_;
 }
@@ -232,11 +265,19 @@ void LRUCache::Unref(LRUHandle* e) {
   } else if (e->in_cache && e->refs == 1) {
     // No longer in use; move to lru_ list.
     LRU_Remove(e);
-    LRU_Append(&lru_, e);
+    LRU_Insert(e);
   }
 }
 
 void LRUCache::LRU_Remove(LRUHandle* e) {
+  if (e == lru_low_pri_) {
+    lru_low_pri_ = e->prev;
+  }
+  if (e->in_high_pri) {
+    assert(high_pri_pool_usage_ >= e->charge);
+    high_pri_pool_usage_ -= e->charge;
+    e->in_high_pri = false;
+  }
   e->next->prev = e->prev;
   e->prev->next = e->next;
 }
@@ -249,10 +290,36 @@ void LRUCache::LRU_Append(LRUHandle* list, LRUHandle* e) {
   e->next->prev = e;
 }
 
+void LRUCache::LRU_Insert(LRUHandle* e) {
+  if (high_pri_pool_ratio_ > 0 && (e->high_pri || e->hit)) {
+    // Newest entry of the high-priority pool.
+    LRU_Append(&lru_, e);
+    e->in_high_pri = true;
+    high_pri_pool_usage_ += e->charge;
+    MaintainPoolSize();
+  } else {
+    // Newest entry of the low-priority pool, just after lru_low_pri_.
+    LRU_Append(lru_low_pri_->next, e);
+    lru_low_pri_ = e;
+  }
+}
+
+void LRUCache::MaintainPoolSize() {
+  while (high_pri_pool_usage_ > high_pri_pool_capacity_) {
+    // Move the oldest entry of the high-priority pool to the low-priority
+    // pool.
+    lru_low_pri_ = lru_low_pri_->next;
+    assert(lru_low_pri_ != &lru_);
+    lru_low_pri_->in_high_pri = false;
+    high_pri_pool_usage_ -= lru_low_pri_->charge;
+  }
+}
+
 Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) {
   MutexLock l(&mutex_);
   LRUHandle* e = table_.Lookup(key, hash);
   if (e != nullptr) {
+    e->hit = true;
     Ref(e);
   }
   return reinterpret_cast<Cache::Handle*>(e);
@@ -266,7 +333,8 @@ void LRUCache::Release(Cache::Handle* handle) {
 Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
                                 size_t charge,
                                 void (*deleter)(const Slice& key,
-                                                void* value)) {
+                                                void* value),
+                                Cache::Priority priority) {
   MutexLock l(&mutex_);
 
   LRUHandle* e =
@@ -277,6 +345,9 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
   e->key_length = key.size();
   e->hash = hash;
   e->in_cache = false;
+  e->high_pri = (priority == Cache::kHighPriority);
+  e->in_high_pri = false;
+  e->hit = false;
   e->refs = 1;  // for the returned handle.
   memcpy(e->key_data, key.data(), key.size());
 
@@ -348,17 +419,24 @@ class ShardedLRUCache : public Cache {
   static uint32_t Shard(uint32_t hash) { return hash >> (32 - kNumShardBits); }
 
  public:
-  explicit ShardedLRUCache(size_t capacity) : last_id_(0) {
+  ShardedLRUCache(size_t capacity, double high_pri_pool_ratio)
+      : last_id_(0) {
     const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
     for (int s = 0; s < kNumShards; s++) {
-      shard_[s].SetCapacity(per_shard);
+      shard_[s].SetCapacity(per_shard, high_pri_pool_ratio);
     }
   }
   ~ShardedLRUCache() override {}
   Handle* Insert(const Slice& key, void* value, size_t charge,
                  void (*deleter)(const Slice& key, void* value)) override {
+    return Insert(key, value, charge, deleter, kLowPriority);
+  }
+  Handle* Insert(const Slice& key, void* value, size_t charge,
+                 void (*deleter)(const Slice& key, void* value),
+                 Priority priority) override {
     const uint32_t hash = HashSlice(key);
-    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter,
+                                      priority);
   }
   Handle* Lookup(const Slice& key) override {
     const uint32_t hash = HashSlice(key);
@@ -395,6 +473,10 @@ class ShardedLRUCache : public Cache {
 
 }  // end anonymous namespace
 
-Cache* NewLRUCache(size_t capacity) { return new ShardedLRUCache(capacity); }
+Cache* NewLRUCache(size_t capacity) { return new ShardedLRUCache(capacity, 0); }
+
+Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio) {
+  return new ShardedLRUCache(capacity, high_pri_pool_ratio);
+}
 
 }  // namespace leveldb
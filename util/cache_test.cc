@@ -53,6 +53,11 @@ class CacheTest {
                                    &CacheTest::Deleter));
   }
 
+  void InsertHighPriority(int key, int value, int charge = 1) {
+    cache_->Release(cache_->Insert(EncodeKey(key), EncodeValue(value), charge,
+                                   &CacheTest::Deleter, Cache::kHighPriority));
+  }
+
   Cache::Handle* InsertAndReturnHandle(int key, int value, int charge = 1) {
     return cache_->Insert(EncodeKey(key), EncodeValue(value), charge,
                           &CacheTest::Deleter);
@@ -150,6 +155,45 @@ TEST(CacheTest, EvictionPolicy) {
   cache_->Release(h);
 }
 
+TEST(CacheTest, HighPriorityPool) {
+  delete cache_;
+  cache_ = NewLRUCache(kCacheSize, 0.5);
+
+  InsertHighPriority(100, 101);
+  Insert(200, 201);
+  Insert(300, 301);
+  ASSERT_EQ(301, Lookup(300));
+
+  // A scan that inserts entries without using them again must not evict
+  // high-priority entries or entries that were hit.
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    Insert(1000 + i, 2000 + i);
+  }
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(-1, Lookup(200));
+  ASSERT_EQ(301, Lookup(300));
+  ASSERT_EQ(2000 + 2 * kCacheSize - 1, Lookup(1000 + 2 * kCacheSize - 1));
+}
+
+TEST(CacheTest, HighPriorityPoolOverflow) {
+  delete cache_;
+  cache_ = NewLRUCache(kCacheSize, 0.5);
+
+  // High-priority entries beyond the pool capacity fall back to LRU order.
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    InsertHighPriority(1000 + i, 2000 + i);
+  }
+  ASSERT_EQ(-1, Lookup(1000));
+  ASSERT_EQ(2000 + 2 * kCacheSize - 1, Lookup(1000 + 2 * kCacheSize - 1));
+  ASSERT_LE(cache_->TotalCharge(), kCacheSize + kCacheSize / 10);
+
+  Cache::Handle* h = InsertAndReturnHandle(100, 101);
+  ASSERT_EQ(101, Lookup(100));
+  cache_->Release(h);
+  Erase(100);
+  ASSERT_EQ(-1, Lookup(100));
+}
+
 TEST(CacheTest, UseExceedsCacheSize) {
   // Overfill the cache, keeping handles on all inserted entries.
   std::vector<Cache::Handle*> h;
@@ -18,6 +18,14 @@ RandomAccessFile::~RandomAccessFile() = default;
 
 WritableFile::~WritableFile() = default;
 
+Status WritableFile::AppendV(const Slice* data, size_t n) {
+  Status s;
+  for (size_t i = 0; i < n && s.ok(); i++) {
+    s = Append(data[i]);
+  }
+  return s;
+}
+
 Logger::~Logger() = default;
 
 FileLock::~FileLock() = default;
@@ -10,10 +10,12 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <atomic>
 #include <cerrno>
+#include <climits>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -26,6 +28,7 @@
 #include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "leveldb/env.h"
 #include "leveldb/slice.h"
@@ -309,6 +312,36 @@ class PosixWritableFile final : public WritableFile {
     return WriteUnbuffered(write_data, write_size);
   }
 
+  Status AppendV(const Slice* data, size_t n) override {
+    size_t write_size = 0;
+    for (size_t i = 0; i < n; i++) {
+      write_size += data[i].size();
+    }
+
+    // Small writes go to the buffer.
+    if (write_size <= kWritableFileBufferSize - pos_) {
+      for (size_t i = 0; i < n; i++) {
+        std::memcpy(buf_ + pos_, data[i].data(), data[i].size());
+        pos_ += data[i].size();
+      }
+      return Status::OK();
+    }
+
+    // Write the buffered bytes and all of "data" with a single writev().
+    std::vector<struct ::iovec> iov;
+    iov.reserve(n + 1);
+    if (pos_ > 0) {
+      iov.push_back({buf_, pos_});
+    }
+    for (size_t i = 0; i < n; i++) {
+      if (!data[i].empty()) {
+        iov.push_back({const_cast<char*>(data[i].data()), data[i].size()});
+      }
+    }
+    pos_ = 0;
+    return WriteUnbufferedV(iov.data(), iov.size());
+  }
+
   Status Close() override {
     Status status = FlushBuffer();
     const int close_result = ::close(fd_);
@@ -370,6 +403,32 @@ class PosixWritableFile final : public WritableFile {
     return Status::OK();
   }
 
+  Status WriteUnbufferedV(struct ::iovec* iov, size_t iovcnt) {
+    while (iovcnt > 0) {
+      ssize_t write_result = ::writev(
+          fd_, iov, static_cast<int>(std::min<size_t>(iovcnt, IOV_MAX)));
+      if (write_result < 0) {
+        if (errno == EINTR) {
+          continue;  // Retry
+        }
+        return PosixError(filename_, errno);
+      }
+      // Skip the pieces that were written completely and trim the first
+      // piece that was written partially.
+      size_t written = write_result;
+      while (iovcnt > 0 && written >= iov->iov_len) {
+        written -= iov->iov_len;
+        iov++;
+        iovcnt--;
+      }
+      if (iovcnt > 0) {
+        iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+        iov->iov_len -= written;
+      }
+    }
+    return Status::OK();
+  }
+
   Status SyncDirIfManifest() {
     Status status;
     if (!is_manifest_) {
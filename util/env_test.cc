@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <atomic>
+#include <vector>
 
 #include "port/port.h"
 #include "port/thread_annotations.h"
@@ -196,6 +197,45 @@ TEST(EnvTest, ReopenWritableFile) {
   env_->DeleteFile(test_file_name);
 }
 
+TEST(EnvTest, AppendV) {
+  std::string test_dir;
+  ASSERT_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file_name = test_dir + "/append_v_file.txt";
+  env_->DeleteFile(test_file_name);
+
+  // Mix small gathers that fit in the write buffer with ones that span
+  // several buffers, behind both empty and partially filled buffers.
+  Random rnd(test::RandomSeed());
+  WritableFile* writable_file;
+  ASSERT_OK(env_->NewWritableFile(test_file_name, &writable_file));
+  std::string expected;
+  for (int i = 0; i < 20; i++) {
+    std::vector<std::string> pieces;
+    const int n = 1 + rnd.Uniform(8);
+    for (int j = 0; j < n; j++) {
+      const int len = rnd.OneIn(4) ? rnd.Uniform(100000) : rnd.Uniform(100);
+      pieces.push_back(std::string(len, static_cast<char>('a' + j)));
+    }
+    std::vector<Slice> slices(pieces.begin(), pieces.end());
+    ASSERT_OK(writable_file->AppendV(slices.data(), slices.size()));
+    for (const std::string& piece : pieces) {
+      expected += piece;
+    }
+    if (rnd.OneIn(3)) {
+      ASSERT_OK(writable_file->Append("x"));
+      expected += "x";
+    }
+  }
+  ASSERT_OK(writable_file->Close());
+  delete writable_file;
+
+  std::string data;
+  ASSERT_OK(ReadFileToString(env_, test_file_name, &data));
+  ASSERT_EQ(expected.size(), data.size());
+  ASSERT_TRUE(expected == data);
+  env_->DeleteFile(test_file_name);
+}
+
 TEST(EnvTest, ReopenAppendableFile) {
   std::string test_dir;
   ASSERT_OK(env_->GetTestDirectory(&test_dir));
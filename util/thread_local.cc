@@ -0,0 +1,174 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/thread_local.h"
+
+#include <atomic>
+
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+#include "util/no_destructor.h"
+
+namespace leveldb {
+
+namespace {
+
+struct Entry {
+  Entry() : ptr(nullptr) {}
+  Entry(const Entry& e) : ptr(e.ptr.load(std::memory_order_relaxed)) {}
+
+  std::atomic<void*> ptr;
+};
+
+// The values of one thread, indexed by ThreadLocalPtr id.  Only the owning
+// thread changes the size of "entries", and only while holding the
+// registry mutex, so the owner can access its entries without locking
+// while Scrape() visits them under the mutex.
+struct ThreadData {
+  std::vector<Entry> entries;
+  ThreadData* next;
+  ThreadData* prev;
+};
+
+class Registry {
+ public:
+  Registry() : next_id_(0) { head_.next = head_.prev = &head_; }
+
+  static Registry* Instance() {
+    static NoDestructor<Registry> instance;
+    return instance.get();
+  }
+
+  uint32_t AcquireId(ThreadLocalPtr::UnrefHandler handler) {
+    MutexLock l(&mutex_);
+    uint32_t id;
+    if (!free_ids_.empty()) {
+      id = free_ids_.back();
+      free_ids_.pop_back();
+    } else {
+      id = next_id_++;
+      handlers_.resize(next_id_);
+    }
+    handlers_[id] = handler;
+    return id;
+  }
+
+  void ReleaseId(uint32_t id) {
+    MutexLock l(&mutex_);
+    // Clear the values so that the next user of the id starts afresh.
+    for (ThreadData* t = head_.next; t != &head_; t = t->next) {
+      if (id < t->entries.size()) {
+        t->entries[id].ptr.store(nullptr, std::memory_order_relaxed);
+      }
+    }
+    handlers_[id] = nullptr;
+    free_ids_.push_back(id);
+  }
+
+  // Grow "t->entries" so that it holds slot "id".
+  void Reserve(ThreadData* t, uint32_t id) {
+    MutexLock l(&mutex_);
+    if (id >= t->entries.size()) {
+      t->entries.resize(next_id_);
+    }
+  }
+
+  void Scrape(uint32_t id, std::vector<void*>* ptrs, void* replacement) {
+    MutexLock l(&mutex_);
+    for (ThreadData* t = head_.next; t != &head_; t = t->next) {
+      if (id < t->entries.size()) {
+        void* ptr = t->entries[id].ptr.exchange(replacement,
+                                                std::memory_order_acquire);
+        if (ptr != nullptr) {
+          ptrs->push_back(ptr);
+        }
+      }
+    }
+  }
+
+  void AddThread(ThreadData* t) {
+    MutexLock l(&mutex_);
+    t->next = &head_;
+    t->prev = head_.prev;
+    head_.prev->next = t;
+    head_.prev = t;
+  }
+
+  // Called on thread exit.  The handlers run while the mutex is held so
+  // that Scrape() never misses a value that is still being released.
+  void RemoveThread(ThreadData* t) {
+    MutexLock l(&mutex_);
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    for (uint32_t id = 0; id < t->entries.size(); id++) {
+      void* ptr = t->entries[id].ptr.load(std::memory_order_relaxed);
+      if (ptr != nullptr && handlers_[id] != nullptr) {
+        (*handlers_[id])(ptr);
+      }
+    }
+  }
+
+ private:
+  port::Mutex mutex_;
+  ThreadData head_ GUARDED_BY(mutex_);  // Dummy head of the thread list
+  uint32_t next_id_ GUARDED_BY(mutex_);
+  std::vector<uint32_t> free_ids_ GUARDED_BY(mutex_);
+  std::vector<ThreadLocalPtr::UnrefHandler> handlers_ GUARDED_BY(mutex_);
+};
+
+// Registers the thread on first use and unregisters it on thread exit.
+class ThreadDataHolder {
+ public:
+  ThreadDataHolder() { Registry::Instance()->AddThread(&data_); }
+  ~ThreadDataHolder() { Registry::Instance()->RemoveThread(&data_); }
+
+  ThreadData* data() { return &data_; }
+
+ private:
+  ThreadData data_;
+};
+
+ThreadData* GetThreadData() {
+  static thread_local ThreadDataHolder holder;
+  return holder.data();
+}
+
+}  // namespace
+
+ThreadLocalPtr::ThreadLocalPtr(UnrefHandler handler)
+    : id_(Registry::Instance()->AcquireId(handler)) {}
+
+ThreadLocalPtr::~ThreadLocalPtr() { Registry::Instance()->ReleaseId(id_); }
+
+void* ThreadLocalPtr::Get() const {
+  ThreadData* t = GetThreadData();
+  if (id_ >= t->entries.size()) {
+    return nullptr;
+  }
+  return t->entries[id_].ptr.load(std::memory_order_acquire);
+}
+
+void* ThreadLocalPtr::Swap(void* ptr) {
+  ThreadData* t = GetThreadData();
+  if (id_ >= t->entries.size()) {
+    Registry::Instance()->Reserve(t, id_);
+  }
+  return t->entries[id_].ptr.exchange(ptr, std::memory_order_acq_rel);
+}
+
+bool ThreadLocalPtr::CompareAndSwap(void* ptr, void** expected) {
+  ThreadData* t = GetThreadData();
+  if (id_ >= t->entries.size()) {
+    Registry::Instance()->Reserve(t, id_);
+  }
+  return t->entries[id_].ptr.compare_exchange_strong(
+      *expected, ptr, std::memory_order_acq_rel, std::memory_order_acquire);
+}
+
+void ThreadLocalPtr::Scrape(std::vector<void*>* ptrs, void* replacement) {
+  Registry::Instance()->Scrape(id_, ptrs, replacement);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,56 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_UTIL_THREAD_LOCAL_H_
+#define STORAGE_LEVELDB_UTIL_THREAD_LOCAL_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace leveldb {
+
+// A pointer that holds a separate value for every thread.
+//
+// Unlike a thread_local variable, any number of ThreadLocalPtr objects can
+// be created at run time, and the owner can visit the values of all
+// threads (see Scrape()) to reclaim the objects they point to.
+//
+// Each thread accesses its own value without locking.
+class ThreadLocalPtr {
+ public:
+  // Called with the non-null value of a thread when the thread exits.
+  typedef void (*UnrefHandler)(void* ptr);
+
+  explicit ThreadLocalPtr(UnrefHandler handler = nullptr);
+
+  ThreadLocalPtr(const ThreadLocalPtr&) = delete;
+  ThreadLocalPtr& operator=(const ThreadLocalPtr&) = delete;
+
+  // REQUIRES: No thread holds a value that needs to be reclaimed, e.g.
+  // because the values were reclaimed with Scrape().
+  ~ThreadLocalPtr();
+
+  // Return the value of the calling thread.  Initially nullptr.
+  void* Get() const;
+
+  // Set the value of the calling thread to "ptr" and return the old value.
+  void* Swap(void* ptr);
+
+  // If the value of the calling thread is "*expected", set it to "ptr" and
+  // return true.  Otherwise store the value in "*expected" and return
+  // false.
+  bool CompareAndSwap(void* ptr, void** expected);
+
+  // Set the value of every thread to "replacement" and append the old
+  // values that were not nullptr to "*ptrs".
+  void Scrape(std::vector<void*>* ptrs, void* replacement);
+
+ private:
+  const uint32_t id_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_THREAD_LOCAL_H_
@@ -0,0 +1,130 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/thread_local.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "leveldb/env.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+class ThreadLocalTest {};
+
+static std::atomic<int> unref_count(0);
+
+static void CountUnref(void* ptr) {
+  unref_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+TEST(ThreadLocalTest, Basic) {
+  ThreadLocalPtr p;
+  int a, b;
+  ASSERT_TRUE(p.Get() == nullptr);
+  ASSERT_TRUE(p.Swap(&a) == nullptr);
+  ASSERT_EQ(&a, p.Get());
+  ASSERT_EQ(&a, p.Swap(&b));
+  ASSERT_EQ(&b, p.Get());
+
+  void* expected = &a;
+  ASSERT_TRUE(!p.CompareAndSwap(nullptr, &expected));
+  ASSERT_EQ(&b, expected);
+  ASSERT_TRUE(p.CompareAndSwap(nullptr, &expected));
+  ASSERT_TRUE(p.Get() == nullptr);
+}
+
+TEST(ThreadLocalTest, Independent) {
+  ThreadLocalPtr p1, p2;
+  int a, b;
+  p1.Swap(&a);
+  p2.Swap(&b);
+  ASSERT_EQ(&a, p1.Get());
+  ASSERT_EQ(&b, p2.Get());
+}
+
+TEST(ThreadLocalTest, ReusedIdStartsEmpty) {
+  int a;
+  for (int i = 0; i < 3; i++) {
+    ThreadLocalPtr p;
+    ASSERT_TRUE(p.Get() == nullptr);
+    p.Swap(&a);
+  }
+}
+
+namespace {
+
+struct ThreadArg {
+  ThreadLocalPtr* p;
+  int value;
+  std::atomic<int>* started;
+  std::atomic<bool>* exit;
+  bool ok;
+};
+
+}  // namespace
+
+static void ThreadBody(void* arg) {
+  ThreadArg* t = reinterpret_cast<ThreadArg*>(arg);
+  t->ok = (t->p->Get() == nullptr);
+  t->p->Swap(&t->value);
+  t->started->fetch_add(1, std::memory_order_release);
+  while (!t->exit->load(std::memory_order_acquire)) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+  // The value was replaced by Scrape().
+  if (t->p->Get() != nullptr) {
+    t->ok = false;
+  }
+  t->p->Swap(&t->value);
+}
+
+TEST(ThreadLocalTest, ScrapeAndThreadExit) {
+  const int kThreads = 4;
+  ThreadLocalPtr p(&CountUnref);
+  std::atomic<int> started(0);
+  std::atomic<bool> exit(false);
+  ThreadArg args[kThreads];
+  for (int i = 0; i < kThreads; i++) {
+    args[i].p = &p;
+    args[i].value = i;
+    args[i].started = &started;
+    args[i].exit = &exit;
+    args[i].ok = false;
+    Env::Default()->StartThread(ThreadBody, &args[i]);
+  }
+  while (started.load(std::memory_order_acquire) < kThreads) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+
+  int own;
+  p.Swap(&own);
+  std::vector<void*> ptrs;
+  p.Scrape(&ptrs, nullptr);
+  ASSERT_EQ(kThreads + 1, ptrs.size());
+  for (int i = 0; i < kThreads; i++) {
+    ASSERT_TRUE(std::find(ptrs.begin(), ptrs.end(), &args[i].value) !=
+                ptrs.end());
+  }
+  ASSERT_TRUE(std::find(ptrs.begin(), ptrs.end(), &own) != ptrs.end());
+  ASSERT_TRUE(p.Get() == nullptr);
+
+  // Every thread sets its value again and exits, which hands the value
+  // to the unref handler.
+  exit.store(true, std::memory_order_release);
+  while (unref_count.load(std::memory_order_relaxed) < kThreads) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+  for (int i = 0; i < kThreads; i++) {
+    ASSERT_TRUE(args[i].ok);
+  }
+  ptrs.clear();
+  p.Scrape(&ptrs, nullptr);
+  ASSERT_TRUE(ptrs.empty());
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) { return leveldb::test::RunAllTests(); }